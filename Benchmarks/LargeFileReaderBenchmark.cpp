@@ -0,0 +1,844 @@
+//
+//  LargeFileReaderBenchmark.cpp
+//  LargeFileReaderBenchmark
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+#include "LargeFileReaderCore.hpp"
+#include "LineIndexerCore.hpp"
+#include "SyntheticFileGenerator.hpp"
+
+// Measures LargeFileReaderCore and LineIndexerCore on synthetic files, for every combination of cache
+// block size and cache size:
+//
+// - sequential: read() the file from start to end.
+// - random:     lseek() + read() at random offsets (readAt() from multiple threads with --threads).
+// - mixed:      like random, but most reads go to a small hot part of the file.
+// - batch:      like random, but --batch-size reads at a time with readRanges(). Latencies are per batch.
+// - async:      like random, but with readAtAsync(), keeping --in-flight reads going at the same time.
+//               Latencies are from starting a read until its completion is called.
+// - index:      index the lines of the file.
+//
+// Each benchmark runs with a cold page cache (the file is dropped from it first, as far as the kernel
+// allows), unless --warm is given. Files are generated once, and reused by later runs.
+
+// MARK: - Options
+
+struct BenchmarkOptions
+{
+    std::string directory = ".";
+    std::vector<off_t> fileSizes;
+    std::vector<size_t> cacheBlockSizes;
+    std::vector<size_t> cacheMaxSizes;
+    std::vector<std::string> benchmarks = { "sequential", "random", "mixed", "batch", "async", "index" };
+    LineLengthDistribution lineLengthDistribution;
+    size_t sequentialReadSize = 1048576;
+    size_t randomReadSize = 4096;
+    size_t numberOfRandomReads = 20000;
+    // In the batch benchmark, the random reads are done batchSize at a time with readRanges.
+    size_t batchSize = 32;
+    // In the async benchmark, at most asyncReadsInFlight random reads are going at the same time.
+    size_t asyncReadsInFlight = 32;
+    // In the mixed benchmark, hotProbability of the reads go to hotFraction of the file.
+    double hotFraction = 0.05;
+    double hotProbability = 0.9;
+    size_t numberOfThreads = 1;
+    bool isDirectIO = false;
+    bool isMemoryMapped = false;
+    FileIOBackend::BackendType ioBackendType = FileIOBackend::BackendTypePosix;
+    CacheMemoryAllocator cacheMemoryAllocator;
+    // -1 keeps the reader's default.
+    off_t largeReadBypassThreshold = -1;
+    bool isWarm = false;
+    bool regenerate = false;
+    bool keepFiles = true;
+    std::string csvFilePath;
+};
+
+static void printUsage(const char* programName)
+{
+    printf("Usage: %s [options]\n"
+           "\n"
+           "  --directory DIR             where the synthetic files are (default .)\n"
+           "  --sizes LIST                file sizes, e.g. 1G,8G,1.5xRAM (default 1G,1.5xRAM)\n"
+           "  --line-lengths DIST         fixed:N, uniform:MIN-MAX, normal:MEAN,SD or\n"
+           "                              lognormal:MEDIAN,SIGMA (default lognormal:100,0.6)\n"
+           "  --block-sizes LIST          cacheBlockSize grid (default 4K,64K,1M)\n"
+           "  --cache-sizes LIST          cacheMaxSize grid (default 16M,256M,1G)\n"
+           "  --benchmarks LIST           sequential,random,mixed,batch,async,index (default all)\n"
+           "  --sequential-read-size N    bytes per read() when scanning (default 1M)\n"
+           "  --random-read-size N        bytes per random read (default 4K)\n"
+           "  --random-reads N            number of random reads (default 20000)\n"
+           "  --batch-size N              batch: random reads per readRanges (default 32)\n"
+           "  --in-flight N               async: random reads going at the same time (default 32)\n"
+           "  --hot-fraction F            mixed: size of the hot part of the file (default 0.05)\n"
+           "  --hot-probability P         mixed: part of the reads that go there (default 0.9)\n"
+           "  --threads N                 threads for random and mixed reads (default 1)\n"
+           "  --direct-io                 open with directIOEnabled\n"
+           "  --memory-mapped             open with memoryMappingEnabled\n"
+           "  --io-backend NAME           ioBackendType: posix or io_uring (default posix)\n"
+           "  --bypass-threshold N        largeReadBypassThreshold, 0 is off (default: the reader's)\n"
+           "  --page-type TYPE            cache pages: default, thp, 2m or 1g (default default)\n"
+           "  --numa POLICY               cache placement: default, interleave[:MASK] or bind:NODE\n"
+           "  --warm                      don't drop the file from the page cache first\n"
+           "  --regenerate                write the files even if they exist\n"
+           "  --remove-files              delete the files afterwards\n"
+           "  --csv FILE                  also write the results as CSV\n"
+           "  --quick                     small files and grid, for a smoke test\n",
+           programName);
+}
+
+static bool parseSizeList(const std::string& list, std::vector<off_t>& sizes)
+{
+    sizes.clear();
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        off_t size = SyntheticFileGenerator::parseSize(list.substr(start, end - start));
+        if (size <= 0)
+        {
+            return false;
+        }
+        sizes.push_back(size);
+        start = end + 1;
+    }
+    return !sizes.empty();
+}
+
+static bool parseSizeList(const std::string& list, std::vector<size_t>& sizes)
+{
+    std::vector<off_t> parsedSizes;
+    if (!parseSizeList(list, parsedSizes))
+    {
+        return false;
+    }
+    sizes.assign(parsedSizes.begin(), parsedSizes.end());
+    return true;
+}
+
+static bool parsePageType(const std::string& value, CacheMemoryAllocator& cacheMemoryAllocator)
+{
+    if (value == "default")
+    {
+        cacheMemoryAllocator.pageType = CacheMemoryAllocator::PageTypeDefault;
+    }
+    else if (value == "thp")
+    {
+        cacheMemoryAllocator.pageType = CacheMemoryAllocator::PageTypeTransparentHuge;
+    }
+    else if (value == "2m")
+    {
+        cacheMemoryAllocator.pageType = CacheMemoryAllocator::PageTypeHuge2MB;
+    }
+    else if (value == "1g")
+    {
+        cacheMemoryAllocator.pageType = CacheMemoryAllocator::PageTypeHuge1GB;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static const char* pageTypeName(CacheMemoryAllocator::PageType pageType)
+{
+    switch (pageType)
+    {
+        case CacheMemoryAllocator::PageTypeTransparentHuge:
+            return "thp";
+        case CacheMemoryAllocator::PageTypeHuge2MB:
+            return "2m";
+        case CacheMemoryAllocator::PageTypeHuge1GB:
+            return "1g";
+        case CacheMemoryAllocator::PageTypeDefault:
+        default:
+            return "default";
+    }
+}
+
+static bool parseNumaPolicy(const std::string& value, CacheMemoryAllocator& cacheMemoryAllocator)
+{
+    // interleave:MASK takes a mask of nodes (0x3 for nodes 0 and 1), bind:NODE a single node.
+    std::string policy = value.substr(0, value.find(':'));
+    std::string argument = (value.find(':') != std::string::npos) ? value.substr(value.find(':') + 1) : "";
+    char* end = nullptr;
+    unsigned long long number = strtoull(argument.c_str(), &end, 0);
+    bool hasNumber = !argument.empty() && (*end == '\0');
+
+    if ((policy == "default") && argument.empty())
+    {
+        cacheMemoryAllocator.numaPolicyType = CacheMemoryAllocator::NumaPolicyTypeDefault;
+    }
+    else if ((policy == "interleave") && (argument.empty() || hasNumber))
+    {
+        cacheMemoryAllocator.numaPolicyType = CacheMemoryAllocator::NumaPolicyTypeInterleave;
+        cacheMemoryAllocator.numaNodeMask = argument.empty() ? 0 : number;
+    }
+    else if ((policy == "bind") && hasNumber && (number < 64))
+    {
+        cacheMemoryAllocator.numaPolicyType = CacheMemoryAllocator::NumaPolicyTypeBind;
+        cacheMemoryAllocator.numaNodeMask = (uint64_t)1 << number;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+    bool isQuick = false;
+    std::string fileSizes = "1G,1.5xRAM";
+    std::string cacheBlockSizes = "4K,64K,1M";
+    std::string cacheMaxSizes = "16M,256M,1G";
+    std::string benchmarks;
+    std::string lineLengths;
+
+    for (int argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+    {
+        std::string argument = argv[argumentIndex];
+        bool hasValue = (argumentIndex + 1) < argc;
+        std::string value = hasValue ? argv[argumentIndex + 1] : "";
+
+        if (argument == "--quick")
+        {
+            isQuick = true;
+            continue;
+        }
+        if (argument == "--direct-io")
+        {
+            options.isDirectIO = true;
+            continue;
+        }
+        if (argument == "--memory-mapped")
+        {
+            options.isMemoryMapped = true;
+            continue;
+        }
+        if (argument == "--warm")
+        {
+            options.isWarm = true;
+            continue;
+        }
+        if (argument == "--regenerate")
+        {
+            options.regenerate = true;
+            continue;
+        }
+        if (argument == "--remove-files")
+        {
+            options.keepFiles = false;
+            continue;
+        }
+        if ((argument == "--help") || (argument == "-h") || !hasValue)
+        {
+            return false;
+        }
+
+        argumentIndex++;
+        if (argument == "--directory")
+        {
+            options.directory = value;
+        }
+        else if (argument == "--sizes")
+        {
+            fileSizes = value;
+        }
+        else if (argument == "--line-lengths")
+        {
+            lineLengths = value;
+        }
+        else if (argument == "--block-sizes")
+        {
+            cacheBlockSizes = value;
+        }
+        else if (argument == "--cache-sizes")
+        {
+            cacheMaxSizes = value;
+        }
+        else if (argument == "--benchmarks")
+        {
+            benchmarks = value;
+        }
+        else if (argument == "--sequential-read-size")
+        {
+            options.sequentialReadSize = SyntheticFileGenerator::parseSize(value);
+        }
+        else if (argument == "--random-read-size")
+        {
+            options.randomReadSize = SyntheticFileGenerator::parseSize(value);
+        }
+        else if (argument == "--random-reads")
+        {
+            options.numberOfRandomReads = strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (argument == "--batch-size")
+        {
+            options.batchSize = std::max(1ull, strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (argument == "--in-flight")
+        {
+            options.asyncReadsInFlight = std::max(1ull, strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (argument == "--hot-fraction")
+        {
+            options.hotFraction = strtod(value.c_str(), nullptr);
+        }
+        else if (argument == "--hot-probability")
+        {
+            options.hotProbability = strtod(value.c_str(), nullptr);
+        }
+        else if (argument == "--threads")
+        {
+            options.numberOfThreads = std::max(1ull, strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (argument == "--bypass-threshold")
+        {
+            options.largeReadBypassThreshold = SyntheticFileGenerator::parseSize(value);
+            if (options.largeReadBypassThreshold < 0)
+            {
+                return false;
+            }
+        }
+        else if (argument == "--io-backend")
+        {
+            if (value == "posix")
+            {
+                options.ioBackendType = FileIOBackend::BackendTypePosix;
+            }
+            else if (value == "io_uring")
+            {
+                options.ioBackendType = FileIOBackend::BackendTypeIOUring;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (argument == "--page-type")
+        {
+            if (!parsePageType(value, options.cacheMemoryAllocator))
+            {
+                return false;
+            }
+        }
+        else if (argument == "--numa")
+        {
+            if (!parseNumaPolicy(value, options.cacheMemoryAllocator))
+            {
+                return false;
+            }
+        }
+        else if (argument == "--csv")
+        {
+            options.csvFilePath = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (isQuick)
+    {
+        // Explicit options still win over these.
+        bool hasFileSizes = false, hasBlockSizes = false, hasCacheSizes = false, hasRandomReads = false;
+        for (int argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+        {
+            hasFileSizes |= (strcmp(argv[argumentIndex], "--sizes") == 0);
+            hasBlockSizes |= (strcmp(argv[argumentIndex], "--block-sizes") == 0);
+            hasCacheSizes |= (strcmp(argv[argumentIndex], "--cache-sizes") == 0);
+            hasRandomReads |= (strcmp(argv[argumentIndex], "--random-reads") == 0);
+        }
+        fileSizes = hasFileSizes ? fileSizes : "16M";
+        cacheBlockSizes = hasBlockSizes ? cacheBlockSizes : "4K,64K";
+        cacheMaxSizes = hasCacheSizes ? cacheMaxSizes : "1M,32M";
+        options.numberOfRandomReads = hasRandomReads ? options.numberOfRandomReads : 2000;
+    }
+
+    if (!parseSizeList(fileSizes, options.fileSizes) || !parseSizeList(cacheBlockSizes, options.cacheBlockSizes) ||
+        !parseSizeList(cacheMaxSizes, options.cacheMaxSizes))
+    {
+        return false;
+    }
+    if (!lineLengths.empty() && !options.lineLengthDistribution.parse(lineLengths))
+    {
+        return false;
+    }
+    if (!benchmarks.empty())
+    {
+        options.benchmarks.clear();
+        size_t start = 0;
+        while (start <= benchmarks.size())
+        {
+            size_t end = std::min(benchmarks.find(',', start), benchmarks.size());
+            std::string benchmark = benchmarks.substr(start, end - start);
+            if ((benchmark != "sequential") && (benchmark != "random") && (benchmark != "mixed") && (benchmark != "batch") && (benchmark != "async") && (benchmark != "index"))
+            {
+                return false;
+            }
+            options.benchmarks.push_back(benchmark);
+            start = end + 1;
+        }
+    }
+
+    return (options.sequentialReadSize > 0) && (options.randomReadSize > 0) && (options.numberOfRandomReads > 0) &&
+           (options.hotFraction > 0.0) && (options.hotFraction <= 1.0) && (options.hotProbability >= 0.0) && (options.hotProbability <= 1.0);
+}
+
+// MARK: - Measuring
+
+struct BenchmarkResult
+{
+    std::string benchmark;
+    off_t fileSize = 0;
+    size_t cacheBlockSize = 0;
+    size_t cacheMaxSize = 0;
+    uint64_t bytesRead = 0;
+    uint64_t numberOfOperations = 0;
+    double seconds = 0.0;
+    // Latency of single operations, in nanoseconds. Empty for the index benchmark.
+    std::vector<uint64_t> latencies;
+    CacheStatistics::Snapshot statistics;
+    bool isSuccess = true;
+};
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+static uint64_t nanosecondsSince(BenchmarkClock::time_point startTime)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - startTime).count();
+}
+
+// The given percentile of the latencies, in microseconds. Sorts the latencies.
+static double latencyPercentile(std::vector<uint64_t>& latencies, double percentile)
+{
+    if (latencies.empty())
+    {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil((percentile / 100.0) * (double)latencies.size());
+    rank = std::max((size_t)1, std::min(rank, latencies.size()));
+    std::nth_element(latencies.begin(), latencies.begin() + (rank - 1), latencies.end());
+    return (double)latencies[rank - 1] / 1000.0;
+}
+
+// Drop the file from the page cache, so that the benchmark reads from the disk. The kernel only drops
+// pages that are not dirty and not mapped, but that's all of them for a file that we just wrote and
+// synced.
+static void dropFileFromPageCache(const std::string& filePath)
+{
+    int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+    {
+        return;
+    }
+    fdatasync(fileDescriptor);
+#if defined(POSIX_FADV_DONTNEED)
+    posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fileDescriptor);
+}
+
+// MARK: - Benchmarks
+
+static void benchmarkSequential(LargeFileReaderCore& reader, const BenchmarkOptions& options, BenchmarkResult& result)
+{
+    std::vector<unsigned char> buffer(options.sequentialReadSize);
+    result.latencies.reserve((size_t)(reader.fileSize() / options.sequentialReadSize) + 1);
+
+    BenchmarkClock::time_point startTime = BenchmarkClock::now();
+    while (true)
+    {
+        BenchmarkClock::time_point readStartTime = BenchmarkClock::now();
+        size_t bytesRead = reader.read(buffer.data(), buffer.size());
+        if (bytesRead == (size_t)-1)
+        {
+            result.isSuccess = false;
+            break;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        result.latencies.push_back(nanosecondsSince(readStartTime));
+        result.bytesRead += bytesRead;
+        result.numberOfOperations++;
+    }
+    result.seconds = (double)nanosecondsSince(startTime) / 1e9;
+}
+
+// Random reads, or mixed hot/cold reads if isMixed is set.
+static void benchmarkRandom(LargeFileReaderCore& reader, const BenchmarkOptions& options, bool isMixed, bool isBatched, BenchmarkResult& result)
+{
+    off_t fileSize = reader.fileSize();
+    off_t lastOffset = std::max((off_t)0, fileSize - (off_t)options.randomReadSize);
+    // The hot part is somewhere in the middle, not at the start, which read-ahead and the generator
+    // might treat differently.
+    off_t hotSize = std::max((off_t)1, (off_t)((double)(lastOffset + 1) * options.hotFraction));
+    off_t hotOffset = (lastOffset + 1 - hotSize) / 2;
+
+    std::vector<std::vector<uint64_t>> threadLatencies(options.numberOfThreads);
+    std::vector<uint64_t> threadBytesRead(options.numberOfThreads, 0);
+    std::vector<bool> threadSuccess(options.numberOfThreads, true);
+
+    auto readRandomly = [&](size_t threadNumber)
+    {
+        std::mt19937_64 randomGenerator(1234 + threadNumber);
+        std::uniform_real_distribution<double> hotOrCold(0.0, 1.0);
+        std::vector<unsigned char> buffer(options.randomReadSize * (isBatched ? options.batchSize : 1));
+        std::vector<LargeFileReaderCore::ReadRequest> readRequests;
+        size_t numberOfReads = options.numberOfRandomReads / options.numberOfThreads;
+        if (threadNumber < (options.numberOfRandomReads % options.numberOfThreads))
+        {
+            numberOfReads++;
+        }
+        threadLatencies[threadNumber].reserve(numberOfReads);
+
+        for (size_t readNumber = 0; readNumber < numberOfReads; readNumber++)
+        {
+            off_t offset;
+            if (isMixed && (hotOrCold(randomGenerator) < options.hotProbability))
+            {
+                offset = hotOffset + (off_t)(randomGenerator() % (uint64_t)hotSize);
+            }
+            else
+            {
+                offset = (off_t)(randomGenerator() % (uint64_t)(lastOffset + 1));
+            }
+
+            if (isBatched)
+            {
+                // Collect the ranges, and read them together when the batch is full.
+                LargeFileReaderCore::ReadRequest readRequest;
+                readRequest.fileOffset = offset;
+                readRequest.buffer = &buffer[readRequests.size() * options.randomReadSize];
+                readRequest.length = options.randomReadSize;
+                readRequests.push_back(readRequest);
+                if ((readRequests.size() < options.batchSize) && ((readNumber + 1) < numberOfReads))
+                {
+                    continue;
+                }
+            }
+
+            BenchmarkClock::time_point readStartTime = BenchmarkClock::now();
+            size_t bytesRead;
+            if (isBatched)
+            {
+                bytesRead = reader.readRanges(readRequests.data(), readRequests.size());
+                readRequests.clear();
+            }
+            else if (options.numberOfThreads == 1)
+            {
+                // What a single consumer does.
+                reader.lseek(offset, SEEK_SET);
+                bytesRead = reader.read(buffer.data(), buffer.size());
+            }
+            else
+            {
+                bytesRead = reader.readAt(offset, buffer.data(), buffer.size());
+            }
+            threadLatencies[threadNumber].push_back(nanosecondsSince(readStartTime));
+            if (bytesRead == (size_t)-1)
+            {
+                threadSuccess[threadNumber] = false;
+                return;
+            }
+            threadBytesRead[threadNumber] += bytesRead;
+        }
+    };
+
+    BenchmarkClock::time_point startTime = BenchmarkClock::now();
+    if (options.numberOfThreads == 1)
+    {
+        readRandomly(0);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (size_t threadNumber = 0; threadNumber < options.numberOfThreads; threadNumber++)
+        {
+            threads.emplace_back(readRandomly, threadNumber);
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+    result.seconds = (double)nanosecondsSince(startTime) / 1e9;
+
+    for (size_t threadNumber = 0; threadNumber < options.numberOfThreads; threadNumber++)
+    {
+        result.latencies.insert(result.latencies.end(), threadLatencies[threadNumber].begin(), threadLatencies[threadNumber].end());
+        result.bytesRead += threadBytesRead[threadNumber];
+        result.isSuccess = result.isSuccess && threadSuccess[threadNumber];
+    }
+    // A batch has one latency, but is batchSize operations, like in the random benchmark.
+    result.numberOfOperations = isBatched ? options.numberOfRandomReads : result.latencies.size();
+}
+
+// Random reads with readAtAsync, asyncReadsInFlight at a time. A buffer is handed to the next read as
+// soon as the completion of its previous one is called.
+static void benchmarkAsync(LargeFileReaderCore& reader, const BenchmarkOptions& options, BenchmarkResult& result)
+{
+    off_t lastOffset = std::max((off_t)0, reader.fileSize() - (off_t)options.randomReadSize);
+    std::mt19937_64 randomGenerator(1234);
+
+    std::vector<std::vector<unsigned char>> buffers(options.asyncReadsInFlight, std::vector<unsigned char>(options.randomReadSize));
+    std::vector<BenchmarkClock::time_point> readStartTimes(options.asyncReadsInFlight);
+    // Protects everything below, which the completions update.
+    std::mutex completionMutex;
+    std::condition_variable completionCondition;
+    std::vector<size_t> freeBuffers;
+    for (size_t bufferNumber = 0; bufferNumber < buffers.size(); bufferNumber++)
+    {
+        freeBuffers.push_back(bufferNumber);
+    }
+    result.latencies.reserve(options.numberOfRandomReads);
+
+    BenchmarkClock::time_point startTime = BenchmarkClock::now();
+    for (size_t readNumber = 0; readNumber < options.numberOfRandomReads; readNumber++)
+    {
+        size_t bufferNumber;
+        {
+            std::unique_lock<std::mutex> lock(completionMutex);
+            completionCondition.wait(lock, [&freeBuffers] { return !freeBuffers.empty(); });
+            bufferNumber = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        off_t offset = (off_t)(randomGenerator() % (uint64_t)(lastOffset + 1));
+        readStartTimes[bufferNumber] = BenchmarkClock::now();
+        reader.readAtAsync(offset, buffers[bufferNumber].data(), options.randomReadSize, [&, bufferNumber](size_t bytesRead)
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            result.latencies.push_back(nanosecondsSince(readStartTimes[bufferNumber]));
+            if (bytesRead == (size_t)-1)
+            {
+                result.isSuccess = false;
+            }
+            else
+            {
+                result.bytesRead += bytesRead;
+            }
+            freeBuffers.push_back(bufferNumber);
+            completionCondition.notify_one();
+        });
+    }
+
+    // Wait for the last reads.
+    std::unique_lock<std::mutex> lock(completionMutex);
+    completionCondition.wait(lock, [&] { return freeBuffers.size() == buffers.size(); });
+    result.seconds = (double)nanosecondsSince(startTime) / 1e9;
+    result.numberOfOperations = result.latencies.size();
+}
+
+static void benchmarkIndex(LargeFileReaderCore& reader, BenchmarkResult& result)
+{
+    LineIndexerCore lineIndexer;
+
+    BenchmarkClock::time_point startTime = BenchmarkClock::now();
+    result.isSuccess = (lineIndexer.indexLinesForFileReader(&reader) == 0);
+    result.seconds = (double)nanosecondsSince(startTime) / 1e9;
+
+    result.bytesRead = reader.fileSize();
+    result.numberOfOperations = (lineIndexer.numberOfLines > 0) ? lineIndexer.numberOfLines : 0;
+}
+
+// MARK: - Reporting
+
+static void printResultHeader()
+{
+    printf("%-10s %8s %8s %8s %10s %12s %10s %10s %7s\n", "benchmark", "file", "block", "cache", "MB/s", "ops/s", "p50 us", "p99 us", "hit %");
+}
+
+static void printResult(BenchmarkResult& result, FILE* csvFile)
+{
+    double megabytesPerSecond = (result.seconds > 0.0) ? ((double)result.bytesRead / 1048576.0) / result.seconds : 0.0;
+    double operationsPerSecond = (result.seconds > 0.0) ? (double)result.numberOfOperations / result.seconds : 0.0;
+    double p50 = latencyPercentile(result.latencies, 50.0);
+    double p99 = latencyPercentile(result.latencies, 99.0);
+    double hitRate = result.statistics.hitRate() * 100.0;
+
+    printf("%-10s %8s %8s %8s %10.1f %12.0f %10.1f %10.1f %7.2f%s\n", result.benchmark.c_str(),
+           SyntheticFileGenerator::formatSize(result.fileSize).c_str(), SyntheticFileGenerator::formatSize(result.cacheBlockSize).c_str(),
+           SyntheticFileGenerator::formatSize(result.cacheMaxSize).c_str(), megabytesPerSecond, operationsPerSecond, p50, p99, hitRate,
+           result.isSuccess ? "" : "  FAILED");
+    fflush(stdout);
+
+    if (csvFile != nullptr)
+    {
+        fprintf(csvFile, "%s,%lld,%zu,%zu,%llu,%llu,%.6f,%.3f,%.3f,%.3f,%.3f,%.6f,%llu,%llu,%llu,%s\n", result.benchmark.c_str(),
+                (long long)result.fileSize, result.cacheBlockSize, result.cacheMaxSize, (unsigned long long)result.bytesRead,
+                (unsigned long long)result.numberOfOperations, result.seconds, megabytesPerSecond, operationsPerSecond, p50, p99,
+                result.statistics.hitRate(), (unsigned long long)result.statistics.numberOfEvictions,
+                (unsigned long long)result.statistics.bytesReadFromFile, (unsigned long long)result.statistics.fetchLatencyPercentile(99.0),
+                result.isSuccess ? "ok" : "failed");
+        fflush(csvFile);
+    }
+}
+
+// MARK: - Main
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    FILE* csvFile = nullptr;
+    if (!options.csvFilePath.empty())
+    {
+        csvFile = fopen(options.csvFilePath.c_str(), "w");
+        if (csvFile == nullptr)
+        {
+            fprintf(stderr, "Can't write %s\n", options.csvFilePath.c_str());
+            return 1;
+        }
+        fprintf(csvFile, "benchmark,file_size,cache_block_size,cache_max_size,bytes,operations,seconds,mb_per_second,ops_per_second,"
+                         "p50_us,p99_us,hit_rate,evictions,bytes_read_from_file,fetch_p99_us,status\n");
+    }
+
+    printf("Physical memory %s, line lengths %s, %zu thread(s)%s%s%s%s\n\n", SyntheticFileGenerator::formatSize(SyntheticFileGenerator::physicalMemorySize()).c_str(),
+           options.lineLengthDistribution.name().c_str(), options.numberOfThreads, options.isDirectIO ? ", direct I/O" : "",
+           options.isMemoryMapped ? ", memory mapped" : "", (options.ioBackendType == FileIOBackend::BackendTypeIOUring) ? ", io_uring" : "",
+           options.isWarm ? ", warm page cache" : "");
+
+    int exitCode = 0;
+    bool isPageTypeFallbackReported = false;
+    for (off_t fileSize : options.fileSizes)
+    {
+        SyntheticFileGenerator generator;
+        generator.lineLengthDistribution = options.lineLengthDistribution;
+        std::string filePath = options.directory + "/largefilereader_benchmark_" + std::to_string((long long)fileSize) + "_" + options.lineLengthDistribution.name() + ".log";
+
+        printf("Generating %s (%s)...\n", filePath.c_str(), SyntheticFileGenerator::formatSize(fileSize).c_str());
+        fflush(stdout);
+        BenchmarkClock::time_point generateStartTime = BenchmarkClock::now();
+        if (!generator.generateFile(filePath, fileSize, options.regenerate))
+        {
+            fprintf(stderr, "Can't write %s\n", filePath.c_str());
+            exitCode = 1;
+            continue;
+        }
+        printf("Ready in %.1fs\n\n", (double)nanosecondsSince(generateStartTime) / 1e9);
+        printResultHeader();
+
+        for (size_t cacheBlockSize : options.cacheBlockSizes)
+        {
+            for (size_t cacheMaxSize : options.cacheMaxSizes)
+            {
+                if (cacheBlockSize > cacheMaxSize)
+                {
+                    continue;
+                }
+
+                for (const std::string& benchmark : options.benchmarks)
+                {
+                    if (!options.isWarm)
+                    {
+                        dropFileFromPageCache(filePath);
+                    }
+
+                    LargeFileReaderCore reader;
+                    reader.directIOEnabled = options.isDirectIO;
+                    reader.memoryMappingEnabled = options.isMemoryMapped;
+                    reader.ioBackendType = options.ioBackendType;
+                    reader.cacheMemoryAllocator = options.cacheMemoryAllocator;
+                    if (options.largeReadBypassThreshold >= 0)
+                    {
+                        reader.largeReadBypassThreshold = options.largeReadBypassThreshold;
+                    }
+                    BenchmarkResult result;
+                    result.benchmark = benchmark;
+                    result.fileSize = fileSize;
+                    result.cacheBlockSize = cacheBlockSize;
+                    result.cacheMaxSize = cacheMaxSize;
+                    try
+                    {
+                        result.isSuccess = reader.open(filePath, cacheMaxSize, cacheBlockSize);
+                    }
+                    catch (const std::exception& exception)
+                    {
+                        result.isSuccess = false;
+                    }
+
+                    if (result.isSuccess && (reader.cacheActualPageType != options.cacheMemoryAllocator.pageType) && !isPageTypeFallbackReported)
+                    {
+                        // Usually no huge pages reserved (vm.nr_hugepages), or THP is switched off.
+                        fprintf(stderr, "cache pages: asked for %s, got %s\n", pageTypeName(options.cacheMemoryAllocator.pageType),
+                                pageTypeName(reader.cacheActualPageType));
+                        isPageTypeFallbackReported = true;
+                    }
+
+                    if (result.isSuccess)
+                    {
+                        if (benchmark == "sequential")
+                        {
+                            benchmarkSequential(reader, options, result);
+                        }
+                        else if ((benchmark == "random") || (benchmark == "mixed") || (benchmark == "batch"))
+                        {
+                            benchmarkRandom(reader, options, benchmark == "mixed", benchmark == "batch", result);
+                        }
+                        else if (benchmark == "async")
+                        {
+                            benchmarkAsync(reader, options, result);
+                        }
+                        else
+                        {
+                            benchmarkIndex(reader, result);
+                        }
+                        reader.statisticsSnapshot(result.statistics);
+                        reader.close();
+                    }
+
+                    if (!result.isSuccess)
+                    {
+                        exitCode = 1;
+                    }
+                    printResult(result, csvFile);
+                }
+            }
+        }
+        printf("\n");
+
+        if (!options.keepFiles)
+        {
+            ::unlink(filePath.c_str());
+        }
+    }
+
+    if (csvFile != nullptr)
+    {
+        fclose(csvFile);
+    }
+    return exitCode;
+}
@@ -0,0 +1,278 @@
+//
+//  SyntheticFileGenerator.cpp
+//  LargeFileReaderBenchmark
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "SyntheticFileGenerator.hpp"
+
+// MARK: - LineLengthDistribution
+
+bool LineLengthDistribution::parse(const std::string& description)
+{
+    size_t colon = description.find(':');
+    if (colon == std::string::npos)
+    {
+        return false;
+    }
+    std::string type = description.substr(0, colon);
+    std::string parameters = description.substr(colon + 1);
+
+    char* end = nullptr;
+    double firstParameter = strtod(parameters.c_str(), &end);
+    if ((end == parameters.c_str()) || (firstParameter < 0.0))
+    {
+        return false;
+    }
+    double secondParameter = 0.0;
+    if (type != "fixed")
+    {
+        if ((*end != ',') && (*end != '-'))
+        {
+            return false;
+        }
+        const char* secondStart = end + 1;
+        secondParameter = strtod(secondStart, &end);
+        if ((end == secondStart) || (secondParameter < 0.0))
+        {
+            return false;
+        }
+    }
+    if (*end != '\0')
+    {
+        return false;
+    }
+
+    if (type == "fixed")
+    {
+        distributionType = DistributionTypeFixed;
+    }
+    else if ((type == "uniform") && (firstParameter <= secondParameter))
+    {
+        distributionType = DistributionTypeUniform;
+    }
+    else if (type == "normal")
+    {
+        distributionType = DistributionTypeNormal;
+    }
+    else if ((type == "lognormal") && (firstParameter >= 1.0))
+    {
+        distributionType = DistributionTypeLogNormal;
+    }
+    else
+    {
+        return false;
+    }
+    parameter1 = firstParameter;
+    parameter2 = secondParameter;
+    return true;
+}
+
+std::string LineLengthDistribution::name() const
+{
+    char name[64];
+    switch (distributionType)
+    {
+        case DistributionTypeFixed:
+            snprintf(name, sizeof(name), "fixed%g", parameter1);
+            break;
+        case DistributionTypeUniform:
+            snprintf(name, sizeof(name), "uniform%g-%g", parameter1, parameter2);
+            break;
+        case DistributionTypeNormal:
+            snprintf(name, sizeof(name), "normal%g-%g", parameter1, parameter2);
+            break;
+        case DistributionTypeLogNormal:
+        default:
+            snprintf(name, sizeof(name), "lognormal%g-%g", parameter1, parameter2);
+            break;
+    }
+    return name;
+}
+
+size_t LineLengthDistribution::nextLineLength(std::mt19937_64& randomGenerator) const
+{
+    double length;
+    switch (distributionType)
+    {
+        case DistributionTypeFixed:
+            length = parameter1;
+            break;
+        case DistributionTypeUniform:
+            length = std::uniform_real_distribution<double>(parameter1, parameter2 + 1.0)(randomGenerator);
+            break;
+        case DistributionTypeNormal:
+            length = std::normal_distribution<double>(parameter1, parameter2)(randomGenerator);
+            break;
+        case DistributionTypeLogNormal:
+        default:
+            length = std::lognormal_distribution<double>(log(parameter1), parameter2)(randomGenerator);
+            break;
+    }
+    return (size_t)std::max(0.0, std::min(floor(length), (double)maximumLineLength));
+}
+
+// MARK: - SyntheticFileGenerator
+
+// Strategy (generating):
+//
+// Generating must be much faster than the disk, or making a file larger than memory takes forever. So
+// we don't make up text for every line: we make up a few MB of text (words from a small vocabulary, so
+// it compresses and searches like a log) once, and every line is a copy of a random piece of it. The
+// lines are collected in a large buffer that is written in one go.
+
+bool SyntheticFileGenerator::generateFile(const std::string& filePath, off_t fileSize, bool regenerate)
+{
+    struct stat fileStatus;
+    if (!regenerate && (::stat(filePath.c_str(), &fileStatus) == 0) && (fileStatus.st_size == fileSize))
+    {
+        return true;
+    }
+
+    std::mt19937_64 randomGenerator(seed);
+
+    static const char* const words[] = {
+        "INFO", "WARN", "ERROR", "DEBUG", "request", "response", "user", "session", "timeout", "connection",
+        "opened", "closed", "GET", "POST", "/api/v1/items", "200", "404", "500", "cache", "miss", "hit",
+        "latency=12ms", "bytes=4096", "retry", "worker-7", "queue", "flushed", "checkpoint", "id=8f3a2c"
+    };
+    const size_t numberOfWords = sizeof(words) / sizeof(words[0]);
+    const size_t textSize = 4194304;
+    std::string text;
+    text.reserve(textSize + 64);
+    while (text.size() < textSize)
+    {
+        text += words[randomGenerator() % numberOfWords];
+        text += ' ';
+    }
+
+    std::string temporaryFilePath = filePath + ".tmp";
+    int fileDescriptor = ::open(temporaryFilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    const size_t writeBufferSize = 16777216;
+    std::vector<char> writeBuffer;
+    writeBuffer.reserve(writeBufferSize + lineLengthDistribution.maximumLineLength + 1);
+
+    off_t bytesWritten = 0;
+    bool isSuccess = true;
+    while (isSuccess && (bytesWritten < fileSize))
+    {
+        writeBuffer.clear();
+        while ((writeBuffer.size() < writeBufferSize) && ((bytesWritten + (off_t)writeBuffer.size()) < fileSize))
+        {
+            // Lines longer than the text are made of multiple pieces.
+            size_t lineLength = lineLengthDistribution.nextLineLength(randomGenerator);
+            while (lineLength > 0)
+            {
+                size_t pieceLength = std::min(lineLength, textSize);
+                size_t pieceOffset = randomGenerator() % (textSize - pieceLength + 1);
+                writeBuffer.insert(writeBuffer.end(), &text[pieceOffset], &text[pieceOffset + pieceLength]);
+                lineLength -= pieceLength;
+            }
+            writeBuffer.push_back('\n');
+        }
+
+        size_t length = (size_t)std::min((off_t)writeBuffer.size(), fileSize - bytesWritten);
+        size_t offset = 0;
+        while (offset < length)
+        {
+            ssize_t written = ::write(fileDescriptor, &writeBuffer[offset], length - offset);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                isSuccess = false;
+                break;
+            }
+            offset += written;
+        }
+        bytesWritten += offset;
+    }
+
+    if ((::close(fileDescriptor) != 0) || !isSuccess || (::rename(temporaryFilePath.c_str(), filePath.c_str()) != 0))
+    {
+        ::unlink(temporaryFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+off_t SyntheticFileGenerator::physicalMemorySize()
+{
+    return (off_t)sysconf(_SC_PHYS_PAGES) * (off_t)sysconf(_SC_PAGESIZE);
+}
+
+off_t SyntheticFileGenerator::parseSize(const std::string& description)
+{
+    char* end = nullptr;
+    double value = strtod(description.c_str(), &end);
+    if ((end == description.c_str()) || (value < 0.0))
+    {
+        return -1;
+    }
+
+    std::string unit = end;
+    double multiplier;
+    if (unit.empty())
+    {
+        multiplier = 1.0;
+    }
+    else if ((unit == "K") || (unit == "k"))
+    {
+        multiplier = 1024.0;
+    }
+    else if ((unit == "M") || (unit == "m"))
+    {
+        multiplier = 1024.0 * 1024.0;
+    }
+    else if ((unit == "G") || (unit == "g"))
+    {
+        multiplier = 1024.0 * 1024.0 * 1024.0;
+    }
+    else if ((unit == "T") || (unit == "t"))
+    {
+        multiplier = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+    }
+    else if ((unit == "xRAM") || (unit == "xram"))
+    {
+        multiplier = (double)physicalMemorySize();
+    }
+    else
+    {
+        return -1;
+    }
+    return (off_t)(value * multiplier);
+}
+
+std::string SyntheticFileGenerator::formatSize(off_t size)
+{
+    static const char* const units[] = { "", "K", "M", "G", "T" };
+    double value = (double)size;
+    int unit = 0;
+    while ((value >= 1024.0) && (unit < 4))
+    {
+        value /= 1024.0;
+        unit++;
+    }
+
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.3g%s", value, units[unit]);
+    return formatted;
+}
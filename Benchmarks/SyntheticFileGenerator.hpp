@@ -0,0 +1,80 @@
+//
+//  SyntheticFileGenerator.hpp
+//  LargeFileReaderBenchmark
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef SyntheticFileGenerator_hpp
+#define SyntheticFileGenerator_hpp
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <random>
+
+// The lengths of the lines of a synthetic file (without the delimiter).
+class LineLengthDistribution
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum DistributionType
+    {
+        // Every line is parameter1 bytes.
+        DistributionTypeFixed,
+        // Uniform between parameter1 and parameter2 bytes.
+        DistributionTypeUniform,
+        // Normal, with mean parameter1 and standard deviation parameter2.
+        DistributionTypeNormal,
+        // Log-normal, with median parameter1 and shape (sigma) parameter2. Mostly short lines with a
+        // long tail of long ones, which is what real logs look like.
+        DistributionTypeLogNormal
+    };
+
+    // MARK: - Public properties
+
+    DistributionType distributionType = DistributionTypeLogNormal;
+    double parameter1 = 100.0;
+    double parameter2 = 0.6;
+    // Lines are never longer than this.
+    size_t maximumLineLength = 1048576;
+
+    // MARK: - Public methods
+
+    // Parse "fixed:N", "uniform:MIN-MAX", "normal:MEAN,STDDEV" or "lognormal:MEDIAN,SIGMA". Returns
+    // false if the description is not valid.
+    bool parse(const std::string& description);
+    // A short description, usable in a file name.
+    std::string name() const;
+
+    size_t nextLineLength(std::mt19937_64& randomGenerator) const;
+};
+
+// Writes files of text lines with a given distribution of line lengths.
+class SyntheticFileGenerator
+{
+public:
+
+    // MARK: - Public properties
+
+    LineLengthDistribution lineLengthDistribution;
+    uint64_t seed = 42;
+
+    // MARK: - Public methods
+
+    // Write a file of exactly fileSize bytes (the last line is cut off if needed). If the file exists
+    // and has that size already, it is left alone, unless regenerate is set. Returns false if the file
+    // could not be written.
+    bool generateFile(const std::string& filePath, off_t fileSize, bool regenerate);
+
+    // The size of the physical memory of the machine, for sizes like "2xRAM".
+    static off_t physicalMemorySize();
+    // Parse a size like "4096", "64K", "256M", "1G", "1.5T" or "2xRAM". Returns -1 if it is not valid.
+    static off_t parseSize(const std::string& description);
+    // Format a size as the shortest of "64K", "1.5G", etc.
+    static std::string formatSize(off_t size);
+};
+
+#endif /* SyntheticFileGenerator_hpp */
@@ -0,0 +1,72 @@
+//
+//  CacheBlockMap.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef CacheBlockMap_hpp
+#define CacheBlockMap_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "CacheMemoryAllocator.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Maps the index of a file data block to the cache block that holds its data.
+//
+// This is an open addressing hash table with linear probing. It is sized for the number of blocks
+// that fit in the cache, not for the size of the file, so its memory use is bounded by the cache.
+// The table is kept at most half full, so lookups are O(1) and usually need a single probe.
+class CacheBlockMap
+{
+public:
+    
+    // MARK: - Public methods
+    
+    // The slots are allocated with the allocator, so that they can be on huge pages too: for a large
+    // cache the map is large as well, and every lookup touches it at a random place.
+    CacheBlockMap(int64_t maximumNumberOfEntries, const CacheMemoryAllocator& memoryAllocator = CacheMemoryAllocator());
+    ~CacheBlockMap();
+    
+    // Returns the cache block for the index, or -1 if the index is not in the map.
+    int64_t find(int64_t index) const;
+    // Add the index. The index must not be in the map yet, and the map must not be full.
+    void insert(int64_t index, int64_t cacheBlock);
+    // Remove the index. Does nothing if the index is not in the map.
+    void erase(int64_t index);
+    
+private:
+    
+    // MARK: - Private definitions
+    
+    struct MapSlot
+    {
+        // Index of the file data block, or -1 if the slot is empty.
+        int64_t index = -1;
+        int64_t cacheBlock = -1;
+    };
+    
+    // MARK: - Private properties
+    
+    MapSlot* mapSlots;
+    CacheMemoryAllocator::Allocation mapSlotsAllocation;
+    // Number of slots is always a power of 2, this is (number of slots - 1).
+    uint64_t slotMask;
+    // log2 of the number of slots.
+    int slotBits;
+    
+    // MARK: - Private methods
+    
+    uint64_t homeSlotForIndex(int64_t index) const;
+};
+
+#pragma GCC visibility pop
+
+#endif /* CacheBlockMap_hpp */
@@ -0,0 +1,200 @@
+//
+//  CacheEvictionPolicy.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef CacheEvictionPolicy_hpp
+#define CacheEvictionPolicy_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// A cache eviction policy decides which cached block is stolen when the cache is full and a
+// block must be fetched.
+//
+// The policy works on cache block numbers (0 up to the maximum number of blocks that fit in the
+// cache), not on file data. It is told about every insert, hit and removal, and must do all of
+// them in O(1). The cache serializes all calls, so a policy does not need its own locking.
+class CacheEvictionPolicy
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum PolicyType
+    {
+        // Least recently used. Evicts the block that has not been used for the longest time.
+        PolicyTypeLRU,
+        // Second chance. Approximates LRU with a single 'referenced' bit per block.
+        PolicyTypeCLOCK,
+        // Scan resistant. New blocks go into a FIFO, and are only promoted to the LRU list if
+        // they are used again after they have been evicted from the FIFO. A single pass over
+        // a large part of the file will then not flush the hot blocks from the cache.
+        PolicyType2Q
+    };
+
+    // MARK: - Public methods
+
+    // Create a policy for a cache that can hold numberOfCacheBlocks blocks.
+    static CacheEvictionPolicy* createPolicy(PolicyType policyType, int64_t numberOfCacheBlocks);
+
+    virtual ~CacheEvictionPolicy() {}
+
+    // The cache block has been filled with the data of the index entry 'index'.
+    virtual void blockInserted(int64_t cacheBlock, int64_t index) = 0;
+    // The cache block has been used (cache hit).
+    virtual void blockAccessed(int64_t cacheBlock) = 0;
+    // The cache block has been evicted, it was the victim.
+    virtual void blockRemoved(int64_t cacheBlock, int64_t index) = 0;
+    // The cache block has been given back without being evicted: its data could not be fetched, or
+    // its file was closed. Its data was never used (or will never be asked for again), so unlike an
+    // evicted block, it must not count as recently seen.
+    virtual void blockDiscarded(int64_t cacheBlock) = 0;
+    // Forget the blocks that were removed earlier, for which shouldForget(index) is true, because
+    // their index entries can be given to other data (the file was closed, and the next file gets its
+    // number). Only a policy that remembers removed blocks has anything to forget.
+    virtual void forgetRemovedBlocks(const std::function<bool(int64_t index)>& /* shouldForget */) {}
+    // Select the block that should be stolen. Blocks for which isEvictable returns false (e.g.
+    // because they are pinned) must be skipped. Returns -1 if there is no block that can be
+    // evicted. Selecting a victim does not remove it, the cache will call blockRemoved for that.
+    virtual int64_t selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable) = 0;
+};
+
+// Intrusive doubly linked list of cache blocks, ordered from least to most recently used. All
+// operations are O(1). Used as a building block by the policies.
+class CacheBlockUsedList
+{
+public:
+
+    // MARK: - Public properties
+
+    int64_t leastRecentlyUsed = -1;
+    int64_t mostRecentlyUsed = -1;
+    int64_t count = 0;
+
+    // MARK: - Public methods
+
+    CacheBlockUsedList(int64_t numberOfCacheBlocks);
+
+    bool contains(int64_t cacheBlock) const { return isLinked[cacheBlock]; }
+    int64_t nextUsed(int64_t cacheBlock) const { return nextUsedBlock[cacheBlock]; }
+
+    // Add the cache block as the most recently used block.
+    void pushMostRecentlyUsed(int64_t cacheBlock);
+    // Remove the cache block from the list.
+    void unlink(int64_t cacheBlock);
+    // Make the cache block the most recently used block.
+    void moveToMostRecentlyUsed(int64_t cacheBlock);
+
+    // Find the least recently used block that is evictable, or -1.
+    int64_t findLeastRecentlyUsed(const std::function<bool(int64_t cacheBlock)>& isEvictable) const;
+
+private:
+
+    // MARK: - Private properties
+
+    std::vector<int64_t> previousUsedBlock;
+    std::vector<int64_t> nextUsedBlock;
+    std::vector<bool> isLinked;
+};
+
+class LRUCacheEvictionPolicy : public CacheEvictionPolicy
+{
+public:
+
+    // MARK: - Public methods
+
+    LRUCacheEvictionPolicy(int64_t numberOfCacheBlocks);
+
+    void blockInserted(int64_t cacheBlock, int64_t index) override;
+    void blockAccessed(int64_t cacheBlock) override;
+    void blockRemoved(int64_t cacheBlock, int64_t index) override;
+    void blockDiscarded(int64_t cacheBlock) override;
+    int64_t selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable) override;
+
+private:
+
+    // MARK: - Private properties
+
+    CacheBlockUsedList usedList;
+};
+
+class ClockCacheEvictionPolicy : public CacheEvictionPolicy
+{
+public:
+
+    // MARK: - Public methods
+
+    ClockCacheEvictionPolicy(int64_t numberOfCacheBlocks);
+
+    void blockInserted(int64_t cacheBlock, int64_t index) override;
+    void blockAccessed(int64_t cacheBlock) override;
+    void blockRemoved(int64_t cacheBlock, int64_t index) override;
+    void blockDiscarded(int64_t cacheBlock) override;
+    int64_t selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable) override;
+
+private:
+
+    // MARK: - Private properties
+
+    int64_t numberOfCacheBlocks;
+    // Position of the clock hand.
+    int64_t hand = 0;
+    std::vector<bool> isPresent;
+    std::vector<bool> isReferenced;
+};
+
+class TwoQueueCacheEvictionPolicy : public CacheEvictionPolicy
+{
+public:
+
+    // MARK: - Public methods
+
+    TwoQueueCacheEvictionPolicy(int64_t numberOfCacheBlocks);
+
+    void blockInserted(int64_t cacheBlock, int64_t index) override;
+    void blockAccessed(int64_t cacheBlock) override;
+    void blockRemoved(int64_t cacheBlock, int64_t index) override;
+    void blockDiscarded(int64_t cacheBlock) override;
+    void forgetRemovedBlocks(const std::function<bool(int64_t index)>& shouldForget) override;
+    int64_t selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable) override;
+
+private:
+
+    // MARK: - Private properties
+
+    // Maximum number of blocks in the FIFO before we take victims from it, and the maximum number of
+    // remembered (ghost) indexes of blocks that were evicted from the FIFO.
+    int64_t maximumFifoCount;
+    int64_t maximumGhostCount;
+
+    // Blocks that were used once (A1in). Kept in insertion order, hits do not reorder it.
+    CacheBlockUsedList fifoList;
+    // Blocks that were used again after being evicted from the FIFO (Am).
+    CacheBlockUsedList hotList;
+
+    // Indexes of blocks that were recently evicted from the FIFO (A1out). The queue can contain
+    // stale entries, only the entry with the generation that is in ghostGenerations counts.
+    std::deque<std::pair<int64_t, uint64_t>> ghostQueue;
+    std::unordered_map<int64_t, uint64_t> ghostGenerations;
+    uint64_t ghostGeneration = 0;
+
+    // MARK: - Private methods
+
+    void rememberGhost(int64_t index);
+};
+
+#pragma GCC visibility pop
+
+#endif /* CacheEvictionPolicy_hpp */
@@ -0,0 +1,109 @@
+//
+//  CacheMemoryAllocator.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef CacheMemoryAllocator_hpp
+#define CacheMemoryAllocator_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <stddef.h>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Allocates the large pieces of memory of a cache: the blocks, and the map that finds them.
+//
+// By default that is plain, page aligned heap memory. For caches of many GB that is slow for random
+// access, as every access to another 4K page needs another TLB entry, and there are only a few
+// thousand of those. Huge pages (2MB or 1GB) cover the same memory with 512 or 262144 times fewer
+// entries. And on a machine with more than one NUMA node, plain memory ends up on the node of the
+// thread that happens to touch it first, which is the node of whatever reader filled that block
+// first; binding it to a node, or interleaving it over all nodes, makes that predictable.
+//
+// Huge pages are not always there: explicit (hugetlbfs) pages must be reserved by the administrator,
+// transparent huge pages can be switched off. Every page type falls back to the next smaller one if
+// it can't be had, down to plain memory, so an allocation only fails if there is no memory at all.
+// Allocation records what was actually used.
+class CacheMemoryAllocator
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum PageType
+    {
+        // Plain memory, in pages of the system's page size.
+        PageTypeDefault,
+        // Memory that the kernel backs with 2MB pages where it can (transparent huge pages, Linux
+        // only). Needs no reservation, but the kernel may give normal pages, or split huge ones later.
+        PageTypeTransparentHuge,
+        // Explicit 2MB or 1GB huge pages (MAP_HUGETLB on Linux, superpages on macOS, which only has
+        // 2MB ones). The memory is rounded up to a whole number of huge pages.
+        PageTypeHuge2MB,
+        PageTypeHuge1GB
+    };
+
+    enum NumaPolicyType
+    {
+        // The memory lands on the node of the thread that touches it first.
+        NumaPolicyTypeDefault,
+        // All memory on one node: the lowest node in numaNodeMask. Use this when the readers of the
+        // cache run on that node.
+        NumaPolicyTypeBind,
+        // Memory spread page by page over the nodes in numaNodeMask (all nodes if it is 0). Use this
+        // when the readers run everywhere, so that no node's memory bandwidth is the bottleneck.
+        NumaPolicyTypeInterleave
+    };
+
+    // What an allocation turned out to be. Needed to free it.
+    struct Allocation
+    {
+        unsigned char* memory = nullptr;
+        // The size that was asked for, and the size that is mapped (rounded up to the page size).
+        size_t size = 0;
+        size_t mappedSize = 0;
+        // True if the memory was mapped, false if it came from the heap.
+        bool isMapped = false;
+        // The page type that was actually used, after falling back.
+        PageType pageType = PageTypeDefault;
+        // True if the NUMA policy was applied.
+        bool isNumaPolicyApplied = false;
+    };
+
+    // MARK: - Public properties
+
+    PageType pageType = PageTypeDefault;
+    NumaPolicyType numaPolicyType = NumaPolicyTypeDefault;
+    // Bit n is NUMA node n.
+    uint64_t numaNodeMask = 0;
+
+    // MARK: - Public methods
+
+    // Allocate size bytes, aligned to alignment (at least a page). Throws std::bad_alloc if there is
+    // no memory of any page type.
+    void allocate(size_t size, size_t alignment, Allocation& allocation) const;
+    // Free the memory of an allocation, and clear it.
+    static void free(Allocation& allocation);
+
+    // The NUMA nodes that are online, as a mask, or 1 (just node 0) where we can't tell.
+    static uint64_t onlineNumaNodeMask();
+
+private:
+
+    // MARK: - Private methods
+
+    // Map size bytes with pages of the page type. Returns false if there are no such pages.
+    static bool mapMemory(size_t size, PageType pageType, Allocation& allocation);
+    // Apply the NUMA policy to memory that has not been touched yet.
+    bool applyNumaPolicy(Allocation& allocation) const;
+};
+
+#pragma GCC visibility pop
+
+#endif /* CacheMemoryAllocator_hpp */
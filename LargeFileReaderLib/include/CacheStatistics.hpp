@@ -0,0 +1,133 @@
+//
+//  CacheStatistics.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef CacheStatistics_hpp
+#define CacheStatistics_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Counts how a LargeFileReaderCore uses its cache: hits and misses, evictions, the bytes that are read
+// from the file and the bytes that are handed out, and how long fetches take.
+//
+// The counters are relaxed atomics, so counting costs an uncontended add, and readers on different
+// threads never wait for each other. A snapshot is not taken atomically as a whole: counters that
+// change while it is taken can be off by the few events that happen in the meantime.
+class CacheStatistics
+{
+public:
+
+    // MARK: - Public consts
+
+    // Fetch latencies are counted in buckets of powers of 2 microseconds: bucket 0 counts fetches
+    // that took less than 1us, bucket n the ones that took from 2^(n-1) up to 2^n us. The last
+    // bucket counts everything longer.
+    static const int numberOfLatencyBuckets = 32;
+
+    // MARK: - Public definitions
+
+    struct Snapshot
+    {
+        // Blocks that were asked for and were in the cache, or were not.
+        uint64_t numberOfHits = 0;
+        uint64_t numberOfMisses = 0;
+        // Blocks that were taken away from the cache to make room for others.
+        uint64_t numberOfEvictions = 0;
+        // Blocks that read-ahead fetched before anyone asked for them. These are not misses.
+        uint64_t numberOfReadAheadBlocks = 0;
+        // Batches of blocks that were fetched from the file, the blocks in them, and the blocks
+        // that could not be read.
+        uint64_t numberOfFetches = 0;
+        uint64_t numberOfFetchedBlocks = 0;
+        uint64_t numberOfFetchErrors = 0;
+        // Bytes fetched from the file into the cache (mapped, when the file is memory mapped), and
+        // bytes handed out by readAt, read and acquireView.
+        uint64_t bytesReadFromFile = 0;
+        uint64_t bytesServedFromCache = 0;
+        // Bytes that large reads read from the file straight into the caller's buffer, around the
+        // cache. These are in neither of the above.
+        uint64_t bytesBypassingCache = 0;
+        // How long the fetches took, see numberOfLatencyBuckets.
+        uint64_t fetchLatencyHistogram[numberOfLatencyBuckets] = {};
+        uint64_t totalFetchLatencyNanoseconds = 0;
+        // Blocks in the cache that hold data now, and how many bytes of cache that is.
+        int64_t numberOfCachedBlocks = 0;
+        size_t workingSetSize = 0;
+
+        // Hits divided by hits + misses, or 0 if nothing was asked for.
+        double hitRate() const;
+        // Mean fetch latency, in microseconds.
+        double meanFetchLatency() const;
+        // An upper bound for the given percentile (0...100) of the fetch latency, in microseconds:
+        // the top of the bucket that the percentile falls in.
+        uint64_t fetchLatencyPercentile(double percentile) const;
+    };
+
+    // MARK: - Public methods
+
+    CacheStatistics();
+
+    void countHits(uint64_t numberOfBlocks)
+    {
+        numberOfHits.fetch_add(numberOfBlocks, std::memory_order_relaxed);
+    }
+    void countMisses(uint64_t numberOfBlocks)
+    {
+        numberOfMisses.fetch_add(numberOfBlocks, std::memory_order_relaxed);
+    }
+    void countEviction()
+    {
+        numberOfEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    void countReadAheadBlocks(uint64_t numberOfBlocks)
+    {
+        numberOfReadAheadBlocks.fetch_add(numberOfBlocks, std::memory_order_relaxed);
+    }
+    void countBytesServed(uint64_t numberOfBytes)
+    {
+        bytesServedFromCache.fetch_add(numberOfBytes, std::memory_order_relaxed);
+    }
+    void countBytesBypassing(uint64_t numberOfBytes)
+    {
+        bytesBypassingCache.fetch_add(numberOfBytes, std::memory_order_relaxed);
+    }
+    // A batch of numberOfBlocks blocks was fetched, of which numberOfErrors failed.
+    void countFetch(uint64_t numberOfBlocks, uint64_t numberOfErrors, uint64_t numberOfBytes, uint64_t latencyNanoseconds);
+
+    // Copy the counters. numberOfCachedBlocks and workingSetSize are left alone, the cache fills them in.
+    void snapshot(Snapshot& snapshot) const;
+    // Set all counters to 0.
+    void reset();
+
+private:
+
+    // MARK: - Private properties
+
+    std::atomic<uint64_t> numberOfHits;
+    std::atomic<uint64_t> numberOfMisses;
+    std::atomic<uint64_t> numberOfEvictions;
+    std::atomic<uint64_t> numberOfReadAheadBlocks;
+    std::atomic<uint64_t> numberOfFetches;
+    std::atomic<uint64_t> numberOfFetchedBlocks;
+    std::atomic<uint64_t> numberOfFetchErrors;
+    std::atomic<uint64_t> bytesReadFromFile;
+    std::atomic<uint64_t> bytesServedFromCache;
+    std::atomic<uint64_t> bytesBypassingCache;
+    std::atomic<uint64_t> fetchLatencyHistogram[numberOfLatencyBuckets];
+    std::atomic<uint64_t> totalFetchLatencyNanoseconds;
+};
+
+#pragma GCC visibility pop
+
+#endif /* CacheStatistics_hpp */
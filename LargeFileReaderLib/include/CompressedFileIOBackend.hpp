@@ -0,0 +1,157 @@
+//
+//  CompressedFileIOBackend.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef CompressedFileIOBackend_hpp
+#define CompressedFileIOBackend_hpp
+
+// zstd is optional, the seekable zstd format is only supported if the library is built (and linked)
+// with it. Define LARGEFILEREADER_HAS_ZSTD as 0 to leave it out even if zstd.h is there, as the Xcode
+// project does, since it only links zlib.
+#if !defined(LARGEFILEREADER_HAS_ZSTD)
+#if __has_include(<zstd.h>)
+#define LARGEFILEREADER_HAS_ZSTD 1
+#else
+#define LARGEFILEREADER_HAS_ZSTD 0
+#endif
+#endif
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <mutex>
+#include <vector>
+
+#include "FileIOBackend.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// FileIOBackend for compressed files. The 'file' that it reads blocks from is the decompressed data,
+// so the cache above it holds decompressed blocks, and everything that uses the cache works on the
+// decompressed data without knowing it.
+//
+// Compressed data can only be decoded from certain points on (restart points). A seekable zstd file
+// has one at the start of every frame, listed in the seek table at its end. A gzip file has none but
+// its start, so attach() decodes the whole file once, and remembers a checkpoint every
+// gzipCheckpointSpacing bytes: where the deflate block starts, and the 32K of data before it that the
+// block can refer back to.
+//
+// Decoding is done by cursors, which keep the state of a decoder between reads. A cursor that is
+// just before the data that is asked for is used as it is, otherwise it is moved to the last restart
+// point before the data first, so a random read never decodes more than the distance between two
+// restart points. Sequential reads (read-ahead, the line indexer, the searcher) continue where the
+// previous read stopped. A few idle cursors are kept, so that a few threads can read at different
+// places without starting over all the time.
+class CompressedFileIOBackend : public FileIOBackend
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum CompressionType
+    {
+        CompressionTypeNone,
+        // gzip (RFC 1952), also files with multiple members, like the ones that pigz and cat make.
+        CompressionTypeGzip,
+        // zstd seekable format: independent frames, followed by a seek table.
+        CompressionTypeZstdSeekable
+    };
+
+    // MARK: - Public consts
+
+    // Average distance between gzip checkpoints, in decompressed bytes. A checkpoint costs its
+    // 32K window, which we keep compressed.
+    static const off_t gzipCheckpointSpacing = 1048576;
+    // Number of idle cursors that are kept.
+    static const size_t maximumNumberOfIdleCursors = 4;
+
+    // MARK: - Public methods
+
+    // What a file is compressed with, judged by the magic numbers at its start and end. Returns
+    // CompressionTypeNone for files that are not compressed, or that we can't decompress.
+    static CompressionType compressionTypeForFile(int fileDescriptor);
+
+    // Create a backend for an open compressed file. This reads the seek table, or builds the
+    // checkpoints, so for gzip it takes as long as decompressing the file. Returns nullptr if the
+    // file can not be decompressed.
+    static CompressedFileIOBackend* createBackendForFile(CompressionType compressionType, int fileDescriptor);
+
+    virtual ~CompressedFileIOBackend();
+
+    // Size of the decompressed data. Only valid after attach.
+    off_t uncompressedSize() const;
+    // Memory used by the restart points.
+    size_t restartPointsMemorySize() const;
+
+    // directIOAlignment is ignored, compressed files are always read through the page cache.
+    bool attach(int fileDescriptor, size_t /* directIOAlignment */) override;
+    void detach() override;
+    // fileOffset of the requests is an offset in the decompressed data.
+    void readBlocks(BlockRequest* requests, size_t numberOfRequests) override;
+
+protected:
+
+    // MARK: - Protected definitions
+
+    // The state of a decoder. Subclasses add their own state.
+    struct DecoderCursor
+    {
+        // Offset of the next byte that decodeCursor will produce.
+        off_t uncompressedOffset = -1;
+
+        virtual ~DecoderCursor() {}
+    };
+
+    // MARK: - Protected properties
+
+    off_t compressedFileSize = 0;
+    off_t uncompressedFileSize = 0;
+
+    // MARK: - Protected methods
+
+    // Find the restart points. Returns false if the file can not be decompressed.
+    virtual bool buildRestartPoints() = 0;
+    virtual void clearRestartPoints() = 0;
+    virtual size_t memorySizeOfRestartPoints() const = 0;
+    // Offset of the last restart point at or before uncompressedOffset.
+    virtual off_t restartPointForOffset(off_t uncompressedOffset) const = 0;
+
+    virtual DecoderCursor* createCursor() = 0;
+    // Move the cursor to the last restart point at or before uncompressedOffset. Returns false on
+    // an error.
+    virtual bool seekCursor(DecoderCursor* cursor, off_t uncompressedOffset) = 0;
+    // Decode the next (at most) length bytes into buffer. Returns the number of bytes decoded, 0 at
+    // the end of the data, or -1 on an error (after which the cursor must be moved before it is used
+    // again).
+    virtual ssize_t decodeCursor(DecoderCursor* cursor, unsigned char* buffer, size_t length) = 0;
+
+    // Read from the compressed file, like pread, but retry until length bytes are read or the end of
+    // the file is reached.
+    ssize_t readCompressedData(off_t fileOffset, unsigned char* buffer, size_t length) const;
+
+private:
+
+    // MARK: - Private properties
+
+    // Protects idleCursors.
+    std::mutex cursorMutex;
+    std::vector<DecoderCursor*> idleCursors;
+
+    // MARK: - Private methods
+
+    // Take the idle cursor that is best placed for reading at uncompressedOffset, or a new one.
+    DecoderCursor* checkOutCursor(off_t uncompressedOffset);
+    void checkInCursor(DecoderCursor* cursor);
+    // Read one request with the cursor.
+    void readBlockWithCursor(DecoderCursor* cursor, BlockRequest& request);
+};
+
+#pragma GCC visibility pop
+
+#endif /* CompressedFileIOBackend_hpp */
@@ -0,0 +1,112 @@
+//
+//  FileIOBackend.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef FileIOBackend_hpp
+#define FileIOBackend_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Does the physical reading of file data for LargeFileReaderCore.
+//
+// The cache hands the backend a batch of block reads at once (all the blocks that a read() is
+// missing, or everything that read-ahead wants), so that a backend that can have multiple reads in
+// flight can submit them together. A backend must be safe to call from multiple threads at once.
+class FileIOBackend
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum BackendType
+    {
+        // One blocking pread per block. Always available.
+        BackendTypePosix,
+        // All reads of a batch are submitted to an io_uring with a single system call, and their
+        // completions are reaped as they come in. Linux only, falls back to BackendTypePosix if
+        // io_uring is not available.
+        BackendTypeIOUring
+    };
+
+    struct BlockRequest
+    {
+        // Where to read from, where to put it, and how much to read.
+        off_t fileOffset;
+        unsigned char* buffer;
+        size_t length;
+        // Result: the number of bytes read (less than length only at the end of the file), or -1.
+        ssize_t bytesRead;
+    };
+
+    // MARK: - Public methods
+
+    // Create a backend of the given type for an open file. If the backend can not be used for the
+    // file (e.g. the system does not support it), a BackendTypePosix backend is returned instead.
+    //
+    // directIOAlignment is the offset/length/buffer alignment that direct I/O on the file requires,
+    // or 0 if the file is read through the page cache (or there are no requirements).
+    static FileIOBackend* createBackendForFile(BackendType backendType, int fileDescriptor, size_t directIOAlignment);
+
+    virtual ~FileIOBackend() {}
+
+    // Start using the backend for the file. Returns false if the backend can not be used.
+    virtual bool attach(int fileDescriptor, size_t directIOAlignment) = 0;
+    // Stop using the backend. Does not close the file.
+    virtual void detach() = 0;
+
+    // Read all requests. Returns when all of them have finished.
+    virtual void readBlocks(BlockRequest* requests, size_t numberOfRequests) = 0;
+
+protected:
+
+    // MARK: - Protected properties
+
+    int fileDescriptor = -1;
+    size_t directIOAlignment = 0;
+
+    // MARK: - Protected methods
+
+    // Read the remainder of a request with pread, until it is complete or we hit the end of the file.
+    // A request that has not started yet must have bytesRead set to 0.
+    void completeBlockRequest(BlockRequest& request) const;
+};
+
+class PosixFileIOBackend : public FileIOBackend
+{
+public:
+
+    // MARK: - Public methods
+
+    bool attach(int fileDescriptor, size_t directIOAlignment) override;
+    void detach() override;
+    void readBlocks(BlockRequest* requests, size_t numberOfRequests) override;
+
+private:
+
+    // MARK: - Private consts
+
+    // Most requests that are read with one preadv: the largest batch that LargeFileReaderCore fetches,
+    // and well below IOV_MAX (1024 on Linux and macOS).
+    static const size_t maximumRunRequests = 64;
+
+    // MARK: - Private methods
+
+    // Read requests that follow each other in the file with a single preadv.
+    void readRun(BlockRequest* requests, size_t numberOfRequests, std::vector<struct iovec>& ioVectors);
+};
+
+#pragma GCC visibility pop
+
+#endif /* FileIOBackend_hpp */
@@ -0,0 +1,43 @@
+//
+//  FileSearcher.h
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef FileSearcher_h
+#define FileSearcher_h
+
+#import <Foundation/Foundation.h>
+
+@class LargeFileReader;
+@class LineIndexer;
+
+// Searches the file that is open in a LargeFileReader for a string or a regular expression, on all
+// cores. The reader (and the line indexer) must stay open while the searcher is used.
+@interface FileSearcher : NSObject
+
+// Number of parts of the file that are searched at the same time, 0 for as many as there are cores.
+@property (nonatomic, assign) NSInteger numberOfSearchThreads;
+// What ends a line for a regular expression search, "\n" by default, and the length of the pieces
+// that longer lines are matched in. Not used with a line indexer, the lines are then those of its
+// index.
+@property (nonatomic, copy) NSData *lineDelimiter;
+@property (nonatomic, assign) NSInteger maximumLineLength;
+
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader;
+// The matches get the number of the line that they are in from lineIndexer, which must have indexed
+// the file.
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader lineIndexer:(LineIndexer *)lineIndexer;
+
+// Calls block for every place where searchString is in the file, in order of offset, until stop is
+// set. lineNumber is -1 without a line indexer. The block is called on other threads, but never on two
+// at the same time. Returns the number of matches, or -1 if the file could not be read.
+- (NSInteger)searchForString:(NSData *)searchString usingBlock:(void (^)(NSInteger offset, NSInteger length, NSInteger lineNumber, BOOL *stop))block;
+// The same, for every match of a regular expression (POSIX extended) in every line. Returns -1 if the
+// regular expression is not valid.
+- (NSInteger)searchForRegularExpression:(NSString *)pattern usingBlock:(void (^)(NSInteger offset, NSInteger length, NSInteger lineNumber, BOOL *stop))block;
+
+@end
+
+#endif /* FileSearcher_h */
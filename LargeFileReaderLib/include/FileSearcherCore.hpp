@@ -0,0 +1,105 @@
+//
+//  FileSearcherCore.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef FileSearcherCore_hpp
+#define FileSearcherCore_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "LargeFileReaderCore.hpp"
+#include "LineIndexerCore.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Searches a file for a string or a regular expression, in place in the reader's cache, on all cores.
+class FileSearcherCore
+{
+public:
+
+    // MARK: - Public definitions
+
+    struct SearchMatch
+    {
+        off_t offset;
+        size_t length;
+        // The line that the match starts in, or -1 if there is no line indexer.
+        int64_t lineNumber;
+    };
+
+    // Gets the matches of a part of the file. Return false to stop the search.
+    typedef std::function<bool(const SearchMatch* matches, size_t numberOfMatches)> SearchMatchHandler;
+
+    // MARK: - Public properties
+
+    // The file is cut into chunks of searchChunkSize bytes, which are searched on
+    // WorkerPool::sharedPool(), with at most numberOfSearchThreads chunks at the same time (0 means as
+    // many as there are cores).
+    size_t numberOfSearchThreads = 0;
+    size_t searchChunkSize = 4194304;
+
+    // Regular expressions are matched against every line on its own, like grep does. Lines end at
+    // lineDelimiter, and lines longer than maximumLineLength are matched in pieces of that length, as
+    // LineIndexerCore cuts them. With a line indexer, the delimiter and maximum line length of its index
+    // are used instead, so that the lines are the lines of the index. A delimiter that can overlap
+    // itself (like "\n\n") makes the search run on a single thread.
+    std::string lineDelimiter = "\n";
+    size_t maximumLineLength = 2048;
+
+    // MARK: - Public methods
+
+    FileSearcherCore();
+    ~FileSearcherCore();
+
+    // Find every occurrence of searchString in the file, overlapping ones too. A match can cross any
+    // cache block or line boundary.
+    //
+    // The matches are handed to handleMatches in order of offset, a chunk at a time, as soon as all
+    // chunks before it are searched. handleMatches is called on the calling thread or the worker threads
+    // (but never on two at the same time), and can stop the search. If lineIndexer is not NULL, it must have indexed the
+    // file, and the matches get their line numbers from it.
+    //
+    // Returns the number of matches, or -1 if the file could not be read or searchString is empty.
+    int64_t searchForString(LargeFileReaderCore* reader, const std::string& searchString, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches);
+    // The same, for all matches of a POSIX extended regular expression in every line. Returns -1 if
+    // the regular expression is not valid, or lineDelimiter is empty.
+    int64_t searchForRegularExpression(LargeFileReaderCore* reader, const std::string& pattern, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches);
+
+private:
+
+    // MARK: - Private consts
+
+    // Number of bytes that we search in one go.
+    const size_t scanSliceSize = 65536;
+    // Chunks that are searched, but can't be handed out because a chunk before them is not done yet,
+    // are kept. This many per thread, at most, before a thread waits.
+    static const size_t maximumNumberOfWaitingChunksPerThread = 4;
+
+    // MARK: - Private methods
+
+    // Search the file in chunks of chunkSize bytes with searchChunk(startOffset, endOffset, matches),
+    // and hand out the matches in order.
+    int64_t searchInChunks(LargeFileReaderCore* reader, size_t chunkSize, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches, const std::function<bool(off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches)>& searchChunk);
+
+    // Find the matches that start from startOffset up to endOffset.
+    bool searchChunkForString(LargeFileReaderCore* reader, const std::string& searchString, off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches);
+    // Call handleLine for every line (without its delimiter) that starts from startOffset up to
+    // endOffset, in pieces of at most maximumLength bytes. All pieces of a line go to the chunk where
+    // the line starts.
+    bool forEachLineInChunk(LargeFileReaderCore* reader, const std::string& delimiter, size_t maximumLength, off_t startOffset, off_t endOffset, const std::function<void(off_t startOfLine, const unsigned char* line, size_t lineLength)>& handleLine);
+};
+
+#pragma GCC visibility pop
+
+#endif /* FileSearcherCore_hpp */
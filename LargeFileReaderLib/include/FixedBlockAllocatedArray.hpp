@@ -8,17 +8,16 @@
 #ifndef FixedBlockAllocatedArray_hpp
 #define FixedBlockAllocatedArray_hpp
 
+#if __has_include(<swift/bridging>)
 #include <swift/bridging>
+#endif
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <assert.h>
-
-#include <swift/bridging>
-#include <stdint.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <assert.h>
+#include <iterator>
+#include <vector>
 
 /* The classes below are exported */
 #pragma GCC visibility push(default)
@@ -26,39 +25,106 @@
 template <class T>
 class FixedBlockAllocatedArray {
 public:
-    
+
     // MARK: - Public consts
-    const uint64_t numberOfEntriesInBlock = 16384;
+    static const uint64_t numberOfEntriesInBlock = 16384;
 
     // MARK: - Public definitions
-    
-    struct AllocatedBlockType {
-        AllocatedBlockType *prevBlock;
-        AllocatedBlockType *nextBlock;
-        T *allocatedBlock;
+
+    // Forward iterator over the elements. Steps through a block with a plain pointer, and only goes
+    // to the block directory when it crosses into the next block. Like a std::vector iterator, it is
+    // invalidated when the array grows.
+    template <class ElementType>
+    class BasicIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef ElementType value_type;
+        typedef ptrdiff_t difference_type;
+        typedef ElementType* pointer;
+        typedef ElementType& reference;
+
+        BasicIterator() {}
+        BasicIterator(T* const* blocks, size_t index) : blocks(blocks), index(index)
+        {
+            T* block = blocks[index / numberOfEntriesInBlock];
+            element = (block != nullptr) ? &block[index % numberOfEntriesInBlock] : nullptr;
+        }
+
+        reference operator * () const { return *element; }
+        pointer operator -> () const { return element; }
+
+        BasicIterator& operator ++ ()
+        {
+            index++;
+            if ((index % numberOfEntriesInBlock) == 0)
+            {
+                // Might be the sentinel after the last block, but then we are at the end.
+                element = blocks[index / numberOfEntriesInBlock];
+            }
+            else
+            {
+                element++;
+            }
+            return *this;
+        }
+        BasicIterator operator ++ (int) { BasicIterator previous = *this; ++(*this); return previous; }
+
+        bool operator == (const BasicIterator& other) const { return index == other.index; }
+        bool operator != (const BasicIterator& other) const { return index != other.index; }
+
+        // Index of the element that the iterator points to.
+        size_t position() const { return index; }
+
+    private:
+        T* const* blocks = nullptr;
+        size_t index = 0;
+        ElementType* element = nullptr;
     };
 
+    typedef BasicIterator<T> iterator;
+    typedef BasicIterator<const T> const_iterator;
+
     // MARK: - Public properties
-    
+
     // MARK: - Public methods
-    
+
     FixedBlockAllocatedArray();
     ~FixedBlockAllocatedArray();
 
+    // Access an element. The non-const version grows the array if index is beyond its end.
     T& operator [] (size_t index);
     const T& operator [] (size_t index) const;
 
+    // Add an element at the end.
+    void push_back(const T& element);
+
+    // Number of elements: one more than the highest index that was used.
+    size_t size() const;
+    // Forget all elements. Keeps the first block.
+    void clear();
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
 private:
 
     // MARK: - Private definitions
-    
+
     // MARK: - Private properties
-    
-    uint64_t totalNumberOfAllocatedBlocks = 0;
-    AllocatedBlockType* firstBlock = nullptr;
-    AllocatedBlockType* lastBlock = nullptr;
+
+    // Pointers to the blocks, in order, followed by a nullptr (so that an iterator can always look at
+    // the next block). Growing it only moves the pointers, never the elements.
+    std::vector<T*> blockDirectory;
+    // Number of elements in use.
+    size_t numberOfElements = 0;
 
     // MARK: - Private methods
+
+    uint64_t numberOfBlocks() const;
+    // Allocate blocks until blockNumber exists.
+    void growToBlock(uint64_t blockNumber);
 };
 
 #include "FixedBlockAllocatedArray.hxx"
@@ -0,0 +1,120 @@
+//
+//  IOUringFileIOBackend.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef IOUringFileIOBackend_hpp
+#define IOUringFileIOBackend_hpp
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LARGEFILEREADER_HAS_IO_URING 1
+#else
+#define LARGEFILEREADER_HAS_IO_URING 0
+#endif
+
+#if LARGEFILEREADER_HAS_IO_URING
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <mutex>
+#include <condition_variable>
+
+#include "FileIOBackend.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// FileIOBackend that submits all reads of a batch to an io_uring with one system call.
+//
+// There is a single ring per backend, shared by all threads. Submitting is done under ringMutex.
+// Completions are reaped by one thread at a time (the 'reaper'), which waits in the kernel for
+// completions without holding the mutex, hands each completion to the request it belongs to, and
+// wakes up the other threads, which then check whether their requests are complete. While there is
+// a reaper, the other threads still submit, but leave the completions to it.
+class IOUringFileIOBackend : public FileIOBackend
+{
+public:
+
+    // MARK: - Public consts
+
+    static const unsigned defaultQueueDepth = 64;
+
+    // MARK: - Public methods
+
+    IOUringFileIOBackend(unsigned queueDepth);
+    ~IOUringFileIOBackend();
+
+    bool attach(int fileDescriptor, size_t directIOAlignment) override;
+    void detach() override;
+    void readBlocks(BlockRequest* requests, size_t numberOfRequests) override;
+
+private:
+
+    // MARK: - Private definitions
+
+    // Keeps track of a request while it is in flight.
+    struct InFlightRequest
+    {
+        BlockRequest* request;
+        bool isComplete;
+    };
+
+    // MARK: - Private properties
+
+    unsigned queueDepth;
+
+    int ringFileDescriptor = -1;
+
+    // Submission queue ring, shared with the kernel.
+    void* submissionRing = nullptr;
+    size_t submissionRingSize = 0;
+    unsigned* submissionHead = nullptr;
+    unsigned* submissionTail = nullptr;
+    unsigned* submissionRingMask = nullptr;
+    unsigned* submissionArray = nullptr;
+    io_uring_sqe* submissionEntries = nullptr;
+    size_t submissionEntriesSize = 0;
+    unsigned numberOfSubmissionEntries = 0;
+
+    // Completion queue ring, shared with the kernel. Can be the same mapping as the submission ring.
+    void* completionRing = nullptr;
+    size_t completionRingSize = 0;
+    unsigned* completionHead = nullptr;
+    unsigned* completionTail = nullptr;
+    unsigned* completionRingMask = nullptr;
+    io_uring_cqe* completionEntries = nullptr;
+
+    // Protects everything below, and the submission and completion rings.
+    std::mutex ringMutex;
+    // Signalled by the reaper when it handed out completions.
+    std::condition_variable ringCondition;
+    // Number of requests that are submitted but not completed. Never more than numberOfSubmissionEntries,
+    // so the completion queue can not overflow.
+    unsigned numberOfRequestsInFlight = 0;
+    // True while a thread is waiting in the kernel for completions. Only that thread takes completions
+    // from the ring then.
+    bool isReaping = false;
+
+    // MARK: - Private methods
+
+    // Submit as many requests as fit. Returns the number of requests handled: submitted, or, if the
+    // kernel refused them, completed with bytesRead -1.
+    size_t submitRequests(InFlightRequest* inFlightRequests, size_t numberOfRequests);
+    // Hand out all completions that are in the completion queue.
+    void processCompletions();
+    void unmapRings();
+};
+
+#pragma GCC visibility pop
+
+#endif /* LARGEFILEREADER_HAS_IO_URING */
+
+#endif /* IOUringFileIOBackend_hpp */
@@ -16,6 +16,95 @@ FOUNDATION_EXPORT double LargeFileReaderVersionNumber;
 //! Project version string for `LargeFileReader`.
 FOUNDATION_EXPORT const unsigned char LargeFileReaderVersionString[];
 
+typedef NS_ENUM(NSInteger, LargeFileReaderCacheEvictionPolicy) {
+    LargeFileReaderCacheEvictionPolicyLRU = 0,
+    LargeFileReaderCacheEvictionPolicyCLOCK,
+    LargeFileReaderCacheEvictionPolicyTwoQueue
+};
+
+typedef NS_ENUM(NSInteger, LargeFileReaderIOBackend) {
+    LargeFileReaderIOBackendPosix = 0,
+    LargeFileReaderIOBackendIOUring
+};
+
+// Pages that the memory of a cache is allocated on. Huge pages make random access to a large cache
+// faster. Types that are not available fall back to smaller ones.
+typedef NS_ENUM(NSInteger, LargeFileReaderCachePageType) {
+    LargeFileReaderCachePageTypeDefault = 0,
+    LargeFileReaderCachePageTypeTransparentHuge,
+    LargeFileReaderCachePageTypeHuge2MB,
+    LargeFileReaderCachePageTypeHuge1GB
+};
+
+// Where the memory of a cache is placed on a machine with several NUMA nodes (Linux only).
+typedef NS_ENUM(NSInteger, LargeFileReaderNumaPolicy) {
+    LargeFileReaderNumaPolicyDefault = 0,
+    LargeFileReaderNumaPolicyBind,
+    LargeFileReaderNumaPolicyInterleave
+};
+
+// One range of a batch read, see -[LargeFileReader readRanges:count:].
+typedef struct {
+    NSInteger fileOffset;
+    unsigned char *buffer;
+    NSInteger length;
+    // Result: the number of bytes read (less than length only at the end of the file), or -1.
+    NSInteger bytesRead;
+} LargeFileReaderReadRange;
+
+// How the cache of a LargeFileReader was used, see -[LargeFileReader statistics].
+@interface LargeFileReaderStatistics : NSObject
+
+@property (nonatomic, readonly) NSInteger numberOfHits;
+@property (nonatomic, readonly) NSInteger numberOfMisses;
+@property (nonatomic, readonly) NSInteger numberOfEvictions;
+// Blocks fetched by read-ahead, before anyone asked for them.
+@property (nonatomic, readonly) NSInteger numberOfReadAheadBlocks;
+@property (nonatomic, readonly) NSInteger numberOfFetches;
+@property (nonatomic, readonly) NSInteger numberOfFetchedBlocks;
+@property (nonatomic, readonly) NSInteger numberOfFetchErrors;
+@property (nonatomic, readonly) NSInteger bytesReadFromFile;
+@property (nonatomic, readonly) NSInteger bytesServedFromCache;
+// Bytes that large reads read straight into the caller's buffer, see -[LargeFileReader largeReadBypassThreshold].
+@property (nonatomic, readonly) NSInteger bytesBypassingCache;
+// Bucket n counts the fetches that took less than 2^n microseconds (and at least 2^(n-1)).
+@property (nonatomic, readonly) NSArray<NSNumber *> *fetchLatencyHistogram;
+@property (nonatomic, readonly) NSInteger numberOfCachedBlocks;
+// Bytes of cache that hold data.
+@property (nonatomic, readonly) NSInteger workingSetSize;
+
+@property (nonatomic, readonly) double hitRate;
+// In microseconds.
+@property (nonatomic, readonly) double meanFetchLatency;
+// An upper bound for a percentile (0...100) of the fetch latency, in microseconds.
+- (NSInteger)fetchLatencyPercentile:(double)percentile;
+
+@end
+
+// A cache that many LargeFileReaders can share, see -[LargeFileReader sharedCache]. The memory is
+// allocated when the cache is created, and stays the same however many files use it.
+@interface LargeFileReaderSharedCache : NSObject
+
+@property (nonatomic, readonly) NSInteger cacheBlockSize;
+// The size of the memory of the cache, a multiple of cacheBlockSize.
+@property (nonatomic, readonly) NSInteger cacheActualSize;
+// Number of open files that read through the cache.
+@property (nonatomic, readonly) NSInteger numberOfAttachedFiles;
+// Number of blocks that hold data, of all files together.
+@property (nonatomic, readonly) NSInteger numberOfCachedBlocks;
+// The page type that the memory of the cache got.
+@property (nonatomic, readonly) LargeFileReaderCachePageType cacheActualPageType;
+
+// Returns nil if cacheBlockSize is 0 or larger than cacheMaxSize, or the memory can't be allocated.
+- (nullable instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize;
+- (nullable instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize cacheEvictionPolicy:(LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy;
+// numaNodeMask has a bit for every node to bind or interleave to, 0 means all nodes. Binding uses the
+// lowest node in the mask.
+- (nullable instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize cacheEvictionPolicy:(LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy
+                                cachePageType:(LargeFileReaderCachePageType)cachePageType numaPolicy:(LargeFileReaderNumaPolicy)numaPolicy numaNodeMask:(NSUInteger)numaNodeMask;
+
+@end
+
 @interface LargeFileReader : NSObject
 
 @property (nonatomic, readonly) NSInteger cacheDefaultBlockSize;
@@ -25,6 +114,49 @@ FOUNDATION_EXPORT const unsigned char LargeFileReaderVersionString[];
 @property (nonatomic, readonly) NSInteger cacheMaxSize;
 @property (nonatomic, readonly) NSInteger cacheActualSize;
 
+// Must be set before opening the file.
+@property (nonatomic, assign) LargeFileReaderCacheEvictionPolicy cacheEvictionPolicy;
+// Must be set before opening the file. How the memory of the cache is allocated, see
+// LargeFileReaderCachePageType and LargeFileReaderNumaPolicy. cacheNumaNodeMask has a bit for every
+// node, 0 means all nodes. Not used with a sharedCache.
+@property (nonatomic, assign) LargeFileReaderCachePageType cachePageType;
+@property (nonatomic, assign) LargeFileReaderNumaPolicy cacheNumaPolicy;
+@property (nonatomic, assign) NSUInteger cacheNumaNodeMask;
+// The page type that the cache of the open file got.
+@property (nonatomic, readonly) LargeFileReaderCachePageType cacheActualPageType;
+// Fetch the next blocks in the background while reading sequentially.
+@property (nonatomic, assign) BOOL readAheadEnabled;
+// Reads of at least this many bytes read the whole blocks in their middle straight into the buffer,
+// around the cache, so they don't evict what is in it. 0 switches this off.
+@property (nonatomic, assign) NSInteger largeReadBypassThreshold;
+// Must be set before opening the file. Read the file through a cache that is shared with other readers,
+// instead of through a cache of its own. The cache sizes passed to open, and cacheEvictionPolicy, are
+// then not used. The reader keeps the cache alive while the file is open.
+@property (nonatomic, strong) LargeFileReaderSharedCache *sharedCache;
+// True if the open file is read through sharedCache.
+@property (nonatomic, readonly) BOOL isSharingCache;
+// Must be set before opening the file. Falls back to Posix where io_uring is not available.
+@property (nonatomic, assign) LargeFileReaderIOBackend ioBackend;
+// Must be set before opening the file. Read the file around the system's page cache, so the cache
+// is the only memory that reading the file costs.
+@property (nonatomic, assign) BOOL directIOEnabled;
+// True if the open file is read with direct I/O.
+@property (nonatomic, readonly) BOOL isDirectIO;
+// Must be set before opening the file. Map windows of the file into memory instead of reading blocks
+// into the cache. cacheBlockSize is then the window size, cacheMaxSize the address space for the windows.
+@property (nonatomic, assign) BOOL memoryMappingEnabled;
+// True if the open file is memory mapped.
+@property (nonatomic, readonly) BOOL isMemoryMapped;
+// Must be set before opening the file. Follow a file that grows while it is open, see refreshFileSize.
+@property (nonatomic, assign) BOOL followEnabled;
+// True if the open file is followed.
+@property (nonatomic, readonly) BOOL isFollowing;
+// Must be set before opening the file. Read a gzip (or seekable zstd) file as the data that it
+// decompresses to. On by default.
+@property (nonatomic, assign) BOOL decompressionEnabled;
+// True if the open file is compressed, and is read decompressed.
+@property (nonatomic, readonly) BOOL isCompressed;
+
 @property (nonatomic, readonly) BOOL isOpen;
 @property (nonatomic, readonly) BOOL isEof;
 @property (nonatomic, readonly) BOOL isFail;
@@ -33,9 +165,32 @@ FOUNDATION_EXPORT const unsigned char LargeFileReaderVersionString[];
 - (BOOL)open:(NSString *)fullFilePath;
 - (BOOL)open:(NSString *)fullFilePath cacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize;
 - (void)close;
+// Size of the open file, or -1 if no file is open.
+- (NSInteger)fileSize;
+// When following the file, make data that was appended to it readable. Returns the size of the file,
+// or -1 if it could not be checked or has become smaller.
+- (NSInteger)refreshFileSize;
 
 - (NSInteger)lseek:(NSInteger)offsetInBytes whence:(NSInteger)whence;
 - (NSInteger)read:(unsigned char *)buffer bytes:(NSInteger)numberOfBytes;
+- (NSInteger)readAt:(NSInteger)offsetInBytes buffer:(unsigned char *)buffer bytes:(NSInteger)numberOfBytes;
+// Read many ranges, in any order, with one trip through the cache. Sets bytesRead of every range.
+// Returns the total number of bytes read, or -1 if any range could not be read.
+- (NSInteger)readRanges:(LargeFileReaderReadRange *)ranges count:(NSInteger)numberOfRanges;
+// readAt, without blocking the calling thread on the file. If the data is in the cache, the handler is
+// called right away, on the calling thread. Otherwise the read is done on the library's I/O worker
+// pool, and the handler is called on the worker thread when it is done. The buffer must stay valid
+// until then. In Swift: let bytesRead = await reader.readAsyncAt(offset, buffer: buffer, bytes: length)
+- (void)readAsyncAt:(NSInteger)offsetInBytes buffer:(unsigned char *)buffer bytes:(NSInteger)numberOfBytes completionHandler:(void (^)(NSInteger bytesRead))completionHandler;
+// Returns the data at the offset without copying it out of the cache. The data never crosses a cache
+// block boundary, so it can be shorter than maximumNumberOfBytes. The cache block stays pinned until
+// the returned object is deallocated, which must happen before the file is closed. Returns empty data
+// at the end of the file, or nil if the data could not be read.
+- (NSData *)viewAt:(NSInteger)offsetInBytes maxBytes:(NSInteger)maximumNumberOfBytes;
+
+// A snapshot of the cache statistics since the file was opened, or since resetStatistics.
+- (LargeFileReaderStatistics *)statistics;
+- (void)resetStatistics;
 
 @end
 
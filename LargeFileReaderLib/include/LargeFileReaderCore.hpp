@@ -11,20 +11,108 @@
 /* The classes below are exported */
 #pragma GCC visibility push(default)
 
+#if __has_include(<swift/bridging>)
 #include <swift/bridging>
+#endif
 #include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <coroutine>
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "CacheEvictionPolicy.hpp"
+#include "SharedBlockCache.hpp"
+#include "FileIOBackend.hpp"
+#include "CompressedFileIOBackend.hpp"
+#include "CacheStatistics.hpp"
+#include "WorkerPool.hpp"
+
 class LargeFileReaderCore
 {
 public:
     
+    // MARK: - Public definitions
+    
+    // A span of file data that points directly into the cache. See acquireView.
+    struct FileDataView
+    {
+        // The data, and how much of it there is.
+        const unsigned char* data = nullptr;
+        size_t length = 0;
+        // Offset in the file of the first byte of data.
+        off_t fileOffset = 0;
+        // The cache block that is pinned for the view, or -1 if nothing is pinned.
+        int64_t cacheBlock = -1;
+    };
+    
+    // One range of a batch read. See readRanges.
+    struct ReadRequest
+    {
+        // Where to read from, where to put it, and how much to read.
+        off_t fileOffset = 0;
+        unsigned char* buffer = nullptr;
+        size_t length = 0;
+        // Result: the number of bytes read (less than length only at the end of the file), or -1.
+        ssize_t bytesRead = 0;
+    };
+    
+    // What readAtAsync returns without a completion: co_await it in a coroutine to read, and get the
+    // number of bytes read, like readAt returns it. If all the data is in the cache, it is copied right
+    // away and the coroutine does not suspend. Otherwise the read is done on asyncReadWorkerPool, and
+    // the coroutine is resumed on the worker thread that did it.
+    class ReadAtAwaitable
+    {
+    public:
+        
+        ReadAtAwaitable(LargeFileReaderCore& reader, off_t fileOffset, unsigned char* buffer, size_t numberOfBytes)
+            : reader(reader), fileOffset(fileOffset), buffer(buffer), numberOfBytes(numberOfBytes)
+        {
+        }
+        
+        bool await_ready()
+        {
+            return reader.readAtFromCache(fileOffset, buffer, numberOfBytes, bytesRead);
+        }
+        
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            reader.submitAsyncRead(fileOffset, buffer, numberOfBytes, [this, coroutine](size_t bytesReadOnWorker)
+            {
+                bytesRead = bytesReadOnWorker;
+                coroutine.resume();
+            });
+        }
+        
+        size_t await_resume() const
+        {
+            return bytesRead;
+        }
+        
+    private:
+        
+        LargeFileReaderCore& reader;
+        off_t fileOffset;
+        unsigned char* buffer;
+        size_t numberOfBytes;
+        size_t bytesRead = 0;
+    };
+    
     // MARK: - Public consts
     
     const int cacheDefaultBlockSize = 65536;
     const int cacheDefaultMaxSize = 2097152;
+    // Defaults when memoryMappingEnabled is set.
+    const int mappingDefaultWindowSize = 16777216;
+    const int mappingDefaultMaxSize = 1073741824;
+    // Largest read into the caller's buffer when a large read bypasses the cache.
+    const size_t bypassChunkSize = 16777216;
     
     // MARK: - Public properties
     
@@ -36,6 +124,105 @@ public:
     // This is the actual size of the cache.
     size_t cacheActualSize;
     
+    // Policy that decides which cached block is stolen when the cache is full. Must be set before
+    // calling open(), changing it while the file is open has no effect until the next open().
+    CacheEvictionPolicy::PolicyType cacheEvictionPolicyType = CacheEvictionPolicy::PolicyTypeLRU;
+    
+    // How the memory of the cache is allocated: on plain pages, or on (transparent) huge pages, which make
+    // random access to a cache of many GB faster, as far fewer TLB entries are needed to cover it. And on
+    // a machine with several NUMA nodes, whether it is bound to one node or interleaved over them. Page
+    // types that are not available fall back to smaller ones, see cacheActualPageType. Not used for the
+    // windows of memory mapping, nor with a shared cache, which has its own allocator. Must be set
+    // before calling open().
+    CacheMemoryAllocator cacheMemoryAllocator;
+    
+    // Shared cache. If set, the file is read through this cache, together with all other readers that
+    // use it, instead of through a cache of its own. The cacheMaxSize and cacheBlockSize that are passed
+    // to open(), and cacheEvictionPolicyType, are then not used: the shared cache has its own. Memory
+    // mapping is not used with a shared cache, and direct I/O only if the block size of the shared cache
+    // is aligned for it. The cache must outlive the open file. Must be set before calling open(). See
+    // isSharingCache.
+    SharedBlockCache* sharedBlockCache = NULL;
+    
+    // True if the open file is read through sharedBlockCache.
+    bool isSharingCache;
+    
+    // Read-ahead. If enabled, 'read' detects sequential access, and fetches the blocks after the
+    // ones that are being read on a background thread, so they are in the cache by the time they
+    // are needed. The read-ahead window starts small and doubles while the access stays sequential,
+    // up to readAheadMaximumBlocks (but never more than half the cache). It stops as soon as the
+    // access becomes random.
+    bool readAheadEnabled = true;
+    int64_t readAheadMaximumBlocks = 32;
+    
+    // Large read bypass. A read (or readAt) of at least largeReadBypassThreshold bytes does not go
+    // through the cache: the blocks in the middle of it are read from the file straight into the
+    // caller's buffer, and only the partial blocks at its start and end go through the cache. A bulk
+    // export then costs no extra copy, and does not evict the blocks that everyone else is using. With
+    // direct I/O, this needs a buffer that is aligned like the blocks are, otherwise the read goes
+    // through the cache. Not used for memory mapped or compressed files. 0 switches it off.
+    size_t largeReadBypassThreshold = 4194304;
+    
+    // Pool that the asynchronous reads (readAtAsync) wait for the file on. NULL means
+    // WorkerPool::sharedIOPool(). The pool must outlive the open file.
+    WorkerPool* asyncReadWorkerPool = NULL;
+    
+    // How blocks are physically read from the file. Must be set before calling open(). If the
+    // backend is not available on this system, open() falls back to BackendTypePosix.
+    FileIOBackend::BackendType ioBackendType = FileIOBackend::BackendTypePosix;
+    
+    // Direct I/O. If enabled, the file is read around the kernel's page cache (O_DIRECT on Linux,
+    // F_NOCACHE on macOS), so data is copied once, from the disk into our cache, and scanning a huge
+    // file does not flush everything else out of the page cache. cacheMaxSize is then the only memory
+    // that reading the file costs. cacheBlockSize is rounded up to the alignment that the file system
+    // requires. Must be set before calling open(). If the file system does not support direct I/O,
+    // the file is read normally, see isDirectIO.
+    bool directIOEnabled = false;
+    
+    // Memory mapping. If enabled, the cache blocks are not filled by reading the file, but are windows
+    // onto the file that are mapped into memory, so the data is never copied into the cache. Apart from
+    // that the cache works as always: cacheBlockSize is the size of a window (rounded up to the page
+    // size), cacheMaxSize is the address space that we use for the windows, and when all windows are in
+    // use, the eviction policy decides which one is remapped. While reading sequentially (see
+    // readAheadEnabled) the windows are advised as sequential and read-ahead asks the kernel to start
+    // loading the windows ahead, otherwise they are advised as random. Must be set before calling
+    // open(), and can not be combined with direct I/O. See isMemoryMapped.
+    bool memoryMappingEnabled = false;
+    
+    // Follow mode, for files that grow while they are open, like logs that are being written. Data that
+    // is appended to the file becomes readable after refreshFileSize(), which only has to fetch the
+    // block at the old end of the file again. The cache is then not made smaller for a file that is
+    // smaller than cacheMaxSize, as it will probably grow. Must be set before calling open().
+    bool followEnabled = false;
+    
+    // Decompression. If enabled, a compressed file (gzip, or seekable zstd if the library is built with
+    // zstd) is read as the data that it decompresses to: fileSize(), lseek, read and everything above
+    // them work on the decompressed data, and the cache holds decompressed blocks. Only the data that
+    // is read is decompressed, starting from the closest restart point before it (see
+    // CompressedFileIOBackend), so memory stays bounded, and a random read decompresses at most one
+    // frame or checkpoint interval. A gzip file has to be decompressed once by open() to find the
+    // checkpoints. Direct I/O, memory mapping and follow mode are not used for compressed files. Must
+    // be set before calling open(). See isCompressed.
+    bool decompressionEnabled = true;
+    
+    // True if the open file is compressed, and is read decompressed.
+    bool isCompressed;
+    // What the open file is compressed with.
+    CompressedFileIOBackend::CompressionType compressionType;
+    
+    // True if the open file is followed.
+    bool isFollowing;
+    
+    // True if the open file is memory mapped.
+    bool isMemoryMapped;
+    
+    // True if the open file is read with direct I/O.
+    bool isDirectIO;
+    
+    // The page type that the cache of the open file got, after falling back (see cacheMemoryAllocator).
+    // Always PageTypeDefault for memory mapping.
+    CacheMemoryAllocator::PageType cacheActualPageType;
+    
     bool isOpen;
     bool isEof;
     bool isFail;
@@ -54,7 +241,7 @@ public:
     // size of blocks of file data to cache.
     //
     // Note: If cacheMaxSize is not an exact multiple of cacheBlockSize, the class will still honor the
-    //       desired cache max size, and will waste some memory.
+    //       desired cache max size, but the part that does not fill a whole block is not used.
     // Note: If the file is smaller than the cacheMaxSize, the cache will be made the smallest size of
     //       multiples of cacheBlockSize, that will fit the complete file.
     //
@@ -67,6 +254,18 @@ public:
     // Close the file. Deletes the index and the cache, and closes the file.
     void close();
     
+    // Size of the open file in bytes, or -1 if no file is open.
+    off_t fileSize();
+    // Status of the open file, as it was when it was opened or last refreshed.
+    const struct stat& openFileStatus();
+    
+    // In follow mode, check if data was appended to the file, and make it readable. This call is
+    // thread-safe with respect to reading, but openFileStatus() must not be used at the same time.
+    // - Returns the size of the file, or -1 if the file could not be checked, or has become
+    //   smaller (truncated), in which case it must be opened again.
+    // - Outside follow mode, nothing is checked and the size from open() is returned.
+    off_t refreshFileSize();
+    
     // Seek to data in file. This does not actually do a seek, but sets
     // currentOffset to the passed offset. currentOffset is then used to
     // check in the index if a block is available in the cache,
@@ -78,63 +277,200 @@ public:
     // the cache and then returned.
     // - This call is synchronous and will block until the data is cached.
     // - Returns the number of bytes actually 'read'.
+    // - This call uses and updates the shared currentFileOffset, so it must not be
+    //   called from multiple threads at the same time. Use readAt for that.
     size_t read(unsigned char* buffer, size_t numberOfBytes);
     
-private:
+    // Read the file's data from an explicit offset. This behaves like 'read', but
+    // does not use or update currentFileOffset, and does not touch the isEof,
+    // isFail and isBad flags.
+    // - This call is thread-safe. Multiple threads can read from the same reader
+    //   (and share the same cache) at the same time.
+    // - Returns the number of bytes actually 'read', 0 if offsetInBytes is at or
+    //   beyond the end of the file, or -1 if the data could not be read.
+    size_t readAt(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes);
     
-    // MARK: - Private definitions
+    // Read many ranges of the file's data in one go, like readAt for each of them, but with a single
+    // trip through the cache: the blocks that all ranges need are acquired together, in file order,
+    // every block once, however many ranges need it, and all missing ones are fetched in batches, so
+    // that neighbouring blocks are read with a single system call. Then the data is copied into the
+    // buffers of the ranges.
+    // - The ranges can be in any order, and can overlap.
+    // - This call is thread-safe, like readAt.
+    // - Sets bytesRead of every request. Returns the total number of bytes read, or -1 if the data of
+    //   any range could not be read (the bytesRead of those requests is -1, the others are read).
+    size_t readRanges(ReadRequest* requests, size_t numberOfRequests);
     
-    struct FileCacheIndexEntry
+    // Read like readAt, without blocking the calling thread on the file. If all the data is in the
+    // cache, it is copied right away, and completion is called before readAtAsync returns. Otherwise
+    // the read is handed to asyncReadWorkerPool, readAtAsync returns at once, and completion is called
+    // on the worker thread when the read is done. Either way, completion gets what readAt would have
+    // returned.
+    // - The buffer must stay valid until completion is called.
+    // - Many reads can be in flight at the same time, up to the number of threads of the pool; more
+    //   are queued. This call is thread-safe, like readAt.
+    // - close() (and destroying the reader) waits until all reads in flight are done, so it must not
+    //   be called from a completion.
+    void readAtAsync(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, std::function<void(size_t bytesRead)> completion);
+    // The same for coroutines: size_t bytesRead = co_await reader.readAtAsync(offset, buffer, length);
+    ReadAtAwaitable readAtAsync(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes)
     {
-        // If true, then we do not have the corresponding data in the cache.
-        bool isFault = true;
-        // If this block is not faulted, then this points to the data in the cache.
-        uint64_t offsetInFileBuffer = -1;
-        // Point to the index of the entry that was previously used (i.e. the previous MRU).
-        int64_t previousUsed = -1;
-        // Point to the index of the entry that was next used (i.e. the previous MRU).
-        int64_t nextUsed = -1;
-    };
+        return ReadAtAwaitable(*this, offsetInBytes, buffer, numberOfBytes);
+    }
+    
+    // Get the file's data from an explicit offset without copying it. The view points directly
+    // into the cache, and the cache block stays pinned (it will not be evicted or reused) until the
+    // view is released with releaseView.
+    // - A view never crosses a cache block boundary, so it can be shorter than
+    //   maximumNumberOfBytes even if the file has more data. Acquire the next view at
+    //   view.fileOffset + view.length to continue.
+    // - This call is thread-safe, like readAt.
+    // - Every pinned block is a block less for everyone else, so release views as soon as
+    //   possible, and do not hold on to more than a few at a time. All views must be released
+    //   before the file is closed.
+    // - Returns the length of the view, 0 if offsetInBytes is at or beyond the end of the file,
+    //   or -1 if the data could not be read. Only a view with a length > 0 needs to be released.
+    size_t acquireView(off_t offsetInBytes, size_t maximumNumberOfBytes, FileDataView& view);
+    // Unpin the cache block of a view. The view must not be used anymore afterwards.
+    void releaseView(FileDataView& view);
+    
+    // How the cache was used since open() or the last resetStatistics(): hits, misses, evictions,
+    // bytes read and handed out, fetch latencies, and how much of the cache holds data. Use it to
+    // tune cacheMaxSize and cacheBlockSize. Both calls are thread-safe, and counting is always on
+    // (it costs a relaxed atomic add per block).
+    void statisticsSnapshot(CacheStatistics::Snapshot& snapshot);
+    void resetStatistics();
+    
+private:
+    
+    // MARK: - Private definitions
     
     // MARK: - Private properties
     
     // Path of the file that is open.
     std::string filePath;
     
-    // Maximum number of blocks that we can cache.
-    int64_t maxNumberOfCachedFileDataBlocks;
-    // Number of indexes in fileCacheIndex
-    int64_t totalNumberOfFileCacheIndexEntries;
-
-    // Number of blocks that we have cached currently.
-    int64_t currentNumberOfCachedFileDataBlocks;
+    // Number of data blocks that it takes to hold the whole file.
+    std::atomic<int64_t> totalNumberOfFileCacheIndexEntries;
 
     // File status of the open file.
     struct stat fileStatus;
+    // Size of the open file. This is what all reading is limited to. It only changes in follow mode,
+    // where readers may be using it while it changes.
+    std::atomic<off_t> currentFileSize;
+    // Makes sure that only one refreshFileSize() runs at the same time.
+    std::mutex refreshMutex;
     // File descriptor of the open file.
     int fileDescriptor;
+    // Alignment of file offsets, lengths and buffers that direct I/O requires, or 0.
+    size_t directIOAlignment;
+    // Does the physical reading for us. Not used when the file is memory mapped.
+    FileIOBackend* fileIOBackend;
+    // Maximum number of blocks that we fetch in one batch. Never more than half the cache, so
+    // that one reader can not pin the whole cache.
+    int64_t maximumFetchBatchBlocks;
     
-    // Index of the file buffers. There are as many entries as fits the file size.
-    // However, there might be fewer blocks in the file buffer, and with the index,
-    // we can read blocks and remove least recently used blocks when necessary.
-    FileCacheIndexEntry* fileCacheIndex;
+    // Cache of file data blocks: sharedBlockCache, or a cache of our own. The cache maps the index of
+    // a file data block (file offset / cacheBlockSize), combined with our file number, to the cache
+    // block that holds its data. The bookkeeping of a block is protected by the shardMutex of its shard.
+    SharedBlockCache* blockCache;
+    // Number of the file in blockCache.
+    int64_t blockCacheFileNumber;
     
-    // Index to the FileBufferBlockEntry that is the most recently used.
-    int64_t mostRecentlyUsedIndex = -1;
-    // Index to the FileBufferBlockEntry that is the least recently used.
-    int64_t leastRecentlyUsedIndex = -1;
-
-    // Cache of file data blocks.
-    unsigned char* fileDataBlocks;
+    // Counts what the cache does, see statisticsSnapshot.
+    CacheStatistics cacheStatistics;
 
     // 'Virtual' current offset pointer into the file. Note that this is not the
     // actual read offset of the file's file pointer. It points to the next data
     // that the 'read' memberfunction will return data from when called.
     off_t currentFileOffset;
     
+    // Read-ahead state. The thread is only started when we first detect sequential access.
+    std::thread readAheadThread;
+    // Protects the read-ahead queue and readAheadStop.
+    std::mutex readAheadMutex;
+    std::condition_variable readAheadCondition;
+    // Indexes of the blocks that the read-ahead thread should fetch, in order.
+    std::deque<int64_t> readAheadQueue;
+    // Tells the read-ahead thread to quit.
+    bool readAheadStop = false;
+    // Offset where the next 'read' should start if the access is sequential.
+    off_t readAheadExpectedFileOffset = -1;
+    // Current size of the read-ahead window in blocks, 0 if not reading ahead.
+    int64_t readAheadWindow = 0;
+    // Last index that we queued for read-ahead.
+    int64_t readAheadLastQueuedIndex = -1;
+    // The madvise advice for windows that are mapped, based on the access pattern that read-ahead detects.
+    std::atomic<int> memoryMappingAdvice;
+    
+    // Number of asynchronous reads that were handed to the pool and are not done yet. close() waits
+    // for them, they use the file and the cache.
+    std::mutex asyncReadMutex;
+    std::condition_variable asyncReadCondition;
+    int64_t numberOfAsyncReadsInFlight = 0;
+    
     // MARK: - Private methods
 
-    size_t fetchDataBlockForIndex(int64_t index);
+    // Find out if the file can be read with direct I/O, and what alignment that requires (0 if
+    // there are no requirements). Returns false if direct I/O is not supported.
+    static bool queryDirectIOAlignmentForFile(const std::string& fullFilePath, size_t& alignment);
+    // Key of the index entry in blockCache.
+    int64_t blockKeyForIndex(int64_t index) const
+    {
+        return blockCache->blockKeyForIndex(blockCacheFileNumber, index);
+    }
+    // Map the window for the index entry into the cache block.
+    ssize_t mapDataBlockForIndex(int64_t index, int64_t cacheBlock);
+    // If the block at the old end of the file is cached, fill in its part from oldFileSize up to
+    // newFileSize (or the end of the block). Returns false if the data could not be read.
+    bool extendTailDataBlock(off_t oldFileSize, off_t newFileSize);
+    
+    // True if a readAt of numberOfBytes from fileOffset into buffer goes around the cache, see
+    // largeReadBypassThreshold.
+    bool isBypassingCacheForRead(off_t fileOffset, const unsigned char* buffer, size_t numberOfBytes) const;
+    // readAt for numberOfBytes that are all in the file: through the cache, or around it.
+    size_t readThroughCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes);
+    size_t readBypassingCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes);
+    // readAt, but only if it can be done without waiting for the file: if all blocks are in the cache
+    // (and none of them is being fetched), or if there is nothing to read. Returns true, and the result
+    // of the read in bytesRead, if it was done, else false, and nothing is read.
+    bool readAtFromCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, size_t& bytesRead);
+    // Do a readAt on asyncReadWorkerPool, and call completion with the result.
+    void submitAsyncRead(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, std::function<void(size_t bytesRead)> completion);
+    
+    // Make sure the data for the index entry is in the cache, and pin it so that it can not
+    // be evicted while we use it. Returns the cache block that holds the data, or
+    // -1 if the data could not be read.
+    int64_t acquireDataBlockForIndex(int64_t index);
+    // Like acquireDataBlockForIndex, for up to numberOfIndexes index entries, in ascending order and
+    // without duplicates. All missing blocks are fetched in one batch. Returns the number of blocks
+    // acquired from the start of indexes (at least 1, their blocks are in cacheBlocks), or -1 if the
+    // data could not be read.
+    int64_t acquireDataBlocksForIndexes(const int64_t* indexes, int64_t numberOfIndexes, int64_t* cacheBlocks);
+    // Unpin a block that was acquired with acquireDataBlockForIndex.
+    void releaseDataBlock(int64_t cacheBlock);
+    // Find a cache block for the index entry, evicting another entry (maybe of another file) if
+    // needed. Must be called with the shardMutex of the shard of the index entry held. Returns the
+    // block, or -1 if all blocks of the shard are pinned.
+    int64_t claimDataBlockForIndex(int64_t index);
+    // Physically read the data for the index entry into the cache block.
+    ssize_t fetchDataBlockForIndex(int64_t index, int64_t cacheBlock);
+    // Physically read the data for multiple index entries in one batch.
+    void fetchDataBlocksForIndexes(const int64_t* indexes, const int64_t* cacheBlocks, ssize_t* bytesRead, int64_t numberOfBlocks);
+    // Finish a fetch that was started with claimDataBlockForIndex. If the fetch failed, the block
+    // is given back. Must be called with the shardMutex of the shard of the block held. Returns false
+    // if the fetch failed.
+    bool completeFetchForCacheBlock(int64_t cacheBlock, ssize_t bytesRead);
+    
+    // Bring the data of the index entries into the cache in one batch, for the ones that are not
+    // there yet and as far as there are blocks available for them, without pinning them.
+    void prefetchDataBlocksForIndexes(const int64_t* indexes, int64_t numberOfIndexes);
+    // Update the sequential access detection after a 'read', and queue blocks for read-ahead.
+    void updateReadAhead(off_t fileOffset, size_t numberOfBytesRead);
+    // Stop the read-ahead thread and forget about everything that was queued.
+    void stopReadAhead();
+    // Main loop of the read-ahead thread.
+    void readAheadThreadMain();
 };
 
 #pragma GCC visibility pop
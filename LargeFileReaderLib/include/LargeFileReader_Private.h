@@ -0,0 +1,22 @@
+//
+//  LargeFileReader_Private.h
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef LargeFileReader_Private_h
+#define LargeFileReader_Private_h
+
+#import "LargeFileReader.h"
+#import "LargeFileReaderCore.hpp"
+
+// Gives the other Objective-C++ classes of the library access to the core of a LargeFileReader. Not
+// part of the module, only for .mm files.
+@interface LargeFileReader()
+
+@property (nonatomic, assign) LargeFileReaderCore *largeFileReaderCore;
+
+@end
+
+#endif /* LargeFileReader_Private_h */
@@ -0,0 +1,55 @@
+//
+//  LineDelimiterScanner.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef LineDelimiterScanner_hpp
+#define LineDelimiterScanner_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Finds all occurrences of a delimiter byte in a buffer, as fast as the machine allows.
+//
+// The search compares a whole vector of bytes with the delimiter at once, turns the result into a bit
+// mask with one bit per byte, and hands out the positions of the set bits. Blocks without delimiters
+// (the vast majority of bytes in a log file) cost a load, a compare and a test.
+//
+// The instruction set is picked once, at the first call: AVX2 if the CPU has it, else SSE2 on x86,
+// NEON on ARM, and memchr everywhere else.
+class LineDelimiterScanner
+{
+public:
+
+    // MARK: - Public definitions
+
+    enum InstructionSet
+    {
+        InstructionSetPortable,
+        InstructionSetSSE2,
+        InstructionSetAVX2,
+        InstructionSetNEON
+    };
+
+    // MARK: - Public methods
+
+    // Store the positions (relative to data) of all delimiters in data in positions, in order. Returns
+    // the number of delimiters found. positions must have room for length entries, and length must
+    // fit in 32 bits.
+    static size_t findDelimiters(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions);
+
+    // The instruction set that findDelimiters uses on this machine.
+    static InstructionSet instructionSet();
+};
+
+#pragma GCC visibility pop
+
+#endif /* LineDelimiterScanner_hpp */
@@ -0,0 +1,135 @@
+//
+//  LineIndexFile.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef LineIndexFile_hpp
+#define LineIndexFile_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <functional>
+
+#include "LargeFileReaderCore.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// A line index stored on disk, next to the file that it indexes, so that the file does not have to be
+// indexed again every time it is opened.
+//
+// The line index file is used exactly as it is on disk: it is mapped into memory, and looking up a
+// line reads the page that the line is in, so loading costs a few system calls, however large the
+// index is. To keep it compact, the lines are stored in pages of entriesPerPage lines, each with the
+// offset of its first line, and for every line its offset relative to that (32 bits) and its length
+// (32 bits). That is 8 bytes per line instead of 16.
+//
+// The header identifies the file that was indexed (size, modification time, inode, and checksums of
+// its first and last checksumBlockSize bytes), and the settings that it was indexed with. A line
+// index file that does not match is stale and is not loaded. The file is stored in the byte order of
+// the machine that wrote it, and is not loaded on a machine with a different byte order.
+class LineIndexFile
+{
+public:
+
+    // MARK: - Public definitions
+
+    struct FileIdentity
+    {
+        uint64_t fileSize;
+        int64_t modificationTimeSeconds;
+        int64_t modificationTimeNanoseconds;
+        uint64_t inode;
+        uint64_t firstBlockChecksum;
+        uint64_t lastBlockChecksum;
+    };
+
+    // Settings that change what the index looks like. An index is only used with the same settings.
+    struct IndexSettings
+    {
+        uint64_t maximumLineLength;
+        uint32_t lineDelimiterLength;
+        // The delimiter, padded with zeroes.
+        uint8_t lineDelimiter[16];
+    };
+
+    // MARK: - Public consts
+
+    static const uint32_t entriesPerPage = 1024;
+    static const size_t checksumBlockSize = 4096;
+
+    // MARK: - Public methods
+
+    LineIndexFile();
+    ~LineIndexFile();
+
+    // Get the identity of the file that is open in the reader.
+    static bool identityForFile(LargeFileReaderCore* reader, FileIdentity& identity);
+
+    // Write a line index file. entryForLine is called for every line in order. The file is written
+    // under a temporary name and renamed when it is complete, so a reader never sees half a file.
+    // Returns false if the file could not be written.
+    static bool write(const std::string& lineIndexFilePath, const FileIdentity& identity, const IndexSettings& settings, int64_t numberOfLines, const std::function<void(int64_t lineNumber, off_t& offset, size_t& length)>& entryForLine);
+
+    // Map a line index file. Returns false if it does not exist, is damaged, or does not match the
+    // identity or the settings.
+    bool map(const std::string& lineIndexFilePath, const FileIdentity& identity, const IndexSettings& settings);
+    void unmap();
+
+    bool isMapped() const;
+    int64_t numberOfLines() const;
+    // Offset and length of a line. lineNumber must be less than numberOfLines().
+    void entryForLine(int64_t lineNumber, off_t& offset, size_t& length) const;
+
+private:
+
+    // MARK: - Private definitions
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entriesPerPage;
+        uint64_t numberOfLines;
+        uint64_t numberOfPages;
+        IndexSettings settings;
+        FileIdentity identity;
+        // Checksum of everything above.
+        uint64_t headerChecksum;
+    };
+
+    struct Page
+    {
+        uint64_t firstOffset;
+        uint32_t relativeOffsets[entriesPerPage];
+        uint32_t lengths[entriesPerPage];
+    };
+
+    // MARK: - Private consts
+
+    static const uint32_t currentVersion = 2;
+    // Pages start at a page boundary of the mapping.
+    static const size_t pagesOffset = 4096;
+
+    // MARK: - Private properties
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const Header* header = nullptr;
+    const Page* pages = nullptr;
+
+    // MARK: - Private methods
+
+    static uint64_t checksum(const void* data, size_t length);
+    static uint64_t checksumForHeader(const Header& header);
+};
+
+#pragma GCC visibility pop
+
+#endif /* LineIndexFile_hpp */
@@ -8,5 +8,51 @@
 #ifndef LineIndexer_h
 #define LineIndexer_h
 
+#import <Foundation/Foundation.h>
+
+@class LargeFileReader;
+
+// Indexes the lines of the file that is open in a LargeFileReader, and reads lines by number. The
+// reader must stay open while the indexer is used.
+@interface LineIndexer : NSObject
+
+// What ends a line, "\n" by default. Can be more than one byte, like "\r\n". Must be set before
+// indexing.
+@property (nonatomic, copy) NSData *lineDelimiter;
+// Lines longer than this are cut into pieces of this length. Must be set before indexing.
+@property (nonatomic, assign) NSInteger maximumLineLength;
+// Number of chunks of the file that are indexed at the same time, 0 for as many as there are cores.
+@property (nonatomic, assign) NSInteger numberOfIndexingThreads;
+// Size in bytes of the chunks that are indexed at the same time, at least 65536. Must be set before
+// indexing.
+@property (nonatomic, assign) NSInteger parallelIndexingChunkSize;
+// Must be set before indexing. With more than 1, only every lineCheckpointInterval-th line is kept in
+// the index, which costs far less memory, and the lines in between are found by scanning the file.
+@property (nonatomic, assign) NSInteger lineCheckpointInterval;
+// Number of lines in the index, or -1 if the file has not been indexed.
+@property (nonatomic, readonly) NSInteger numberOfLines;
+
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader;
+
+- (BOOL)indexLines;
+// Only index what was appended to a followed file, see LargeFileReader.followEnabled.
+- (BOOL)indexNewLines;
+- (BOOL)saveLineIndex:(NSString *)lineIndexFilePath;
+// Returns NO if there is no line index file, or if it does not belong to the open file (anymore).
+- (BOOL)loadLineIndex:(NSString *)lineIndexFilePath;
+
+// Returns the line (without its delimiter), or nil if there is no such line or it could not be read. A
+// line that is in a single cache block is not copied, the block stays pinned until the returned
+// object is deallocated, which must happen before the file is closed.
+- (NSData *)lineAt:(NSInteger)lineNumber;
+// Returns up to count lines from firstLineNumber on, read from the file in one go, or nil if they
+// could not be read.
+- (NSArray<NSData *> *)linesFrom:(NSInteger)firstLineNumber count:(NSInteger)count;
+// Calls block for every line from firstLineNumber on, towards the end of the file, or towards the
+// start if reverse is YES, until stop is set. The line data is not copied, and is only valid in the
+// block.
+- (void)enumerateLinesFrom:(NSInteger)firstLineNumber reverse:(BOOL)reverse usingBlock:(void (^)(NSInteger lineNumber, NSData *line, BOOL *stop))block;
+
+@end
 
 #endif /* LineIndexer_h */
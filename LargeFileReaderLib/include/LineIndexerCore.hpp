@@ -8,12 +8,17 @@
 #ifndef LineIndexerCore_hpp
 #define LineIndexerCore_hpp
 
+#if __has_include(<swift/bridging>)
 #include <swift/bridging>
+#endif
 #include <stdint.h>
 #include <sys/types.h>
+#include <vector>
+#include <string>
 
 #include "LargeFileReaderCore.hpp"
 #include "FixedBlockAllocatedArray.hpp"
+#include "LineIndexFile.hpp"
 
 class LineIndexerCore {
 public:
@@ -25,14 +30,82 @@ public:
         size_t  length;
     };
     
+    // Walks through the lines of an indexed file, forward or backward.
+    //
+    // A line that is in a single cache block is not copied: lineData() points into the cache, and the
+    // block stays pinned (see LargeFileReaderCore::acquireView) until the iterator moves to another
+    // line or is destroyed. A line that crosses a block boundary is copied into a buffer of the
+    // iterator. The indexer and the reader must outlive the iterator, and the iterator must be
+    // destroyed before the file is closed or indexed again.
+    class LineIterator {
+    public:
+        // Start at lineNumber. If there is no such line, the iterator is not at a line.
+        LineIterator(const LineIndexerCore* lineIndexer, LargeFileReaderCore* reader, int64_t lineNumber);
+        ~LineIterator();
+        
+        LineIterator(const LineIterator&) = delete;
+        LineIterator& operator = (const LineIterator&) = delete;
+        
+        // Go to a line. Returns false if there is no such line or it could not be read, the iterator
+        // is then not at a line anymore.
+        bool moveToLine(int64_t lineNumber);
+        bool moveToNextLine();
+        bool moveToPreviousLine();
+        
+        bool isAtLine() const;
+        // The line that the iterator is at, or -1.
+        int64_t lineNumber() const;
+        // Data (without the delimiter) and length of the line. Only valid until the iterator moves.
+        const unsigned char* lineData() const;
+        size_t lineLength() const;
+        
+    private:
+        const LineIndexerCore* lineIndexer;
+        LargeFileReaderCore* reader;
+        int64_t currentLineNumber = -1;
+        const unsigned char* currentLineData = nullptr;
+        size_t currentLineLength = 0;
+        // The view that holds the line, if it is in a single block.
+        LargeFileReaderCore::FileDataView view;
+        // The line, if it is not in a single block.
+        std::vector<unsigned char> lineBuffer;
+    };
+    
     // MARK: - Public consts
     
+    static const int64_t maximumLineCheckpointInterval = 16384;
+    static const size_t maximumLineDelimiterLength = sizeof(LineIndexFile::IndexSettings::lineDelimiter);
+    
     // MARK: - Public properties
     
-    // TODO: Make it an array or string, so we can pass \x0D\x0A.
-    uint8_t lineDelimiter = '\n';
+    // What ends a line: "\n", "\r\n", "\x1E" (record separator), std::string(1, '\0') for NUL
+    // separated records, or any other string of 1 to maximumLineDelimiterLength bytes. Where two
+    // delimiters overlap (as "\n\n" does in "\n\n\n"), the first one counts. Must be set before
+    // indexing.
+    std::string lineDelimiter = "\n";
+    // Lines longer than this are cut into pieces of maximumLineLength bytes, each of which is a line in
+    // the index. At least 1 and at most UINT32_MAX. Must be set before indexing.
+    size_t maximumLineLength = 2048;
+    
+    // Parallel indexing. The file is cut into chunks of parallelIndexingChunkSize bytes, which are
+    // searched for delimiters on WorkerPool::sharedPool(), with at most numberOfIndexingThreads chunks
+    // at the same time (0 means as many as there are cores). With 1, or for a file that fits in a
+    // single chunk, the file is indexed on the calling thread.
+    size_t numberOfIndexingThreads = 0;
+    size_t parallelIndexingChunkSize = 67108864;
+    
+    // Sparse indexing. With 1, every line is in lineIndex (16 bytes per line). With more, only the
+    // offset of every lineCheckpointInterval-th line is kept, in about 4 bytes, and lineIndex is not
+    // used. Looking up a line then means scanning the file forward from the checkpoint before it, so
+    // this trades lookup time for memory. Must be set before indexing, at most
+    // maximumLineCheckpointInterval, and less with a very large maximumLineLength.
+    int64_t lineCheckpointInterval = 1;
     
-    int numberOfLines = -1;
+    // Number of lines in the index, or -1 if the file has not been indexed.
+    int64_t numberOfLines = -1;
+    // Offset and length (without the delimiter) of every line in the file, if the file was indexed by
+    // indexLinesForFileReader without checkpoints. Use lineEntryForLine to access the index, wherever
+    // it came from.
     FixedBlockAllocatedArray<LineIndexerCore::LineIndexEntry> lineIndex;
     
     // MARK: - Public methods
@@ -40,7 +113,69 @@ public:
     LineIndexerCore();
     ~LineIndexerCore();
     
+    // Index all lines in the file. The data is scanned in place in the reader's cache, the reader's
+    // current file offset is not used or changed.
+    //
+    // Lines that are longer than maximumLineLength are cut into pieces of maximumLineLength bytes. A
+    // last line without a delimiter is indexed too.
+    //
+    // Returns 0 if the file was indexed, or -1 if it could not be read or lineDelimiter is empty or too
+    // long.
+    //
+    // The reader is only used through positional, thread-safe calls, so it may be used by others
+    // while we index.
     int indexLinesForFileReader(LargeFileReaderCore* reader);
+    // Index only what was appended to the file since it was indexed, for a file that is followed (see
+    // LargeFileReaderCore::followEnabled). The new lines are added to the index. A last line that had
+    // no delimiter yet is indexed again, as it may have become longer. Indexes the whole file if it
+    // was not indexed before. A loaded index is copied into lineIndex first, as that can't be added to.
+    //
+    // Returns 0 if the new lines were indexed, or -1 if the file could not be read or has become
+    // smaller than it was.
+    int indexNewLinesForFileReader(LargeFileReaderCore* reader);
+    
+    // Offset and length of a line. lineNumber must be less than numberOfLines, and reader must have
+    // the file open that was indexed (it is only used with a sparse index). Returns 0, or -1 if the
+    // file could not be read.
+    int lineEntryForLine(LargeFileReaderCore* reader, int64_t lineNumber, LineIndexEntry& lineIndexEntry) const;
+    // Same, for numberOfLinesWanted lines from firstLineNumber on. With a sparse index, this scans
+    // from the checkpoint only once.
+    int lineEntriesForLines(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, LineIndexEntry* lineIndexEntries) const;
+    
+    // The line that the byte at offset is in, a delimiter counting as part of the line before it.
+    // Returns -1 if the file has not been indexed, or could not be read.
+    int64_t lineNumberForOffset(LargeFileReaderCore* reader, off_t offset) const;
+    
+    // Read a line (without its delimiter) into buffer, at most bufferSize bytes of it. Returns the
+    // length of the line, or -1 if there is no such line or it could not be read.
+    size_t readLine(LargeFileReaderCore* reader, int64_t lineNumber, unsigned char* buffer, size_t bufferSize) const;
+    // Read up to numberOfLinesWanted lines from firstLineNumber on into buffer, as they are in the
+    // file: with their delimiters in between. Lines are only read as far as they fit completely. The
+    // offset and length of every line are stored in lineIndexEntries (which must have room for
+    // numberOfLinesWanted entries), the offset of a line in buffer is its offset minus the offset of
+    // the first line. Since the lines are next to each other in the file, this is a single read, and
+    // only fetches the cache blocks that the lines are in.
+    // Returns the number of lines read, or -1 if the lines could not be read.
+    int64_t readLines(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, unsigned char* buffer, size_t bufferSize, LineIndexEntry* lineIndexEntries) const;
+    
+    // Save the index to a line index file, see LineIndexFile. reader must have the file open that was
+    // indexed. A sparse index can not be saved. Returns false if the file could not be written.
+    bool saveLineIndexForFileReader(LargeFileReaderCore* reader, const std::string& lineIndexFilePath);
+    // Use the index in a line index file, instead of indexing the file. The line index file is mapped
+    // into memory, not read. Returns false if there is no line index file, or if it does not belong
+    // to the file that is open in reader (anymore), or was made with other settings. The file must be
+    // indexed with indexLinesForFileReader in that case.
+    bool loadLineIndexForFileReader(LargeFileReaderCore* reader, const std::string& lineIndexFilePath);
+    // Where the line index file for a file is kept by default.
+    static std::string defaultLineIndexFilePathForFile(const std::string& fullFilePath);
+    
+    // The delimiter and maximum line length that the lines in the index were made with. lineDelimiter
+    // and maximumLineLength can have been changed since.
+    const std::string& lineDelimiterOfIndex() const;
+    size_t maximumLineLengthOfIndex() const;
+    // Whether the end of the delimiter can be the start of another one, like "\n\n". Such delimiters
+    // can't be found in a chunk without knowing the delimiters before it.
+    static bool lineDelimiterCanOverlapItself(const std::string& lineDelimiter);
 
 private:
     
@@ -48,9 +183,79 @@ private:
     
     // MARK: - Private consts
     
+    // Number of bytes that we search for delimiters in one go.
+    const size_t scanSliceSize = 65536;
+    // Same, when looking up a line from a checkpoint. Usually only a few lines are needed.
+    static const size_t lookupScanSliceSize = 4096;
+    // Number of chunks per thread that are indexed in parallel before the next ones, see
+    // indexLinesInParallel.
+    static const size_t parallelIndexingChunksPerThread = 4;
+    // Checkpoints are stored in groups. Every group has the full offset of its first checkpoint, and
+    // every checkpoint has its offset relative to that in 32 bits. A group covers at most
+    // checkpointsPerGroup * lineCheckpointInterval entries of at most maximumLineLength bytes plus a
+    // delimiter, lineCheckpointInterval is limited so that fits.
+    static const int64_t checkpointsPerGroup = 64;
+    
     // MARK: - Private properties
     
+    // The line index file, if the index was loaded instead of made.
+    LineIndexFile loadedLineIndexFile;
+    // Number of bytes of the file that the index covers.
+    off_t indexedFileSize = 0;
+    // lineCheckpointInterval, as it was when the file was indexed. 1 if every line is in lineIndex.
+    int64_t indexedLineCheckpointInterval = 1;
+    // lineDelimiter and maximumLineLength, as they were when the file was indexed.
+    std::string indexedLineDelimiter = "\n";
+    size_t indexedMaximumLineLength = 2048;
+    // Offset of the first checkpoint of every group, and of every checkpoint relative to that.
+    FixedBlockAllocatedArray<off_t> checkpointGroupOffsets;
+    FixedBlockAllocatedArray<uint32_t> checkpointRelativeOffsets;
+    
     // MARK: - Private methods
+    
+    static LineIndexFile::IndexSettings indexSettings(const std::string& lineDelimiter, size_t maximumLineLength);
+    
+    // Scan from startOffset up to endOffset for delimiters, through views of at most sliceSize bytes.
+    // handleDelimiter(endOfLine, startOfNextLine) is called for every delimiter, and
+    // handleEndOfSlice(fileOffset) after every view, with the offset up to where we scanned. Either
+    // can return true to stop the scan. Delimiters that start before earliestStartOfDelimiter are not
+    // matched. sliceDelimiterPositions must have room for sliceSize entries.
+    // Returns 1 if the scan was stopped, 0 if it got to endOffset, or -1 if the data could not be read.
+    template <typename DelimiterHandler, typename SliceHandler>
+    int scanForDelimiters(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, off_t earliestStartOfDelimiter, size_t sliceSize, uint32_t* sliceDelimiterPositions, DelimiterHandler handleDelimiter, SliceHandler handleEndOfSlice) const;
+    // The same, for a delimiter of one byte or of more bytes, so the common case does not pay for the
+    // other one.
+    template <bool isSingleByteDelimiter, typename DelimiterHandler, typename SliceHandler>
+    int scanForDelimitersOfLength(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, off_t earliestStartOfDelimiter, size_t sliceSize, uint32_t* sliceDelimiterPositions, DelimiterHandler handleDelimiter, SliceHandler handleEndOfSlice) const;
+    
+    int indexLinesSequentially(LargeFileReaderCore* reader, off_t fileSize);
+    // Index the lines from startOffset (the start of a line) up to endOffset, and add them to the index
+    // from entry numberOfLines on.
+    int indexLinesInRange(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset);
+    int indexLinesInParallel(LargeFileReaderCore* reader, off_t fileSize, size_t chunkSize);
+    // Find the positions (relative to startOffset) of the last byte of all delimiters that end from
+    // startOffset up to endOffset. Returns false if the data could not be read.
+    bool findDelimitersInRange(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, std::vector<uint32_t>& delimiterPositions);
+    
+    // Number of entries in the index that a line of lineLength bytes takes.
+    int64_t numberOfEntriesForLine(size_t lineLength) const;
+    // Store the line from startOfLine to endOfLine (the offset of its delimiter, or of the end of the
+    // file) in the index at entryNumber, cut into pieces if it is too long. entryNumber is advanced
+    // past the line.
+    void storeLine(int64_t& entryNumber, off_t startOfLine, off_t endOfLine);
+    // Store a single entry, in lineIndex, or as a checkpoint if it is one.
+    void storeEntry(int64_t entryNumber, off_t offset, size_t length);
+    
+    // maximumLineLength and lineCheckpointInterval, limited to what we can do.
+    size_t validMaximumLineLength() const;
+    int64_t validLineCheckpointInterval() const;
+    bool hasValidLineDelimiter() const;
+    // Forget the index, and start a new one with the given interval, and the current lineDelimiter and
+    // maximumLineLength.
+    void resetIndex(int64_t checkpointInterval);
+    off_t offsetOfCheckpoint(int64_t checkpointNumber) const;
+    // Find the lines by scanning forward from the checkpoint before the first one.
+    int lineEntriesFromCheckpoint(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, LineIndexEntry* lineIndexEntries) const;
 
 };
 
@@ -0,0 +1,22 @@
+//
+//  LineIndexer_Private.h
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef LineIndexer_Private_h
+#define LineIndexer_Private_h
+
+#import "LineIndexer.h"
+#import "LineIndexerCore.hpp"
+
+// Gives the other Objective-C++ classes of the library access to the core of a LineIndexer. Not part
+// of the module, only for .mm files.
+@interface LineIndexer()
+
+@property (nonatomic, assign) LineIndexerCore *lineIndexerCore;
+
+@end
+
+#endif /* LineIndexer_Private_h */
@@ -0,0 +1,231 @@
+//
+//  SharedBlockCache.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef SharedBlockCache_hpp
+#define SharedBlockCache_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+
+#include "CacheEvictionPolicy.hpp"
+#include "CacheBlockMap.hpp"
+#include "CacheMemoryAllocator.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// The memory and the bookkeeping of a block cache: the blocks, which file data each of them holds, the
+// map from file data to blocks, and the eviction policy.
+//
+// Every LargeFileReaderCore reads through one of these. A reader that is not given one creates its own
+// when it opens a file. Many readers can also share one: they then share its memory budget and its
+// eviction policy, and memory goes to whichever files are being read, instead of sitting idle in the
+// caches of the files that are not. Blocks are identified by a key that combines the number of the file
+// (given out by attachFile) and the index of the block in the file, so blocks of different files never
+// mix.
+//
+// A large cache is split into shards by block key. Every shard has its own blocks, map, eviction policy
+// and mutex, so readers of blocks in different shards do not contend.
+//
+// The cache itself only hands out file numbers and cleans up after files. LargeFileReaderCore does the
+// bookkeeping for its reads, with the shardMutex of the shard of the block held.
+class SharedBlockCache
+{
+public:
+
+    // MARK: - Public consts
+
+    // A block key is (file number << fileNumberShift) + index of the block in the file. A file can
+    // then have 2^40 blocks, and 2^23 files can be attached at the same time.
+    static const int fileNumberShift = 40;
+    static const int64_t maximumNumberOfFiles = (int64_t)1 << (63 - fileNumberShift);
+    // A cache is split into at most maximumNumberOfCacheShards shards (a power of 2), and only into as
+    // many as give every shard at least minimumCacheBlocksPerShard blocks. A small cache has one.
+    static const int64_t maximumNumberOfCacheShards = 16;
+    static const int64_t minimumCacheBlocksPerShard = 256;
+
+    // MARK: - Public properties
+
+    // Size of a block. All files that are attached are read in blocks of this size.
+    const size_t cacheBlockSize;
+    // Size of the memory of the cache, a multiple of cacheBlockSize.
+    const size_t cacheActualSize;
+    // Number of blocks in the cache.
+    const int64_t maxNumberOfCachedBlocks;
+    // Number of shards the blocks are split into.
+    const int64_t numberOfCacheShards;
+    // True if the blocks are windows that files are mapped into, instead of memory that data is read into.
+    const bool isMappingAddressSpace;
+
+    // The page type the blocks actually got, and whether the NUMA policy could be applied to them.
+    CacheMemoryAllocator::PageType cacheBlocksPageType() const
+    {
+        return cacheBlocksAllocation.pageType;
+    }
+    bool isCacheBlocksNumaPolicyApplied() const
+    {
+        return cacheBlocksAllocation.isNumaPolicyApplied;
+    }
+
+    // MARK: - Public methods
+
+    // Create a cache of (at most) cacheMaxSize bytes, in blocks of cacheBlockSize bytes. The memory is
+    // allocated now, aligned to memoryAlignment (at least a page). With isMappingAddressSpace, only
+    // address space is reserved, for a reader that maps windows of its file into it; such a cache can
+    // not be shared. A cacheMaxSize of 0 makes a cache without blocks (for an empty file). Throws
+    // std::out_of_range if cacheBlockSize is 0 or larger than cacheMaxSize, and std::bad_alloc if
+    // there is not enough memory. The blocks and the map are allocated with memoryAllocator, which
+    // decides on huge pages and NUMA placement (not for the blocks of a mapping cache, those are files).
+    SharedBlockCache(size_t cacheMaxSize, size_t cacheBlockSize, CacheEvictionPolicy::PolicyType evictionPolicyType = CacheEvictionPolicy::PolicyTypeLRU,
+                     size_t memoryAlignment = 0, bool isMappingAddressSpace = false,
+                     const CacheMemoryAllocator& memoryAllocator = CacheMemoryAllocator());
+    // All files must have been detached.
+    ~SharedBlockCache();
+
+    // Number of the files that are attached, and blocks that hold data (or are being loaded).
+    int64_t numberOfAttachedFiles();
+    int64_t numberOfCachedBlocks();
+    // Number of blocks that hold data of the file.
+    int64_t numberOfCachedBlocksForFile(int64_t fileNumber);
+
+    // Attach a file. Returns the file number for the keys of its blocks, or -1 if too many files are
+    // attached.
+    int64_t attachFile();
+    // Detach a file, and give all of its blocks back. None of its blocks may be in use, the reader must
+    // be done with them.
+    void detachFile(int64_t fileNumber);
+
+    int64_t blockKeyForIndex(int64_t fileNumber, int64_t index) const
+    {
+        return (fileNumber << fileNumberShift) + index;
+    }
+    static int64_t fileNumberForBlockKey(int64_t blockKey)
+    {
+        return blockKey >> fileNumberShift;
+    }
+    static int64_t indexForBlockKey(int64_t blockKey)
+    {
+        return blockKey & (((int64_t)1 << fileNumberShift) - 1);
+    }
+
+    // Allocate/free memory for blocks. The memory is aligned to at least a page.
+    static unsigned char* allocateCacheMemory(size_t size, size_t alignment);
+    static void freeCacheMemory(unsigned char* memory);
+    // Reserve/release address space that windows are mapped into.
+    static unsigned char* reserveMappingAddressSpace(size_t size);
+    static void releaseMappingAddressSpace(unsigned char* memory, size_t size);
+
+private:
+
+    friend class LargeFileReaderCore;
+
+    // MARK: - Private definitions
+
+    struct CacheBlockEntry
+    {
+        // Key of the file data block that this cache block holds the data for, or -1 if the cache
+        // block is not used.
+        int64_t blockKey = -1;
+        // Number of readers that are currently using the data of this block. A pinned block will
+        // never be evicted.
+        uint32_t pinCount = 0;
+        // If true, then a reader is busy fetching the data of this block from its file.
+        bool isLoading = false;
+    };
+
+    // The blocks from firstCacheBlock up to firstCacheBlock + numberOfCacheBlocks, and their bookkeeping.
+    // The map holds cache block numbers, the eviction policy works on the numbers of the blocks within
+    // the shard (cache block - firstCacheBlock).
+    struct CacheShard
+    {
+        int64_t firstCacheBlock = 0;
+        int64_t numberOfCacheBlocks = 0;
+        // Maps block keys to the blocks that hold their data. Only blocks that are in the cache are in
+        // the map, so its size depends on the size of the cache, not on the size of the files.
+        CacheBlockMap* cacheBlockMap = nullptr;
+        // Keeps track of how the blocks are used, and decides which one to steal when the shard is full.
+        CacheEvictionPolicy* cacheEvictionPolicy = nullptr;
+        // Blocks that were in use before, but were given back (a fetch failed, or the file was detached).
+        std::vector<int64_t> freeCacheBlocks;
+        // Number of blocks that hold data (or are loading), in total, and for every file number. The
+        // blocks are taken into use from firstCacheBlock up, so the blocks that are not counted are
+        // either in freeCacheBlocks or come after all others.
+        int64_t currentNumberOfCachedBlocks = 0;
+        std::vector<int64_t> numberOfCachedBlocksForFiles;
+
+        // Protects everything above, and the entries of the blocks of the shard. It is only held while
+        // updating the bookkeeping, never while reading from a file or copying data.
+        std::mutex shardMutex;
+        // Signalled when a block of the shard has finished loading or has been unpinned.
+        std::condition_variable shardCondition;
+    };
+
+    // MARK: - Private properties
+
+    // The blocks.
+    unsigned char* cacheBlocks;
+    CacheMemoryAllocator::Allocation cacheBlocksAllocation;
+    // Bookkeeping for every block in cacheBlocks, protected by the mutex of the shard of the block.
+    CacheBlockEntry* cacheBlockEntries;
+    // The shards, numberOfCacheShards of them. All but the last have cacheBlocksPerShard blocks, the
+    // last one also has the blocks that are left over.
+    CacheShard* cacheShards;
+    int64_t cacheBlocksPerShard;
+
+    // Which file numbers are given out.
+    std::vector<bool> isFileNumberAttached;
+    int64_t currentNumberOfAttachedFiles;
+    // Protects the two above. Taken before the mutex of a shard, never while holding one.
+    std::mutex filesMutex;
+
+    // MARK: - Private methods
+
+    // The shard that holds the block key. Neighbouring blocks of a file go to different shards, and so
+    // do the first blocks of different files.
+    CacheShard& shardForBlockKey(int64_t blockKey)
+    {
+        return cacheShards[(blockKey + (blockKey >> fileNumberShift)) & (numberOfCacheShards - 1)];
+    }
+    // The shard that the cache block belongs to.
+    CacheShard& shardForCacheBlock(int64_t cacheBlock)
+    {
+        return cacheShards[std::min(cacheBlock / cacheBlocksPerShard, numberOfCacheShards - 1)];
+    }
+
+    // Number of shards for a cache of numberOfCacheBlocks blocks.
+    static int64_t numberOfCacheShardsForBlocks(int64_t numberOfCacheBlocks);
+    // Take a block of the shard that is not used by any file for the block key, or return -1 if all
+    // blocks of the shard are used. Must be called with the shardMutex of the shard held.
+    int64_t takeUnusedCacheBlock(CacheShard& shard, int64_t blockKey);
+    // Ask the eviction policy of the shard for a block that is not pinned, or return -1 if they all
+    // are. Must be called with the shardMutex of the shard held.
+    int64_t selectVictimCacheBlock(CacheShard& shard);
+    // Give the block over to another block key, after it was evicted. Must be called with the
+    // shardMutex of its shard held.
+    void reuseCacheBlock(CacheShard& shard, int64_t cacheBlock, int64_t blockKey);
+    // Give the block back, it is not used by its file anymore. Must be called with the shardMutex of
+    // its shard held.
+    void freeCacheBlock(CacheShard& shard, int64_t cacheBlock);
+    // Pin a block that holds data (a cache hit), and let the eviction policy know that it is being
+    // used. Must be called with the shardMutex of its shard held.
+    void pinCachedBlock(CacheShard& shard, int64_t cacheBlock)
+    {
+        shard.cacheEvictionPolicy->blockAccessed(cacheBlock - shard.firstCacheBlock);
+        cacheBlockEntries[cacheBlock].pinCount++;
+    }
+};
+
+#pragma GCC visibility pop
+
+#endif /* SharedBlockCache_hpp */
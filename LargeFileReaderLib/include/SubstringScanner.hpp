@@ -0,0 +1,45 @@
+//
+//  SubstringScanner.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef SubstringScanner_hpp
+#define SubstringScanner_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "LineDelimiterScanner.hpp"
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// Finds all occurrences of a string in a buffer, as fast as the machine allows.
+//
+// The search compares a whole vector of bytes with the first byte of the string, and the vector
+// patternLength - 1 bytes further on with its last byte, at once. Only where both match (which in text
+// is rare, even for common letters) the rest of the string is compared. Blocks without candidates cost
+// two loads, two compares and a test.
+//
+// The instruction set is the one that LineDelimiterScanner picked.
+class SubstringScanner
+{
+public:
+
+    // MARK: - Public methods
+
+    // Store the positions (relative to data) of all occurrences of pattern that are completely in data
+    // in positions, in order. Occurrences can overlap. Returns the number of occurrences found.
+    // positions must have room for length entries, length must fit in 32 bits, and patternLength must
+    // be at least 1.
+    static size_t findMatches(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions);
+};
+
+#pragma GCC visibility pop
+
+#endif /* SubstringScanner_hpp */
@@ -0,0 +1,78 @@
+//
+//  WorkerPool.hpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef WorkerPool_hpp
+#define WorkerPool_hpp
+
+#if __has_include(<swift/bridging>)
+#include <swift/bridging>
+#endif
+#include <stdint.h>
+#include <sys/types.h>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+
+/* The classes below are exported */
+#pragma GCC visibility push(default)
+
+// A fixed set of threads that run tasks from a queue.
+//
+// Most users want sharedPool(), which has a thread per core and is created on first use, so that
+// everything that runs in parallel shares the same threads instead of each starting its own. Tasks that
+// mostly wait for the disk, like the asynchronous reads of LargeFileReaderCore, go to sharedIOPool()
+// instead, so they don't keep the cores of sharedPool() idle while they wait.
+class WorkerPool
+{
+public:
+
+    // MARK: - Public methods
+
+    // Start numberOfWorkers threads, or a thread per core if numberOfWorkers is 0.
+    WorkerPool(size_t numberOfWorkers);
+    // Waits for the tasks that are running, drops the ones that did not start yet.
+    ~WorkerPool();
+
+    static WorkerPool& sharedPool();
+    // Twice as many threads as cores, and at least 8, as every thread is a read that can be waiting for
+    // the disk at the same time. It is never destroyed, so reads that are still queued when the process
+    // exits do not get lost (a reader that closes waits for them).
+    static WorkerPool& sharedIOPool();
+
+    size_t numberOfWorkers() const;
+
+    // Run the task on one of the workers, some time later.
+    void enqueue(std::function<void()> task);
+
+    // Run task(taskNumber) for every taskNumber in 0..<numberOfTasks, with at most maximumConcurrency
+    // (0 means no limit) running at the same time, and return when all of them are done. The calling
+    // thread runs tasks too, so this can be called from a task on the same pool without deadlocking.
+    void runTasks(size_t numberOfTasks, size_t maximumConcurrency, const std::function<void(size_t taskNumber)>& task);
+
+private:
+
+    // MARK: - Private properties
+
+    std::vector<std::thread> workers;
+
+    // Protects the queue and stop.
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::function<void()>> queue;
+    bool stop = false;
+
+    // MARK: - Private methods
+
+    void workerMain();
+};
+
+#pragma GCC visibility pop
+
+#endif /* WorkerPool_hpp */
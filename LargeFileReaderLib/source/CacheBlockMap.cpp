@@ -0,0 +1,105 @@
+//
+//  CacheBlockMap.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <cassert>
+#include <new>
+
+#include "CacheBlockMap.hpp"
+
+CacheBlockMap::CacheBlockMap(int64_t maximumNumberOfEntries, const CacheMemoryAllocator& memoryAllocator)
+{
+    // Use at least twice as many slots as entries, rounded up to a power of 2.
+    slotBits = 1;
+    while (((int64_t)1 << slotBits) < (2 * maximumNumberOfEntries))
+    {
+        slotBits++;
+    }
+    
+    slotMask = ((uint64_t)1 << slotBits) - 1;
+    memoryAllocator.allocate((slotMask + 1) * sizeof(MapSlot), alignof(MapSlot), mapSlotsAllocation);
+    mapSlots = (MapSlot*)mapSlotsAllocation.memory;
+    for (uint64_t slot = 0; slot <= slotMask; slot++)
+    {
+        new (&mapSlots[slot]) MapSlot();
+    }
+}
+
+CacheBlockMap::~CacheBlockMap()
+{
+    // MapSlot is trivially destructible.
+    CacheMemoryAllocator::free(mapSlotsAllocation);
+}
+
+uint64_t CacheBlockMap::homeSlotForIndex(int64_t index) const
+{
+    // Fibonacci hashing. Indexes of neighbouring blocks are usually in the map at the same time,
+    // multiplying by 2^64/phi and taking the top bits spreads them over the table.
+    return ((uint64_t)index * 0x9E3779B97F4A7C15ULL) >> (64 - slotBits);
+}
+
+int64_t CacheBlockMap::find(int64_t index) const
+{
+    for (uint64_t slot = homeSlotForIndex(index); ; slot = (slot + 1) & slotMask)
+    {
+        if (mapSlots[slot].index == index)
+        {
+            return mapSlots[slot].cacheBlock;
+        }
+        if (mapSlots[slot].index == -1)
+        {
+            return -1;
+        }
+    }
+}
+
+void CacheBlockMap::insert(int64_t index, int64_t cacheBlock)
+{
+    assert(index >= 0);
+    
+    uint64_t slot = homeSlotForIndex(index);
+    while (mapSlots[slot].index != -1)
+    {
+        assert(mapSlots[slot].index != index);
+        slot = (slot + 1) & slotMask;
+    }
+    
+    mapSlots[slot].index = index;
+    mapSlots[slot].cacheBlock = cacheBlock;
+}
+
+void CacheBlockMap::erase(int64_t index)
+{
+    uint64_t slot = homeSlotForIndex(index);
+    while (mapSlots[slot].index != index)
+    {
+        if (mapSlots[slot].index == -1)
+        {
+            return;
+        }
+        slot = (slot + 1) & slotMask;
+    }
+    
+    // Backward shift deletion: instead of leaving a tombstone, move entries that follow the hole
+    // back into it, if that does not move them before their home slot. This keeps lookups short
+    // no matter how many inserts and erases we do.
+    uint64_t holeSlot = slot;
+    for (uint64_t nextSlot = (holeSlot + 1) & slotMask; mapSlots[nextSlot].index != -1; nextSlot = (nextSlot + 1) & slotMask)
+    {
+        uint64_t homeSlot = homeSlotForIndex(mapSlots[nextSlot].index);
+        // Distance from the home slot to where the entry is, and to where the hole is.
+        uint64_t distanceToEntry = (nextSlot - homeSlot) & slotMask;
+        uint64_t distanceToHole = (holeSlot - homeSlot) & slotMask;
+        if (distanceToHole < distanceToEntry)
+        {
+            mapSlots[holeSlot] = mapSlots[nextSlot];
+            holeSlot = nextSlot;
+        }
+    }
+    
+    mapSlots[holeSlot].index = -1;
+    mapSlots[holeSlot].cacheBlock = -1;
+}
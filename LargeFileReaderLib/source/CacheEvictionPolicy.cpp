@@ -0,0 +1,347 @@
+//
+//  CacheEvictionPolicy.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <cassert>
+
+#include "CacheEvictionPolicy.hpp"
+
+CacheEvictionPolicy* CacheEvictionPolicy::createPolicy(PolicyType policyType, int64_t numberOfCacheBlocks)
+{
+    switch (policyType)
+    {
+        case PolicyTypeCLOCK:
+            return new ClockCacheEvictionPolicy(numberOfCacheBlocks);
+        case PolicyType2Q:
+            return new TwoQueueCacheEvictionPolicy(numberOfCacheBlocks);
+        case PolicyTypeLRU:
+        default:
+            return new LRUCacheEvictionPolicy(numberOfCacheBlocks);
+    }
+}
+
+// MARK: - CacheBlockUsedList
+
+CacheBlockUsedList::CacheBlockUsedList(int64_t numberOfCacheBlocks) :
+    previousUsedBlock(numberOfCacheBlocks, -1),
+    nextUsedBlock(numberOfCacheBlocks, -1),
+    isLinked(numberOfCacheBlocks, false)
+{
+}
+
+void CacheBlockUsedList::pushMostRecentlyUsed(int64_t cacheBlock)
+{
+    assert(!isLinked[cacheBlock]);
+
+    // Point previous used of the new block to the previous MRU, and the previous MRU to us.
+    previousUsedBlock[cacheBlock] = mostRecentlyUsed;
+    nextUsedBlock[cacheBlock] = -1;
+
+    if (mostRecentlyUsed != -1)
+    {
+        nextUsedBlock[mostRecentlyUsed] = cacheBlock;
+    }
+
+    // The first block in the list will become both LRU and MRU.
+    if (leastRecentlyUsed == -1)
+    {
+        leastRecentlyUsed = cacheBlock;
+    }
+
+    mostRecentlyUsed = cacheBlock;
+    isLinked[cacheBlock] = true;
+    count++;
+}
+
+void CacheBlockUsedList::unlink(int64_t cacheBlock)
+{
+    assert(isLinked[cacheBlock]);
+
+    int64_t previousUsed = previousUsedBlock[cacheBlock];
+    int64_t nextUsed = nextUsedBlock[cacheBlock];
+
+    if (previousUsed != -1)
+    {
+        nextUsedBlock[previousUsed] = nextUsed;
+    }
+    else
+    {
+        // We were the LRU, our next used becomes the new LRU.
+        leastRecentlyUsed = nextUsed;
+    }
+
+    if (nextUsed != -1)
+    {
+        previousUsedBlock[nextUsed] = previousUsed;
+    }
+    else
+    {
+        // We were the MRU, our previous used becomes the new MRU.
+        mostRecentlyUsed = previousUsed;
+    }
+
+    previousUsedBlock[cacheBlock] = -1;
+    nextUsedBlock[cacheBlock] = -1;
+    isLinked[cacheBlock] = false;
+    count--;
+}
+
+void CacheBlockUsedList::moveToMostRecentlyUsed(int64_t cacheBlock)
+{
+    if (cacheBlock == mostRecentlyUsed)
+    {
+        return;
+    }
+
+    unlink(cacheBlock);
+    pushMostRecentlyUsed(cacheBlock);
+}
+
+int64_t CacheBlockUsedList::findLeastRecentlyUsed(const std::function<bool(int64_t cacheBlock)>& isEvictable) const
+{
+    // Normally the LRU itself is evictable, so this is O(1). Only if blocks are pinned, we need to
+    // walk towards the MRU.
+    int64_t cacheBlock = leastRecentlyUsed;
+    while ((cacheBlock != -1) && !isEvictable(cacheBlock))
+    {
+        cacheBlock = nextUsedBlock[cacheBlock];
+    }
+    return cacheBlock;
+}
+
+// MARK: - LRUCacheEvictionPolicy
+
+LRUCacheEvictionPolicy::LRUCacheEvictionPolicy(int64_t numberOfCacheBlocks) :
+    usedList(numberOfCacheBlocks)
+{
+}
+
+void LRUCacheEvictionPolicy::blockInserted(int64_t cacheBlock, int64_t /* index */)
+{
+    usedList.pushMostRecentlyUsed(cacheBlock);
+}
+
+void LRUCacheEvictionPolicy::blockAccessed(int64_t cacheBlock)
+{
+    usedList.moveToMostRecentlyUsed(cacheBlock);
+}
+
+void LRUCacheEvictionPolicy::blockRemoved(int64_t cacheBlock, int64_t /* index */)
+{
+    usedList.unlink(cacheBlock);
+}
+
+void LRUCacheEvictionPolicy::blockDiscarded(int64_t cacheBlock)
+{
+    usedList.unlink(cacheBlock);
+}
+
+int64_t LRUCacheEvictionPolicy::selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable)
+{
+    return usedList.findLeastRecentlyUsed(isEvictable);
+}
+
+// MARK: - ClockCacheEvictionPolicy
+
+ClockCacheEvictionPolicy::ClockCacheEvictionPolicy(int64_t numberOfCacheBlocks) :
+    numberOfCacheBlocks(numberOfCacheBlocks),
+    isPresent(numberOfCacheBlocks, false),
+    isReferenced(numberOfCacheBlocks, false)
+{
+}
+
+void ClockCacheEvictionPolicy::blockInserted(int64_t cacheBlock, int64_t /* index */)
+{
+    isPresent[cacheBlock] = true;
+    isReferenced[cacheBlock] = true;
+}
+
+void ClockCacheEvictionPolicy::blockAccessed(int64_t cacheBlock)
+{
+    isReferenced[cacheBlock] = true;
+}
+
+void ClockCacheEvictionPolicy::blockRemoved(int64_t cacheBlock, int64_t /* index */)
+{
+    isPresent[cacheBlock] = false;
+    isReferenced[cacheBlock] = false;
+}
+
+void ClockCacheEvictionPolicy::blockDiscarded(int64_t cacheBlock)
+{
+    isPresent[cacheBlock] = false;
+    isReferenced[cacheBlock] = false;
+}
+
+int64_t ClockCacheEvictionPolicy::selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable)
+{
+    if (numberOfCacheBlocks == 0)
+    {
+        return -1;
+    }
+
+    // Sweep the hand over the blocks, giving referenced blocks a second chance by clearing their
+    // referenced bit. After two full sweeps every evictable block has had its bit cleared, so if
+    // we found nothing by then, everything is pinned.
+    for (int64_t numberOfSteps = 0; numberOfSteps < 2 * numberOfCacheBlocks; numberOfSteps++)
+    {
+        int64_t cacheBlock = hand;
+        hand = (hand + 1) % numberOfCacheBlocks;
+
+        if (!isPresent[cacheBlock] || !isEvictable(cacheBlock))
+        {
+            continue;
+        }
+        if (isReferenced[cacheBlock])
+        {
+            isReferenced[cacheBlock] = false;
+            continue;
+        }
+        return cacheBlock;
+    }
+
+    return -1;
+}
+
+// MARK: - TwoQueueCacheEvictionPolicy
+
+// Strategy (simplified 2Q, Johnson & Shasha):
+//
+// A block that is fetched for the first time goes into the FIFO. Hits in the FIFO do nothing, so a
+// block that is only used during a single scan leaves the cache in FIFO order. When a block leaves
+// the FIFO, its index is remembered in the ghost queue. If that index is fetched again while it is
+// still remembered, the block is hot and goes into the hot list, which is a normal LRU. Only evicted
+// blocks become ghosts, blocks that are discarded (a failed fetch, a closed file) are simply forgotten.
+// When a file is closed, the ghosts of its blocks are forgotten too, the next file reuses its keys.
+//
+// Victims are taken from the FIFO as long as it is larger than its share of the cache (25%), else
+// from the hot list.
+
+TwoQueueCacheEvictionPolicy::TwoQueueCacheEvictionPolicy(int64_t numberOfCacheBlocks) :
+    fifoList(numberOfCacheBlocks),
+    hotList(numberOfCacheBlocks)
+{
+    maximumFifoCount = numberOfCacheBlocks / 4;
+    if (maximumFifoCount < 1)
+    {
+        maximumFifoCount = 1;
+    }
+    maximumGhostCount = numberOfCacheBlocks / 2;
+    if (maximumGhostCount < 1)
+    {
+        maximumGhostCount = 1;
+    }
+}
+
+void TwoQueueCacheEvictionPolicy::blockInserted(int64_t cacheBlock, int64_t index)
+{
+    auto ghost = ghostGenerations.find(index);
+    if (ghost != ghostGenerations.end())
+    {
+        // We have seen this block recently, it is hot. Its entry in the ghost queue becomes stale.
+        ghostGenerations.erase(ghost);
+        hotList.pushMostRecentlyUsed(cacheBlock);
+    }
+    else
+    {
+        fifoList.pushMostRecentlyUsed(cacheBlock);
+    }
+}
+
+void TwoQueueCacheEvictionPolicy::blockAccessed(int64_t cacheBlock)
+{
+    if (hotList.contains(cacheBlock))
+    {
+        hotList.moveToMostRecentlyUsed(cacheBlock);
+    }
+}
+
+void TwoQueueCacheEvictionPolicy::blockRemoved(int64_t cacheBlock, int64_t index)
+{
+    if (hotList.contains(cacheBlock))
+    {
+        hotList.unlink(cacheBlock);
+    }
+    else
+    {
+        fifoList.unlink(cacheBlock);
+        rememberGhost(index);
+    }
+}
+
+void TwoQueueCacheEvictionPolicy::blockDiscarded(int64_t cacheBlock)
+{
+    // No ghost: a block that was never read, or whose file is gone, was not used. Remembering it would
+    // send the retry of a failed fetch (or a block of the next file that gets the same key) straight
+    // into the hot list.
+    if (hotList.contains(cacheBlock))
+    {
+        hotList.unlink(cacheBlock);
+    }
+    else
+    {
+        fifoList.unlink(cacheBlock);
+    }
+}
+
+void TwoQueueCacheEvictionPolicy::forgetRemovedBlocks(const std::function<bool(int64_t index)>& shouldForget)
+{
+    // Their entries in the ghost queue become stale.
+    for (auto ghost = ghostGenerations.begin(); ghost != ghostGenerations.end();)
+    {
+        if (shouldForget(ghost->first))
+        {
+            ghost = ghostGenerations.erase(ghost);
+        }
+        else
+        {
+            ++ghost;
+        }
+    }
+}
+
+int64_t TwoQueueCacheEvictionPolicy::selectVictim(const std::function<bool(int64_t cacheBlock)>& isEvictable)
+{
+    int64_t cacheBlock = -1;
+
+    if (fifoList.count > maximumFifoCount)
+    {
+        cacheBlock = fifoList.findLeastRecentlyUsed(isEvictable);
+    }
+    if (cacheBlock == -1)
+    {
+        cacheBlock = hotList.findLeastRecentlyUsed(isEvictable);
+    }
+    if (cacheBlock == -1)
+    {
+        // The hot list is empty or completely pinned, the FIFO is all we have.
+        cacheBlock = fifoList.findLeastRecentlyUsed(isEvictable);
+    }
+
+    return cacheBlock;
+}
+
+void TwoQueueCacheEvictionPolicy::rememberGhost(int64_t index)
+{
+    ghostGeneration++;
+    ghostGenerations[index] = ghostGeneration;
+    ghostQueue.push_back(std::make_pair(index, ghostGeneration));
+
+    // Forget the oldest ghosts. Stale entries in the queue are dropped along the way, and we also
+    // bound the queue itself so that stale entries can not pile up.
+    while (((int64_t)ghostGenerations.size() > maximumGhostCount) ||
+           ((int64_t)ghostQueue.size() > 2 * maximumGhostCount))
+    {
+        auto oldestGhost = ghostQueue.front();
+        ghostQueue.pop_front();
+
+        auto ghost = ghostGenerations.find(oldestGhost.first);
+        if ((ghost != ghostGenerations.end()) && (ghost->second == oldestGhost.second))
+        {
+            ghostGenerations.erase(ghost);
+        }
+    }
+}
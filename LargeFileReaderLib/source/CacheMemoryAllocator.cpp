@@ -0,0 +1,232 @@
+//
+//  CacheMemoryAllocator.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <new>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+#ifdef __APPLE__
+#include <mach/vm_statistics.h>
+#endif
+
+#include "CacheMemoryAllocator.hpp"
+
+// Strategy (huge pages):
+//
+// Plain memory is allocated as before, with posix_memalign. Everything else is mapped with mmap, because
+// that is the only way to ask for huge pages, and because a NUMA policy must be set on whole pages of
+// memory that has not been touched yet (mbind only moves pages that are already there with extra
+// flags, and we don't want to pay for that).
+//
+// Explicit huge pages come from a pool that the administrator reserves (vm.nr_hugepages, or the
+// hugepages= kernel argument for 1GB ones). If the pool is too small, mmap fails right away (the pages
+// are reserved when mapping, not when touching), and we try the next smaller page type. Transparent huge
+// pages never fail: the mapping is aligned to 2MB and marked with MADV_HUGEPAGE, and the kernel uses
+// huge pages for it when it can, and normal pages when it can't. So Allocation.pageType says what was
+// asked for and granted, not how many huge pages the kernel actually used; AnonHugePages in
+// /proc/self/smaps tells that.
+//
+// The memory of all page types is zeroed by the kernel when it is first touched. The cache does not
+// touch it up front: a 1GB huge page is zeroed on the first access to any of its bytes, which takes
+// a while, but only once.
+
+static const size_t hugePageSize2MB = (size_t)2 << 20;
+static const size_t hugePageSize1GB = (size_t)1 << 30;
+
+static size_t roundUp(size_t size, size_t multiple)
+{
+    return ((size + multiple - 1) / multiple) * multiple;
+}
+
+void CacheMemoryAllocator::allocate(size_t size, size_t alignment, Allocation& allocation) const
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    alignment = std::max(alignment, pageSize);
+
+    allocation = Allocation();
+    allocation.size = size;
+
+    // Try the page type we are asked for, and then the smaller ones. A mapping is aligned to its
+    // page size, if that is not enough for the caller it falls through to posix_memalign.
+    if ((size > 0) && ((pageType != PageTypeDefault) || (numaPolicyType != NumaPolicyTypeDefault)))
+    {
+        static const PageType fallbackPageTypes[] = {PageTypeHuge1GB, PageTypeHuge2MB, PageTypeTransparentHuge, PageTypeDefault};
+        for (PageType fallbackPageType : fallbackPageTypes)
+        {
+            if (fallbackPageType > pageType)
+            {
+                continue;
+            }
+            size_t mappingAlignment = (fallbackPageType == PageTypeHuge1GB) ? hugePageSize1GB : ((fallbackPageType == PageTypeDefault) ? pageSize : hugePageSize2MB);
+            if ((alignment <= mappingAlignment) && mapMemory(size, fallbackPageType, allocation))
+            {
+                allocation.isNumaPolicyApplied = applyNumaPolicy(allocation);
+                return;
+            }
+        }
+    }
+
+    void* memory = NULL;
+    if (posix_memalign(&memory, alignment, size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    allocation.memory = (unsigned char*)memory;
+    allocation.mappedSize = size;
+}
+
+void CacheMemoryAllocator::free(Allocation& allocation)
+{
+    if (allocation.isMapped)
+    {
+        munmap(allocation.memory, allocation.mappedSize);
+    }
+    else
+    {
+        ::free(allocation.memory);
+    }
+    allocation = Allocation();
+}
+
+bool CacheMemoryAllocator::mapMemory(size_t size, PageType pageType, Allocation& allocation)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    void* memory = MAP_FAILED;
+    size_t mappedSize = 0;
+
+    switch (pageType)
+    {
+        case PageTypeDefault:
+        {
+            mappedSize = roundUp(size, pageSize);
+            memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            break;
+        }
+        case PageTypeTransparentHuge:
+        {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            // The kernel only uses a huge page for a 2MB aligned piece of a mapping. Map 2MB extra, and
+            // cut off what is before the first and after the last aligned piece.
+            mappedSize = roundUp(size, hugePageSize2MB);
+            void* oversizedMemory = mmap(NULL, mappedSize + hugePageSize2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            if (oversizedMemory == MAP_FAILED)
+            {
+                return false;
+            }
+            uintptr_t alignedAddress = roundUp((uintptr_t)oversizedMemory, hugePageSize2MB);
+            size_t headSize = alignedAddress - (uintptr_t)oversizedMemory;
+            if (headSize > 0)
+            {
+                munmap(oversizedMemory, headSize);
+            }
+            munmap((unsigned char*)alignedAddress + mappedSize, hugePageSize2MB - headSize);
+            memory = (void*)alignedAddress;
+            // Advice only, if THP is switched off, we simply get normal pages.
+            madvise(memory, mappedSize, MADV_HUGEPAGE);
+#endif
+            break;
+        }
+        case PageTypeHuge2MB:
+        {
+            mappedSize = roundUp(size, hugePageSize2MB);
+#if defined(__linux__) && defined(MAP_HUGETLB)
+            memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+#elif defined(__APPLE__) && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+            // On macOS the superpage size goes where the file descriptor would be.
+            memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+#endif
+            break;
+        }
+        case PageTypeHuge1GB:
+        {
+            mappedSize = roundUp(size, hugePageSize1GB);
+#if defined(__linux__) && defined(MAP_HUGETLB)
+            memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+#endif
+            break;
+        }
+    }
+
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+    allocation.memory = (unsigned char*)memory;
+    allocation.mappedSize = mappedSize;
+    allocation.isMapped = true;
+    allocation.pageType = pageType;
+    return true;
+}
+
+bool CacheMemoryAllocator::applyNumaPolicy(Allocation& allocation) const
+{
+    if (numaPolicyType == NumaPolicyTypeDefault)
+    {
+        return false;
+    }
+
+#if defined(__linux__) && defined(SYS_mbind)
+    uint64_t nodeMask = (numaNodeMask != 0) ? numaNodeMask : onlineNumaNodeMask();
+    int mode = MPOL_INTERLEAVE;
+    if (numaPolicyType == NumaPolicyTypeBind)
+    {
+        // Only the lowest node, binding to more than one node fills them one after the other.
+        nodeMask &= ~(nodeMask - 1);
+        mode = MPOL_BIND;
+    }
+
+    // The kernel reads maxnode - 1 bits of the mask. We call the system call ourselves, so we don't
+    // need libnuma.
+    unsigned long kernelNodeMask[1] = {(unsigned long)nodeMask};
+    return syscall(SYS_mbind, allocation.memory, allocation.mappedSize, mode, kernelNodeMask, (unsigned long)(sizeof(kernelNodeMask) * 8 + 1), 0) == 0;
+#else
+    // No NUMA policies on this platform, macOS has no API for it.
+    return false;
+#endif
+}
+
+uint64_t CacheMemoryAllocator::onlineNumaNodeMask()
+{
+    uint64_t nodeMask = 0;
+
+    // The file holds a list of ranges, like "0-3,6".
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (file != NULL)
+    {
+        int firstNode;
+        while (fscanf(file, "%d", &firstNode) == 1)
+        {
+            int lastNode = firstNode;
+            int separator = fgetc(file);
+            if (separator == '-')
+            {
+                if (fscanf(file, "%d", &lastNode) != 1)
+                {
+                    break;
+                }
+                separator = fgetc(file);
+            }
+            for (int node = std::max(firstNode, 0); (node <= lastNode) && (node < 64); node++)
+            {
+                nodeMask |= (uint64_t)1 << node;
+            }
+            if (separator != ',')
+            {
+                break;
+            }
+        }
+        fclose(file);
+    }
+
+    return (nodeMask != 0) ? nodeMask : 1;
+}
@@ -0,0 +1,111 @@
+//
+//  CacheStatistics.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <algorithm>
+
+#include "CacheStatistics.hpp"
+
+CacheStatistics::CacheStatistics()
+{
+    reset();
+}
+
+void CacheStatistics::countFetch(uint64_t numberOfBlocks, uint64_t numberOfErrors, uint64_t numberOfBytes, uint64_t latencyNanoseconds)
+{
+    numberOfFetches.fetch_add(1, std::memory_order_relaxed);
+    numberOfFetchedBlocks.fetch_add(numberOfBlocks, std::memory_order_relaxed);
+    if (numberOfErrors != 0)
+    {
+        numberOfFetchErrors.fetch_add(numberOfErrors, std::memory_order_relaxed);
+    }
+    bytesReadFromFile.fetch_add(numberOfBytes, std::memory_order_relaxed);
+    totalFetchLatencyNanoseconds.fetch_add(latencyNanoseconds, std::memory_order_relaxed);
+
+    // Bucket n holds latencies below 2^n microseconds, so it is the number of bits of the latency.
+    uint64_t latencyMicroseconds = latencyNanoseconds / 1000;
+    int bucket = (latencyMicroseconds == 0) ? 0 : (64 - __builtin_clzll(latencyMicroseconds));
+    bucket = std::min(bucket, numberOfLatencyBuckets - 1);
+    fetchLatencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CacheStatistics::snapshot(Snapshot& snapshot) const
+{
+    snapshot.numberOfHits = numberOfHits.load(std::memory_order_relaxed);
+    snapshot.numberOfMisses = numberOfMisses.load(std::memory_order_relaxed);
+    snapshot.numberOfEvictions = numberOfEvictions.load(std::memory_order_relaxed);
+    snapshot.numberOfReadAheadBlocks = numberOfReadAheadBlocks.load(std::memory_order_relaxed);
+    snapshot.numberOfFetches = numberOfFetches.load(std::memory_order_relaxed);
+    snapshot.numberOfFetchedBlocks = numberOfFetchedBlocks.load(std::memory_order_relaxed);
+    snapshot.numberOfFetchErrors = numberOfFetchErrors.load(std::memory_order_relaxed);
+    snapshot.bytesReadFromFile = bytesReadFromFile.load(std::memory_order_relaxed);
+    snapshot.bytesServedFromCache = bytesServedFromCache.load(std::memory_order_relaxed);
+    snapshot.bytesBypassingCache = bytesBypassingCache.load(std::memory_order_relaxed);
+    for (int bucket = 0; bucket < numberOfLatencyBuckets; bucket++)
+    {
+        snapshot.fetchLatencyHistogram[bucket] = fetchLatencyHistogram[bucket].load(std::memory_order_relaxed);
+    }
+    snapshot.totalFetchLatencyNanoseconds = totalFetchLatencyNanoseconds.load(std::memory_order_relaxed);
+}
+
+void CacheStatistics::reset()
+{
+    numberOfHits = 0;
+    numberOfMisses = 0;
+    numberOfEvictions = 0;
+    numberOfReadAheadBlocks = 0;
+    numberOfFetches = 0;
+    numberOfFetchedBlocks = 0;
+    numberOfFetchErrors = 0;
+    bytesReadFromFile = 0;
+    bytesServedFromCache = 0;
+    bytesBypassingCache = 0;
+    for (int bucket = 0; bucket < numberOfLatencyBuckets; bucket++)
+    {
+        fetchLatencyHistogram[bucket] = 0;
+    }
+    totalFetchLatencyNanoseconds = 0;
+}
+
+// MARK: - Snapshot
+
+double CacheStatistics::Snapshot::hitRate() const
+{
+    uint64_t numberOfRequests = numberOfHits + numberOfMisses;
+    return (numberOfRequests == 0) ? 0.0 : (double)numberOfHits / (double)numberOfRequests;
+}
+
+double CacheStatistics::Snapshot::meanFetchLatency() const
+{
+    return (numberOfFetches == 0) ? 0.0 : ((double)totalFetchLatencyNanoseconds / 1000.0) / (double)numberOfFetches;
+}
+
+uint64_t CacheStatistics::Snapshot::fetchLatencyPercentile(double percentile) const
+{
+    uint64_t numberOfLatencies = 0;
+    for (int bucket = 0; bucket < numberOfLatencyBuckets; bucket++)
+    {
+        numberOfLatencies += fetchLatencyHistogram[bucket];
+    }
+    if (numberOfLatencies == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the latency that we want, counting from 1.
+    percentile = std::max(0.0, std::min(100.0, percentile));
+    uint64_t rank = std::max((uint64_t)1, (uint64_t)((percentile / 100.0) * (double)numberOfLatencies + 0.5));
+    uint64_t numberOfLatenciesSeen = 0;
+    for (int bucket = 0; bucket < numberOfLatencyBuckets; bucket++)
+    {
+        numberOfLatenciesSeen += fetchLatencyHistogram[bucket];
+        if (numberOfLatenciesSeen >= rank)
+        {
+            return (uint64_t)1 << bucket;
+        }
+    }
+    return (uint64_t)1 << (numberOfLatencyBuckets - 1);
+}
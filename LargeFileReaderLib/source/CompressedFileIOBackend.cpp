@@ -0,0 +1,892 @@
+//
+//  CompressedFileIOBackend.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <zlib.h>
+
+#include "CompressedFileIOBackend.hpp"
+
+#if LARGEFILEREADER_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+// MARK: - GzipFileIOBackend
+
+// Strategy (gzip checkpoints):
+//
+// Deflate data is a series of blocks, and decoding can start at the start of any block, if the
+// decoder is given the last 32K of decompressed data before it (a block can copy from there), and the
+// bits of the block that are in the byte before it (blocks are not byte aligned). That's what a
+// checkpoint stores. attach() decodes the file once with inflate(Z_BLOCK), which stops at every block
+// boundary, and takes a checkpoint at the first boundary after every gzipCheckpointSpacing bytes. The
+// windows are compressed, which makes them about 4 times smaller for text.
+//
+// The checkpoints are in the middle of a gzip member, so a cursor decodes raw deflate data from them.
+// When the member ends, the cursor skips its trailer, and continues with the gzip header of the next
+// member, if there is one. Anything after the last member that is not a gzip header (zero padding from
+// tape archives, for example) is ignored, like gzip itself does.
+
+class GzipFileIOBackend : public CompressedFileIOBackend
+{
+public:
+
+    ~GzipFileIOBackend()
+    {
+        detach();
+    }
+
+protected:
+
+    bool buildRestartPoints() override;
+    void clearRestartPoints() override;
+    size_t memorySizeOfRestartPoints() const override;
+    off_t restartPointForOffset(off_t uncompressedOffset) const override;
+
+    DecoderCursor* createCursor() override;
+    bool seekCursor(DecoderCursor* cursor, off_t uncompressedOffset) override;
+    ssize_t decodeCursor(DecoderCursor* cursor, unsigned char* buffer, size_t length) override;
+
+private:
+
+    static const size_t windowSize = 32768;
+    static const size_t inputBufferSize = 65536;
+    // Size of the gzip trailer (CRC32 and size) after the deflate data of a member.
+    static const int trailerSize = 8;
+
+    struct Checkpoint
+    {
+        off_t uncompressedOffset;
+        // Offset of the first byte of the block that is whole, and the number of bits of the block
+        // in the byte before it.
+        off_t compressedOffset;
+        int bits;
+        // The compressed window, in compressedWindows.
+        size_t windowOffset;
+        size_t windowLength;
+    };
+
+    struct GzipCursor : public DecoderCursor
+    {
+        z_stream stream;
+        bool isStreamInitialized = false;
+        // Offset of the next compressed byte to read into input.
+        off_t compressedOffset = 0;
+        // True while decoding the raw deflate data that a checkpoint starts in, false once we continue
+        // with the gzip header of a next member.
+        bool isRawDeflate = true;
+        // Bytes of a trailer that still have to be skipped before the next member starts.
+        int numberOfBytesToSkip = 0;
+        // True after a member ended, until the next member produces data. If the 'member' turns out
+        // not to be one, the data ends there.
+        bool isBetweenMembers = false;
+        bool isAtEnd = false;
+        std::vector<unsigned char> input;
+
+        GzipCursor() : input(inputBufferSize)
+        {
+            memset(&stream, 0, sizeof(stream));
+        }
+        ~GzipCursor()
+        {
+            if (isStreamInitialized)
+            {
+                inflateEnd(&stream);
+            }
+        }
+    };
+
+    std::vector<Checkpoint> checkpoints;
+    std::vector<unsigned char> compressedWindows;
+
+    // Index of the last checkpoint at or before uncompressedOffset, or -1.
+    int64_t checkpointForOffset(off_t uncompressedOffset) const;
+    // Store the last windowLength bytes before writePosition in the circular buffer window.
+    bool addCheckpoint(off_t uncompressedOffset, off_t compressedOffset, int bits, const unsigned char* window, size_t writePosition, size_t windowLength);
+};
+
+bool GzipFileIOBackend::buildRestartPoints()
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 15 + 16: a gzip header, and the largest window.
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> input(inputBufferSize);
+    std::vector<unsigned char> window(windowSize);
+    off_t compressedOffset = 0;
+    off_t totalOut = 0;
+    bool isBetweenMembers = false;
+    bool isSuccess = false;
+
+    stream.avail_in = 0;
+    stream.avail_out = 0;
+    while (true)
+    {
+        if (stream.avail_in == 0)
+        {
+            ssize_t bytesRead = readCompressedData(compressedOffset, input.data(), input.size());
+            if (bytesRead < 0)
+            {
+                break;
+            }
+            if (bytesRead == 0)
+            {
+                // A file that ends in the middle of a member is damaged.
+                isSuccess = isBetweenMembers;
+                break;
+            }
+            compressedOffset += bytesRead;
+            stream.next_in = input.data();
+            stream.avail_in = (uInt)bytesRead;
+        }
+        if (stream.avail_out == 0)
+        {
+            // The window is a circular buffer that always holds the last 32K of output.
+            stream.next_out = window.data();
+            stream.avail_out = (uInt)windowSize;
+        }
+
+        uInt availableOut = stream.avail_out;
+        int result = inflate(&stream, Z_BLOCK);
+        totalOut += availableOut - stream.avail_out;
+
+        if (result == Z_STREAM_END)
+        {
+            isBetweenMembers = true;
+            inflateReset(&stream);
+            continue;
+        }
+        if ((result != Z_OK) && (result != Z_BUF_ERROR))
+        {
+            // Not a gzip header after the last member: that's where the data ends.
+            isSuccess = isBetweenMembers;
+            break;
+        }
+        if (availableOut != stream.avail_out)
+        {
+            isBetweenMembers = false;
+        }
+
+        // At a block boundary, but not after the last block (the trailer follows that).
+        if (((stream.data_type & 128) != 0) && ((stream.data_type & 64) == 0))
+        {
+            isBetweenMembers = false;
+            if (checkpoints.empty() || ((totalOut - checkpoints.back().uncompressedOffset) >= gzipCheckpointSpacing))
+            {
+                size_t writePosition = windowSize - stream.avail_out;
+                size_t windowLength = (size_t)std::min((off_t)windowSize, totalOut);
+                if (!addCheckpoint(totalOut, compressedOffset - stream.avail_in, stream.data_type & 7, window.data(), writePosition, windowLength))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    inflateEnd(&stream);
+
+    if (!isSuccess || checkpoints.empty())
+    {
+        clearRestartPoints();
+        return false;
+    }
+
+    uncompressedFileSize = totalOut;
+    compressedWindows.shrink_to_fit();
+    checkpoints.shrink_to_fit();
+    return true;
+}
+
+bool GzipFileIOBackend::addCheckpoint(off_t uncompressedOffset, off_t compressedOffset, int bits, const unsigned char* window, size_t writePosition, size_t windowLength)
+{
+    // Put the window in order.
+    unsigned char orderedWindow[windowSize];
+    if (writePosition >= windowLength)
+    {
+        memcpy(orderedWindow, &window[writePosition - windowLength], windowLength);
+    }
+    else
+    {
+        size_t wrappedLength = windowLength - writePosition;
+        memcpy(orderedWindow, &window[windowSize - wrappedLength], wrappedLength);
+        memcpy(&orderedWindow[wrappedLength], window, writePosition);
+    }
+
+    size_t windowOffset = compressedWindows.size();
+    uLongf compressedLength = compressBound((uLong)windowLength);
+    compressedWindows.resize(windowOffset + compressedLength);
+    if (compress2(&compressedWindows[windowOffset], &compressedLength, orderedWindow, (uLong)windowLength, Z_BEST_SPEED) != Z_OK)
+    {
+        return false;
+    }
+    compressedWindows.resize(windowOffset + compressedLength);
+
+    Checkpoint checkpoint;
+    checkpoint.uncompressedOffset = uncompressedOffset;
+    checkpoint.compressedOffset = compressedOffset;
+    checkpoint.bits = bits;
+    checkpoint.windowOffset = windowOffset;
+    checkpoint.windowLength = compressedLength;
+    checkpoints.push_back(checkpoint);
+    return true;
+}
+
+void GzipFileIOBackend::clearRestartPoints()
+{
+    checkpoints.clear();
+    checkpoints.shrink_to_fit();
+    compressedWindows.clear();
+    compressedWindows.shrink_to_fit();
+}
+
+size_t GzipFileIOBackend::memorySizeOfRestartPoints() const
+{
+    return (checkpoints.capacity() * sizeof(Checkpoint)) + compressedWindows.capacity();
+}
+
+int64_t GzipFileIOBackend::checkpointForOffset(off_t uncompressedOffset) const
+{
+    auto next = std::upper_bound(checkpoints.begin(), checkpoints.end(), uncompressedOffset, [](off_t offset, const Checkpoint& checkpoint)
+    {
+        return offset < checkpoint.uncompressedOffset;
+    });
+    return (int64_t)(next - checkpoints.begin()) - 1;
+}
+
+off_t GzipFileIOBackend::restartPointForOffset(off_t uncompressedOffset) const
+{
+    int64_t checkpoint = checkpointForOffset(uncompressedOffset);
+    return (checkpoint < 0) ? 0 : checkpoints[checkpoint].uncompressedOffset;
+}
+
+CompressedFileIOBackend::DecoderCursor* GzipFileIOBackend::createCursor()
+{
+    return new GzipCursor;
+}
+
+bool GzipFileIOBackend::seekCursor(DecoderCursor* decoderCursor, off_t uncompressedOffset)
+{
+    GzipCursor* cursor = static_cast<GzipCursor*>(decoderCursor);
+
+    int64_t checkpointIndex = checkpointForOffset(uncompressedOffset);
+    if (checkpointIndex < 0)
+    {
+        return false;
+    }
+    const Checkpoint& checkpoint = checkpoints[checkpointIndex];
+
+    // Raw deflate data, without a header.
+    if (!cursor->isStreamInitialized)
+    {
+        if (inflateInit2(&cursor->stream, -15) != Z_OK)
+        {
+            return false;
+        }
+        cursor->isStreamInitialized = true;
+    }
+    else if (inflateReset2(&cursor->stream, -15) != Z_OK)
+    {
+        return false;
+    }
+
+    if (checkpoint.bits != 0)
+    {
+        unsigned char partialByte;
+        if (readCompressedData(checkpoint.compressedOffset - 1, &partialByte, 1) != 1)
+        {
+            return false;
+        }
+        inflatePrime(&cursor->stream, checkpoint.bits, partialByte >> (8 - checkpoint.bits));
+    }
+
+    unsigned char window[windowSize];
+    uLongf windowLength = windowSize;
+    if (uncompress(window, &windowLength, &compressedWindows[checkpoint.windowOffset], (uLong)checkpoint.windowLength) != Z_OK)
+    {
+        return false;
+    }
+    if ((windowLength != 0) && (inflateSetDictionary(&cursor->stream, window, (uInt)windowLength) != Z_OK))
+    {
+        return false;
+    }
+
+    cursor->stream.avail_in = 0;
+    cursor->compressedOffset = checkpoint.compressedOffset;
+    cursor->isRawDeflate = true;
+    cursor->numberOfBytesToSkip = 0;
+    cursor->isBetweenMembers = false;
+    cursor->isAtEnd = false;
+    cursor->uncompressedOffset = checkpoint.uncompressedOffset;
+    return true;
+}
+
+ssize_t GzipFileIOBackend::decodeCursor(DecoderCursor* decoderCursor, unsigned char* buffer, size_t length)
+{
+    GzipCursor* cursor = static_cast<GzipCursor*>(decoderCursor);
+    z_stream& stream = cursor->stream;
+
+    stream.next_out = buffer;
+    stream.avail_out = (uInt)std::min(length, (size_t)UINT_MAX);
+    while (!cursor->isAtEnd && (stream.avail_out > 0))
+    {
+        if (stream.avail_in == 0)
+        {
+            ssize_t bytesRead = readCompressedData(cursor->compressedOffset, cursor->input.data(), cursor->input.size());
+            if (bytesRead < 0)
+            {
+                return -1;
+            }
+            if (bytesRead == 0)
+            {
+                if (!cursor->isBetweenMembers)
+                {
+                    return -1;
+                }
+                cursor->isAtEnd = true;
+                break;
+            }
+            cursor->compressedOffset += bytesRead;
+            stream.next_in = cursor->input.data();
+            stream.avail_in = (uInt)bytesRead;
+        }
+
+        if (cursor->numberOfBytesToSkip > 0)
+        {
+            uInt skipLength = std::min(stream.avail_in, (uInt)cursor->numberOfBytesToSkip);
+            stream.next_in += skipLength;
+            stream.avail_in -= skipLength;
+            cursor->numberOfBytesToSkip -= skipLength;
+            if ((cursor->numberOfBytesToSkip == 0) && (inflateReset2(&stream, 15 + 16) != Z_OK))
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        uInt availableOut = stream.avail_out;
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (availableOut != stream.avail_out)
+        {
+            cursor->isBetweenMembers = false;
+        }
+
+        if (result == Z_STREAM_END)
+        {
+            cursor->isBetweenMembers = true;
+            if (cursor->isRawDeflate)
+            {
+                // inflate only reads the trailer itself when it read the header too.
+                cursor->isRawDeflate = false;
+                cursor->numberOfBytesToSkip = trailerSize;
+            }
+            else if (inflateReset(&stream) != Z_OK)
+            {
+                return -1;
+            }
+            continue;
+        }
+        if ((result != Z_OK) && (result != Z_BUF_ERROR))
+        {
+            if (!cursor->isBetweenMembers)
+            {
+                return -1;
+            }
+            cursor->isAtEnd = true;
+        }
+    }
+
+    return (ssize_t)(stream.next_out - buffer);
+}
+
+#if LARGEFILEREADER_HAS_ZSTD
+
+// MARK: - ZstdSeekableFileIOBackend
+
+static uint32_t readLittleEndian32(const unsigned char* bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Strategy (zstd seekable):
+//
+// A seekable zstd file is a series of independent zstd frames, followed by a skippable frame with the
+// seek table: the compressed and decompressed size of every frame. Every frame is a restart point, we
+// add up the sizes to know where they are. A cursor is a zstd stream decoder, which decodes frame after
+// frame until the seek table.
+
+class ZstdSeekableFileIOBackend : public CompressedFileIOBackend
+{
+public:
+
+    // Magic number at the very end of the file.
+    static const uint32_t seekableMagicNumber = 0x8F92EAB1;
+    // Size of the footer of the seek table: number of frames, descriptor, magic number.
+    static const size_t seekTableFooterSize = 9;
+
+    ~ZstdSeekableFileIOBackend()
+    {
+        detach();
+    }
+
+protected:
+
+    bool buildRestartPoints() override;
+    void clearRestartPoints() override;
+    size_t memorySizeOfRestartPoints() const override;
+    off_t restartPointForOffset(off_t uncompressedOffset) const override;
+
+    DecoderCursor* createCursor() override;
+    bool seekCursor(DecoderCursor* cursor, off_t uncompressedOffset) override;
+    ssize_t decodeCursor(DecoderCursor* cursor, unsigned char* buffer, size_t length) override;
+
+private:
+
+    // The skippable frame that holds the seek table.
+    static const uint32_t skippableFrameMagicNumber = 0x184D2A5E;
+    static const size_t skippableFrameHeaderSize = 8;
+    // The descriptor bit that says that every entry has a checksum, and the bits that must be 0.
+    static const uint8_t checksumFlag = 0x80;
+    static const uint8_t reservedBits = 0x7C;
+
+    struct Frame
+    {
+        off_t compressedOffset;
+        off_t uncompressedOffset;
+    };
+
+    struct ZstdCursor : public DecoderCursor
+    {
+        ZSTD_DCtx* context;
+        off_t compressedOffset = 0;
+        std::vector<unsigned char> input;
+        ZSTD_inBuffer inputBuffer = { nullptr, 0, 0 };
+
+        ZstdCursor() : input(ZSTD_DStreamInSize())
+        {
+            context = ZSTD_createDCtx();
+        }
+        ~ZstdCursor()
+        {
+            ZSTD_freeDCtx(context);
+        }
+    };
+
+    // All frames, and one more, where the seek table starts.
+    std::vector<Frame> frames;
+
+    // Index of the frame that uncompressedOffset is in.
+    size_t frameForOffset(off_t uncompressedOffset) const;
+};
+
+bool ZstdSeekableFileIOBackend::buildRestartPoints()
+{
+    if (compressedFileSize < (off_t)(skippableFrameHeaderSize + seekTableFooterSize))
+    {
+        return false;
+    }
+
+    unsigned char footer[seekTableFooterSize];
+    if (readCompressedData(compressedFileSize - seekTableFooterSize, footer, seekTableFooterSize) != (ssize_t)seekTableFooterSize)
+    {
+        return false;
+    }
+    uint64_t numberOfFrames = readLittleEndian32(&footer[0]);
+    uint8_t descriptor = footer[4];
+    if ((readLittleEndian32(&footer[5]) != seekableMagicNumber) || ((descriptor & reservedBits) != 0))
+    {
+        return false;
+    }
+
+    size_t entrySize = ((descriptor & checksumFlag) != 0) ? 12 : 8;
+    uint64_t seekTableSize = skippableFrameHeaderSize + (numberOfFrames * entrySize) + seekTableFooterSize;
+    if (seekTableSize > (uint64_t)compressedFileSize)
+    {
+        return false;
+    }
+    off_t seekTableOffset = compressedFileSize - (off_t)seekTableSize;
+
+    std::vector<unsigned char> seekTable(seekTableSize);
+    if (readCompressedData(seekTableOffset, seekTable.data(), seekTable.size()) != (ssize_t)seekTable.size())
+    {
+        return false;
+    }
+    if ((readLittleEndian32(&seekTable[0]) != skippableFrameMagicNumber) || (readLittleEndian32(&seekTable[4]) != (seekTableSize - skippableFrameHeaderSize)))
+    {
+        return false;
+    }
+
+    frames.reserve(numberOfFrames + 1);
+    Frame frame = { 0, 0 };
+    const unsigned char* entry = &seekTable[skippableFrameHeaderSize];
+    for (uint64_t frameIndex = 0; frameIndex < numberOfFrames; frameIndex++, entry += entrySize)
+    {
+        frames.push_back(frame);
+        frame.compressedOffset += readLittleEndian32(&entry[0]);
+        frame.uncompressedOffset += readLittleEndian32(&entry[4]);
+    }
+    frames.push_back(frame);
+
+    if (frame.compressedOffset != seekTableOffset)
+    {
+        // The frames don't add up to the file.
+        clearRestartPoints();
+        return false;
+    }
+
+    uncompressedFileSize = frame.uncompressedOffset;
+    return true;
+}
+
+void ZstdSeekableFileIOBackend::clearRestartPoints()
+{
+    frames.clear();
+    frames.shrink_to_fit();
+}
+
+size_t ZstdSeekableFileIOBackend::memorySizeOfRestartPoints() const
+{
+    return frames.capacity() * sizeof(Frame);
+}
+
+size_t ZstdSeekableFileIOBackend::frameForOffset(off_t uncompressedOffset) const
+{
+    // Leave out the end, so that an offset at or beyond the end ends up in the last frame.
+    auto next = std::upper_bound(frames.begin(), frames.end() - 1, uncompressedOffset, [](off_t offset, const Frame& frame)
+    {
+        return offset < frame.uncompressedOffset;
+    });
+    return (next == frames.begin()) ? 0 : (next - frames.begin()) - 1;
+}
+
+off_t ZstdSeekableFileIOBackend::restartPointForOffset(off_t uncompressedOffset) const
+{
+    return frames[frameForOffset(uncompressedOffset)].uncompressedOffset;
+}
+
+CompressedFileIOBackend::DecoderCursor* ZstdSeekableFileIOBackend::createCursor()
+{
+    return new ZstdCursor;
+}
+
+bool ZstdSeekableFileIOBackend::seekCursor(DecoderCursor* decoderCursor, off_t uncompressedOffset)
+{
+    ZstdCursor* cursor = static_cast<ZstdCursor*>(decoderCursor);
+    if ((cursor->context == nullptr) || ZSTD_isError(ZSTD_DCtx_reset(cursor->context, ZSTD_reset_session_only)))
+    {
+        return false;
+    }
+
+    const Frame& frame = frames[frameForOffset(uncompressedOffset)];
+    cursor->compressedOffset = frame.compressedOffset;
+    cursor->inputBuffer.src = cursor->input.data();
+    cursor->inputBuffer.size = 0;
+    cursor->inputBuffer.pos = 0;
+    cursor->uncompressedOffset = frame.uncompressedOffset;
+    return true;
+}
+
+ssize_t ZstdSeekableFileIOBackend::decodeCursor(DecoderCursor* decoderCursor, unsigned char* buffer, size_t length)
+{
+    ZstdCursor* cursor = static_cast<ZstdCursor*>(decoderCursor);
+    ZSTD_inBuffer& inputBuffer = cursor->inputBuffer;
+    off_t endOfFrames = frames.back().compressedOffset;
+
+    ZSTD_outBuffer outputBuffer = { buffer, length, 0 };
+    while (outputBuffer.pos < outputBuffer.size)
+    {
+        if ((inputBuffer.pos == inputBuffer.size) && (cursor->compressedOffset < endOfFrames))
+        {
+            size_t readLength = (size_t)std::min((off_t)cursor->input.size(), endOfFrames - cursor->compressedOffset);
+            ssize_t bytesRead = readCompressedData(cursor->compressedOffset, cursor->input.data(), readLength);
+            if (bytesRead <= 0)
+            {
+                return -1;
+            }
+            cursor->compressedOffset += bytesRead;
+            inputBuffer.size = (size_t)bytesRead;
+            inputBuffer.pos = 0;
+        }
+
+        size_t outputPosition = outputBuffer.pos;
+        size_t inputPosition = inputBuffer.pos;
+        size_t result = ZSTD_decompressStream(cursor->context, &outputBuffer, &inputBuffer);
+        if (ZSTD_isError(result))
+        {
+            return -1;
+        }
+        if ((outputBuffer.pos == outputPosition) && (inputBuffer.pos == inputPosition) && (cursor->compressedOffset >= endOfFrames))
+        {
+            // Nothing left to decode.
+            break;
+        }
+    }
+
+    return (ssize_t)outputBuffer.pos;
+}
+
+#endif /* LARGEFILEREADER_HAS_ZSTD */
+
+// MARK: - CompressedFileIOBackend
+
+CompressedFileIOBackend::CompressionType CompressedFileIOBackend::compressionTypeForFile(int fileDescriptor)
+{
+    unsigned char header[3];
+    if ((::pread(fileDescriptor, header, sizeof(header), 0) == (ssize_t)sizeof(header)) &&
+        (header[0] == 0x1F) && (header[1] == 0x8B) && (header[2] == Z_DEFLATED))
+    {
+        return CompressionTypeGzip;
+    }
+
+#if LARGEFILEREADER_HAS_ZSTD
+    struct stat fileStatus;
+    unsigned char footer[ZstdSeekableFileIOBackend::seekTableFooterSize];
+    if ((fstat(fileDescriptor, &fileStatus) == 0) && (fileStatus.st_size >= (off_t)sizeof(footer)) &&
+        (::pread(fileDescriptor, footer, sizeof(footer), fileStatus.st_size - sizeof(footer)) == (ssize_t)sizeof(footer)) &&
+        (readLittleEndian32(&footer[5]) == ZstdSeekableFileIOBackend::seekableMagicNumber))
+    {
+        return CompressionTypeZstdSeekable;
+    }
+#endif
+
+    return CompressionTypeNone;
+}
+
+CompressedFileIOBackend* CompressedFileIOBackend::createBackendForFile(CompressionType compressionType, int fileDescriptor)
+{
+    CompressedFileIOBackend* backend = nullptr;
+
+    switch (compressionType)
+    {
+        case CompressionTypeGzip:
+            backend = new GzipFileIOBackend;
+            break;
+        case CompressionTypeZstdSeekable:
+#if LARGEFILEREADER_HAS_ZSTD
+            backend = new ZstdSeekableFileIOBackend;
+#endif
+            break;
+        case CompressionTypeNone:
+        default:
+            break;
+    }
+
+    if ((backend != nullptr) && !backend->attach(fileDescriptor, 0))
+    {
+        delete backend;
+        backend = nullptr;
+    }
+
+    return backend;
+}
+
+CompressedFileIOBackend::~CompressedFileIOBackend()
+{
+    for (DecoderCursor* cursor : idleCursors)
+    {
+        delete cursor;
+    }
+}
+
+off_t CompressedFileIOBackend::uncompressedSize() const
+{
+    return uncompressedFileSize;
+}
+
+size_t CompressedFileIOBackend::restartPointsMemorySize() const
+{
+    return memorySizeOfRestartPoints();
+}
+
+bool CompressedFileIOBackend::attach(int fileDescriptor, size_t /* directIOAlignment */)
+{
+    this->fileDescriptor = fileDescriptor;
+    this->directIOAlignment = 0;
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) != 0)
+    {
+        return false;
+    }
+    compressedFileSize = fileStatus.st_size;
+    uncompressedFileSize = 0;
+
+    return buildRestartPoints();
+}
+
+void CompressedFileIOBackend::detach()
+{
+    {
+        std::lock_guard<std::mutex> lock(cursorMutex);
+        for (DecoderCursor* cursor : idleCursors)
+        {
+            delete cursor;
+        }
+        idleCursors.clear();
+    }
+    clearRestartPoints();
+    fileDescriptor = -1;
+}
+
+// Strategy (reading blocks):
+//
+// The requests of a batch are read in order of offset with one cursor, so a batch of consecutive
+// blocks (read-ahead, or a read that misses several blocks) is decoded in one pass. Skipping to the
+// start of a request decodes into the request's own buffer, which is overwritten afterwards anyway.
+
+void CompressedFileIOBackend::readBlocks(BlockRequest* requests, size_t numberOfRequests)
+{
+    if (numberOfRequests == 0)
+    {
+        return;
+    }
+
+    std::vector<BlockRequest*> sortedRequests(numberOfRequests);
+    for (size_t requestIndex = 0; requestIndex < numberOfRequests; requestIndex++)
+    {
+        sortedRequests[requestIndex] = &requests[requestIndex];
+    }
+    std::sort(sortedRequests.begin(), sortedRequests.end(), [](const BlockRequest* request1, const BlockRequest* request2)
+    {
+        return request1->fileOffset < request2->fileOffset;
+    });
+
+    DecoderCursor* cursor = checkOutCursor(sortedRequests[0]->fileOffset);
+    for (BlockRequest* request : sortedRequests)
+    {
+        readBlockWithCursor(cursor, *request);
+    }
+    checkInCursor(cursor);
+}
+
+void CompressedFileIOBackend::readBlockWithCursor(DecoderCursor* cursor, BlockRequest& request)
+{
+    request.bytesRead = 0;
+    if (request.fileOffset >= uncompressedFileSize)
+    {
+        return;
+    }
+    size_t length = (size_t)std::min((off_t)request.length, uncompressedFileSize - request.fileOffset);
+
+    // Continue where the cursor is, unless it is past the data, or a restart point is closer.
+    if ((cursor->uncompressedOffset < 0) || (cursor->uncompressedOffset > request.fileOffset) ||
+        (restartPointForOffset(request.fileOffset) > cursor->uncompressedOffset))
+    {
+        if (!seekCursor(cursor, request.fileOffset))
+        {
+            cursor->uncompressedOffset = -1;
+            request.bytesRead = -1;
+            return;
+        }
+    }
+
+    while (cursor->uncompressedOffset < request.fileOffset)
+    {
+        size_t skipLength = (size_t)std::min((off_t)request.length, request.fileOffset - cursor->uncompressedOffset);
+        ssize_t bytesDecoded = decodeCursor(cursor, request.buffer, skipLength);
+        if (bytesDecoded <= 0)
+        {
+            cursor->uncompressedOffset = -1;
+            request.bytesRead = -1;
+            return;
+        }
+        cursor->uncompressedOffset += bytesDecoded;
+    }
+
+    size_t totalBytesDecoded = 0;
+    while (totalBytesDecoded < length)
+    {
+        ssize_t bytesDecoded = decodeCursor(cursor, &request.buffer[totalBytesDecoded], length - totalBytesDecoded);
+        if (bytesDecoded < 0)
+        {
+            cursor->uncompressedOffset = -1;
+            request.bytesRead = -1;
+            return;
+        }
+        if (bytesDecoded == 0)
+        {
+            break;
+        }
+        cursor->uncompressedOffset += bytesDecoded;
+        totalBytesDecoded += bytesDecoded;
+    }
+    request.bytesRead = totalBytesDecoded;
+}
+
+CompressedFileIOBackend::DecoderCursor* CompressedFileIOBackend::checkOutCursor(off_t uncompressedOffset)
+{
+    off_t restartPoint = restartPointForOffset(uncompressedOffset);
+    {
+        std::lock_guard<std::mutex> lock(cursorMutex);
+
+        // The cursor closest before the offset, if it is not before the restart point that we
+        // would otherwise decode from.
+        int64_t bestCursor = -1;
+        for (size_t cursorIndex = 0; cursorIndex < idleCursors.size(); cursorIndex++)
+        {
+            off_t cursorOffset = idleCursors[cursorIndex]->uncompressedOffset;
+            if ((cursorOffset >= restartPoint) && (cursorOffset <= uncompressedOffset) &&
+                ((bestCursor == -1) || (cursorOffset > idleCursors[bestCursor]->uncompressedOffset)))
+            {
+                bestCursor = cursorIndex;
+            }
+        }
+        if (bestCursor != -1)
+        {
+            DecoderCursor* cursor = idleCursors[bestCursor];
+            idleCursors.erase(idleCursors.begin() + bestCursor);
+            return cursor;
+        }
+    }
+
+    return createCursor();
+}
+
+void CompressedFileIOBackend::checkInCursor(DecoderCursor* cursor)
+{
+    DecoderCursor* oldestCursor = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(cursorMutex);
+        idleCursors.push_back(cursor);
+        if (idleCursors.size() > maximumNumberOfIdleCursors)
+        {
+            oldestCursor = idleCursors.front();
+            idleCursors.erase(idleCursors.begin());
+        }
+    }
+    delete oldestCursor;
+}
+
+ssize_t CompressedFileIOBackend::readCompressedData(off_t fileOffset, unsigned char* buffer, size_t length) const
+{
+    size_t totalBytesRead = 0;
+    while (totalBytesRead < length)
+    {
+        ssize_t bytesRead = ::pread(fileDescriptor, &buffer[totalBytesRead], length - totalBytesRead, fileOffset + totalBytesRead);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        totalBytesRead += bytesRead;
+    }
+    return (ssize_t)totalBytesRead;
+}
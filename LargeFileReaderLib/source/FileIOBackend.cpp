@@ -0,0 +1,183 @@
+//
+//  FileIOBackend.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <sys/uio.h>
+#include <vector>
+
+#include "FileIOBackend.hpp"
+#include "IOUringFileIOBackend.hpp"
+
+FileIOBackend* FileIOBackend::createBackendForFile(BackendType backendType, int fileDescriptor, size_t directIOAlignment)
+{
+    FileIOBackend* backend = nullptr;
+
+    switch (backendType)
+    {
+        case BackendTypeIOUring:
+#if LARGEFILEREADER_HAS_IO_URING
+            backend = new IOUringFileIOBackend(IOUringFileIOBackend::defaultQueueDepth);
+#endif
+            break;
+        case BackendTypePosix:
+        default:
+            break;
+    }
+
+    if ((backend != nullptr) && !backend->attach(fileDescriptor, directIOAlignment))
+    {
+        // Not supported here (old kernel, not allowed by a sandbox, ...).
+        delete backend;
+        backend = nullptr;
+    }
+
+    if (backend == nullptr)
+    {
+        backend = new PosixFileIOBackend;
+        backend->attach(fileDescriptor, directIOAlignment);
+    }
+
+    return backend;
+}
+
+void FileIOBackend::completeBlockRequest(BlockRequest& request) const
+{
+    // pread may return less than we asked for, even if we are not at the end of the file. Keep
+    // reading until the request is complete, or until we hit the end of the file.
+    size_t totalBytesRead = request.bytesRead;
+    while (totalBytesRead < request.length)
+    {
+        if ((directIOAlignment != 0) && ((totalBytesRead % directIOAlignment) != 0))
+        {
+            // Direct I/O only comes back short in units of the alignment, except at the end of the
+            // file. Continuing from here would be an unaligned read, which the kernel refuses.
+            break;
+        }
+
+        ssize_t bytesRead = ::pread(fileDescriptor, &request.buffer[totalBytesRead], request.length - totalBytesRead, request.fileOffset + totalBytesRead);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            request.bytesRead = -1;
+            return;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        totalBytesRead += bytesRead;
+    }
+
+    request.bytesRead = totalBytesRead;
+}
+
+// MARK: - PosixFileIOBackend
+
+bool PosixFileIOBackend::attach(int fileDescriptor, size_t directIOAlignment)
+{
+    this->fileDescriptor = fileDescriptor;
+    this->directIOAlignment = directIOAlignment;
+    return true;
+}
+
+void PosixFileIOBackend::detach()
+{
+    fileDescriptor = -1;
+}
+
+void PosixFileIOBackend::readBlocks(BlockRequest* requests, size_t numberOfRequests)
+{
+    // Use positional reads, so that we do not depend on (and do not change) the file offset of the
+    // file descriptor. This makes it safe to read from multiple threads at the same time.
+    //
+    // Requests that follow each other in the file (a batch of missing neighbouring blocks) are read
+    // with a single preadv, that scatters the data over their buffers, wherever those are in memory.
+    std::vector<struct iovec> ioVectors;
+    size_t requestNumber = 0;
+    while (requestNumber < numberOfRequests)
+    {
+        size_t numberOfRunRequests = 1;
+        while (((requestNumber + numberOfRunRequests) < numberOfRequests) && (numberOfRunRequests < maximumRunRequests) &&
+               (requests[requestNumber + numberOfRunRequests].fileOffset ==
+                (requests[requestNumber + numberOfRunRequests - 1].fileOffset + (off_t)requests[requestNumber + numberOfRunRequests - 1].length)))
+        {
+            numberOfRunRequests++;
+        }
+
+        if (numberOfRunRequests == 1)
+        {
+            requests[requestNumber].bytesRead = 0;
+            completeBlockRequest(requests[requestNumber]);
+        }
+        else
+        {
+            readRun(&requests[requestNumber], numberOfRunRequests, ioVectors);
+        }
+        requestNumber += numberOfRunRequests;
+    }
+}
+
+void PosixFileIOBackend::readRun(BlockRequest* requests, size_t numberOfRequests, std::vector<struct iovec>& ioVectors)
+{
+    ioVectors.resize(numberOfRequests);
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        ioVectors[requestNumber].iov_base = requests[requestNumber].buffer;
+        ioVectors[requestNumber].iov_len = requests[requestNumber].length;
+        requests[requestNumber].bytesRead = 0;
+    }
+
+    ssize_t bytesRead;
+    do
+    {
+        bytesRead = ::preadv(fileDescriptor, ioVectors.data(), (int)numberOfRequests, requests[0].fileOffset);
+    }
+    while ((bytesRead < 0) && (errno == EINTR));
+
+    if (bytesRead < 0)
+    {
+        // Read them one by one, so only the requests that really fail, fail.
+        for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+        {
+            completeBlockRequest(requests[requestNumber]);
+        }
+        return;
+    }
+
+    // Hand out the data in order. If preadv came back short, the request where it stopped is completed
+    // with pread. If that comes back short without an error, we are at the end of the file, and the
+    // requests after it are empty. If it fails, the requests after it are read one by one, like above,
+    // as they have not been read at all.
+    size_t bytesLeft = bytesRead;
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        BlockRequest& request = requests[requestNumber];
+        request.bytesRead = std::min(bytesLeft, request.length);
+        bytesLeft -= request.bytesRead;
+        if ((size_t)request.bytesRead < request.length)
+        {
+            completeBlockRequest(request);
+            if (request.bytesRead < 0)
+            {
+                for (size_t laterRequestNumber = requestNumber + 1; laterRequestNumber < numberOfRequests; laterRequestNumber++)
+                {
+                    completeBlockRequest(requests[laterRequestNumber]);
+                }
+                return;
+            }
+            if ((size_t)request.bytesRead < request.length)
+            {
+                break;
+            }
+        }
+    }
+}
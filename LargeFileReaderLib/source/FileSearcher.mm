@@ -0,0 +1,106 @@
+//
+//  FileSearcher.mm
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#import <Foundation/Foundation.h>
+#import "FileSearcher.h"
+#import "LargeFileReader_Private.h"
+#import "LineIndexer_Private.h"
+#import "FileSearcherCore.hpp"
+
+@interface FileSearcher()
+
+@property (nonatomic, assign) FileSearcherCore *fileSearcherCore;
+// Keep the reader and the line indexer (and their cores) alive for as long as we use them.
+@property (nonatomic, strong) LargeFileReader *largeFileReader;
+@property (nonatomic, strong) LineIndexer *lineIndexer;
+
+@end
+
+@implementation FileSearcher
+
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader
+{
+    return [self initWithReader:largeFileReader lineIndexer:nil];
+}
+
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader lineIndexer:(LineIndexer *)lineIndexer
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _fileSearcherCore = new FileSearcherCore;
+        _largeFileReader = largeFileReader;
+        _lineIndexer = lineIndexer;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    delete _fileSearcherCore;
+    _fileSearcherCore = nil;
+}
+
+- (NSInteger)numberOfSearchThreads
+{
+    return self.fileSearcherCore->numberOfSearchThreads;
+}
+
+- (void)setNumberOfSearchThreads:(NSInteger)numberOfSearchThreads
+{
+    self.fileSearcherCore->numberOfSearchThreads = numberOfSearchThreads;
+}
+
+- (NSData *)lineDelimiter
+{
+    const std::string& lineDelimiter = self.fileSearcherCore->lineDelimiter;
+    return [NSData dataWithBytes:lineDelimiter.data() length:lineDelimiter.size()];
+}
+
+- (void)setLineDelimiter:(NSData *)lineDelimiter
+{
+    self.fileSearcherCore->lineDelimiter = std::string((const char *)lineDelimiter.bytes, lineDelimiter.length);
+}
+
+- (NSInteger)maximumLineLength
+{
+    return self.fileSearcherCore->maximumLineLength;
+}
+
+- (void)setMaximumLineLength:(NSInteger)maximumLineLength
+{
+    self.fileSearcherCore->maximumLineLength = MAX(maximumLineLength, 1);
+}
+
+- (NSInteger)searchForString:(NSData *)searchString usingBlock:(void (^)(NSInteger offset, NSInteger length, NSInteger lineNumber, BOOL *stop))block
+{
+    std::string searchStringCore((const char *)searchString.bytes, searchString.length);
+    return self.fileSearcherCore->searchForString(self.largeFileReader.largeFileReaderCore, searchStringCore, self.lineIndexer.lineIndexerCore, [self handlerForBlock:block]);
+}
+
+- (NSInteger)searchForRegularExpression:(NSString *)pattern usingBlock:(void (^)(NSInteger offset, NSInteger length, NSInteger lineNumber, BOOL *stop))block
+{
+    return self.fileSearcherCore->searchForRegularExpression(self.largeFileReader.largeFileReaderCore, pattern.UTF8String, self.lineIndexer.lineIndexerCore, [self handlerForBlock:block]);
+}
+
+- (FileSearcherCore::SearchMatchHandler)handlerForBlock:(void (^)(NSInteger offset, NSInteger length, NSInteger lineNumber, BOOL *stop))block
+{
+    return [block](const FileSearcherCore::SearchMatch* matches, size_t numberOfMatches)
+    {
+        BOOL stop = NO;
+        for (size_t matchNumber = 0; (matchNumber < numberOfMatches) && !stop; matchNumber++)
+        {
+            const FileSearcherCore::SearchMatch& match = matches[matchNumber];
+            block(match.offset, match.length, match.lineNumber, &stop);
+        }
+        return !stop;
+    };
+}
+
+@end
@@ -0,0 +1,457 @@
+//
+//  FileSearcherCore.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <regex.h>
+
+#include "FileSearcherCore.hpp"
+#include "LineDelimiterScanner.hpp"
+#include "SubstringScanner.hpp"
+#include "WorkerPool.hpp"
+
+FileSearcherCore::FileSearcherCore()
+{
+
+}
+
+FileSearcherCore::~FileSearcherCore()
+{
+
+}
+
+// Strategy:
+//
+// The file is cut into chunks, which are searched on the worker pool, through views into the reader's
+// cache, so the data is never copied. A match belongs to the chunk where it starts. A chunk is scanned
+// up to the end of the last match that can start in it, so matches that cross a chunk boundary are
+// found too.
+//
+// A string is found with SubstringScanner, per view. A match that starts in one view and ends in the
+// next (so in another cache block) is found by searching the last bytes of the view together with the
+// first bytes of the next one, which is a few bytes, however long the views are.
+//
+// A regular expression is matched per line. A chunk starts with the first line that starts in it, and
+// ends with the last one, wherever that ends. A line is matched where it is in the cache, only a line
+// that crosses a view is copied. Long lines are matched in pieces, as they are in the line index, so
+// the copy is never longer than a piece. The lines are found as LineIndexerCore finds them: by the
+// last byte of the delimiter, checked against the bytes before it.
+//
+// We use the POSIX regex functions, not std::regex. Its matcher recurses for every character it takes,
+// and runs out of stack on a line of a few thousand bytes on a worker thread.
+//
+// Chunks finish in any order, but their matches are handed out in order. Whichever thread finishes the
+// chunk that is next in line hands it out, and all chunks after it that are done, while the other
+// threads go on searching. So that a slow chunk does not make us keep the matches of the whole file,
+// threads wait before they start a chunk that is too far ahead.
+
+int64_t FileSearcherCore::searchForString(LargeFileReaderCore* reader, const std::string& searchString, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches)
+{
+    assert(reader != NULL);
+
+    if (searchString.empty())
+    {
+        return -1;
+    }
+
+    size_t chunkSize = std::max(searchChunkSize, scanSliceSize);
+    return searchInChunks(reader, chunkSize, lineIndexer, handleMatches, [&](off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches)
+    {
+        return searchChunkForString(reader, searchString, startOffset, endOffset, matches);
+    });
+}
+
+int64_t FileSearcherCore::searchForRegularExpression(LargeFileReaderCore* reader, const std::string& pattern, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches)
+{
+    assert(reader != NULL);
+
+    // The lines are the lines of the index, if there is one.
+    const std::string& delimiter = (lineIndexer != NULL) ? lineIndexer->lineDelimiterOfIndex() : lineDelimiter;
+    size_t maximumLength = (lineIndexer != NULL) ? lineIndexer->maximumLineLengthOfIndex() : std::max(maximumLineLength, (size_t)1);
+    // Offsets in a line must fit in a regoff_t.
+    maximumLength = std::min(maximumLength, (size_t)std::numeric_limits<regoff_t>::max());
+    if (delimiter.empty())
+    {
+        return -1;
+    }
+
+    regex_t regularExpression;
+    if (regcomp(&regularExpression, pattern.c_str(), REG_EXTENDED) != 0)
+    {
+        return -1;
+    }
+
+    // Where the lines of a chunk start can only be found from the start of the file, if delimiters can
+    // overlap.
+    size_t chunkSize = std::max(searchChunkSize, scanSliceSize);
+    if (LineIndexerCore::lineDelimiterCanOverlapItself(delimiter))
+    {
+        chunkSize = std::max((size_t)reader->fileSize(), chunkSize);
+    }
+
+    int64_t numberOfMatches = searchInChunks(reader, chunkSize, lineIndexer, handleMatches, [&](off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches)
+    {
+        return forEachLineInChunk(reader, delimiter, maximumLength, startOffset, endOffset, [&](off_t startOfLine, const unsigned char* line, size_t lineLength)
+        {
+            // REG_STARTEND matches the line where it is, without a terminating zero.
+            const char* lineStart = (lineLength > 0) ? (const char*)line : "";
+            int flags = REG_STARTEND;
+            regoff_t position = 0;
+            while ((size_t)position <= lineLength)
+            {
+                regmatch_t match;
+                match.rm_so = position;
+                match.rm_eo = (regoff_t)lineLength;
+                if (regexec(&regularExpression, lineStart, 1, &match, flags) != 0)
+                {
+                    break;
+                }
+                matches.push_back({ startOfLine + (off_t)match.rm_so, (size_t)(match.rm_eo - match.rm_so), -1 });
+
+                // An empty match is only found once. The next match is not at the start of the line.
+                position = (match.rm_eo > match.rm_so) ? match.rm_eo : match.rm_eo + 1;
+                flags = REG_STARTEND | REG_NOTBOL;
+            }
+        });
+    });
+
+    regfree(&regularExpression);
+
+    return numberOfMatches;
+}
+
+int64_t FileSearcherCore::searchInChunks(LargeFileReaderCore* reader, size_t chunkSize, const LineIndexerCore* lineIndexer, const SearchMatchHandler& handleMatches, const std::function<bool(off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches)>& searchChunk)
+{
+    if (!reader->isOpen)
+    {
+        return -1;
+    }
+
+    off_t fileSize = reader->fileSize();
+    size_t numberOfChunks = (fileSize + chunkSize - 1) / chunkSize;
+
+    WorkerPool& workerPool = WorkerPool::sharedPool();
+    size_t numberOfThreads = (numberOfSearchThreads == 0) ? (workerPool.numberOfWorkers() + 1) : numberOfSearchThreads;
+    size_t maximumNumberOfChunksAhead = numberOfThreads * maximumNumberOfWaitingChunksPerThread;
+
+    // Protects everything below.
+    std::mutex chunkMutex;
+    std::condition_variable chunkCondition;
+    std::vector<std::vector<SearchMatch>> chunkMatches(numberOfChunks);
+    std::vector<bool> isChunkDone(numberOfChunks, false);
+    size_t nextChunkToHandOut = 0;
+    bool isHandingOut = false;
+    bool isStopped = false;
+    bool hasFailed = false;
+    int64_t numberOfMatches = 0;
+
+    workerPool.runTasks(numberOfChunks, numberOfSearchThreads, [&](size_t chunkNumber)
+    {
+        {
+            std::unique_lock<std::mutex> lock(chunkMutex);
+            chunkCondition.wait(lock, [&] { return isStopped || (chunkNumber < (nextChunkToHandOut + maximumNumberOfChunksAhead)); });
+            if (isStopped)
+            {
+                return;
+            }
+        }
+
+        off_t chunkStartOffset = (off_t)chunkNumber * chunkSize;
+        off_t chunkEndOffset = std::min(chunkStartOffset + (off_t)chunkSize, fileSize);
+
+        std::vector<SearchMatch> matches;
+        bool isSearched = searchChunk(chunkStartOffset, chunkEndOffset, matches);
+        if (isSearched && (lineIndexer != NULL))
+        {
+            for (SearchMatch& match : matches)
+            {
+                match.lineNumber = lineIndexer->lineNumberForOffset(reader, match.offset);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(chunkMutex);
+        if (!isSearched)
+        {
+            hasFailed = true;
+            isStopped = true;
+            chunkCondition.notify_all();
+            return;
+        }
+
+        chunkMatches[chunkNumber].swap(matches);
+        isChunkDone[chunkNumber] = true;
+
+        // The thread that is handing out will see this chunk when it gets to it.
+        if (isHandingOut)
+        {
+            return;
+        }
+
+        isHandingOut = true;
+        while (!isStopped && (nextChunkToHandOut < numberOfChunks) && isChunkDone[nextChunkToHandOut])
+        {
+            std::vector<SearchMatch> matchesToHandOut;
+            matchesToHandOut.swap(chunkMatches[nextChunkToHandOut]);
+
+            lock.unlock();
+            bool shouldContinue = matchesToHandOut.empty() || handleMatches(matchesToHandOut.data(), matchesToHandOut.size());
+            lock.lock();
+
+            numberOfMatches += matchesToHandOut.size();
+            nextChunkToHandOut++;
+            if (!shouldContinue)
+            {
+                isStopped = true;
+            }
+            chunkCondition.notify_all();
+        }
+        isHandingOut = false;
+    });
+
+    return hasFailed ? -1 : numberOfMatches;
+}
+
+bool FileSearcherCore::searchChunkForString(LargeFileReaderCore* reader, const std::string& searchString, off_t startOffset, off_t endOffset, std::vector<SearchMatch>& matches)
+{
+    const unsigned char* pattern = (const unsigned char*)searchString.data();
+    size_t patternLength = searchString.size();
+
+    // A match that starts before endOffset can end up to patternLength - 1 bytes after it.
+    off_t scanEndOffset = std::min(endOffset + (off_t)(patternLength - 1), reader->fileSize());
+
+    std::vector<uint32_t> matchPositions(scanSliceSize);
+    // The last patternLength - 1 bytes of the previous view, followed by the first patternLength - 1
+    // bytes of the next one.
+    std::vector<unsigned char> boundaryBytes(2 * (patternLength - 1));
+    std::vector<uint32_t> boundaryMatchPositions(boundaryBytes.size());
+    size_t numberOfBytesBeforeView = 0;
+
+    auto addMatch = [&](off_t offset)
+    {
+        if (offset < endOffset)
+        {
+            matches.push_back({ offset, patternLength, -1 });
+        }
+    };
+
+    off_t fileOffset = startOffset;
+    while (fileOffset < scanEndOffset)
+    {
+        LargeFileReaderCore::FileDataView view;
+        size_t viewLength = reader->acquireView(fileOffset, std::min((off_t)scanSliceSize, scanEndOffset - fileOffset), view);
+        if ((viewLength == (size_t)-1) || (viewLength == 0))
+        {
+            // The file can not be shorter than it was when we started.
+            return false;
+        }
+
+        // Matches that start in the previous view, and end in this one.
+        if (numberOfBytesBeforeView > 0)
+        {
+            size_t numberOfBytesOfView = std::min(viewLength, patternLength - 1);
+            memcpy(&boundaryBytes[numberOfBytesBeforeView], view.data, numberOfBytesOfView);
+            size_t numberOfMatches = SubstringScanner::findMatches(boundaryBytes.data(), numberOfBytesBeforeView + numberOfBytesOfView, pattern, patternLength, boundaryMatchPositions.data());
+            for (size_t matchNumber = 0; (matchNumber < numberOfMatches) && (boundaryMatchPositions[matchNumber] < numberOfBytesBeforeView); matchNumber++)
+            {
+                addMatch(fileOffset - numberOfBytesBeforeView + boundaryMatchPositions[matchNumber]);
+            }
+        }
+
+        size_t numberOfMatches = SubstringScanner::findMatches(view.data, viewLength, pattern, patternLength, matchPositions.data());
+        for (size_t matchNumber = 0; matchNumber < numberOfMatches; matchNumber++)
+        {
+            addMatch(fileOffset + matchPositions[matchNumber]);
+        }
+
+        // Keep the last bytes for the next view.
+        size_t numberOfBytesToKeep = patternLength - 1;
+        if (numberOfBytesToKeep == 0)
+        {
+            // A single byte can't cross views.
+        }
+        else if (viewLength >= numberOfBytesToKeep)
+        {
+            memcpy(boundaryBytes.data(), view.data + viewLength - numberOfBytesToKeep, numberOfBytesToKeep);
+            numberOfBytesBeforeView = numberOfBytesToKeep;
+        }
+        else
+        {
+            size_t numberOfBytesStillBefore = std::min(numberOfBytesBeforeView, numberOfBytesToKeep - viewLength);
+            memmove(boundaryBytes.data(), &boundaryBytes[numberOfBytesBeforeView - numberOfBytesStillBefore], numberOfBytesStillBefore);
+            memcpy(&boundaryBytes[numberOfBytesStillBefore], view.data, viewLength);
+            numberOfBytesBeforeView = numberOfBytesStillBefore + viewLength;
+        }
+
+        reader->releaseView(view);
+
+        fileOffset += viewLength;
+    }
+
+    return true;
+}
+
+bool FileSearcherCore::forEachLineInChunk(LargeFileReaderCore* reader, const std::string& delimiter, size_t maximumLength, off_t startOffset, off_t endOffset, const std::function<void(off_t startOfLine, const unsigned char* line, size_t lineLength)>& handleLine)
+{
+    off_t fileSize = reader->fileSize();
+    const unsigned char* delimiterBytes = (const unsigned char*)delimiter.data();
+    size_t delimiterLength = delimiter.size();
+
+    std::vector<uint32_t> delimiterPositions(scanSliceSize);
+    // The last delimiterLength - 1 bytes before the view, for a delimiter that starts before it.
+    std::vector<unsigned char> precedingBytes(delimiterLength);
+    size_t numberOfPrecedingBytes = 0;
+    // The part of the line from startOfLine up to the view, if it started in an earlier view. Pieces are
+    // handed out as soon as they are complete, so this is never much longer than a piece.
+    std::vector<unsigned char> lineBuffer;
+
+    // We don't know where the lines of a chunk start until we have seen the delimiter before the first
+    // one. It can end with the last byte of the chunk before us.
+    off_t startOfLine = (startOffset == 0) ? 0 : -1;
+    off_t fileOffset = std::max(startOffset - (off_t)delimiterLength, (off_t)0);
+    off_t earliestStartOfDelimiter = fileOffset;
+    const unsigned char* viewData = NULL;
+    bool isDone = false;
+
+    // Hand out the (piece of the) line from startOfLine up to endOfLine, which is in lineBuffer, the
+    // view, or both.
+    auto handleLineUpTo = [&](off_t endOfLine)
+    {
+        if (startOfLine >= fileOffset)
+        {
+            handleLine(startOfLine, viewData + (startOfLine - fileOffset), endOfLine - startOfLine);
+        }
+        else if (endOfLine <= fileOffset)
+        {
+            handleLine(startOfLine, lineBuffer.data(), endOfLine - startOfLine);
+        }
+        else
+        {
+            size_t numberOfBufferedBytes = lineBuffer.size();
+            lineBuffer.insert(lineBuffer.end(), viewData, viewData + (endOfLine - fileOffset));
+            handleLine(startOfLine, lineBuffer.data(), endOfLine - startOfLine);
+            lineBuffer.resize(numberOfBufferedBytes);
+        }
+    };
+    auto handlePiece = [&]()
+    {
+        handleLineUpTo(startOfLine + maximumLength);
+        startOfLine += maximumLength;
+        if (startOfLine < fileOffset)
+        {
+            lineBuffer.erase(lineBuffer.begin(), lineBuffer.begin() + maximumLength);
+        }
+        else
+        {
+            lineBuffer.clear();
+        }
+    };
+
+    while (!isDone && (fileOffset < fileSize) && ((startOfLine >= 0) || (fileOffset < endOffset)))
+    {
+        LargeFileReaderCore::FileDataView view;
+        size_t viewLength = reader->acquireView(fileOffset, std::min((off_t)scanSliceSize, fileSize - fileOffset), view);
+        if ((viewLength == (size_t)-1) || (viewLength == 0))
+        {
+            return false;
+        }
+        viewData = view.data;
+
+        size_t numberOfDelimiters = LineDelimiterScanner::findDelimiters(view.data, viewLength, delimiterBytes[delimiterLength - 1], delimiterPositions.data());
+
+        for (size_t delimiterNumber = 0; (delimiterNumber < numberOfDelimiters) && !isDone; delimiterNumber++)
+        {
+            size_t positionOfLastByte = delimiterPositions[delimiterNumber];
+            off_t startOfDelimiter = fileOffset + positionOfLastByte + 1 - delimiterLength;
+            if (startOfDelimiter < earliestStartOfDelimiter)
+            {
+                continue;
+            }
+            if (positionOfLastByte >= (delimiterLength - 1))
+            {
+                if (memcmp(view.data + positionOfLastByte + 1 - delimiterLength, delimiterBytes, delimiterLength - 1) != 0)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                // The delimiter starts before the view.
+                size_t numberOfBytesBeforeView = delimiterLength - 1 - positionOfLastByte;
+                if ((memcmp(precedingBytes.data() + numberOfPrecedingBytes - numberOfBytesBeforeView, delimiterBytes, numberOfBytesBeforeView) != 0) ||
+                    (memcmp(view.data, delimiterBytes + numberOfBytesBeforeView, positionOfLastByte) != 0))
+                {
+                    continue;
+                }
+            }
+
+            if (startOfLine >= 0)
+            {
+                while ((startOfDelimiter - startOfLine) > (off_t)maximumLength)
+                {
+                    handlePiece();
+                }
+                handleLineUpTo(startOfDelimiter);
+            }
+
+            startOfLine = startOfDelimiter + delimiterLength;
+            earliestStartOfDelimiter = startOfLine;
+            lineBuffer.clear();
+            // The lines from here on are for the chunks after us.
+            isDone = (startOfLine >= endOffset);
+        }
+
+        off_t endOfView = fileOffset + viewLength;
+        if (!isDone && (startOfLine >= 0))
+        {
+            // Hand out the pieces that are complete. The last bytes of the view can be the start of a
+            // delimiter, which would end the line before them.
+            while ((endOfView - (off_t)(delimiterLength - 1) - startOfLine) > (off_t)maximumLength)
+            {
+                handlePiece();
+            }
+            // The line goes on in the next view.
+            off_t startOfLineInView = std::max(startOfLine, fileOffset);
+            lineBuffer.insert(lineBuffer.end(), view.data + (startOfLineInView - fileOffset), view.data + viewLength);
+        }
+
+        // Keep the last bytes for the next view, which can be in another cache block.
+        size_t numberOfBytesToKeep = delimiterLength - 1;
+        if (viewLength >= numberOfBytesToKeep)
+        {
+            memcpy(precedingBytes.data(), view.data + viewLength - numberOfBytesToKeep, numberOfBytesToKeep);
+            numberOfPrecedingBytes = numberOfBytesToKeep;
+        }
+        else
+        {
+            size_t numberOfBytesStillPreceding = std::min(numberOfPrecedingBytes, numberOfBytesToKeep - viewLength);
+            memmove(precedingBytes.data(), precedingBytes.data() + numberOfPrecedingBytes - numberOfBytesStillPreceding, numberOfBytesStillPreceding);
+            memcpy(precedingBytes.data() + numberOfBytesStillPreceding, view.data, viewLength);
+            numberOfPrecedingBytes = numberOfBytesStillPreceding + viewLength;
+        }
+
+        reader->releaseView(view);
+        viewData = NULL;
+
+        fileOffset = endOfView;
+    }
+
+    // The last line does not need to end with a delimiter. All of it is in lineBuffer now.
+    if (!isDone && (startOfLine >= 0) && (startOfLine < fileSize))
+    {
+        while ((fileSize - startOfLine) > (off_t)maximumLength)
+        {
+            handlePiece();
+        }
+        handleLineUpTo(fileSize);
+    }
+
+    return true;
+}
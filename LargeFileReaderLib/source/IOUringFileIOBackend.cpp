@@ -0,0 +1,332 @@
+//
+//  IOUringFileIOBackend.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include "IOUringFileIOBackend.hpp"
+
+#if LARGEFILEREADER_HAS_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+// We talk to the kernel directly instead of through liburing, so that there are no dependencies.
+
+static int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ringFileDescriptor, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFileDescriptor, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+IOUringFileIOBackend::IOUringFileIOBackend(unsigned queueDepth)
+{
+    this->queueDepth = queueDepth;
+}
+
+IOUringFileIOBackend::~IOUringFileIOBackend()
+{
+    detach();
+}
+
+bool IOUringFileIOBackend::attach(int fileDescriptor, size_t directIOAlignment)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ringFileDescriptor = ioUringSetup(queueDepth, &params);
+    if (ringFileDescriptor < 0)
+    {
+        return false;
+    }
+
+    numberOfSubmissionEntries = params.sq_entries;
+
+    submissionRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+    completionRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+
+    // Newer kernels map both rings with a single mmap.
+    bool isSingleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (isSingleMapping)
+    {
+        submissionRingSize = std::max(submissionRingSize, completionRingSize);
+        completionRingSize = submissionRingSize;
+    }
+
+    submissionRing = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_SQ_RING);
+    if (submissionRing == MAP_FAILED)
+    {
+        submissionRing = nullptr;
+        unmapRings();
+        return false;
+    }
+
+    if (isSingleMapping)
+    {
+        completionRing = submissionRing;
+    }
+    else
+    {
+        completionRing = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_CQ_RING);
+        if (completionRing == MAP_FAILED)
+        {
+            completionRing = nullptr;
+            unmapRings();
+            return false;
+        }
+    }
+
+    submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    submissionEntries = (io_uring_sqe*)mmap(nullptr, submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_SQES);
+    if (submissionEntries == MAP_FAILED)
+    {
+        submissionEntries = nullptr;
+        unmapRings();
+        return false;
+    }
+
+    unsigned char* submissionRingBytes = (unsigned char*)submissionRing;
+    submissionHead = (unsigned*)(submissionRingBytes + params.sq_off.head);
+    submissionTail = (unsigned*)(submissionRingBytes + params.sq_off.tail);
+    submissionRingMask = (unsigned*)(submissionRingBytes + params.sq_off.ring_mask);
+    submissionArray = (unsigned*)(submissionRingBytes + params.sq_off.array);
+
+    unsigned char* completionRingBytes = (unsigned char*)completionRing;
+    completionHead = (unsigned*)(completionRingBytes + params.cq_off.head);
+    completionTail = (unsigned*)(completionRingBytes + params.cq_off.tail);
+    completionRingMask = (unsigned*)(completionRingBytes + params.cq_off.ring_mask);
+    completionEntries = (io_uring_cqe*)(completionRingBytes + params.cq_off.cqes);
+
+    this->fileDescriptor = fileDescriptor;
+    this->directIOAlignment = directIOAlignment;
+    numberOfRequestsInFlight = 0;
+    isReaping = false;
+
+    return true;
+}
+
+void IOUringFileIOBackend::detach()
+{
+    // All requests have completed by now, readBlocks does not return before they have.
+    assert(numberOfRequestsInFlight == 0);
+
+    unmapRings();
+    fileDescriptor = -1;
+}
+
+void IOUringFileIOBackend::unmapRings()
+{
+    if (submissionEntries != nullptr)
+    {
+        munmap(submissionEntries, submissionEntriesSize);
+        submissionEntries = nullptr;
+    }
+    if ((completionRing != nullptr) && (completionRing != submissionRing))
+    {
+        munmap(completionRing, completionRingSize);
+    }
+    completionRing = nullptr;
+    if (submissionRing != nullptr)
+    {
+        munmap(submissionRing, submissionRingSize);
+        submissionRing = nullptr;
+    }
+    if (ringFileDescriptor >= 0)
+    {
+        ::close(ringFileDescriptor);
+        ringFileDescriptor = -1;
+    }
+}
+
+void IOUringFileIOBackend::readBlocks(BlockRequest* requests, size_t numberOfRequests)
+{
+    std::vector<InFlightRequest> inFlightRequests(numberOfRequests);
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        requests[requestNumber].bytesRead = 0;
+        inFlightRequests[requestNumber].request = &requests[requestNumber];
+        inFlightRequests[requestNumber].isComplete = false;
+    }
+
+    std::unique_lock<std::mutex> lock(ringMutex);
+
+    size_t numberOfRequestsSubmitted = 0;
+
+    while (true)
+    {
+        // Submit what we can. If the ring is full, we will get another chance after completions
+        // have been reaped.
+        if (numberOfRequestsSubmitted < numberOfRequests)
+        {
+            numberOfRequestsSubmitted += submitRequests(&inFlightRequests[numberOfRequestsSubmitted], numberOfRequests - numberOfRequestsSubmitted);
+        }
+
+        // While a reaper is waiting in the kernel, only it takes completions from the ring. If we took
+        // the one it is waiting for, it would wait forever.
+        if (!isReaping)
+        {
+            processCompletions();
+        }
+
+        size_t numberOfRequestsCompleted = 0;
+        for (size_t requestNumber = 0; requestNumber < numberOfRequestsSubmitted; requestNumber++)
+        {
+            if (inFlightRequests[requestNumber].isComplete)
+            {
+                numberOfRequestsCompleted++;
+            }
+        }
+        if (numberOfRequestsCompleted == numberOfRequests)
+        {
+            break;
+        }
+        if (numberOfRequestsInFlight == 0)
+        {
+            // Everything we submitted has already completed, but there is more to submit.
+            continue;
+        }
+
+        if (!isReaping)
+        {
+            // Become the reaper: wait in the kernel for at least one completion, without holding the lock.
+            isReaping = true;
+            lock.unlock();
+            ioUringEnter(ringFileDescriptor, 0, 1, IORING_ENTER_GETEVENTS);
+            lock.lock();
+            isReaping = false;
+
+            processCompletions();
+            ringCondition.notify_all();
+        }
+        else
+        {
+            // Someone else is reaping, it will wake us up.
+            ringCondition.wait(lock);
+        }
+    }
+
+    lock.unlock();
+
+    // Reads that failed (e.g. because the kernel does not know IORING_OP_READ) or that came back short
+    // are finished with pread. At the end of the file this costs one extra pread that returns 0.
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        BlockRequest& request = requests[requestNumber];
+        if (request.bytesRead < 0)
+        {
+            request.bytesRead = 0;
+        }
+        if ((size_t)request.bytesRead < request.length)
+        {
+            completeBlockRequest(request);
+        }
+    }
+}
+
+size_t IOUringFileIOBackend::submitRequests(InFlightRequest* inFlightRequests, size_t numberOfRequests)
+{
+    unsigned tail = *submissionTail;
+    unsigned head = __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE);
+
+    size_t numberOfRequestsQueued = 0;
+
+    while ((numberOfRequestsQueued < numberOfRequests) &&
+           ((numberOfRequestsInFlight + numberOfRequestsQueued) < numberOfSubmissionEntries) &&
+           ((tail - head) < numberOfSubmissionEntries))
+    {
+        BlockRequest* request = inFlightRequests[numberOfRequestsQueued].request;
+
+        unsigned index = tail & *submissionRingMask;
+        io_uring_sqe* submissionEntry = &submissionEntries[index];
+        memset(submissionEntry, 0, sizeof(io_uring_sqe));
+        submissionEntry->opcode = IORING_OP_READ;
+        submissionEntry->fd = fileDescriptor;
+        submissionEntry->off = request->fileOffset;
+        submissionEntry->addr = (uint64_t)request->buffer;
+        submissionEntry->len = (uint32_t)request->length;
+        submissionEntry->user_data = (uint64_t)&inFlightRequests[numberOfRequestsQueued];
+
+        submissionArray[index] = index;
+        tail++;
+        numberOfRequestsQueued++;
+    }
+
+    if (numberOfRequestsQueued == 0)
+    {
+        return 0;
+    }
+
+    // Make the entries visible to the kernel before we tell it about them.
+    __atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+    numberOfRequestsInFlight += numberOfRequestsQueued;
+
+    // One system call for the whole batch. Without SQPOLL the kernel consumes all entries, unless it is
+    // temporarily out of resources, in which case we try again.
+    size_t numberOfRequestsToSubmit = numberOfRequestsQueued;
+    while (numberOfRequestsToSubmit > 0)
+    {
+        int result = ioUringEnter(ringFileDescriptor, (unsigned)numberOfRequestsToSubmit, 0, 0);
+        if (result < 0)
+        {
+            if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+            {
+                sched_yield();
+                continue;
+            }
+
+            // Anything else (EFAULT, EBADF, ENOMEM, ...) will not get better by trying again. The kernel
+            // consumes entries in order, and only when we enter it, so the ones it did not take are the
+            // last ones we queued: take them back, so they are never submitted and never waited for, and
+            // fail them. readBlocks then reads them with pread.
+            tail -= (unsigned)numberOfRequestsToSubmit;
+            __atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+            numberOfRequestsInFlight -= (unsigned)numberOfRequestsToSubmit;
+            for (size_t requestNumber = numberOfRequestsQueued - numberOfRequestsToSubmit; requestNumber < numberOfRequestsQueued; requestNumber++)
+            {
+                inFlightRequests[requestNumber].request->bytesRead = -1;
+                inFlightRequests[requestNumber].isComplete = true;
+            }
+            break;
+        }
+        numberOfRequestsToSubmit -= result;
+    }
+
+    // Requests that could not be submitted are complete (and failed), so they count as handled too.
+    return numberOfRequestsQueued;
+}
+
+void IOUringFileIOBackend::processCompletions()
+{
+    unsigned head = *completionHead;
+    unsigned tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        io_uring_cqe* completionEntry = &completionEntries[head & *completionRingMask];
+
+        InFlightRequest* inFlightRequest = (InFlightRequest*)completionEntry->user_data;
+        inFlightRequest->request->bytesRead = (completionEntry->res < 0) ? -1 : completionEntry->res;
+        inFlightRequest->isComplete = true;
+
+        head++;
+        numberOfRequestsInFlight--;
+    }
+
+    // Give the entries back to the kernel.
+    __atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+}
+
+#endif /* LARGEFILEREADER_HAS_IO_URING */
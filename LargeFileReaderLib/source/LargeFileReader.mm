@@ -7,11 +7,290 @@
 
 #import <Foundation/Foundation.h>
 #import "LargeFileReader.h"
+#import "LargeFileReader_Private.h"
 #import "LargeFileReaderCore.hpp"
 
-@interface LargeFileReader()
+@interface LargeFileReaderStatistics()
+{
+    CacheStatistics::Snapshot snapshot;
+}
+
+- (instancetype)initWithSnapshot:(const CacheStatistics::Snapshot&)snapshot;
+
+@end
+
+@implementation LargeFileReaderStatistics
+
+- (instancetype)initWithSnapshot:(const CacheStatistics::Snapshot&)snapshot
+{
+    self = [super init];
+    
+    if (self)
+    {
+        self->snapshot = snapshot;
+    }
+    
+    return self;
+}
+
+- (NSInteger)numberOfHits
+{
+    return snapshot.numberOfHits;
+}
+
+- (NSInteger)numberOfMisses
+{
+    return snapshot.numberOfMisses;
+}
+
+- (NSInteger)numberOfEvictions
+{
+    return snapshot.numberOfEvictions;
+}
+
+- (NSInteger)numberOfReadAheadBlocks
+{
+    return snapshot.numberOfReadAheadBlocks;
+}
+
+- (NSInteger)numberOfFetches
+{
+    return snapshot.numberOfFetches;
+}
+
+- (NSInteger)numberOfFetchedBlocks
+{
+    return snapshot.numberOfFetchedBlocks;
+}
+
+- (NSInteger)numberOfFetchErrors
+{
+    return snapshot.numberOfFetchErrors;
+}
+
+- (NSInteger)bytesReadFromFile
+{
+    return snapshot.bytesReadFromFile;
+}
+
+- (NSInteger)bytesServedFromCache
+{
+    return snapshot.bytesServedFromCache;
+}
+
+- (NSInteger)bytesBypassingCache
+{
+    return snapshot.bytesBypassingCache;
+}
+
+- (NSArray<NSNumber *> *)fetchLatencyHistogram
+{
+    NSMutableArray<NSNumber *> *histogram = [NSMutableArray arrayWithCapacity:CacheStatistics::numberOfLatencyBuckets];
+    for (int bucket = 0; bucket < CacheStatistics::numberOfLatencyBuckets; bucket++)
+    {
+        [histogram addObject:@(snapshot.fetchLatencyHistogram[bucket])];
+    }
+    return histogram;
+}
+
+- (NSInteger)numberOfCachedBlocks
+{
+    return snapshot.numberOfCachedBlocks;
+}
+
+- (NSInteger)workingSetSize
+{
+    return snapshot.workingSetSize;
+}
+
+- (double)hitRate
+{
+    return snapshot.hitRate();
+}
+
+- (double)meanFetchLatency
+{
+    return snapshot.meanFetchLatency();
+}
+
+- (NSInteger)fetchLatencyPercentile:(double)percentile
+{
+    return snapshot.fetchLatencyPercentile(percentile);
+}
+
+@end
+
+static CacheMemoryAllocator::PageType pageTypeForCachePageType(LargeFileReaderCachePageType cachePageType)
+{
+    switch (cachePageType)
+    {
+        case LargeFileReaderCachePageTypeTransparentHuge:
+            return CacheMemoryAllocator::PageTypeTransparentHuge;
+        case LargeFileReaderCachePageTypeHuge2MB:
+            return CacheMemoryAllocator::PageTypeHuge2MB;
+        case LargeFileReaderCachePageTypeHuge1GB:
+            return CacheMemoryAllocator::PageTypeHuge1GB;
+        case LargeFileReaderCachePageTypeDefault:
+        default:
+            return CacheMemoryAllocator::PageTypeDefault;
+    }
+}
+
+static LargeFileReaderCachePageType cachePageTypeForPageType(CacheMemoryAllocator::PageType pageType)
+{
+    switch (pageType)
+    {
+        case CacheMemoryAllocator::PageTypeTransparentHuge:
+            return LargeFileReaderCachePageTypeTransparentHuge;
+        case CacheMemoryAllocator::PageTypeHuge2MB:
+            return LargeFileReaderCachePageTypeHuge2MB;
+        case CacheMemoryAllocator::PageTypeHuge1GB:
+            return LargeFileReaderCachePageTypeHuge1GB;
+        case CacheMemoryAllocator::PageTypeDefault:
+        default:
+            return LargeFileReaderCachePageTypeDefault;
+    }
+}
+
+static CacheMemoryAllocator::NumaPolicyType numaPolicyTypeForNumaPolicy(LargeFileReaderNumaPolicy numaPolicy)
+{
+    switch (numaPolicy)
+    {
+        case LargeFileReaderNumaPolicyBind:
+            return CacheMemoryAllocator::NumaPolicyTypeBind;
+        case LargeFileReaderNumaPolicyInterleave:
+            return CacheMemoryAllocator::NumaPolicyTypeInterleave;
+        case LargeFileReaderNumaPolicyDefault:
+        default:
+            return CacheMemoryAllocator::NumaPolicyTypeDefault;
+    }
+}
+
+static LargeFileReaderNumaPolicy numaPolicyForNumaPolicyType(CacheMemoryAllocator::NumaPolicyType numaPolicyType)
+{
+    switch (numaPolicyType)
+    {
+        case CacheMemoryAllocator::NumaPolicyTypeBind:
+            return LargeFileReaderNumaPolicyBind;
+        case CacheMemoryAllocator::NumaPolicyTypeInterleave:
+            return LargeFileReaderNumaPolicyInterleave;
+        case CacheMemoryAllocator::NumaPolicyTypeDefault:
+        default:
+            return LargeFileReaderNumaPolicyDefault;
+    }
+}
+
+@interface LargeFileReaderSharedCache()
+{
+    SharedBlockCache *sharedBlockCache;
+}
+
+@property (nonatomic, readonly) SharedBlockCache *sharedBlockCache;
+
+@end
+
+@implementation LargeFileReaderSharedCache
+
+- (instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize
+{
+    return [self initWithCacheMaxSize:cacheMaxSize cacheBlockSize:cacheBlockSize cacheEvictionPolicy:LargeFileReaderCacheEvictionPolicyLRU];
+}
+
+- (instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize cacheEvictionPolicy:(LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy
+{
+    return [self initWithCacheMaxSize:cacheMaxSize cacheBlockSize:cacheBlockSize cacheEvictionPolicy:cacheEvictionPolicy
+                        cachePageType:LargeFileReaderCachePageTypeDefault numaPolicy:LargeFileReaderNumaPolicyDefault numaNodeMask:0];
+}
+
+- (instancetype)initWithCacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize cacheEvictionPolicy:(LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy
+                       cachePageType:(LargeFileReaderCachePageType)cachePageType numaPolicy:(LargeFileReaderNumaPolicy)numaPolicy numaNodeMask:(NSUInteger)numaNodeMask
+{
+    self = [super init];
+    
+    if (self)
+    {
+        if ((cacheMaxSize <= 0) || (cacheBlockSize <= 0))
+        {
+            return nil;
+        }
+        
+        CacheEvictionPolicy::PolicyType policyType;
+        switch (cacheEvictionPolicy)
+        {
+            case LargeFileReaderCacheEvictionPolicyCLOCK:
+                policyType = CacheEvictionPolicy::PolicyTypeCLOCK;
+                break;
+            case LargeFileReaderCacheEvictionPolicyTwoQueue:
+                policyType = CacheEvictionPolicy::PolicyType2Q;
+                break;
+            case LargeFileReaderCacheEvictionPolicyLRU:
+            default:
+                policyType = CacheEvictionPolicy::PolicyTypeLRU;
+                break;
+        }
+        
+        try
+        {
+            CacheMemoryAllocator memoryAllocator;
+            memoryAllocator.pageType = pageTypeForCachePageType(cachePageType);
+            memoryAllocator.numaPolicyType = numaPolicyTypeForNumaPolicy(numaPolicy);
+            memoryAllocator.numaNodeMask = numaNodeMask;
+            sharedBlockCache = new SharedBlockCache(cacheMaxSize, cacheBlockSize, policyType, 0, false, memoryAllocator);
+        }
+        catch (const std::exception& exception)
+        {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    // Readers keep us alive while they have a file open, so no file is attached anymore.
+    delete sharedBlockCache;
+    sharedBlockCache = nil;
+}
+
+- (SharedBlockCache *)sharedBlockCache
+{
+    return sharedBlockCache;
+}
+
+- (NSInteger)cacheBlockSize
+{
+    return sharedBlockCache->cacheBlockSize;
+}
+
+- (NSInteger)cacheActualSize
+{
+    return sharedBlockCache->cacheActualSize;
+}
+
+- (NSInteger)numberOfAttachedFiles
+{
+    return sharedBlockCache->numberOfAttachedFiles();
+}
+
+- (NSInteger)numberOfCachedBlocks
+{
+    return sharedBlockCache->numberOfCachedBlocks();
+}
+
+- (LargeFileReaderCachePageType)cacheActualPageType
+{
+    return cachePageTypeForPageType(sharedBlockCache->cacheBlocksPageType());
+}
+
+@end
 
-@property (nonatomic, assign) LargeFileReaderCore *largeFileReaderCore;
+@interface LargeFileReader()
+{
+    // The shared cache that the open file is read through. Keeps it alive until the file is closed,
+    // even if sharedCache is changed in the meantime.
+    LargeFileReaderSharedCache *openFileSharedCache;
+}
 
 @end
 
@@ -31,6 +310,8 @@
 
 - (void)dealloc
 {
+    // Deleting the core closes the file and stops its read-ahead thread.
+    delete _largeFileReaderCore;
     _largeFileReaderCore = nil;
 }
 
@@ -59,6 +340,189 @@
     return self.largeFileReaderCore->cacheActualSize;
 }
 
+- (LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy
+{
+    switch (self.largeFileReaderCore->cacheEvictionPolicyType)
+    {
+        case CacheEvictionPolicy::PolicyTypeCLOCK:
+            return LargeFileReaderCacheEvictionPolicyCLOCK;
+        case CacheEvictionPolicy::PolicyType2Q:
+            return LargeFileReaderCacheEvictionPolicyTwoQueue;
+        case CacheEvictionPolicy::PolicyTypeLRU:
+        default:
+            return LargeFileReaderCacheEvictionPolicyLRU;
+    }
+}
+
+- (void)setCacheEvictionPolicy:(LargeFileReaderCacheEvictionPolicy)cacheEvictionPolicy
+{
+    switch (cacheEvictionPolicy)
+    {
+        case LargeFileReaderCacheEvictionPolicyCLOCK:
+            self.largeFileReaderCore->cacheEvictionPolicyType = CacheEvictionPolicy::PolicyTypeCLOCK;
+            break;
+        case LargeFileReaderCacheEvictionPolicyTwoQueue:
+            self.largeFileReaderCore->cacheEvictionPolicyType = CacheEvictionPolicy::PolicyType2Q;
+            break;
+        case LargeFileReaderCacheEvictionPolicyLRU:
+        default:
+            self.largeFileReaderCore->cacheEvictionPolicyType = CacheEvictionPolicy::PolicyTypeLRU;
+            break;
+    }
+}
+
+- (LargeFileReaderCachePageType)cachePageType
+{
+    return cachePageTypeForPageType(self.largeFileReaderCore->cacheMemoryAllocator.pageType);
+}
+
+- (void)setCachePageType:(LargeFileReaderCachePageType)cachePageType
+{
+    self.largeFileReaderCore->cacheMemoryAllocator.pageType = pageTypeForCachePageType(cachePageType);
+}
+
+- (LargeFileReaderNumaPolicy)cacheNumaPolicy
+{
+    return numaPolicyForNumaPolicyType(self.largeFileReaderCore->cacheMemoryAllocator.numaPolicyType);
+}
+
+- (void)setCacheNumaPolicy:(LargeFileReaderNumaPolicy)cacheNumaPolicy
+{
+    self.largeFileReaderCore->cacheMemoryAllocator.numaPolicyType = numaPolicyTypeForNumaPolicy(cacheNumaPolicy);
+}
+
+- (NSUInteger)cacheNumaNodeMask
+{
+    return (NSUInteger)self.largeFileReaderCore->cacheMemoryAllocator.numaNodeMask;
+}
+
+- (void)setCacheNumaNodeMask:(NSUInteger)cacheNumaNodeMask
+{
+    self.largeFileReaderCore->cacheMemoryAllocator.numaNodeMask = cacheNumaNodeMask;
+}
+
+- (LargeFileReaderCachePageType)cacheActualPageType
+{
+    return cachePageTypeForPageType(self.largeFileReaderCore->cacheActualPageType);
+}
+
+- (void)setSharedCache:(LargeFileReaderSharedCache *)sharedCache
+{
+    _sharedCache = sharedCache;
+    self.largeFileReaderCore->sharedBlockCache = sharedCache.sharedBlockCache;
+}
+
+- (BOOL)isSharingCache
+{
+    return self.largeFileReaderCore->isSharingCache;
+}
+
+- (BOOL)readAheadEnabled
+{
+    return self.largeFileReaderCore->readAheadEnabled;
+}
+
+- (void)setReadAheadEnabled:(BOOL)readAheadEnabled
+{
+    self.largeFileReaderCore->readAheadEnabled = readAheadEnabled;
+}
+
+- (NSInteger)largeReadBypassThreshold
+{
+    return self.largeFileReaderCore->largeReadBypassThreshold;
+}
+
+- (void)setLargeReadBypassThreshold:(NSInteger)largeReadBypassThreshold
+{
+    self.largeFileReaderCore->largeReadBypassThreshold = (largeReadBypassThreshold > 0) ? largeReadBypassThreshold : 0;
+}
+
+- (LargeFileReaderIOBackend)ioBackend
+{
+    switch (self.largeFileReaderCore->ioBackendType)
+    {
+        case FileIOBackend::BackendTypeIOUring:
+            return LargeFileReaderIOBackendIOUring;
+        case FileIOBackend::BackendTypePosix:
+        default:
+            return LargeFileReaderIOBackendPosix;
+    }
+}
+
+- (void)setIoBackend:(LargeFileReaderIOBackend)ioBackend
+{
+    switch (ioBackend)
+    {
+        case LargeFileReaderIOBackendIOUring:
+            self.largeFileReaderCore->ioBackendType = FileIOBackend::BackendTypeIOUring;
+            break;
+        case LargeFileReaderIOBackendPosix:
+        default:
+            self.largeFileReaderCore->ioBackendType = FileIOBackend::BackendTypePosix;
+            break;
+    }
+}
+
+- (BOOL)directIOEnabled
+{
+    return self.largeFileReaderCore->directIOEnabled;
+}
+
+- (void)setDirectIOEnabled:(BOOL)directIOEnabled
+{
+    self.largeFileReaderCore->directIOEnabled = directIOEnabled;
+}
+
+- (BOOL)isDirectIO
+{
+    return self.largeFileReaderCore->isDirectIO;
+}
+
+- (BOOL)memoryMappingEnabled
+{
+    return self.largeFileReaderCore->memoryMappingEnabled;
+}
+
+- (void)setMemoryMappingEnabled:(BOOL)memoryMappingEnabled
+{
+    self.largeFileReaderCore->memoryMappingEnabled = memoryMappingEnabled;
+}
+
+- (BOOL)isMemoryMapped
+{
+    return self.largeFileReaderCore->isMemoryMapped;
+}
+
+- (BOOL)followEnabled
+{
+    return self.largeFileReaderCore->followEnabled;
+}
+
+- (void)setFollowEnabled:(BOOL)followEnabled
+{
+    self.largeFileReaderCore->followEnabled = followEnabled;
+}
+
+- (BOOL)isFollowing
+{
+    return self.largeFileReaderCore->isFollowing;
+}
+
+- (BOOL)decompressionEnabled
+{
+    return self.largeFileReaderCore->decompressionEnabled;
+}
+
+- (void)setDecompressionEnabled:(BOOL)decompressionEnabled
+{
+    self.largeFileReaderCore->decompressionEnabled = decompressionEnabled;
+}
+
+- (BOOL)isCompressed
+{
+    return self.largeFileReaderCore->isCompressed;
+}
+
 - (BOOL)isOpen
 {
     return self.largeFileReaderCore->isOpen;
@@ -81,17 +545,33 @@
 
 - (BOOL)open:(NSString *)fullFilePath;
 {
-    return self.largeFileReaderCore->open([fullFilePath cStringUsingEncoding:NSASCIIStringEncoding]);
+    return [self open:fullFilePath cacheMaxSize:0 cacheBlockSize:0];
 }
 
 - (BOOL)open:(NSString *)fullFilePath cacheMaxSize:(NSInteger)cacheMaxSize cacheBlockSize:(NSInteger)cacheBlockSize
 {
-    return self.largeFileReaderCore->open([fullFilePath cStringUsingEncoding:NSASCIIStringEncoding], cacheMaxSize, cacheBlockSize);
+    BOOL isOpened = self.largeFileReaderCore->open([fullFilePath cStringUsingEncoding:NSASCIIStringEncoding], cacheMaxSize, cacheBlockSize);
+    if (isOpened && self.largeFileReaderCore->isSharingCache)
+    {
+        openFileSharedCache = self.sharedCache;
+    }
+    return isOpened;
 }
 
 - (void)close
 {
     self.largeFileReaderCore->close();
+    openFileSharedCache = nil;
+}
+
+- (NSInteger)fileSize
+{
+    return self.largeFileReaderCore->fileSize();
+}
+
+- (NSInteger)refreshFileSize
+{
+    return self.largeFileReaderCore->refreshFileSize();
 }
 
 - (NSInteger)lseek:(NSInteger)offsetInBytes whence:(NSInteger)whence
@@ -104,4 +584,77 @@
     return self.largeFileReaderCore->read(buffer, numberOfBytes);
 }
 
+- (NSInteger)readAt:(NSInteger)offsetInBytes buffer:(unsigned char *)buffer bytes:(NSInteger)numberOfBytes
+{
+    return self.largeFileReaderCore->readAt(offsetInBytes, buffer, numberOfBytes);
+}
+
+- (NSInteger)readRanges:(LargeFileReaderReadRange *)ranges count:(NSInteger)numberOfRanges
+{
+    if (numberOfRanges <= 0)
+    {
+        return 0;
+    }
+    
+    std::vector<LargeFileReaderCore::ReadRequest> requests(numberOfRanges);
+    for (NSInteger rangeNumber = 0; rangeNumber < numberOfRanges; rangeNumber++)
+    {
+        requests[rangeNumber].fileOffset = ranges[rangeNumber].fileOffset;
+        requests[rangeNumber].buffer = ranges[rangeNumber].buffer;
+        // A negative length reads nothing.
+        requests[rangeNumber].length = (ranges[rangeNumber].length > 0) ? (size_t)ranges[rangeNumber].length : 0;
+    }
+    
+    NSInteger totalBytesRead = self.largeFileReaderCore->readRanges(requests.data(), requests.size());
+    
+    for (NSInteger rangeNumber = 0; rangeNumber < numberOfRanges; rangeNumber++)
+    {
+        ranges[rangeNumber].bytesRead = requests[rangeNumber].bytesRead;
+    }
+    return totalBytesRead;
+}
+
+- (void)readAsyncAt:(NSInteger)offsetInBytes buffer:(unsigned char *)buffer bytes:(NSInteger)numberOfBytes completionHandler:(void (^)(NSInteger bytesRead))completionHandler
+{
+    // The completion keeps us (and the core) alive until the read is done.
+    LargeFileReader *reader = self;
+    self.largeFileReaderCore->readAtAsync(offsetInBytes, buffer, numberOfBytes, [reader, completionHandler](size_t bytesRead) {
+        completionHandler(bytesRead);
+        (void)reader;
+    });
+}
+
+- (NSData *)viewAt:(NSInteger)offsetInBytes maxBytes:(NSInteger)maximumNumberOfBytes
+{
+    LargeFileReaderCore::FileDataView view;
+    size_t length = self.largeFileReaderCore->acquireView(offsetInBytes, maximumNumberOfBytes, view);
+    if (length == (size_t)-1)
+    {
+        return nil;
+    }
+    if (length == 0)
+    {
+        return [NSData data];
+    }
+    
+    // The block is unpinned when the data goes away. The deallocator keeps us (and the core) alive
+    // until then.
+    return [[NSData alloc] initWithBytesNoCopy:(void *)view.data length:view.length deallocator:^(void *bytes, NSUInteger length) {
+        LargeFileReaderCore::FileDataView releasedView = view;
+        self.largeFileReaderCore->releaseView(releasedView);
+    }];
+}
+
+- (LargeFileReaderStatistics *)statistics
+{
+    CacheStatistics::Snapshot snapshot;
+    self.largeFileReaderCore->statisticsSnapshot(snapshot);
+    return [[LargeFileReaderStatistics alloc] initWithSnapshot:snapshot];
+}
+
+- (void)resetStatistics
+{
+    self.largeFileReaderCore->resetStatistics();
+}
+
 @end
@@ -9,8 +9,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <new>
+#include <algorithm>
+#include <chrono>
 
 #include "LargeFileReaderCore.hpp"
 
@@ -20,11 +28,23 @@ LargeFileReaderCore::LargeFileReaderCore()
     isEof = false;
     isFail = false;
     isBad = false;
+    isDirectIO = false;
+    isMemoryMapped = false;
+    isFollowing = false;
+    isCompressed = false;
+    isSharingCache = false;
+    cacheActualPageType = CacheMemoryAllocator::PageTypeDefault;
+    compressionType = CompressedFileIOBackend::CompressionTypeNone;
+    blockCache = NULL;
+    blockCacheFileNumber = -1;
+    currentFileSize = 0;
+    totalNumberOfFileCacheIndexEntries = 0;
+    memoryMappingAdvice = MADV_NORMAL;
 }
 
 LargeFileReaderCore::~LargeFileReaderCore()
 {
-    
+    close();
 }
 
 bool LargeFileReaderCore::open(std::string fullFilePath)
@@ -46,65 +66,206 @@ bool LargeFileReaderCore::open(std::string fullFilePath, size_t cacheMaxSize, si
         return false;
     }
     
+    // A shared cache holds data that was read into it, it has no windows to map the file into.
+    isSharingCache = (sharedBlockCache != NULL);
+    if (isSharingCache && sharedBlockCache->isMappingAddressSpace)
+    {
+        return false;
+    }
+    
+    isMemoryMapped = memoryMappingEnabled && !isSharingCache;
+    isFollowing = followEnabled;
+    isCompressed = false;
+    compressionType = CompressedFileIOBackend::CompressionTypeNone;
+    
+    // A compressed file is decompressed by its backend, the cache only sees the decompressed data. It
+    // can't be mapped (the file does not hold the data), and it is read through the page cache, as
+    // decompressing reads every compressed byte once. A file that only looks compressed, but can't be
+    // decompressed, is read as it is.
+    CompressedFileIOBackend* compressedFileIOBackend = NULL;
+    if (decompressionEnabled)
+    {
+        int compressedFileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+        if (compressedFileDescriptor >= 0)
+        {
+            CompressedFileIOBackend::CompressionType detectedCompressionType = CompressedFileIOBackend::compressionTypeForFile(compressedFileDescriptor);
+            if (detectedCompressionType != CompressedFileIOBackend::CompressionTypeNone)
+            {
+                compressedFileIOBackend = CompressedFileIOBackend::createBackendForFile(detectedCompressionType, compressedFileDescriptor);
+            }
+            if (compressedFileIOBackend != NULL)
+            {
+                fileDescriptor = compressedFileDescriptor;
+                compressionType = detectedCompressionType;
+                isCompressed = true;
+                isMemoryMapped = false;
+                isFollowing = false;
+            }
+            else
+            {
+                ::close(compressedFileDescriptor);
+            }
+        }
+    }
+    
+    if (isSharingCache)
+    {
+        // The shared cache decides.
+        cacheMaxSize = sharedBlockCache->cacheActualSize;
+        cacheBlockSize = sharedBlockCache->cacheBlockSize;
+    }
     if (cacheMaxSize <= 0)
     {
-        cacheMaxSize = cacheDefaultMaxSize;
+        cacheMaxSize = isMemoryMapped ? mappingDefaultMaxSize : cacheDefaultMaxSize;
     }
     if (cacheBlockSize <= 0)
     {
-        cacheBlockSize = cacheDefaultBlockSize;
+        cacheBlockSize = isMemoryMapped ? std::min((size_t)mappingDefaultWindowSize, cacheMaxSize) : cacheDefaultBlockSize;
+    }
+    
+    // Windows can only be mapped at page boundaries.
+    if (isMemoryMapped)
+    {
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        cacheBlockSize = ((cacheBlockSize + pageSize - 1) / pageSize) * pageSize;
+    }
+
+    // Direct I/O requires aligned file offsets, so every block must start at a multiple of the
+    // alignment.
+    isDirectIO = false;
+    directIOAlignment = 0;
+    if (directIOEnabled && !isMemoryMapped && !isCompressed && queryDirectIOAlignmentForFile(filePath, directIOAlignment))
+    {
+        isDirectIO = true;
+        if (isSharingCache)
+        {
+            // We can't change the blocks of a shared cache, they must be aligned already.
+            isDirectIO = (directIOAlignment == 0) ||
+                         (((cacheBlockSize % directIOAlignment) == 0) && (((uintptr_t)sharedBlockCache->cacheBlocks % directIOAlignment) == 0));
+        }
+        else if (directIOAlignment != 0)
+        {
+            cacheBlockSize = ((cacheBlockSize + directIOAlignment - 1) / directIOAlignment) * directIOAlignment;
+        }
+        if (!isDirectIO)
+        {
+            directIOAlignment = 0;
+        }
     }
 
     if (cacheBlockSize > cacheMaxSize)
     {
+        if (isCompressed)
+        {
+            delete compressedFileIOBackend;
+            ::close(fileDescriptor);
+            isCompressed = false;
+        }
         throw std::out_of_range("Cache block size must be less than cache max size");
     }
 
     this->cacheMaxSize = cacheMaxSize;
     this->cacheBlockSize = cacheBlockSize;
 
-    // Calculate size of cache, number of blocks, etc.
+    // Open the file, unless it is already open for decompressing.
     
-    // If file size is less than cacheMaxSize, then it makes no sense to waste memory,
-    // make the cache size less in that case.
-    if (fileStatus.st_size < cacheMaxSize)
+    // The size of the data that we cache: the size of the file, or what it decompresses to.
+    off_t dataSize = fileStatus.st_size;
+    if (isCompressed)
     {
-        // Actual size will be a multiple of cacheBlockSize, so that the whole file can fit.
-        // Probably wasting a little memory due to aliasing, but who cares in this case.
-        cacheActualSize = (size_t)ceil((double)fileStatus.st_size / (double)cacheBlockSize) * cacheBlockSize;
+        fileIOBackend = compressedFileIOBackend;
+        dataSize = compressedFileIOBackend->uncompressedSize();
     }
     else
     {
-        // Actual size will be the maximum requested size. Aliasing (and small memory waste)
-        // will happen if user did not request a multiple of cacheBlockSize.
-        cacheActualSize = cacheMaxSize;
+        int openFlags = O_RDONLY;
+#ifdef O_DIRECT
+        if (isDirectIO)
+        {
+            openFlags |= O_DIRECT;
+        }
+#endif
+        fileDescriptor = ::open(filePath.c_str(), openFlags);
+        if ((fileDescriptor < 0) && isDirectIO && (errno == EINVAL))
+        {
+            // The file system does not do direct I/O after all, read the file normally.
+            isDirectIO = false;
+            directIOAlignment = 0;
+            fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+        }
+        if (fileDescriptor < 0)
+        {
+            return false;
+        }
+#if defined(F_NOCACHE) && !defined(O_DIRECT)
+        if (isDirectIO && (fcntl(fileDescriptor, F_NOCACHE, 1) != 0))
+        {
+            isDirectIO = false;
+        }
+#endif
+        
+        fileIOBackend = isMemoryMapped ? NULL : FileIOBackend::createBackendForFile(ioBackendType, fileDescriptor, directIOAlignment);
     }
-    // Maximum number of file data blocks that we can actually store.
-    maxNumberOfCachedFileDataBlocks = (int64_t)floor((double)cacheActualSize / (double)cacheBlockSize);
-    // Number of datablocks necessary to fit the whole file (the number of indexes in the file cache).
-    totalNumberOfFileCacheIndexEntries = (size_t)ceil((double)fileStatus.st_size / (double)cacheBlockSize);
-    
-    // Currently, we have cached nothing.
-    currentNumberOfCachedFileDataBlocks = 0;
 
-    // Allocate memory.
-    
-    fileDataBlocks = new unsigned char[cacheActualSize];
-    fileCacheIndex = new FileCacheIndexEntry[totalNumberOfFileCacheIndexEntries];
+    // Number of datablocks necessary to fit the whole file (the number of possible indexes in the file cache).
+    totalNumberOfFileCacheIndexEntries = (dataSize + cacheBlockSize - 1) / cacheBlockSize;
     
-    mostRecentlyUsedIndex = -1;
-    leastRecentlyUsedIndex = -1;
-    
-    // Open the file.
-    
-    if ((fileDescriptor = ::open(filePath.c_str(), O_RDONLY)) < 0)
+    if (isSharingCache)
     {
-        delete [] fileDataBlocks;
-        delete [] fileCacheIndex;
-        return false;
+        // The blocks of the file are keyed by the file number in the shared cache, which leaves room
+        // for a limited number of blocks per file.
+        blockCache = sharedBlockCache;
+        blockCacheFileNumber = (totalNumberOfFileCacheIndexEntries < ((int64_t)1 << SharedBlockCache::fileNumberShift)) ? blockCache->attachFile() : -1;
+        if (blockCacheFileNumber == -1)
+        {
+            delete fileIOBackend;
+            fileIOBackend = NULL;
+            ::close(fileDescriptor);
+            blockCache = NULL;
+            isSharingCache = false;
+            isCompressed = false;
+            return false;
+        }
+        cacheActualSize = blockCache->cacheActualSize;
+    }
+    else
+    {
+        // Calculate size of cache, number of blocks, etc.
+        
+        // If file size is less than cacheMaxSize, then it makes no sense to waste memory,
+        // make the cache size less in that case. Unless we follow the file, then it will grow.
+        if (!isFollowing && (dataSize < cacheMaxSize))
+        {
+            // Actual size will be a multiple of cacheBlockSize, so that the whole file can fit.
+            // Probably wasting a little memory due to aliasing, but who cares in this case.
+            cacheActualSize = (size_t)ceil((double)dataSize / (double)cacheBlockSize) * cacheBlockSize;
+        }
+        else
+        {
+            // Actual size will be the maximum requested size. Aliasing will happen if user did not
+            // request a multiple of cacheBlockSize, the cache then only uses the whole blocks.
+            cacheActualSize = cacheMaxSize;
+        }
+        
+        // Allocate memory, in a cache of our own that only we attach to. Everything is sized by the
+        // number of blocks in the cache, not by the size of the file, so opening a huge file costs no
+        // more than opening a small one.
+        blockCache = new SharedBlockCache(cacheActualSize, cacheBlockSize, cacheEvictionPolicyType, directIOAlignment, isMemoryMapped, cacheMemoryAllocator);
+        blockCacheFileNumber = blockCache->attachFile();
     }
     
+    cacheActualPageType = blockCache->cacheBlocksPageType();
+    maximumFetchBatchBlocks = std::max((int64_t)1, std::min((int64_t)64, blockCache->maxNumberOfCachedBlocks / 2));
+    
     currentFileOffset = 0;
+    currentFileSize = dataSize;
+    
+    readAheadExpectedFileOffset = -1;
+    readAheadWindow = 0;
+    readAheadLastQueuedIndex = -1;
+    memoryMappingAdvice = MADV_NORMAL;
+    
+    cacheStatistics.reset();
     
     isOpen = true;
     isEof = false;
@@ -121,17 +282,212 @@ void LargeFileReaderCore::close()
         return;
     }
     
+    // Asynchronous reads use the file and the cache too, wait until they are done.
+    {
+        std::unique_lock<std::mutex> lock(asyncReadMutex);
+        asyncReadCondition.wait(lock, [this] { return numberOfAsyncReadsInFlight == 0; });
+    }
+    
+    // The read-ahead thread uses the cache, so stop it before we take the cache away.
+    stopReadAhead();
+    
+    delete fileIOBackend;
+    fileIOBackend = NULL;
     ::close(fileDescriptor);
     
-    delete [] fileDataBlocks;
-    fileDataBlocks = NULL;
-    delete [] fileCacheIndex;
-    fileCacheIndex = NULL;
+    // Give our blocks back. A cache of our own goes away with them (and unmaps all windows, when the
+    // file is memory mapped).
+    blockCache->detachFile(blockCacheFileNumber);
+    if (!isSharingCache)
+    {
+        delete blockCache;
+    }
+    blockCache = NULL;
+    blockCacheFileNumber = -1;
     
     isOpen = false;
     isEof = false;
     isFail = false;
     isBad = false;
+    isDirectIO = false;
+    isMemoryMapped = false;
+    isFollowing = false;
+    isCompressed = false;
+    isSharingCache = false;
+    cacheActualPageType = CacheMemoryAllocator::PageTypeDefault;
+    compressionType = CompressedFileIOBackend::CompressionTypeNone;
+}
+
+bool LargeFileReaderCore::queryDirectIOAlignmentForFile(const std::string& fullFilePath, size_t& alignment)
+{
+#if defined(O_DIRECT)
+#if defined(STATX_DIOALIGN)
+    // Newer kernels tell us exactly what the file system needs.
+    struct statx directIOStatus;
+    if ((statx(AT_FDCWD, fullFilePath.c_str(), 0, STATX_DIOALIGN, &directIOStatus) == 0) &&
+        ((directIOStatus.stx_mask & STATX_DIOALIGN) != 0))
+    {
+        if (directIOStatus.stx_dio_offset_align == 0)
+        {
+            return false;
+        }
+        alignment = std::max(directIOStatus.stx_dio_offset_align, directIOStatus.stx_dio_mem_align);
+        return true;
+    }
+#endif
+    // Older kernels don't, but no device that we care about has logical blocks larger than 4K.
+    alignment = 4096;
+    return true;
+#elif defined(F_NOCACHE)
+    // F_NOCACHE has no alignment requirements, unaligned reads are just slower.
+    alignment = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+off_t LargeFileReaderCore::fileSize()
+{
+    if (!isOpen)
+    {
+        return -1;
+    }
+    
+    return currentFileSize;
+}
+
+const struct stat& LargeFileReaderCore::openFileStatus()
+{
+    return fileStatus;
+}
+
+void LargeFileReaderCore::statisticsSnapshot(CacheStatistics::Snapshot& snapshot)
+{
+    cacheStatistics.snapshot(snapshot);
+    
+    snapshot.numberOfCachedBlocks = 0;
+    snapshot.workingSetSize = 0;
+    if (isOpen)
+    {
+        // Blocks that are claimed but still loading count too, they will hold data in a moment. With a
+        // shared cache, only the blocks of this file count.
+        snapshot.numberOfCachedBlocks = blockCache->numberOfCachedBlocksForFile(blockCacheFileNumber);
+        snapshot.workingSetSize = (size_t)snapshot.numberOfCachedBlocks * cacheBlockSize;
+    }
+}
+
+void LargeFileReaderCore::resetStatistics()
+{
+    cacheStatistics.reset();
+}
+
+// Strategy (follow mode):
+//
+// Everything that reads is limited to currentFileSize, so data beyond it is never looked at. When the
+// file has grown, the blocks that are entirely beyond the old end of the file can not be in the cache,
+// nobody asked for them yet, and they will be fetched as usual. Only the block at the old end of the
+// file can be cached with less data than it has now. We fill in the missing part of that block in
+// place, and only then publish the new size. Readers that still use the old size never look at the
+// part that we fill in, so we don't have to take the block away from them.
+//
+// In memory mapped mode there is nothing to fill in. The windows are shared mappings of the file, and
+// the pages beyond the old end of the file show the new data as soon as it is there.
+
+off_t LargeFileReaderCore::refreshFileSize()
+{
+    if (!isOpen)
+    {
+        return -1;
+    }
+    if (!isFollowing)
+    {
+        return currentFileSize;
+    }
+    
+    std::lock_guard<std::mutex> refreshLock(refreshMutex);
+    
+    struct stat newFileStatus;
+    if (fstat(fileDescriptor, &newFileStatus) != 0)
+    {
+        return -1;
+    }
+    
+    off_t oldFileSize = currentFileSize;
+    off_t newFileSize = newFileStatus.st_size;
+    if (newFileSize < oldFileSize)
+    {
+        // Truncated. The data that we have cached might not be in the file anymore.
+        return -1;
+    }
+    
+    if ((newFileSize > oldFileSize) && !isMemoryMapped && !extendTailDataBlock(oldFileSize, newFileSize))
+    {
+        return -1;
+    }
+    
+    fileStatus = newFileStatus;
+    totalNumberOfFileCacheIndexEntries = (newFileSize + cacheBlockSize - 1) / cacheBlockSize;
+    currentFileSize = newFileSize;
+    
+    return newFileSize;
+}
+
+bool LargeFileReaderCore::extendTailDataBlock(off_t oldFileSize, off_t newFileSize)
+{
+    if ((oldFileSize % cacheBlockSize) == 0)
+    {
+        // The old end of the file was at the end of a block, there is no partial block.
+        return true;
+    }
+    
+    int64_t index = oldFileSize / cacheBlockSize;
+    off_t blockFileOffset = (off_t)index * cacheBlockSize;
+    
+    int64_t cacheBlock;
+    {
+        SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKeyForIndex(index));
+        std::unique_lock<std::mutex> lock(shard.shardMutex);
+        while (true)
+        {
+            cacheBlock = shard.cacheBlockMap->find(blockKeyForIndex(index));
+            if ((cacheBlock == -1) || !blockCache->cacheBlockEntries[cacheBlock].isLoading)
+            {
+                break;
+            }
+            // Wait for the fetch to finish, it might have read less than there is now.
+            shard.shardCondition.wait(lock);
+        }
+        if (cacheBlock == -1)
+        {
+            // Not cached, it will be fetched with all data when it is needed.
+            return true;
+        }
+        // Pin it, so that it is not reused while we fill it in.
+        blockCache->cacheBlockEntries[cacheBlock].pinCount++;
+    }
+    
+    // Read the whole block (direct I/O can only read aligned blocks) into a buffer of our own, and
+    // copy only the new part, so we never write to the part that readers may be using.
+    unsigned char* blockBuffer = SharedBlockCache::allocateCacheMemory(cacheBlockSize, directIOAlignment);
+    FileIOBackend::BlockRequest blockRequest;
+    blockRequest.fileOffset = blockFileOffset;
+    blockRequest.buffer = blockBuffer;
+    blockRequest.length = cacheBlockSize;
+    fileIOBackend->readBlocks(&blockRequest, 1);
+    
+    off_t endOfNewData = std::min(newFileSize, blockFileOffset + (off_t)cacheBlockSize);
+    bool isSuccess = (blockRequest.bytesRead >= (endOfNewData - blockFileOffset));
+    if (isSuccess)
+    {
+        size_t offsetInDataBlock = oldFileSize - blockFileOffset;
+        memcpy(&blockCache->cacheBlocks[(cacheBlock * cacheBlockSize) + offsetInDataBlock], &blockBuffer[offsetInDataBlock], endOfNewData - oldFileSize);
+    }
+    SharedBlockCache::freeCacheMemory(blockBuffer);
+    
+    releaseDataBlock(cacheBlock);
+    
+    return isSuccess;
 }
 
 off_t LargeFileReaderCore::lseek(off_t offsetInBytes, int whence)
@@ -156,7 +512,7 @@ off_t LargeFileReaderCore::lseek(off_t offsetInBytes, int whence)
             newFileOffset = currentFileOffset + offsetInBytes;
             break;
         case SEEK_END:
-            newFileOffset = fileStatus.st_size + offsetInBytes;
+            newFileOffset = currentFileSize + offsetInBytes;
             break;
         default:
             return -1;
@@ -168,10 +524,11 @@ off_t LargeFileReaderCore::lseek(off_t offsetInBytes, int whence)
     //       do allow setting the file offset beyond the end of the file. They also allow 'reading'
     //       from beyond the end of the file. But do we need that?
     
-    if (newFileOffset >= fileStatus.st_size)
+    off_t endOfFile = currentFileSize;
+    if (newFileOffset >= endOfFile)
     {
         isEof = true;
-        currentFileOffset = fileStatus.st_size;
+        currentFileOffset = endOfFile;
     }
     else
     {
@@ -192,191 +549,1027 @@ size_t LargeFileReaderCore::read(unsigned char* buffer, size_t numberOfBytes)
     isFail = false;
     isBad = false;
     
-    // Check if we are going to try to read beyond the end of the file. If so, adjust numberOfBytes
-    // to the amount of data left in the file, from currentFileOffset. If the numberOfBytes becomes
-    // 0 or even negative, we can break out early. If the numberOfBytes becomes less than the user
-    // passed, we will still go through the while loop exactly as many times as needed, without
-    // extra checks.
+    // A read that goes around the cache should not fill the cache with read-ahead either.
+    bool isBypassingCache = isBypassingCacheForRead(currentFileOffset, buffer, numberOfBytes);
     
-    if ((currentFileOffset + numberOfBytes) > fileStatus.st_size)
+    size_t totalBytesRead = readAt(currentFileOffset, buffer, numberOfBytes);
+    if (totalBytesRead == (size_t)-1)
+    {
+        // Abort, we failed to read/cache any data.
+        isFail = true;
+        return -1;
+    }
+    
+    if (readAheadEnabled && !isBypassingCache)
+    {
+        updateReadAhead(currentFileOffset, totalBytesRead);
+    }
+    
+    // Adjust current file offset for the next read.
+    currentFileOffset += totalBytesRead;
+    
+    // We might be at EOF now. Either we read the last byte of the file, or we were trying to read
+    // beyond the end of file.
+    if (currentFileOffset >= currentFileSize)
     {
-        numberOfBytes = fileStatus.st_size - currentFileOffset;
-        
-        // We were trying to read beyond the end of file, and after reading, the currentFileOffset
-        // will point beyond the last data byte in the file, so we can set the EOF flag.
         isEof = true;
-        
-        if (numberOfBytes <= 0)
-        {
-            return 0;
-        }
     }
     
+    return totalBytesRead;
+}
+
+size_t LargeFileReaderCore::readAt(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes)
+{
+    if (!isOpen || (offsetInBytes < 0))
+    {
+        return -1;
+    }
+    
+    // Check if we are going to try to read beyond the end of the file. If so, adjust numberOfBytes
+    // to the amount of data left in the file, from offsetInBytes. If there is no data left, we can
+    // break out early. If the numberOfBytes becomes less than the user passed, we will still go
+    // through the while loop exactly as many times as needed, without extra checks.
+    
+    off_t endOfFile = currentFileSize;
+    if (offsetInBytes >= endOfFile)
+    {
+        return 0;
+    }
+    if (numberOfBytes > (size_t)(endOfFile - offsetInBytes))
+    {
+        numberOfBytes = endOfFile - offsetInBytes;
+    }
+    
+    if (isBypassingCacheForRead(offsetInBytes, buffer, numberOfBytes))
+    {
+        return readBypassingCache(offsetInBytes, buffer, numberOfBytes);
+    }
+    return readThroughCache(offsetInBytes, buffer, numberOfBytes);
+}
+
+size_t LargeFileReaderCore::readThroughCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes)
+{
+    off_t fileOffset = offsetInBytes;
     size_t totalBytesRead = 0;
+    
+    int64_t lastDataBlockIndex = (offsetInBytes + numberOfBytes - 1) / cacheBlockSize;
+    std::vector<int64_t> dataBlockIndexes(std::min(maximumFetchBatchBlocks, lastDataBlockIndex - (int64_t)(offsetInBytes / cacheBlockSize) + 1));
+    std::vector<int64_t> cacheBlocks(dataBlockIndexes.size());
 
     while (totalBytesRead < numberOfBytes)
     {
         // Calculate the data block that should contain (part of) our data. Don't forget, this
         // is the entry in the index that should point to the data that we want.
-        uint64_t dataBlockIndex = floor(currentFileOffset / cacheBlockSize);
+        int64_t dataBlockIndex = fileOffset / cacheBlockSize;
         assert(dataBlockIndex < totalNumberOfFileCacheIndexEntries);
-        // If the block is faulted, we don't have its data in the cache, so fetch it.
-        if (fileCacheIndex[dataBlockIndex].isFault)
+        
+        // Make sure the data is in the cache, fetch it if it is not. If we need multiple blocks, all
+        // missing blocks are fetched in one go. The blocks are pinned until we release them, so other
+        // readers can not steal them while we are copying from them.
+        int64_t numberOfDataBlocks = std::min((int64_t)cacheBlocks.size(), lastDataBlockIndex - dataBlockIndex + 1);
+        for (int64_t blockNumber = 0; blockNumber < numberOfDataBlocks; blockNumber++)
         {
-            // We must fetch data for this index entry.
-            size_t bytesRead = fetchDataBlockForIndex(dataBlockIndex);
-            if (bytesRead < 0)
-            {
-                // Abort, we failed to read/cache any data.
-                isFail = true;
-                return -1;
-            }
+            dataBlockIndexes[blockNumber] = dataBlockIndex + blockNumber;
         }
-        // If the block is still faulted here, then we couldn't read the data from the file.
-        if (fileCacheIndex[dataBlockIndex].isFault)
+        numberOfDataBlocks = acquireDataBlocksForIndexes(dataBlockIndexes.data(), numberOfDataBlocks, cacheBlocks.data());
+        if (numberOfDataBlocks == -1)
         {
-            // Abort
-            isFail = true;
-            return -2;
+            // Abort, we failed to read/cache the data.
+            return -1;
         }
         
-        // We want the bytes from 'currentFileOffset' to either the 'numberOfBytes' or the end of the block,
-        // depending on if the block contains enough data.
-        
-        // Calculate offset inside the data block where we think our data is.
-        uint64_t offsetInDataBlock = currentFileOffset - (dataBlockIndex * cacheBlockSize);
-        
-        // Calculate the length of the data we want to copy. Start by assuming that we will need everything
-        // from the offset to the end of the block, and truncate accordingly for numberOfBytes and
-        // fileStatus.st_size.
-        
-        uint64_t lengthInDataBlock = cacheBlockSize - offsetInDataBlock;
-        if (lengthInDataBlock > (numberOfBytes - totalBytesRead))
-        {
-            // All of our (possibly remaining) data is in this data block. Read only the necessary.
-            lengthInDataBlock = (numberOfBytes - totalBytesRead);
-        }
-        // Maybe we are about to read beyond the end of the file. Truncate the length even more, if so.
-        if ((currentFileOffset + lengthInDataBlock) > fileStatus.st_size)
+        for (int64_t blockNumber = 0; blockNumber < numberOfDataBlocks; blockNumber++)
         {
-            lengthInDataBlock = fileStatus.st_size - currentFileOffset;
-            // After reading, we will be at EOF.
-            isEof = true;
-            // If we are reading far beyond the file (i.e. even currentFileOffset is beyond the file's end),
-            // we should read 0 bytes.
-            if (lengthInDataBlock < 0)
+            // We want the bytes from 'fileOffset' to either the 'numberOfBytes' or the end of the block,
+            // depending on if the block contains enough data.
+            
+            // Calculate offset inside the data block where we think our data is.
+            uint64_t offsetInDataBlock = fileOffset - ((dataBlockIndex + blockNumber) * cacheBlockSize);
+            
+            // Calculate the length of the data we want to copy. Start by assuming that we will need everything
+            // from the offset to the end of the block, and truncate for numberOfBytes. We already truncated
+            // numberOfBytes for the size of the file.
+            
+            uint64_t lengthInDataBlock = cacheBlockSize - offsetInDataBlock;
+            if (lengthInDataBlock > (numberOfBytes - totalBytesRead))
             {
-                lengthInDataBlock = 0;
+                // All of our (possibly remaining) data is in this data block. Read only the necessary.
+                lengthInDataBlock = (numberOfBytes - totalBytesRead);
             }
+            
+            // Point to the data.
+            unsigned char* cacheBlockPointer = &blockCache->cacheBlocks[cacheBlocks[blockNumber] * cacheBlockSize];
+            // Copy the data.
+            memcpy(&buffer[totalBytesRead], &cacheBlockPointer[offsetInDataBlock], lengthInDataBlock);
+            
+            releaseDataBlock(cacheBlocks[blockNumber]);
+            
+            // Adjust the offset for the next block.
+            fileOffset += lengthInDataBlock;
+            // Update total bytes read to see if we are finished.
+            totalBytesRead += lengthInDataBlock;
         }
-        // If we got here and are now trying to read 0 bytes, we're trying to read beyond the end of the
-        // file's data. We can break out early. Note that we may have copied data to the buffer, and want
-        // to keep it. So return the totalBytesRead.
-        if (lengthInDataBlock == 0)
-        {
-            assert(isEof == true);  // If it is false here, there must have been a use-case that I forgot.
-            return totalBytesRead;
-        }
+    }
+    
+    cacheStatistics.countBytesServed(totalBytesRead);
+    
+    return totalBytesRead;
+}
 
-        // Point to the data.
-        unsigned char* cacheBlockPointer = &fileDataBlocks[fileCacheIndex[dataBlockIndex].offsetInFileBuffer];
-        // Copy the data.
-        memcpy(&buffer[totalBytesRead], &cacheBlockPointer[offsetInDataBlock], lengthInDataBlock);
-        // Adjust current file offset for the next read.
-        currentFileOffset += lengthInDataBlock;
-        // Update total bytes read to see if we are finished.
-        totalBytesRead += lengthInDataBlock;
+// Strategy (large read bypass):
+//
+// A read of many MB through the cache evicts that many MB of blocks that others are using, to hold data
+// that is copied out once and never looked at again, and it costs a fetch per batch of blocks plus a
+// copy of every byte. So a large read only uses the cache for the blocks at its start and end that it
+// needs part of: those may well be used by the reads before and after it. The whole blocks in between
+// are read from the file straight into the caller's buffer, in chunks of bypassChunkSize, which the
+// backend reads with a single preadv (or, with io_uring, all at the same time).
+//
+// Blocks in the middle that are in the cache are read from the file anyway. They hold the same data (in
+// follow mode, data is only appended), and the page cache probably still has them.
+
+bool LargeFileReaderCore::isBypassingCacheForRead(off_t fileOffset, const unsigned char* buffer, size_t numberOfBytes) const
+{
+    if ((largeReadBypassThreshold == 0) || isMemoryMapped || isCompressed || (fileOffset < 0))
+    {
+        return false;
     }
     
-    // We might be at EOF now.
-    if (currentFileOffset >= fileStatus.st_size)
+    off_t endOfFile = currentFileSize;
+    if (fileOffset >= endOfFile)
     {
-        isEof = true;
+        return false;
+    }
+    numberOfBytes = std::min(numberOfBytes, (size_t)(endOfFile - fileOffset));
+    if (numberOfBytes < largeReadBypassThreshold)
+    {
+        return false;
     }
     
-    return totalBytesRead;
+    // There must be at least one whole block in the middle, and direct I/O must be able to read into
+    // the buffer there.
+    off_t startOfMiddle = ((fileOffset + cacheBlockSize - 1) / cacheBlockSize) * cacheBlockSize;
+    off_t endOfMiddle = ((fileOffset + (off_t)numberOfBytes) / cacheBlockSize) * cacheBlockSize;
+    if (endOfMiddle <= startOfMiddle)
+    {
+        return false;
+    }
+    return (directIOAlignment == 0) || ((((uintptr_t)buffer + (startOfMiddle - fileOffset)) % directIOAlignment) == 0);
 }
 
-size_t LargeFileReaderCore::fetchDataBlockForIndex(int64_t index)
+size_t LargeFileReaderCore::readBypassingCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes)
 {
-    // Fetch data for an index entry.
-    
-    // Step 1: Find a place in fileDataBlocks that we can use. Either:
-    //         1) find an unused buffer block
-    //         2) take the LRU index's buffer block, overwrite it for our own use, and become the MRU,
-    //            while making the predecessor of the LRU the new LRU, and the previous MRU our PRU.
+    off_t startOfMiddle = ((offsetInBytes + cacheBlockSize - 1) / cacheBlockSize) * cacheBlockSize;
+    off_t endOfMiddle = ((offsetInBytes + (off_t)numberOfBytes) / cacheBlockSize) * cacheBlockSize;
+    size_t headLength = startOfMiddle - offsetInBytes;
+    size_t middleLength = endOfMiddle - startOfMiddle;
+    size_t tailLength = numberOfBytes - headLength - middleLength;
     
-    // We initially start with all blocks empty and fill them linearly from 0 to max. Once we filled
-    // all blocks, we start stealing LRU's blocks.
+    size_t totalBytesRead = 0;
+    if (headLength > 0)
+    {
+        totalBytesRead = readThroughCache(offsetInBytes, buffer, headLength);
+        if (totalBytesRead == (size_t)-1)
+        {
+            return -1;
+        }
+    }
     
-    uint64_t cacheBlockOffset;
+    std::vector<FileIOBackend::BlockRequest> blockRequests((middleLength + bypassChunkSize - 1) / bypassChunkSize);
+    for (size_t requestNumber = 0; requestNumber < blockRequests.size(); requestNumber++)
+    {
+        size_t offsetInMiddle = requestNumber * bypassChunkSize;
+        blockRequests[requestNumber].fileOffset = startOfMiddle + (off_t)offsetInMiddle;
+        blockRequests[requestNumber].buffer = &buffer[headLength + offsetInMiddle];
+        blockRequests[requestNumber].length = std::min(bypassChunkSize, middleLength - offsetInMiddle);
+    }
+    fileIOBackend->readBlocks(blockRequests.data(), blockRequests.size());
     
-    if (currentNumberOfCachedFileDataBlocks < maxNumberOfCachedFileDataBlocks)
+    for (FileIOBackend::BlockRequest& blockRequest : blockRequests)
     {
-        // The cache is not full yet, and we fill from start to end first.
-        cacheBlockOffset = currentNumberOfCachedFileDataBlocks * cacheBlockSize;
-        currentNumberOfCachedFileDataBlocks++;
-
-        // Store the offset in the index, this will become the next MRU.
-        fileCacheIndex[index].isFault = false;
-        fileCacheIndex[index].offsetInFileBuffer = cacheBlockOffset;
-        // Point previous used of new index to previous MRU.
-        fileCacheIndex[index].previousUsed = mostRecentlyUsedIndex;
-
-        // Update the previous MRU to point to us.
-        if (mostRecentlyUsedIndex != -1)
+        if (blockRequest.bytesRead < 0)
         {
-            fileCacheIndex[mostRecentlyUsedIndex].nextUsed = index;
+            return -1;
         }
-
-        // Update the LRU if we didn't set it before. We set it to us: the first
-        // cached block will become both LRU and MRU.
-        if (leastRecentlyUsedIndex == -1)
+        totalBytesRead += blockRequest.bytesRead;
+        cacheStatistics.countBytesBypassing(blockRequest.bytesRead);
+        if ((size_t)blockRequest.bytesRead < blockRequest.length)
         {
-            leastRecentlyUsedIndex = index;
+            // The file ended early (it was truncated while we have it open).
+            return totalBytesRead;
         }
-        
-        // We are now the new MRU.
-        mostRecentlyUsedIndex = index;
     }
-    else
+    
+    if (tailLength > 0)
     {
-        // We're going to reuse the LRU's cache block.
-        cacheBlockOffset = fileCacheIndex[leastRecentlyUsedIndex].offsetInFileBuffer;
-        
-        // Save the current LRU's next used. It will become the new LRU later.
-        int64_t nextToBecomeLRU = fileCacheIndex[leastRecentlyUsedIndex].nextUsed;
-        if (nextToBecomeLRU != -1)
-        {
-            fileCacheIndex[nextToBecomeLRU].previousUsed = -1;
-        }
-        
-        // Fault the LRU.
-        fileCacheIndex[leastRecentlyUsedIndex].isFault = true;
-        fileCacheIndex[leastRecentlyUsedIndex].offsetInFileBuffer = -1;
-        fileCacheIndex[leastRecentlyUsedIndex].previousUsed = -1;
-        fileCacheIndex[leastRecentlyUsedIndex].nextUsed = -1;
-        
-        // Update the new index.
-        fileCacheIndex[index].isFault = false;
-        fileCacheIndex[index].offsetInFileBuffer = cacheBlockOffset;
-        fileCacheIndex[index].previousUsed = mostRecentlyUsedIndex;
-        fileCacheIndex[index].nextUsed = -1;
-        
-        if (mostRecentlyUsedIndex != -1)
+        size_t tailBytesRead = readThroughCache(endOfMiddle, &buffer[headLength + middleLength], tailLength);
+        if (tailBytesRead == (size_t)-1)
         {
-            fileCacheIndex[mostRecentlyUsedIndex].nextUsed = index;
+            return -1;
         }
+        totalBytesRead += tailBytesRead;
+    }
+    
+    return totalBytesRead;
+}
 
-        // Update LRU.
-        leastRecentlyUsedIndex = nextToBecomeLRU;
+// Strategy (batch reads):
+//
+// Reading the ranges one by one costs a lock round trip per block per range, and a fetch (a system
+// call) per range that misses, even if the ranges are neighbours, or need the same block. Instead we
+// cut every range into pieces of one block each, and sort the pieces by block. That gives the blocks
+// that the batch needs in file order, each of them once, and for every block the pieces that are in
+// it. The blocks are acquired like readAt does, maximumFetchBatchBlocks at a time, which fetches
+// all missing ones together, and the backend reads neighbouring blocks with a single system call.
+// Every acquired block is copied to all of its pieces and released right away.
+//
+// A block that can not be read only fails the ranges that need it.
 
-        // Update MRU.
-        mostRecentlyUsedIndex = index;
+size_t LargeFileReaderCore::readRanges(ReadRequest* requests, size_t numberOfRequests)
+{
+    if (!isOpen)
+    {
+        return -1;
     }
 
-    unsigned char* cacheBlockPointer = &fileDataBlocks[fileCacheIndex[index].offsetInFileBuffer];
-    
-    return ::read(fileDescriptor, cacheBlockPointer, cacheBlockSize);
-}
+    off_t endOfFile = currentFileSize;
+
+    bool isSuccess = true;
+
+    // Pieces of the ranges: the index of the block, and the range that needs data from it.
+    std::vector<std::pair<int64_t, size_t>> blockPieces;
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        ReadRequest& request = requests[requestNumber];
+        if (request.fileOffset < 0)
+        {
+            request.bytesRead = -1;
+            isSuccess = false;
+            continue;
+        }
+        request.bytesRead = 0;
+        if ((request.fileOffset >= endOfFile) || (request.length == 0))
+        {
+            continue;
+        }
 
+        off_t endOfRequest = request.fileOffset + (off_t)std::min(request.length, (size_t)(endOfFile - request.fileOffset));
+        for (int64_t index = request.fileOffset / cacheBlockSize; index <= (int64_t)((endOfRequest - 1) / cacheBlockSize); index++)
+        {
+            blockPieces.push_back(std::make_pair(index, requestNumber));
+        }
+    }
+    std::sort(blockPieces.begin(), blockPieces.end());
+
+    std::vector<int64_t> dataBlockIndexes;
+    for (const std::pair<int64_t, size_t>& blockPiece : blockPieces)
+    {
+        if (dataBlockIndexes.empty() || (dataBlockIndexes.back() != blockPiece.first))
+        {
+            dataBlockIndexes.push_back(blockPiece.first);
+        }
+    }
+
+    std::vector<int64_t> cacheBlocks(std::min(maximumFetchBatchBlocks, (int64_t)dataBlockIndexes.size()));
+    size_t pieceNumber = 0;
+    size_t totalBytesRead = 0;
+
+    for (size_t blockNumber = 0; blockNumber < dataBlockIndexes.size(); )
+    {
+        int64_t numberOfDataBlocks = std::min((int64_t)cacheBlocks.size(), (int64_t)(dataBlockIndexes.size() - blockNumber));
+        numberOfDataBlocks = acquireDataBlocksForIndexes(&dataBlockIndexes[blockNumber], numberOfDataBlocks, cacheBlocks.data());
+        if (numberOfDataBlocks == -1)
+        {
+            // One of the blocks failed. Find out which one, and fail the ranges that need it.
+            cacheBlocks[0] = acquireDataBlockForIndex(dataBlockIndexes[blockNumber]);
+            numberOfDataBlocks = 1;
+        }
+
+        for (int64_t acquiredBlockNumber = 0; acquiredBlockNumber < numberOfDataBlocks; acquiredBlockNumber++, blockNumber++)
+        {
+            int64_t dataBlockIndex = dataBlockIndexes[blockNumber];
+            int64_t cacheBlock = cacheBlocks[acquiredBlockNumber];
+            off_t startOfDataBlock = (off_t)dataBlockIndex * cacheBlockSize;
+            unsigned char* cacheBlockPointer = (cacheBlock != -1) ? &blockCache->cacheBlocks[cacheBlock * cacheBlockSize] : NULL;
+
+            for (; (pieceNumber < blockPieces.size()) && (blockPieces[pieceNumber].first == dataBlockIndex); pieceNumber++)
+            {
+                ReadRequest& request = requests[blockPieces[pieceNumber].second];
+                if (cacheBlock == -1)
+                {
+                    request.bytesRead = -1;
+                    isSuccess = false;
+                    continue;
+                }
+                if (request.bytesRead == -1)
+                {
+                    continue;
+                }
+
+                // The part of the range that is in this block.
+                off_t endOfRequest = request.fileOffset + (off_t)std::min(request.length, (size_t)(endOfFile - request.fileOffset));
+                off_t startOfPiece = std::max(request.fileOffset, startOfDataBlock);
+                off_t endOfPiece = std::min(endOfRequest, startOfDataBlock + (off_t)cacheBlockSize);
+                memcpy(&request.buffer[startOfPiece - request.fileOffset], &cacheBlockPointer[startOfPiece - startOfDataBlock], endOfPiece - startOfPiece);
+                request.bytesRead += endOfPiece - startOfPiece;
+            }
+
+            if (cacheBlock != -1)
+            {
+                releaseDataBlock(cacheBlock);
+            }
+        }
+    }
+
+    for (size_t requestNumber = 0; requestNumber < numberOfRequests; requestNumber++)
+    {
+        if (requests[requestNumber].bytesRead > 0)
+        {
+            totalBytesRead += requests[requestNumber].bytesRead;
+        }
+    }
+    cacheStatistics.countBytesServed(totalBytesRead);
+
+    return isSuccess ? totalBytesRead : -1;
+}
+
+// Strategy (asynchronous reads):
+//
+// Most reads are cache hits, and a hit only takes a lock and a copy. Handing those to another thread
+// would cost more than the read itself, so an asynchronous read first tries to get all its blocks from
+// the cache without fetching, and completes on the calling thread if that works. Only a read that has to
+// wait for the file (a miss, a block that someone else is fetching, a read that bypasses the cache, or a
+// memory mapped window, whose pages may not be in memory) goes to the worker pool, where it is a plain
+// readAt. So the caller never waits for the disk, and a worker only for one read at a time: the reads in
+// flight are limited by the number of workers, and the rest wait in the queue of the pool.
+//
+// close() waits until all reads in flight are done. A read is done before its completion is called,
+// so a completion can destroy the reader, or resume a coroutine that does.
+
+void LargeFileReaderCore::readAtAsync(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, std::function<void(size_t bytesRead)> completion)
+{
+    size_t bytesRead;
+    if (readAtFromCache(offsetInBytes, buffer, numberOfBytes, bytesRead))
+    {
+        completion(bytesRead);
+        return;
+    }
+    
+    submitAsyncRead(offsetInBytes, buffer, numberOfBytes, std::move(completion));
+}
+
+bool LargeFileReaderCore::readAtFromCache(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, size_t& bytesRead)
+{
+    if (!isOpen || (offsetInBytes < 0))
+    {
+        bytesRead = -1;
+        return true;
+    }
+    
+    off_t endOfFile = currentFileSize;
+    if (offsetInBytes >= endOfFile)
+    {
+        bytesRead = 0;
+        return true;
+    }
+    if (numberOfBytes > (size_t)(endOfFile - offsetInBytes))
+    {
+        numberOfBytes = endOfFile - offsetInBytes;
+    }
+    
+    if (isMemoryMapped || isBypassingCacheForRead(offsetInBytes, buffer, numberOfBytes))
+    {
+        return false;
+    }
+    
+    // Never pin more blocks than a fetch batch, maximumFetchBatchBlocks is at most 64.
+    int64_t firstDataBlockIndex = offsetInBytes / cacheBlockSize;
+    int64_t numberOfDataBlocks = (offsetInBytes + numberOfBytes - 1) / cacheBlockSize - firstDataBlockIndex + 1;
+    if (numberOfDataBlocks > maximumFetchBatchBlocks)
+    {
+        return false;
+    }
+    int64_t cacheBlocks[64];
+    
+    // Pin the blocks, so they can not be evicted while we copy, each with the mutex of its shard held.
+    int64_t numberOfBlocksPinned = 0;
+    while (numberOfBlocksPinned < numberOfDataBlocks)
+    {
+        int64_t blockKey = blockKeyForIndex(firstDataBlockIndex + numberOfBlocksPinned);
+        SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKey);
+        std::lock_guard<std::mutex> lock(shard.shardMutex);
+        
+        int64_t cacheBlock = shard.cacheBlockMap->find(blockKey);
+        if ((cacheBlock == -1) || blockCache->cacheBlockEntries[cacheBlock].isLoading)
+        {
+            break;
+        }
+        blockCache->pinCachedBlock(shard, cacheBlock);
+        cacheBlocks[numberOfBlocksPinned] = cacheBlock;
+        numberOfBlocksPinned++;
+    }
+    if (numberOfBlocksPinned < numberOfDataBlocks)
+    {
+        // A block is not there (yet), leave it all to a read that can wait.
+        for (int64_t blockNumber = 0; blockNumber < numberOfBlocksPinned; blockNumber++)
+        {
+            releaseDataBlock(cacheBlocks[blockNumber]);
+        }
+        return false;
+    }
+    cacheStatistics.countHits(numberOfDataBlocks);
+    
+    off_t fileOffset = offsetInBytes;
+    size_t totalBytesRead = 0;
+    for (int64_t blockNumber = 0; blockNumber < numberOfDataBlocks; blockNumber++)
+    {
+        uint64_t offsetInDataBlock = fileOffset - ((firstDataBlockIndex + blockNumber) * cacheBlockSize);
+        uint64_t lengthInDataBlock = std::min((uint64_t)(cacheBlockSize - offsetInDataBlock), (uint64_t)(numberOfBytes - totalBytesRead));
+        
+        unsigned char* cacheBlockPointer = &blockCache->cacheBlocks[cacheBlocks[blockNumber] * cacheBlockSize];
+        memcpy(&buffer[totalBytesRead], &cacheBlockPointer[offsetInDataBlock], lengthInDataBlock);
+        releaseDataBlock(cacheBlocks[blockNumber]);
+        
+        fileOffset += lengthInDataBlock;
+        totalBytesRead += lengthInDataBlock;
+    }
+    
+    cacheStatistics.countBytesServed(totalBytesRead);
+    
+    bytesRead = totalBytesRead;
+    return true;
+}
+
+void LargeFileReaderCore::submitAsyncRead(off_t offsetInBytes, unsigned char* buffer, size_t numberOfBytes, std::function<void(size_t bytesRead)> completion)
+{
+    {
+        std::lock_guard<std::mutex> lock(asyncReadMutex);
+        numberOfAsyncReadsInFlight++;
+    }
+    
+    WorkerPool& workerPool = (asyncReadWorkerPool != NULL) ? *asyncReadWorkerPool : WorkerPool::sharedIOPool();
+    workerPool.enqueue([this, offsetInBytes, buffer, numberOfBytes, completion = std::move(completion)]()
+    {
+        size_t bytesRead = readAt(offsetInBytes, buffer, numberOfBytes);
+        
+        {
+            std::lock_guard<std::mutex> lock(asyncReadMutex);
+            numberOfAsyncReadsInFlight--;
+            if (numberOfAsyncReadsInFlight == 0)
+            {
+                asyncReadCondition.notify_all();
+            }
+        }
+        
+        // The reader can be closed, or destroyed, from here on. Don't touch it anymore.
+        completion(bytesRead);
+    });
+}
+
+size_t LargeFileReaderCore::acquireView(off_t offsetInBytes, size_t maximumNumberOfBytes, FileDataView& view)
+{
+    view = FileDataView();
+    
+    if (!isOpen || (offsetInBytes < 0))
+    {
+        return -1;
+    }
+    off_t endOfFile = currentFileSize;
+    if ((offsetInBytes >= endOfFile) || (maximumNumberOfBytes == 0))
+    {
+        return 0;
+    }
+    
+    int64_t dataBlockIndex = offsetInBytes / cacheBlockSize;
+    
+    // Same as a read of a single block, but we keep the block pinned instead of copying from it.
+    int64_t cacheBlock = acquireDataBlockForIndex(dataBlockIndex);
+    if (cacheBlock == -1)
+    {
+        return -1;
+    }
+    
+    uint64_t offsetInDataBlock = offsetInBytes - (dataBlockIndex * cacheBlockSize);
+    size_t length = std::min((size_t)(cacheBlockSize - offsetInDataBlock), maximumNumberOfBytes);
+    length = std::min(length, (size_t)(endOfFile - offsetInBytes));
+    
+    view.data = &blockCache->cacheBlocks[(cacheBlock * cacheBlockSize) + offsetInDataBlock];
+    view.length = length;
+    view.fileOffset = offsetInBytes;
+    view.cacheBlock = cacheBlock;
+    
+    cacheStatistics.countBytesServed(length);
+    
+    return length;
+}
+
+void LargeFileReaderCore::releaseView(FileDataView& view)
+{
+    if (view.cacheBlock == -1)
+    {
+        return;
+    }
+    
+    releaseDataBlock(view.cacheBlock);
+    view = FileDataView();
+}
+
+// Strategy:
+//
+// Multiple threads can read from the same reader at the same time. The bookkeeping of a block (its
+// entry in the map, its block entry, the eviction policy and the free blocks) is protected by the
+// shardMutex of the shard of the cache that the block key goes to, but the mutex is only held for the
+// short time that it takes to update the bookkeeping. With a shared cache the same goes for the readers
+// of all files that share it. The expensive parts, reading from the file and copying data out of the
+// cache, are done without holding a mutex:
+//
+// - A reader that wants a block pins it (pinCount), copies the data, and unpins it. Pinned blocks
+//   are never evicted, so the data can not change while it is being copied.
+// - A reader that faults a block claims a cache block for it and marks it as loading, then reads the
+//   data with a positional read (pread), which does not depend on or change the file's offset. Other
+//   readers that want the same block wait for the loading to finish instead of reading it again.
+// - A reader that needs multiple blocks claims blocks for all of the ones that are missing, and
+//   fetches them in one batch, so that the I/O backend can have them all in flight at once. It never
+//   waits while it has claimed blocks that it has not fetched yet, so readers can not deadlock.
+// - The blocks of a batch are in different shards. Their mutexes are taken one at a time, never two
+//   at once, so there is no order to keep.
+
+int64_t LargeFileReaderCore::acquireDataBlockForIndex(int64_t index)
+{
+    SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKeyForIndex(index));
+    std::unique_lock<std::mutex> lock(shard.shardMutex);
+    
+    while (true)
+    {
+        int64_t cacheBlock = shard.cacheBlockMap->find(blockKeyForIndex(index));
+        
+        if (cacheBlock != -1)
+        {
+            if (blockCache->cacheBlockEntries[cacheBlock].isLoading)
+            {
+                // Another reader is fetching this block, wait for it and check again. If the fetch
+                // failed, the block will not be in the index anymore and we will try ourselves.
+                shard.shardCondition.wait(lock);
+                continue;
+            }
+            
+            // Cache hit. Let the eviction policy know that the block is being used.
+            blockCache->pinCachedBlock(shard, cacheBlock);
+            cacheStatistics.countHits(1);
+            return cacheBlock;
+        }
+        
+        // Cache fault. Find a block in the shard to put the data in.
+        cacheBlock = claimDataBlockForIndex(index);
+        if (cacheBlock == -1)
+        {
+            // All blocks of the shard are pinned by other readers. Wait until one is released.
+            shard.shardCondition.wait(lock);
+            continue;
+        }
+        
+        // We own the block now. Fetch the data without holding the lock.
+        cacheStatistics.countMisses(1);
+        lock.unlock();
+        ssize_t bytesRead = fetchDataBlockForIndex(index, cacheBlock);
+        lock.lock();
+        
+        if (!completeFetchForCacheBlock(cacheBlock, bytesRead))
+        {
+            return -1;
+        }
+        
+        return cacheBlock;
+    }
+}
+
+int64_t LargeFileReaderCore::acquireDataBlocksForIndexes(const int64_t* indexes, int64_t numberOfIndexes, int64_t* cacheBlocks)
+{
+    if (numberOfIndexes <= 1)
+    {
+        cacheBlocks[0] = acquireDataBlockForIndex(indexes[0]);
+        return (cacheBlocks[0] == -1) ? -1 : 1;
+    }
+    
+    // Pin the blocks that are cached and claim blocks for the ones that are not, until we run into a
+    // block that someone else is loading, or until we can not claim a block anymore. We must not
+    // wait while we have claimed blocks that we have not fetched yet, others might be waiting for them.
+    std::vector<int64_t> indexesToFetch;
+    std::vector<int64_t> cacheBlocksToFetch;
+    
+    int64_t numberOfBlocksAcquired = 0;
+    while (numberOfBlocksAcquired < numberOfIndexes)
+    {
+        int64_t index = indexes[numberOfBlocksAcquired];
+        SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKeyForIndex(index));
+        std::lock_guard<std::mutex> lock(shard.shardMutex);
+        int64_t cacheBlock = shard.cacheBlockMap->find(blockKeyForIndex(index));
+        
+        if (cacheBlock != -1)
+        {
+            if (blockCache->cacheBlockEntries[cacheBlock].isLoading)
+            {
+                break;
+            }
+            
+            // Cache hit.
+            blockCache->pinCachedBlock(shard, cacheBlock);
+            cacheStatistics.countHits(1);
+        }
+        else
+        {
+            cacheBlock = claimDataBlockForIndex(index);
+            if (cacheBlock == -1)
+            {
+                break;
+            }
+            indexesToFetch.push_back(index);
+            cacheBlocksToFetch.push_back(cacheBlock);
+        }
+        
+        cacheBlocks[numberOfBlocksAcquired] = cacheBlock;
+        numberOfBlocksAcquired++;
+    }
+    
+    if (numberOfBlocksAcquired == 0)
+    {
+        // The very first block is busy. Do it the slow way, which can wait, as we have nothing pinned.
+        cacheBlocks[0] = acquireDataBlockForIndex(indexes[0]);
+        return (cacheBlocks[0] == -1) ? -1 : 1;
+    }
+    
+    if (indexesToFetch.empty())
+    {
+        return numberOfBlocksAcquired;
+    }
+    cacheStatistics.countMisses(indexesToFetch.size());
+    
+    // Fetch all missing blocks in one batch, without holding a lock.
+    std::vector<ssize_t> bytesRead(indexesToFetch.size());
+    fetchDataBlocksForIndexes(indexesToFetch.data(), cacheBlocksToFetch.data(), bytesRead.data(), indexesToFetch.size());
+    if (isMemoryMapped)
+    {
+        // Mapping a window does not read anything, ask the kernel to start loading the windows.
+        for (size_t blockNumber = 0; blockNumber < indexesToFetch.size(); blockNumber++)
+        {
+            if (bytesRead[blockNumber] > 0)
+            {
+                madvise(&blockCache->cacheBlocks[cacheBlocksToFetch[blockNumber] * cacheBlockSize], cacheBlockSize, MADV_WILLNEED);
+            }
+        }
+    }
+    
+    bool isSuccess = true;
+    for (size_t blockNumber = 0; blockNumber < indexesToFetch.size(); blockNumber++)
+    {
+        std::lock_guard<std::mutex> lock(blockCache->shardForCacheBlock(cacheBlocksToFetch[blockNumber]).shardMutex);
+        if (!completeFetchForCacheBlock(cacheBlocksToFetch[blockNumber], bytesRead[blockNumber]))
+        {
+            isSuccess = false;
+        }
+    }
+    
+    if (!isSuccess)
+    {
+        // Unpin everything that we still have pinned. Blocks that failed were already given back.
+        for (int64_t blockNumber = 0; blockNumber < numberOfBlocksAcquired; blockNumber++)
+        {
+            SharedBlockCache::CacheShard& shard = blockCache->shardForCacheBlock(cacheBlocks[blockNumber]);
+            std::lock_guard<std::mutex> lock(shard.shardMutex);
+            SharedBlockCache::CacheBlockEntry& entry = blockCache->cacheBlockEntries[cacheBlocks[blockNumber]];
+            if ((entry.pinCount > 0) && (entry.blockKey == blockKeyForIndex(indexes[blockNumber])))
+            {
+                entry.pinCount--;
+            }
+            shard.shardCondition.notify_all();
+        }
+        return -1;
+    }
+    
+    return numberOfBlocksAcquired;
+}
+
+bool LargeFileReaderCore::completeFetchForCacheBlock(int64_t cacheBlock, ssize_t bytesRead)
+{
+    SharedBlockCache::CacheShard& shard = blockCache->shardForCacheBlock(cacheBlock);
+    SharedBlockCache::CacheBlockEntry& entry = blockCache->cacheBlockEntries[cacheBlock];
+    entry.isLoading = false;
+    
+    // Readers might be waiting for this block to finish loading.
+    shard.shardCondition.notify_all();
+    
+    if (bytesRead < 0)
+    {
+        // Failed to read the data, give the block back.
+        blockCache->freeCacheBlock(shard, cacheBlock);
+        
+        return false;
+    }
+    
+    return true;
+}
+
+void LargeFileReaderCore::releaseDataBlock(int64_t cacheBlock)
+{
+    SharedBlockCache::CacheShard& shard = blockCache->shardForCacheBlock(cacheBlock);
+    std::lock_guard<std::mutex> lock(shard.shardMutex);
+    
+    SharedBlockCache::CacheBlockEntry& entry = blockCache->cacheBlockEntries[cacheBlock];
+    
+    assert(entry.pinCount > 0);
+    entry.pinCount--;
+    
+    if (entry.pinCount == 0)
+    {
+        // Someone might be waiting for a block of the shard to become available.
+        shard.shardCondition.notify_all();
+    }
+}
+
+int64_t LargeFileReaderCore::claimDataBlockForIndex(int64_t index)
+{
+    // Find a cache block in the shard of the index entry that we can use. Either:
+    // 1) find an unused cache block
+    // 2) ask the eviction policy for a victim that is not pinned, fault it, and take its cache block.
+    //    With a shared cache, the victim can be a block of another file.
+    // The block is pinned and loading, until the data is fetched.
+    
+    int64_t blockKey = blockKeyForIndex(index);
+    SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKey);
+    int64_t cacheBlock = blockCache->takeUnusedCacheBlock(shard, blockKey);
+    if (cacheBlock != -1)
+    {
+        return cacheBlock;
+    }
+    
+    cacheBlock = blockCache->selectVictimCacheBlock(shard);
+    if (cacheBlock == -1)
+    {
+        return -1;
+    }
+    
+    blockCache->reuseCacheBlock(shard, cacheBlock, blockKey);
+    cacheStatistics.countEviction();
+    
+    return cacheBlock;
+}
+
+ssize_t LargeFileReaderCore::fetchDataBlockForIndex(int64_t index, int64_t cacheBlock)
+{
+    ssize_t bytesRead;
+    fetchDataBlocksForIndexes(&index, &cacheBlock, &bytesRead, 1);
+    return bytesRead;
+}
+
+void LargeFileReaderCore::fetchDataBlocksForIndexes(const int64_t* indexes, const int64_t* cacheBlocks, ssize_t* bytesRead, int64_t numberOfBlocks)
+{
+    // Fetch data for index entries. The cache blocks must have been claimed for them before.
+    
+    std::chrono::steady_clock::time_point fetchStartTime = std::chrono::steady_clock::now();
+    
+    if (isMemoryMapped)
+    {
+        for (int64_t blockNumber = 0; blockNumber < numberOfBlocks; blockNumber++)
+        {
+            bytesRead[blockNumber] = mapDataBlockForIndex(indexes[blockNumber], cacheBlocks[blockNumber]);
+        }
+    }
+    else
+    {
+        // The backend uses positional reads, so that we do not depend on (and do not change) the file
+        // offset of the file descriptor. This makes it safe to fetch multiple blocks at the same time.
+        std::vector<FileIOBackend::BlockRequest> blockRequests(numberOfBlocks);
+        for (int64_t blockNumber = 0; blockNumber < numberOfBlocks; blockNumber++)
+        {
+            blockRequests[blockNumber].fileOffset = (off_t)indexes[blockNumber] * cacheBlockSize;
+            blockRequests[blockNumber].buffer = &blockCache->cacheBlocks[cacheBlocks[blockNumber] * cacheBlockSize];
+            blockRequests[blockNumber].length = cacheBlockSize;
+        }
+        
+        fileIOBackend->readBlocks(blockRequests.data(), numberOfBlocks);
+        
+        for (int64_t blockNumber = 0; blockNumber < numberOfBlocks; blockNumber++)
+        {
+            bytesRead[blockNumber] = blockRequests[blockNumber].bytesRead;
+        }
+    }
+    
+    uint64_t fetchLatency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - fetchStartTime).count();
+    uint64_t numberOfErrors = 0;
+    uint64_t numberOfBytes = 0;
+    for (int64_t blockNumber = 0; blockNumber < numberOfBlocks; blockNumber++)
+    {
+        if (bytesRead[blockNumber] < 0)
+        {
+            numberOfErrors++;
+        }
+        else
+        {
+            numberOfBytes += bytesRead[blockNumber];
+        }
+    }
+    cacheStatistics.countFetch(numberOfBlocks, numberOfErrors, numberOfBytes, fetchLatency);
+}
+
+ssize_t LargeFileReaderCore::mapDataBlockForIndex(int64_t index, int64_t cacheBlock)
+{
+    off_t fileOffset = (off_t)index * cacheBlockSize;
+    unsigned char* window = &blockCache->cacheBlocks[cacheBlock * cacheBlockSize];
+    
+    // This replaces whatever window the cache block had before. The part of the last window that is
+    // beyond the end of the file is never touched.
+    if (mmap(window, cacheBlockSize, PROT_READ, MAP_SHARED | MAP_FIXED, fileDescriptor, fileOffset) == MAP_FAILED)
+    {
+        // A failed MAP_FIXED may have unmapped the old window, put the reservation back.
+        mmap(window, cacheBlockSize, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+        return -1;
+    }
+    
+    madvise(window, cacheBlockSize, memoryMappingAdvice);
+    
+    return std::min((off_t)cacheBlockSize, currentFileSize - fileOffset);
+}
+
+// Strategy (read-ahead):
+//
+// Every 'read' that starts where the previous one ended counts as sequential. On the first sequential
+// read we queue the next 2 blocks after the last block that was read. Every time the reader gets
+// within half a window of the last queued block, we double the window (up to readAheadMaximumBlocks,
+// and never more than half the cache, so that read-ahead can not flush the blocks that are being
+// read) and queue the blocks up to the end of the new window. A read that does not start where the
+// previous one ended resets the window and drops everything that was queued and not yet fetched.
+//
+// The read-ahead thread fetches the queued blocks into free blocks or blocks that the eviction policy
+// gives up, exactly like a reader would, but does not pin them. It never waits for pinned blocks.
+
+void LargeFileReaderCore::prefetchDataBlocksForIndexes(const int64_t* indexes, int64_t numberOfIndexes)
+{
+    std::vector<int64_t> indexesToFetch;
+    std::vector<int64_t> cacheBlocksToFetch;
+    
+    for (int64_t indexNumber = 0; indexNumber < numberOfIndexes; indexNumber++)
+    {
+        SharedBlockCache::CacheShard& shard = blockCache->shardForBlockKey(blockKeyForIndex(indexes[indexNumber]));
+        std::lock_guard<std::mutex> lock(shard.shardMutex);
+        if (shard.cacheBlockMap->find(blockKeyForIndex(indexes[indexNumber])) != -1)
+        {
+            // Already cached, or being fetched by a reader.
+            continue;
+        }
+        
+        int64_t cacheBlock = claimDataBlockForIndex(indexes[indexNumber]);
+        if (cacheBlock == -1)
+        {
+            // Everything in the shard is pinned, the readers need the cache more than we do.
+            break;
+        }
+        indexesToFetch.push_back(indexes[indexNumber]);
+        cacheBlocksToFetch.push_back(cacheBlock);
+    }
+    
+    if (indexesToFetch.empty())
+    {
+        return;
+    }
+    cacheStatistics.countReadAheadBlocks(indexesToFetch.size());
+    
+    std::vector<ssize_t> bytesRead(indexesToFetch.size());
+    fetchDataBlocksForIndexes(indexesToFetch.data(), cacheBlocksToFetch.data(), bytesRead.data(), indexesToFetch.size());
+    if (isMemoryMapped)
+    {
+        // Mapping a window does not read anything, ask the kernel to start loading the windows.
+        for (size_t blockNumber = 0; blockNumber < indexesToFetch.size(); blockNumber++)
+        {
+            if (bytesRead[blockNumber] > 0)
+            {
+                madvise(&blockCache->cacheBlocks[cacheBlocksToFetch[blockNumber] * cacheBlockSize], cacheBlockSize, MADV_WILLNEED);
+            }
+        }
+    }
+    
+    for (size_t blockNumber = 0; blockNumber < indexesToFetch.size(); blockNumber++)
+    {
+        std::lock_guard<std::mutex> lock(blockCache->shardForCacheBlock(cacheBlocksToFetch[blockNumber]).shardMutex);
+        if (completeFetchForCacheBlock(cacheBlocksToFetch[blockNumber], bytesRead[blockNumber]))
+        {
+            // We don't use the data ourselves, so unpin it immediately. completeFetchForCacheBlock has
+            // woken up the readers that wait for the shard.
+            blockCache->cacheBlockEntries[cacheBlocksToFetch[blockNumber]].pinCount--;
+        }
+    }
+}
+
+void LargeFileReaderCore::updateReadAhead(off_t fileOffset, size_t numberOfBytesRead)
+{
+    int64_t maximumWindow = readAheadMaximumBlocks;
+    if (maximumWindow > (blockCache->maxNumberOfCachedBlocks / 2))
+    {
+        maximumWindow = blockCache->maxNumberOfCachedBlocks / 2;
+    }
+    
+    bool isSequential = (fileOffset == readAheadExpectedFileOffset);
+    readAheadExpectedFileOffset = fileOffset + numberOfBytesRead;
+    
+    if (!isSequential || (numberOfBytesRead == 0) || (maximumWindow < 1))
+    {
+        memoryMappingAdvice = MADV_RANDOM;
+        
+        if (readAheadWindow != 0)
+        {
+            // Random access, stop reading ahead.
+            std::lock_guard<std::mutex> lock(readAheadMutex);
+            readAheadQueue.clear();
+            readAheadWindow = 0;
+            readAheadLastQueuedIndex = -1;
+        }
+        return;
+    }
+    
+    // Index of the last block that the reader used.
+    int64_t currentIndex = (readAheadExpectedFileOffset - 1) / cacheBlockSize;
+    
+    if (readAheadWindow == 0)
+    {
+        readAheadWindow = 2;
+        memoryMappingAdvice = MADV_SEQUENTIAL;
+    }
+    else if ((currentIndex + (readAheadWindow / 2)) < readAheadLastQueuedIndex)
+    {
+        // We are still far enough ahead of the reader.
+        return;
+    }
+    else if (readAheadWindow < maximumWindow)
+    {
+        readAheadWindow *= 2;
+    }
+    if (readAheadWindow > maximumWindow)
+    {
+        readAheadWindow = maximumWindow;
+    }
+    
+    int64_t firstIndexToQueue = std::max(currentIndex, readAheadLastQueuedIndex) + 1;
+    int64_t lastIndexToQueue = std::min(currentIndex + readAheadWindow, totalNumberOfFileCacheIndexEntries - 1);
+    if (firstIndexToQueue > lastIndexToQueue)
+    {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(readAheadMutex);
+        for (int64_t index = firstIndexToQueue; index <= lastIndexToQueue; index++)
+        {
+            readAheadQueue.push_back(index);
+        }
+    }
+    readAheadLastQueuedIndex = lastIndexToQueue;
+    
+    if (!readAheadThread.joinable())
+    {
+        readAheadThread = std::thread(&LargeFileReaderCore::readAheadThreadMain, this);
+    }
+    readAheadCondition.notify_one();
+}
+
+void LargeFileReaderCore::stopReadAhead()
+{
+    {
+        std::lock_guard<std::mutex> lock(readAheadMutex);
+        readAheadStop = true;
+        readAheadQueue.clear();
+    }
+    readAheadCondition.notify_one();
+    
+    if (readAheadThread.joinable())
+    {
+        readAheadThread.join();
+    }
+    
+    readAheadStop = false;
+}
+
+void LargeFileReaderCore::readAheadThreadMain()
+{
+    std::vector<int64_t> indexes;
+    
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(readAheadMutex);
+            readAheadCondition.wait(lock, [this] { return readAheadStop || !readAheadQueue.empty(); });
+            if (readAheadStop)
+            {
+                return;
+            }
+            
+            // Take as much as we can fetch in one batch.
+            indexes.clear();
+            while (!readAheadQueue.empty() && ((int64_t)indexes.size() < maximumFetchBatchBlocks))
+            {
+                indexes.push_back(readAheadQueue.front());
+                readAheadQueue.pop_front();
+            }
+        }
+        
+        prefetchDataBlocksForIndexes(indexes.data(), indexes.size());
+    }
+}
@@ -0,0 +1,190 @@
+//
+//  LineDelimiterScanner.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LINEDELIMITERSCANNER_HAS_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LINEDELIMITERSCANNER_HAS_NEON 1
+#endif
+
+#include "LineDelimiterScanner.hpp"
+
+typedef size_t (*FindDelimitersFunction)(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions);
+
+// MARK: - Portable
+
+// Used for whatever is left after the last full vector, and on machines without vector support.
+static size_t findDelimitersPortable(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions, size_t baseOffset)
+{
+    size_t numberOfDelimiters = 0;
+
+    const unsigned char* end = data + length;
+    const unsigned char* search = data;
+    while (search < end)
+    {
+        const unsigned char* found = (const unsigned char*)memchr(search, delimiter, end - search);
+        if (found == nullptr)
+        {
+            break;
+        }
+        positions[numberOfDelimiters++] = (uint32_t)(baseOffset + (found - data));
+        search = found + 1;
+    }
+
+    return numberOfDelimiters;
+}
+
+static size_t findDelimitersPortable(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions)
+{
+    return findDelimitersPortable(data, length, delimiter, positions, 0);
+}
+
+// Hand out the positions of the bits that are set in mask, one bit per byte starting at offset.
+static inline size_t storePositionsForMask(uint64_t mask, size_t offset, uint32_t* positions)
+{
+    size_t numberOfDelimiters = 0;
+    while (mask != 0)
+    {
+        positions[numberOfDelimiters++] = (uint32_t)(offset + __builtin_ctzll(mask));
+        mask &= mask - 1;
+    }
+    return numberOfDelimiters;
+}
+
+#if LINEDELIMITERSCANNER_HAS_X86
+
+// MARK: - SSE2
+
+__attribute__((target("sse2")))
+static size_t findDelimitersSSE2(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions)
+{
+    size_t numberOfDelimiters = 0;
+    const __m128i pattern = _mm_set1_epi8((char)delimiter);
+
+    size_t offset = 0;
+    for (; (offset + 32) <= length; offset += 32)
+    {
+        __m128i low = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[offset]), pattern);
+        __m128i high = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[offset + 16]), pattern);
+        uint64_t mask = (uint32_t)_mm_movemask_epi8(low) | ((uint64_t)(uint32_t)_mm_movemask_epi8(high) << 16);
+        if (mask != 0)
+        {
+            numberOfDelimiters += storePositionsForMask(mask, offset, &positions[numberOfDelimiters]);
+        }
+    }
+
+    return numberOfDelimiters + findDelimitersPortable(&data[offset], length - offset, delimiter, &positions[numberOfDelimiters], offset);
+}
+
+// MARK: - AVX2
+
+__attribute__((target("avx2")))
+static size_t findDelimitersAVX2(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions)
+{
+    size_t numberOfDelimiters = 0;
+    const __m256i pattern = _mm256_set1_epi8((char)delimiter);
+
+    // Two vectors per iteration, so that a 64 bit mask covers the whole step.
+    size_t offset = 0;
+    for (; (offset + 64) <= length; offset += 64)
+    {
+        __m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)&data[offset]), pattern);
+        __m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)&data[offset + 32]), pattern);
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(low) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(high) << 32);
+        if (mask != 0)
+        {
+            numberOfDelimiters += storePositionsForMask(mask, offset, &positions[numberOfDelimiters]);
+        }
+    }
+
+    return numberOfDelimiters + findDelimitersPortable(&data[offset], length - offset, delimiter, &positions[numberOfDelimiters], offset);
+}
+
+#endif /* LINEDELIMITERSCANNER_HAS_X86 */
+
+#if LINEDELIMITERSCANNER_HAS_NEON
+
+// MARK: - NEON
+
+static size_t findDelimitersNEON(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions)
+{
+    size_t numberOfDelimiters = 0;
+    const uint8x16_t pattern = vdupq_n_u8(delimiter);
+
+    // NEON has no movemask. Narrowing the compare result by 4 bits per 16 bit lane gives a 64 bit mask
+    // with 4 bits per byte, which is just as good for finding the positions.
+    size_t offset = 0;
+    for (; (offset + 16) <= length; offset += 16)
+    {
+        uint8x16_t matches = vceqq_u8(vld1q_u8(&data[offset]), pattern);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+        while (mask != 0)
+        {
+            positions[numberOfDelimiters++] = (uint32_t)(offset + (__builtin_ctzll(mask) >> 2));
+            mask &= ~((uint64_t)0xF << (__builtin_ctzll(mask) & ~3));
+        }
+    }
+
+    return numberOfDelimiters + findDelimitersPortable(&data[offset], length - offset, delimiter, &positions[numberOfDelimiters], offset);
+}
+
+#endif /* LINEDELIMITERSCANNER_HAS_NEON */
+
+// MARK: - Dispatch
+
+static LineDelimiterScanner::InstructionSet selectInstructionSet()
+{
+#if LINEDELIMITERSCANNER_HAS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return LineDelimiterScanner::InstructionSetAVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return LineDelimiterScanner::InstructionSetSSE2;
+    }
+#elif LINEDELIMITERSCANNER_HAS_NEON
+    return LineDelimiterScanner::InstructionSetNEON;
+#endif
+    return LineDelimiterScanner::InstructionSetPortable;
+}
+
+static FindDelimitersFunction findDelimitersFunctionForInstructionSet(LineDelimiterScanner::InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#if LINEDELIMITERSCANNER_HAS_X86
+        case LineDelimiterScanner::InstructionSetAVX2:
+            return findDelimitersAVX2;
+        case LineDelimiterScanner::InstructionSetSSE2:
+            return findDelimitersSSE2;
+#endif
+#if LINEDELIMITERSCANNER_HAS_NEON
+        case LineDelimiterScanner::InstructionSetNEON:
+            return findDelimitersNEON;
+#endif
+        default:
+            return findDelimitersPortable;
+    }
+}
+
+LineDelimiterScanner::InstructionSet LineDelimiterScanner::instructionSet()
+{
+    static const InstructionSet selectedInstructionSet = selectInstructionSet();
+    return selectedInstructionSet;
+}
+
+size_t LineDelimiterScanner::findDelimiters(const unsigned char* data, size_t length, uint8_t delimiter, uint32_t* positions)
+{
+    static const FindDelimitersFunction findDelimitersFunction = findDelimitersFunctionForInstructionSet(instructionSet());
+    return findDelimitersFunction(data, length, delimiter, positions);
+}
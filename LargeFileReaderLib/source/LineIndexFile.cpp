@@ -0,0 +1,274 @@
+//
+//  LineIndexFile.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "LineIndexFile.hpp"
+
+static const char lineIndexFileMagic[8] = { 'L', 'F', 'R', 'L', 'I', 'D', 'X', '\0' };
+
+// Write all of the data, or fail.
+static bool writeAll(int fileDescriptor, const void* data, size_t length, off_t fileOffset)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (length > 0)
+    {
+        ssize_t bytesWritten = ::pwrite(fileDescriptor, bytes, length, fileOffset);
+        if (bytesWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        bytes += bytesWritten;
+        length -= bytesWritten;
+        fileOffset += bytesWritten;
+    }
+    return true;
+}
+
+LineIndexFile::LineIndexFile()
+{
+
+}
+
+LineIndexFile::~LineIndexFile()
+{
+    unmap();
+}
+
+uint64_t LineIndexFile::checksum(const void* data, size_t length)
+{
+    // FNV-1a. We only need to notice that a file changed, not protect against anyone.
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t byteNumber = 0; byteNumber < length; byteNumber++)
+    {
+        hash ^= bytes[byteNumber];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t LineIndexFile::checksumForHeader(const Header& header)
+{
+    return checksum(&header, offsetof(Header, headerChecksum));
+}
+
+bool LineIndexFile::identityForFile(LargeFileReaderCore* reader, FileIdentity& identity)
+{
+    if (!reader->isOpen)
+    {
+        return false;
+    }
+
+    const struct stat& fileStatus = reader->openFileStatus();
+
+    // The size of the data that we index, which for a compressed file is not the size of the file.
+    off_t fileSize = reader->fileSize();
+
+    memset(&identity, 0, sizeof(identity));
+    identity.fileSize = fileSize;
+#if defined(__APPLE__)
+    identity.modificationTimeSeconds = fileStatus.st_mtimespec.tv_sec;
+    identity.modificationTimeNanoseconds = fileStatus.st_mtimespec.tv_nsec;
+#else
+    identity.modificationTimeSeconds = fileStatus.st_mtim.tv_sec;
+    identity.modificationTimeNanoseconds = fileStatus.st_mtim.tv_nsec;
+#endif
+    identity.inode = fileStatus.st_ino;
+
+    // The modification time can be set back, so also look at the data at both ends of the file. This
+    // goes through the reader's cache, so it costs nothing if we are going to read there anyway.
+    std::vector<unsigned char> block(checksumBlockSize);
+
+    size_t bytesRead = reader->readAt(0, block.data(), checksumBlockSize);
+    if (bytesRead == (size_t)-1)
+    {
+        return false;
+    }
+    identity.firstBlockChecksum = checksum(block.data(), bytesRead);
+
+    off_t lastBlockOffset = std::max((off_t)0, fileSize - (off_t)checksumBlockSize);
+    bytesRead = reader->readAt(lastBlockOffset, block.data(), checksumBlockSize);
+    if (bytesRead == (size_t)-1)
+    {
+        return false;
+    }
+    identity.lastBlockChecksum = checksum(block.data(), bytesRead);
+
+    return true;
+}
+
+bool LineIndexFile::write(const std::string& lineIndexFilePath, const FileIdentity& identity, const IndexSettings& settings, int64_t numberOfLines, const std::function<void(int64_t lineNumber, off_t& offset, size_t& length)>& entryForLine)
+{
+    if (numberOfLines < 0)
+    {
+        return false;
+    }
+
+    std::string temporaryFilePath = lineIndexFilePath + ".tmp" + std::to_string(getpid());
+
+    int fileDescriptor = ::open(temporaryFilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, lineIndexFileMagic, sizeof(header.magic));
+    header.version = currentVersion;
+    header.entriesPerPage = entriesPerPage;
+    header.numberOfLines = numberOfLines;
+    header.numberOfPages = (numberOfLines + entriesPerPage - 1) / entriesPerPage;
+    header.settings = settings;
+    header.identity = identity;
+    header.headerChecksum = checksumForHeader(header);
+
+    bool isWritten = writeAll(fileDescriptor, &header, sizeof(header), 0);
+
+    Page page;
+    for (uint64_t pageNumber = 0; isWritten && (pageNumber < header.numberOfPages); pageNumber++)
+    {
+        memset(&page, 0, sizeof(page));
+
+        int64_t firstLineNumber = pageNumber * entriesPerPage;
+        int64_t numberOfLinesInPage = std::min((int64_t)entriesPerPage, numberOfLines - firstLineNumber);
+        for (int64_t entryNumber = 0; entryNumber < numberOfLinesInPage; entryNumber++)
+        {
+            off_t offset;
+            size_t length;
+            entryForLine(firstLineNumber + entryNumber, offset, length);
+
+            if (entryNumber == 0)
+            {
+                page.firstOffset = offset;
+            }
+
+            // A page covers at most entriesPerPage lines of at most the maximum line length, so this
+            // only fails with absurd maximum line lengths.
+            uint64_t relativeOffset = offset - page.firstOffset;
+            if ((relativeOffset > UINT32_MAX) || (length > UINT32_MAX))
+            {
+                isWritten = false;
+                break;
+            }
+            page.relativeOffsets[entryNumber] = (uint32_t)relativeOffset;
+            page.lengths[entryNumber] = (uint32_t)length;
+        }
+
+        isWritten = isWritten && writeAll(fileDescriptor, &page, sizeof(page), pagesOffset + (pageNumber * sizeof(Page)));
+    }
+
+    if (::close(fileDescriptor) != 0)
+    {
+        isWritten = false;
+    }
+
+    if (!isWritten || (::rename(temporaryFilePath.c_str(), lineIndexFilePath.c_str()) != 0))
+    {
+        ::unlink(temporaryFilePath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool LineIndexFile::map(const std::string& lineIndexFilePath, const FileIdentity& identity, const IndexSettings& settings)
+{
+    unmap();
+
+    int fileDescriptor = ::open(lineIndexFilePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat lineIndexFileStatus;
+    if ((fstat(fileDescriptor, &lineIndexFileStatus) != 0) || (lineIndexFileStatus.st_size < (off_t)sizeof(Header)))
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    void* newMapping = mmap(NULL, lineIndexFileStatus.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    // The mapping keeps the file alive.
+    ::close(fileDescriptor);
+    if (newMapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const Header* newHeader = (const Header*)newMapping;
+
+    bool isValid = (memcmp(newHeader->magic, lineIndexFileMagic, sizeof(newHeader->magic)) == 0) &&
+                   (newHeader->version == currentVersion) &&
+                   (newHeader->entriesPerPage == entriesPerPage) &&
+                   (newHeader->headerChecksum == checksumForHeader(*newHeader)) &&
+                   (newHeader->numberOfPages == ((newHeader->numberOfLines + entriesPerPage - 1) / entriesPerPage)) &&
+                   ((uint64_t)lineIndexFileStatus.st_size == ((newHeader->numberOfPages == 0) ? sizeof(Header) : pagesOffset + (newHeader->numberOfPages * sizeof(Page)))) &&
+                   (newHeader->settings.maximumLineLength == settings.maximumLineLength) &&
+                   (newHeader->settings.lineDelimiterLength == settings.lineDelimiterLength) &&
+                   (memcmp(newHeader->settings.lineDelimiter, settings.lineDelimiter, sizeof(settings.lineDelimiter)) == 0) &&
+                   (memcmp(&newHeader->identity, &identity, sizeof(identity)) == 0);
+
+    if (!isValid)
+    {
+        munmap(newMapping, lineIndexFileStatus.st_size);
+        return false;
+    }
+
+    mapping = newMapping;
+    mappingSize = lineIndexFileStatus.st_size;
+    header = newHeader;
+    pages = (const Page*)((const unsigned char*)mapping + pagesOffset);
+
+    return true;
+}
+
+void LineIndexFile::unmap()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    pages = nullptr;
+}
+
+bool LineIndexFile::isMapped() const
+{
+    return mapping != nullptr;
+}
+
+int64_t LineIndexFile::numberOfLines() const
+{
+    return (header != nullptr) ? header->numberOfLines : 0;
+}
+
+void LineIndexFile::entryForLine(int64_t lineNumber, off_t& offset, size_t& length) const
+{
+    const Page& page = pages[lineNumber / entriesPerPage];
+    uint32_t entryNumber = lineNumber % entriesPerPage;
+
+    offset = page.firstOffset + page.relativeOffsets[entryNumber];
+    length = page.lengths[entryNumber];
+}
@@ -6,3 +6,222 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "LineIndexer.h"
+#import "LargeFileReader_Private.h"
+#import "LineIndexer_Private.h"
+
+#include <vector>
+#include <algorithm>
+
+@interface LineIndexer()
+
+// Keeps the reader (and its core) alive for as long as we use it.
+@property (nonatomic, strong) LargeFileReader *largeFileReader;
+
+@end
+
+@implementation LineIndexer
+
+- (instancetype)initWithReader:(LargeFileReader *)largeFileReader
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _lineIndexerCore = new LineIndexerCore;
+        _largeFileReader = largeFileReader;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    delete _lineIndexerCore;
+    _lineIndexerCore = nil;
+}
+
+- (NSData *)lineDelimiter
+{
+    const std::string& lineDelimiter = self.lineIndexerCore->lineDelimiter;
+    return [NSData dataWithBytes:lineDelimiter.data() length:lineDelimiter.size()];
+}
+
+- (void)setLineDelimiter:(NSData *)lineDelimiter
+{
+    self.lineIndexerCore->lineDelimiter = std::string((const char *)lineDelimiter.bytes, lineDelimiter.length);
+}
+
+- (NSInteger)maximumLineLength
+{
+    return self.lineIndexerCore->maximumLineLength;
+}
+
+- (void)setMaximumLineLength:(NSInteger)maximumLineLength
+{
+    self.lineIndexerCore->maximumLineLength = MAX(maximumLineLength, 1);
+}
+
+- (NSInteger)numberOfIndexingThreads
+{
+    return self.lineIndexerCore->numberOfIndexingThreads;
+}
+
+- (void)setNumberOfIndexingThreads:(NSInteger)numberOfIndexingThreads
+{
+    self.lineIndexerCore->numberOfIndexingThreads = numberOfIndexingThreads;
+}
+
+- (NSInteger)parallelIndexingChunkSize
+{
+    return self.lineIndexerCore->parallelIndexingChunkSize;
+}
+
+- (void)setParallelIndexingChunkSize:(NSInteger)parallelIndexingChunkSize
+{
+    self.lineIndexerCore->parallelIndexingChunkSize = MAX(parallelIndexingChunkSize, 1);
+}
+
+- (NSInteger)lineCheckpointInterval
+{
+    return self.lineIndexerCore->lineCheckpointInterval;
+}
+
+- (void)setLineCheckpointInterval:(NSInteger)lineCheckpointInterval
+{
+    self.lineIndexerCore->lineCheckpointInterval = lineCheckpointInterval;
+}
+
+- (NSInteger)numberOfLines
+{
+    return self.lineIndexerCore->numberOfLines;
+}
+
+- (BOOL)indexLines
+{
+    return self.lineIndexerCore->indexLinesForFileReader(self.largeFileReader.largeFileReaderCore) == 0;
+}
+
+- (BOOL)indexNewLines
+{
+    return self.lineIndexerCore->indexNewLinesForFileReader(self.largeFileReader.largeFileReaderCore) == 0;
+}
+
+- (BOOL)saveLineIndex:(NSString *)lineIndexFilePath
+{
+    return self.lineIndexerCore->saveLineIndexForFileReader(self.largeFileReader.largeFileReaderCore, [lineIndexFilePath fileSystemRepresentation]);
+}
+
+- (BOOL)loadLineIndex:(NSString *)lineIndexFilePath
+{
+    return self.lineIndexerCore->loadLineIndexForFileReader(self.largeFileReader.largeFileReaderCore, [lineIndexFilePath fileSystemRepresentation]);
+}
+
+- (NSData *)lineAt:(NSInteger)lineNumber
+{
+    LargeFileReaderCore *largeFileReaderCore = self.largeFileReader.largeFileReaderCore;
+    
+    if ((lineNumber < 0) || (lineNumber >= self.lineIndexerCore->numberOfLines))
+    {
+        return nil;
+    }
+    
+    LineIndexerCore::LineIndexEntry lineIndexEntry;
+    if (self.lineIndexerCore->lineEntryForLine(largeFileReaderCore, lineNumber, lineIndexEntry) != 0)
+    {
+        return nil;
+    }
+    if (lineIndexEntry.length == 0)
+    {
+        return [NSData data];
+    }
+    
+    // Most lines are in a single cache block, then we hand out the data where it is, like viewAt:.
+    LargeFileReaderCore::FileDataView view;
+    size_t viewLength = largeFileReaderCore->acquireView(lineIndexEntry.offset, lineIndexEntry.length, view);
+    if (viewLength == (size_t)-1)
+    {
+        return nil;
+    }
+    if (viewLength == lineIndexEntry.length)
+    {
+        LargeFileReader *largeFileReader = self.largeFileReader;
+        return [[NSData alloc] initWithBytesNoCopy:(void *)view.data length:view.length deallocator:^(void *bytes, NSUInteger length) {
+            LargeFileReaderCore::FileDataView releasedView = view;
+            largeFileReader.largeFileReaderCore->releaseView(releasedView);
+        }];
+    }
+    
+    // The line crosses a block boundary, copy it.
+    largeFileReaderCore->releaseView(view);
+    NSMutableData *line = [NSMutableData dataWithLength:lineIndexEntry.length];
+    if (largeFileReaderCore->readAt(lineIndexEntry.offset, (unsigned char *)line.mutableBytes, lineIndexEntry.length) != lineIndexEntry.length)
+    {
+        return nil;
+    }
+    return line;
+}
+
+- (NSArray<NSData *> *)linesFrom:(NSInteger)firstLineNumber count:(NSInteger)count
+{
+    LargeFileReaderCore *largeFileReaderCore = self.largeFileReader.largeFileReaderCore;
+    int64_t numberOfLines = self.lineIndexerCore->numberOfLines;
+    
+    if ((firstLineNumber < 0) || (firstLineNumber > numberOfLines) || (count < 0))
+    {
+        return nil;
+    }
+    count = std::min((int64_t)count, numberOfLines - firstLineNumber);
+    if (count == 0)
+    {
+        return @[];
+    }
+    
+    // Find out how much room the lines take, and read all of them at once.
+    std::vector<LineIndexerCore::LineIndexEntry> lineIndexEntries(count);
+    if (self.lineIndexerCore->lineEntriesForLines(largeFileReaderCore, firstLineNumber, count, lineIndexEntries.data()) != 0)
+    {
+        return nil;
+    }
+    off_t startOffset = lineIndexEntries.front().offset;
+    size_t numberOfBytes = lineIndexEntries.back().offset + lineIndexEntries.back().length - startOffset;
+    
+    NSMutableData *allLines = [NSMutableData dataWithLength:numberOfBytes];
+    if (largeFileReaderCore->readAt(startOffset, (unsigned char *)allLines.mutableBytes, numberOfBytes) != numberOfBytes)
+    {
+        return nil;
+    }
+    
+    NSMutableArray<NSData *> *lines = [NSMutableArray arrayWithCapacity:count];
+    for (const LineIndexerCore::LineIndexEntry& lineIndexEntry : lineIndexEntries)
+    {
+        [lines addObject:[allLines subdataWithRange:NSMakeRange(lineIndexEntry.offset - startOffset, lineIndexEntry.length)]];
+    }
+    return lines;
+}
+
+- (void)enumerateLinesFrom:(NSInteger)firstLineNumber reverse:(BOOL)reverse usingBlock:(void (^)(NSInteger lineNumber, NSData *line, BOOL *stop))block
+{
+    LineIndexerCore::LineIterator lineIterator(self.lineIndexerCore, self.largeFileReader.largeFileReaderCore, firstLineNumber);
+    
+    BOOL stop = NO;
+    while (lineIterator.isAtLine() && !stop)
+    {
+        @autoreleasepool
+        {
+            NSData *line = (lineIterator.lineLength() == 0) ? [NSData data] : [[NSData alloc] initWithBytesNoCopy:(void *)lineIterator.lineData() length:lineIterator.lineLength() freeWhenDone:NO];
+            block(lineIterator.lineNumber(), line, &stop);
+        }
+        
+        if (reverse)
+        {
+            lineIterator.moveToPreviousLine();
+        }
+        else
+        {
+            lineIterator.moveToNextLine();
+        }
+    }
+}
+
+@end
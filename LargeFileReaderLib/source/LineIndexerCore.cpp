@@ -11,9 +11,15 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <cassert>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <algorithm>
 
 #include "LineIndexerCore.hpp"
+#include "LineDelimiterScanner.hpp"
 #include "FixedBlockAllocatedArray.hpp"
+#include "WorkerPool.hpp"
 
 LineIndexerCore::LineIndexerCore()
 {
@@ -25,75 +31,964 @@ LineIndexerCore::~LineIndexerCore()
     
 }
 
+// Strategy:
+//
+// We walk through the file with views into the reader's cache, so the data is never copied. Each view
+// is searched for delimiters in slices of scanSliceSize bytes by LineDelimiterScanner, which uses the
+// widest vector instructions that the machine has, and gives us the positions of all delimiters in the
+// slice at once. A line is simply everything from the end of the previous delimiter up to the start of
+// the next one, so lines that cross a view or cache block boundary need no special handling.
+//
+// A delimiter of more than one byte (like "\r\n") is found by its last byte, which is then checked
+// against the bytes before it. Those can be in the previous view, and so in another cache block, so
+// we keep the last few bytes of every view around. All of this is in the scan loop for delimiters of
+// more than one byte only: the scan loop is a template, and the one for single byte delimiters is
+// exactly what it was before.
+//
+// Large files are indexed in parallel, a window of a few chunks per thread at a time, in three passes:
+//
+// 1. Every chunk of the file is searched for delimiters on its own, on the worker pool. This is where
+//    all the data is touched, the rest only looks at the delimiter positions. A delimiter belongs to
+//    the chunk that its last byte is in. A delimiter that can overlap itself (like "\n\n") can only be
+//    found by scanning from a line start, the file is then indexed sequentially.
+// 2. Where the first line of a chunk starts depends on the chunks before it (the line can start many
+//    chunks back). Walking the chunks in order, using only their last delimiter, tells us.
+// 3. Now every chunk can count its entries (long lines take more than one), a prefix sum over the
+//    counts gives every chunk the entry where its lines go, and the chunks fill in the index in
+//    parallel.
+//
+// The next window starts where the last line of this one started, with the entry after its last one.
+// Only the delimiter positions of a window are kept, so indexing doesn't take memory for every line of
+// the file on top of the index, which matters most for a sparse index that is much smaller.
+
 int LineIndexerCore::indexLinesForFileReader(LargeFileReaderCore* reader)
 {
     assert(reader != NULL);
 
-    if (!reader->isOpen)
+    if (!reader->isOpen || !hasValidLineDelimiter())
     {
         return -1;
     }
     
-    // Allocate enough space for 2 full buffers
+    off_t fileSize = reader->fileSize();
+    
+    loadedLineIndexFile.unmap();
+    resetIndex(validLineCheckpointInterval());
+    
+    // Delimiter positions in a chunk are 32 bits.
+    size_t chunkSize = std::min(std::max(parallelIndexingChunkSize, scanSliceSize), (size_t)UINT32_MAX);
+    
+    int result;
+    if ((numberOfIndexingThreads == 1) || ((size_t)fileSize <= chunkSize) || lineDelimiterCanOverlapItself(lineDelimiter))
+    {
+        result = indexLinesSequentially(reader, fileSize);
+    }
+    else
+    {
+        result = indexLinesInParallel(reader, fileSize, chunkSize);
+    }
     
-    uint8_t buffer[reader->cacheBlockSize];
-    size_t totalNumberOfBytesInBuffer;
+    indexedFileSize = (result == 0) ? fileSize : 0;
+    
+    return result;
+}
 
-    // Start from file position 0.
-    reader->lseek(0, SEEK_SET);
+// Strategy (indexNewLinesForFileReader):
+//
+// Lines are only ever added at the end of the file, so everything up to the last line stays as it is.
+// The last line is different: if the file did not end with a delimiter, the line was not complete, and
+// the new data may continue it. We recognize that line by its last entry, which then ends at the end
+// of what we indexed (a complete line ends at its delimiter, before that). We drop that one entry and
+// index again from where it starts. Its earlier entries (if it was cut into pieces) stay valid, as a
+// long line is always cut at multiples of maximumLineLength from where it starts. This also takes care
+// of a file that ended in the first part of a delimiter of more than one byte.
 
-    // Initially read two full buffers
-    size_t lastNumberOfBytesRead;
+int LineIndexerCore::indexNewLinesForFileReader(LargeFileReaderCore* reader)
+{
+    assert(reader != NULL);
+    
+    if (!reader->isOpen)
+    {
+        return -1;
+    }
+    if (numberOfLines < 0)
+    {
+        return indexLinesForFileReader(reader);
+    }
+    
+    off_t fileSize = reader->fileSize();
+    if (fileSize < indexedFileSize)
+    {
+        return -1;
+    }
+    
+    if (loadedLineIndexFile.isMapped())
+    {
+        resetIndex(validLineCheckpointInterval());
+        for (int64_t lineNumber = 0; lineNumber < numberOfLines; lineNumber++)
+        {
+            LineIndexEntry lineIndexEntry;
+            loadedLineIndexFile.entryForLine(lineNumber, lineIndexEntry.offset, lineIndexEntry.length);
+            storeEntry(lineNumber, lineIndexEntry.offset, lineIndexEntry.length);
+        }
+        loadedLineIndexFile.unmap();
+    }
+    
+    if (fileSize == indexedFileSize)
+    {
+        return 0;
+    }
+    
+    off_t startOffset = indexedFileSize;
+    if (numberOfLines > 0)
+    {
+        LineIndexEntry lastLineIndexEntry;
+        if (lineEntryForLine(reader, numberOfLines - 1, lastLineIndexEntry) != 0)
+        {
+            return -1;
+        }
+        if ((off_t)(lastLineIndexEntry.offset + lastLineIndexEntry.length) == indexedFileSize)
+        {
+            startOffset = lastLineIndexEntry.offset;
+            numberOfLines--;
+        }
+    }
+    
+    if (indexLinesInRange(reader, startOffset, fileSize) != 0)
+    {
+        indexedFileSize = 0;
+        return -1;
+    }
+    
+    indexedFileSize = fileSize;
+    
+    return 0;
+}
 
-    lastNumberOfBytesRead = reader->read(&buffer[0], reader->cacheBlockSize);
-    totalNumberOfBytesInBuffer = lastNumberOfBytesRead;
-    lastNumberOfBytesRead = reader->read(&buffer[reader->cacheBlockSize], reader->cacheBlockSize);
-    totalNumberOfBytesInBuffer += lastNumberOfBytesRead;
+int LineIndexerCore::lineEntryForLine(LargeFileReaderCore* reader, int64_t lineNumber, LineIndexEntry& lineIndexEntry) const
+{
+    return lineEntriesForLines(reader, lineNumber, 1, &lineIndexEntry);
+}
+
+int LineIndexerCore::lineEntriesForLines(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, LineIndexEntry* lineIndexEntries) const
+{
+    assert((firstLineNumber >= 0) && (numberOfLinesWanted >= 0) && ((firstLineNumber + numberOfLinesWanted) <= numberOfLines));
     
-    bool hasDataToProcess = totalNumberOfBytesInBuffer > 0;
+    if (loadedLineIndexFile.isMapped())
+    {
+        for (int64_t entryNumber = 0; entryNumber < numberOfLinesWanted; entryNumber++)
+        {
+            loadedLineIndexFile.entryForLine(firstLineNumber + entryNumber, lineIndexEntries[entryNumber].offset, lineIndexEntries[entryNumber].length);
+        }
+        return 0;
+    }
+    
+    if (indexedLineCheckpointInterval > 1)
+    {
+        return lineEntriesFromCheckpoint(reader, firstLineNumber, numberOfLinesWanted, lineIndexEntries);
+    }
+    
+    for (int64_t entryNumber = 0; entryNumber < numberOfLinesWanted; entryNumber++)
+    {
+        lineIndexEntries[entryNumber] = lineIndex[firstLineNumber + entryNumber];
+    }
+    return 0;
+}
 
-    uint64_t currentLineNumber = 0;
-    off_t currentStartOfLineInBuffer = 0;
-    off_t currentSearchIndexInbuffer = 0;
+// Strategy (sparse index):
+//
+// A checkpoint is the offset of a line, and lines are only cut at delimiters and at multiples of
+// maximumLineLength from where a line starts. So from a checkpoint on, we can find every next line
+// exactly like indexing does: scan for delimiters with LineDelimiterScanner, through views into the
+// reader's cache, and count the entries that every line takes until we get to the ones that we want.
+// The lines after a checkpoint are usually in the same cache block, so this costs a scan of a few
+// kilobytes that are already in memory.
+
+int LineIndexerCore::lineEntriesFromCheckpoint(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, LineIndexEntry* lineIndexEntries) const
+{
+    assert(reader != NULL);
+    
+    if (numberOfLinesWanted == 0)
+    {
+        return 0;
+    }
+    
+    int64_t checkpointNumber = firstLineNumber / indexedLineCheckpointInterval;
+    
+    off_t startOfLine = offsetOfCheckpoint(checkpointNumber);
+    // The entry that we want next, counted in entries from startOfLine. Can be beyond the line.
+    int64_t entryNumberInLine = firstLineNumber - (checkpointNumber * indexedLineCheckpointInterval);
+    int64_t numberOfLinesFound = 0;
+    
+    off_t maximumLength = indexedMaximumLineLength;
+    off_t delimiterLength = indexedLineDelimiter.size();
     
-    while (hasDataToProcess)
+    auto addEntry = [&](off_t endOfLine)
     {
-        // Scan the buffer for our end-of-line marker, or until we have reached a maximum line length.
-        bool lineEndFound = false;
+        off_t offset = startOfLine + (entryNumberInLine * maximumLength);
+        lineIndexEntries[numberOfLinesFound].offset = offset;
+        lineIndexEntries[numberOfLinesFound].length = std::min(maximumLength, endOfLine - offset);
+        numberOfLinesFound++;
+        entryNumberInLine++;
+    };
+    // Add the entries that we want of the line from startOfLine to endOfLine, and go to the next line.
+    // Returns true when we have all entries.
+    auto addEntriesOfLine = [&](off_t endOfLine, off_t startOfNextLine)
+    {
+        int64_t numberOfEntries = numberOfEntriesForLine(endOfLine - startOfLine);
+        while ((entryNumberInLine < numberOfEntries) && (numberOfLinesFound < numberOfLinesWanted))
+        {
+            addEntry(endOfLine);
+        }
+        entryNumberInLine -= numberOfEntries;
+        startOfLine = startOfNextLine;
+        return numberOfLinesFound == numberOfLinesWanted;
+    };
+    // Pieces of a long line that we have seen the whole of are full length, whatever follows. We don't
+    // have to scan to the end of a very long line for them. The line can end in a delimiter that
+    // starts before fileOffset though.
+    auto addFullLengthEntries = [&](off_t fileOffset)
+    {
+        while (((fileOffset - (delimiterLength - 1)) >= (startOfLine + ((entryNumberInLine + 1) * maximumLength))) && (numberOfLinesFound < numberOfLinesWanted))
+        {
+            addEntry(fileOffset);
+        }
+        return numberOfLinesFound == numberOfLinesWanted;
+    };
+    
+    uint32_t delimiterPositions[lookupScanSliceSize];
+    
+    int result = scanForDelimiters(reader, startOfLine, indexedFileSize, startOfLine, lookupScanSliceSize, delimiterPositions, addEntriesOfLine, addFullLengthEntries);
+    if (result != 0)
+    {
+        return (result == 1) ? 0 : -1;
+    }
+    
+    // The last line does not need to end with a delimiter.
+    if ((startOfLine < indexedFileSize) && addEntriesOfLine(indexedFileSize, indexedFileSize))
+    {
+        return 0;
+    }
+    
+    // The file is not what it was when it was indexed.
+    return -1;
+}
 
-        while (!lineEndFound &&
-               (currentSearchIndexInbuffer < totalNumberOfBytesInBuffer))
+int64_t LineIndexerCore::lineNumberForOffset(LargeFileReaderCore* reader, off_t offset) const
+{
+    if ((numberOfLines <= 0) || (offset < 0))
+    {
+        return -1;
+    }
+    
+    // Every line starts after the one before it, so we look for the last line that starts at or before
+    // offset. With a sparse index, we look for the last checkpoint first, and then scan the lines from
+    // there.
+    if (!loadedLineIndexFile.isMapped() && (indexedLineCheckpointInterval > 1))
+    {
+        int64_t low = 0;
+        int64_t high = (numberOfLines + indexedLineCheckpointInterval - 1) / indexedLineCheckpointInterval;
+        while ((high - low) > 1)
         {
-            if ((buffer[currentSearchIndexInbuffer] == '\n') ||                         // TODO: Configurable end of line.
-                (currentSearchIndexInbuffer - currentStartOfLineInBuffer) == 2048)      // TODO: Configurable max line length.
+            int64_t middle = low + ((high - low) / 2);
+            if (offsetOfCheckpoint(middle) <= offset)
             {
-                lineEndFound = true;
+                low = middle;
             }
             else
             {
-                currentSearchIndexInbuffer++;
+                high = middle;
             }
         }
         
-        if (lineEndFound)
+        int64_t firstLineNumber = low * indexedLineCheckpointInterval;
+        int64_t numberOfLinesToSearch = std::min(indexedLineCheckpointInterval, numberOfLines - firstLineNumber);
+        
+        std::vector<LineIndexEntry> lineIndexEntries(numberOfLinesToSearch);
+        if (lineEntriesForLines(reader, firstLineNumber, numberOfLinesToSearch, lineIndexEntries.data()) != 0)
         {
-            lineIndex[currentLineNumber].offset = currentStartOfLineInBuffer;
-            lineIndex[currentLineNumber].length = currentSearchIndexInbuffer - currentStartOfLineInBuffer;
-            
-            currentSearchIndexInbuffer++;
-            currentStartOfLineInBuffer = currentSearchIndexInbuffer;
-            
-            lineEndFound = false;
+            return -1;
+        }
+        auto lineIndexEntry = std::upper_bound(lineIndexEntries.begin(), lineIndexEntries.end(), offset, [](off_t offset, const LineIndexEntry& lineIndexEntry)
+        {
+            return offset < lineIndexEntry.offset;
+        });
+        return firstLineNumber + (lineIndexEntry - lineIndexEntries.begin()) - 1;
+    }
+    
+    int64_t low = 0;
+    int64_t high = numberOfLines;
+    while ((high - low) > 1)
+    {
+        int64_t middle = low + ((high - low) / 2);
+        LineIndexEntry lineIndexEntry;
+        lineEntryForLine(reader, middle, lineIndexEntry);
+        if (lineIndexEntry.offset <= offset)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+int64_t LineIndexerCore::readLines(LargeFileReaderCore* reader, int64_t firstLineNumber, int64_t numberOfLinesWanted, unsigned char* buffer, size_t bufferSize, LineIndexEntry* lineIndexEntries) const
+{
+    assert(reader != NULL);
+    
+    if ((firstLineNumber < 0) || (firstLineNumber > numberOfLines) || (numberOfLinesWanted < 0))
+    {
+        return -1;
+    }
+    numberOfLinesWanted = std::min(numberOfLinesWanted, numberOfLines - firstLineNumber);
+    if (numberOfLinesWanted == 0)
+    {
+        return 0;
+    }
+    
+    if (lineEntriesForLines(reader, firstLineNumber, numberOfLinesWanted, lineIndexEntries) != 0)
+    {
+        return -1;
+    }
+    
+    // The lines follow each other in the file, with only their delimiters in between, so all of them
+    // are a single read. Only read the lines that fit.
+    off_t startOffset = lineIndexEntries[0].offset;
+    int64_t numberOfLinesThatFit = 0;
+    while ((numberOfLinesThatFit < numberOfLinesWanted) &&
+           ((size_t)(lineIndexEntries[numberOfLinesThatFit].offset + lineIndexEntries[numberOfLinesThatFit].length - startOffset) <= bufferSize))
+    {
+        numberOfLinesThatFit++;
+    }
+    if (numberOfLinesThatFit == 0)
+    {
+        return 0;
+    }
+    
+    const LineIndexEntry& lastLineIndexEntry = lineIndexEntries[numberOfLinesThatFit - 1];
+    size_t numberOfBytes = lastLineIndexEntry.offset + lastLineIndexEntry.length - startOffset;
+    if (reader->readAt(startOffset, buffer, numberOfBytes) != numberOfBytes)
+    {
+        return -1;
+    }
+    
+    return numberOfLinesThatFit;
+}
+
+size_t LineIndexerCore::readLine(LargeFileReaderCore* reader, int64_t lineNumber, unsigned char* buffer, size_t bufferSize) const
+{
+    assert(reader != NULL);
+    
+    if ((lineNumber < 0) || (lineNumber >= numberOfLines))
+    {
+        return -1;
+    }
+    
+    LineIndexEntry lineIndexEntry;
+    if (lineEntryForLine(reader, lineNumber, lineIndexEntry) != 0)
+    {
+        return -1;
+    }
+    
+    size_t numberOfBytes = std::min(lineIndexEntry.length, bufferSize);
+    if ((numberOfBytes > 0) && (reader->readAt(lineIndexEntry.offset, buffer, numberOfBytes) != numberOfBytes))
+    {
+        return -1;
+    }
+    
+    return lineIndexEntry.length;
+}
+
+// MARK: - LineIterator
+
+LineIndexerCore::LineIterator::LineIterator(const LineIndexerCore* lineIndexer, LargeFileReaderCore* reader, int64_t lineNumber) : lineIndexer(lineIndexer), reader(reader)
+{
+    assert((lineIndexer != NULL) && (reader != NULL));
+    
+    moveToLine(lineNumber);
+}
+
+LineIndexerCore::LineIterator::~LineIterator()
+{
+    reader->releaseView(view);
+}
+
+bool LineIndexerCore::LineIterator::moveToLine(int64_t lineNumber)
+{
+    reader->releaseView(view);
+    currentLineNumber = -1;
+    currentLineData = nullptr;
+    currentLineLength = 0;
+    
+    if ((lineNumber < 0) || (lineNumber >= lineIndexer->numberOfLines))
+    {
+        return false;
+    }
+    
+    LineIndexEntry lineIndexEntry;
+    if (lineIndexer->lineEntryForLine(reader, lineNumber, lineIndexEntry) != 0)
+    {
+        return false;
+    }
+    
+    if (lineIndexEntry.length > 0)
+    {
+        // Most lines are in a single cache block, then we can use the data where it is.
+        size_t viewLength = reader->acquireView(lineIndexEntry.offset, lineIndexEntry.length, view);
+        if (viewLength == (size_t)-1)
+        {
+            return false;
+        }
+        
+        if (viewLength == lineIndexEntry.length)
+        {
+            currentLineData = view.data;
         }
         else
         {
-            // Did not find a line end
+            // The line crosses a block boundary, copy it.
+            reader->releaseView(view);
+            lineBuffer.resize(lineIndexEntry.length);
+            if (reader->readAt(lineIndexEntry.offset, lineBuffer.data(), lineIndexEntry.length) != lineIndexEntry.length)
+            {
+                return false;
+            }
+            currentLineData = lineBuffer.data();
+        }
+    }
+    
+    currentLineNumber = lineNumber;
+    currentLineLength = lineIndexEntry.length;
+    
+    return true;
+}
+
+bool LineIndexerCore::LineIterator::moveToNextLine()
+{
+    if (currentLineNumber < 0)
+    {
+        return false;
+    }
+    return moveToLine(currentLineNumber + 1);
+}
+
+bool LineIndexerCore::LineIterator::moveToPreviousLine()
+{
+    if (currentLineNumber < 0)
+    {
+        return false;
+    }
+    return moveToLine(currentLineNumber - 1);
+}
+
+bool LineIndexerCore::LineIterator::isAtLine() const
+{
+    return currentLineNumber >= 0;
+}
+
+int64_t LineIndexerCore::LineIterator::lineNumber() const
+{
+    return currentLineNumber;
+}
+
+const unsigned char* LineIndexerCore::LineIterator::lineData() const
+{
+    return currentLineData;
+}
+
+size_t LineIndexerCore::LineIterator::lineLength() const
+{
+    return currentLineLength;
+}
+
+bool LineIndexerCore::saveLineIndexForFileReader(LargeFileReaderCore* reader, const std::string& lineIndexFilePath)
+{
+    assert(reader != NULL);
+    
+    // Saving a sparse index would mean scanning the whole file again, that's what indexing is for.
+    LineIndexFile::FileIdentity identity;
+    if ((numberOfLines < 0) || (!loadedLineIndexFile.isMapped() && (indexedLineCheckpointInterval > 1)) || !LineIndexFile::identityForFile(reader, identity))
+    {
+        return false;
+    }
+    
+    return LineIndexFile::write(lineIndexFilePath, identity, indexSettings(indexedLineDelimiter, indexedMaximumLineLength), numberOfLines, [this, reader](int64_t lineNumber, off_t& offset, size_t& length)
+    {
+        LineIndexEntry lineIndexEntry;
+        lineEntryForLine(reader, lineNumber, lineIndexEntry);
+        offset = lineIndexEntry.offset;
+        length = lineIndexEntry.length;
+    });
+}
+
+bool LineIndexerCore::loadLineIndexForFileReader(LargeFileReaderCore* reader, const std::string& lineIndexFilePath)
+{
+    assert(reader != NULL);
+    
+    LineIndexFile::FileIdentity identity;
+    if (!hasValidLineDelimiter() || !LineIndexFile::identityForFile(reader, identity))
+    {
+        return false;
+    }
+    
+    if (!loadedLineIndexFile.map(lineIndexFilePath, identity, indexSettings(lineDelimiter, validMaximumLineLength())))
+    {
+        return false;
+    }
+    
+    resetIndex(1);
+    numberOfLines = loadedLineIndexFile.numberOfLines();
+    indexedFileSize = identity.fileSize;
+    
+    return true;
+}
+
+std::string LineIndexerCore::defaultLineIndexFilePathForFile(const std::string& fullFilePath)
+{
+    return fullFilePath + ".lineindex";
+}
+
+const std::string& LineIndexerCore::lineDelimiterOfIndex() const
+{
+    return indexedLineDelimiter;
+}
+
+size_t LineIndexerCore::maximumLineLengthOfIndex() const
+{
+    return indexedMaximumLineLength;
+}
+
+LineIndexFile::IndexSettings LineIndexerCore::indexSettings(const std::string& lineDelimiter, size_t maximumLineLength)
+{
+    LineIndexFile::IndexSettings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.maximumLineLength = maximumLineLength;
+    settings.lineDelimiterLength = (uint32_t)lineDelimiter.size();
+    memcpy(settings.lineDelimiter, lineDelimiter.data(), std::min(lineDelimiter.size(), sizeof(settings.lineDelimiter)));
+    return settings;
+}
+
+template <typename DelimiterHandler, typename SliceHandler>
+int LineIndexerCore::scanForDelimiters(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, off_t earliestStartOfDelimiter, size_t sliceSize, uint32_t* sliceDelimiterPositions, DelimiterHandler handleDelimiter, SliceHandler handleEndOfSlice) const
+{
+    if (indexedLineDelimiter.size() == 1)
+    {
+        return scanForDelimitersOfLength<true>(reader, startOffset, endOffset, earliestStartOfDelimiter, sliceSize, sliceDelimiterPositions, handleDelimiter, handleEndOfSlice);
+    }
+    return scanForDelimitersOfLength<false>(reader, startOffset, endOffset, earliestStartOfDelimiter, sliceSize, sliceDelimiterPositions, handleDelimiter, handleEndOfSlice);
+}
+
+template <bool isSingleByteDelimiter, typename DelimiterHandler, typename SliceHandler>
+int LineIndexerCore::scanForDelimitersOfLength(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, off_t earliestStartOfDelimiter, size_t sliceSize, uint32_t* sliceDelimiterPositions, DelimiterHandler handleDelimiter, SliceHandler handleEndOfSlice) const
+{
+    const unsigned char* delimiter = (const unsigned char*)indexedLineDelimiter.data();
+    size_t delimiterLength = indexedLineDelimiter.size();
+    
+    // The last delimiterLength - 1 bytes before the view (but not before earliestStartOfDelimiter), for
+    // a delimiter that starts before the view.
+    unsigned char precedingBytes[maximumLineDelimiterLength];
+    size_t numberOfPrecedingBytes = 0;
+    if constexpr (!isSingleByteDelimiter)
+    {
+        if (earliestStartOfDelimiter < startOffset)
+        {
+            numberOfPrecedingBytes = std::min((size_t)(startOffset - earliestStartOfDelimiter), delimiterLength - 1);
+            if (reader->readAt(startOffset - numberOfPrecedingBytes, precedingBytes, numberOfPrecedingBytes) != numberOfPrecedingBytes)
+            {
+                return -1;
+            }
+        }
+    }
+    
+    off_t fileOffset = startOffset;
+    while (fileOffset < endOffset)
+    {
+        LargeFileReaderCore::FileDataView view;
+        size_t viewLength = reader->acquireView(fileOffset, std::min((off_t)sliceSize, endOffset - fileOffset), view);
+        if ((viewLength == (size_t)-1) || (viewLength == 0))
+        {
+            // The file can not be shorter than it was when we started.
+            return -1;
+        }
+        
+        size_t numberOfDelimiters = LineDelimiterScanner::findDelimiters(view.data, viewLength, delimiter[delimiterLength - 1], sliceDelimiterPositions);
+        
+        if constexpr (!isSingleByteDelimiter)
+        {
+            // Only keep the last bytes that are preceded by the rest of the delimiter.
+            size_t numberOfMatchingDelimiters = 0;
+            for (size_t delimiterNumber = 0; delimiterNumber < numberOfDelimiters; delimiterNumber++)
+            {
+                size_t positionOfLastByte = sliceDelimiterPositions[delimiterNumber];
+                off_t startOfDelimiter = fileOffset + positionOfLastByte + 1 - delimiterLength;
+                if (startOfDelimiter < earliestStartOfDelimiter)
+                {
+                    continue;
+                }
+                
+                bool isMatching;
+                if (positionOfLastByte >= (delimiterLength - 1))
+                {
+                    isMatching = memcmp(view.data + positionOfLastByte + 1 - delimiterLength, delimiter, delimiterLength - 1) == 0;
+                }
+                else
+                {
+                    // The delimiter starts before the view.
+                    size_t numberOfBytesBeforeView = delimiterLength - 1 - positionOfLastByte;
+                    isMatching = (memcmp(precedingBytes + numberOfPrecedingBytes - numberOfBytesBeforeView, delimiter, numberOfBytesBeforeView) == 0) &&
+                                 (memcmp(view.data, delimiter + numberOfBytesBeforeView, positionOfLastByte) == 0);
+                }
+                
+                if (isMatching)
+                {
+                    sliceDelimiterPositions[numberOfMatchingDelimiters] = (uint32_t)positionOfLastByte;
+                    numberOfMatchingDelimiters++;
+                    // Delimiters don't overlap.
+                    earliestStartOfDelimiter = fileOffset + positionOfLastByte + 1;
+                }
+            }
+            numberOfDelimiters = numberOfMatchingDelimiters;
             
-            // NOTE: THIS IS DEBUG STUFF TO SILENCE THE COMPILER FOR NOW!
-            hasDataToProcess = true;
+            // Keep the last bytes for the next view, which can be in another cache block.
+            size_t numberOfBytesToKeep = delimiterLength - 1;
+            if (viewLength >= numberOfBytesToKeep)
+            {
+                memcpy(precedingBytes, view.data + viewLength - numberOfBytesToKeep, numberOfBytesToKeep);
+                numberOfPrecedingBytes = numberOfBytesToKeep;
+            }
+            else
+            {
+                size_t numberOfBytesStillPreceding = std::min(numberOfPrecedingBytes, numberOfBytesToKeep - viewLength);
+                memmove(precedingBytes, precedingBytes + numberOfPrecedingBytes - numberOfBytesStillPreceding, numberOfBytesStillPreceding);
+                memcpy(precedingBytes + numberOfBytesStillPreceding, view.data, viewLength);
+                numberOfPrecedingBytes = numberOfBytesStillPreceding + viewLength;
+            }
         }
         
+        reader->releaseView(view);
+        
+        for (size_t delimiterNumber = 0; delimiterNumber < numberOfDelimiters; delimiterNumber++)
+        {
+            off_t startOfNextLine = fileOffset + sliceDelimiterPositions[delimiterNumber] + 1;
+            if (handleDelimiter(startOfNextLine - (off_t)delimiterLength, startOfNextLine))
+            {
+                return 1;
+            }
+        }
+        
+        fileOffset += viewLength;
+        
+        if (handleEndOfSlice(fileOffset))
+        {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+bool LineIndexerCore::lineDelimiterCanOverlapItself(const std::string& lineDelimiter)
+{
+    for (size_t shift = 1; shift < lineDelimiter.size(); shift++)
+    {
+        if (memcmp(lineDelimiter.data(), lineDelimiter.data() + shift, lineDelimiter.size() - shift) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int LineIndexerCore::indexLinesSequentially(LargeFileReaderCore* reader, off_t fileSize)
+{
+    numberOfLines = 0;
+    
+    return indexLinesInRange(reader, 0, fileSize);
+}
+
+int LineIndexerCore::indexLinesInRange(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset)
+{
+    std::vector<uint32_t> delimiterPositions(scanSliceSize);
+    
+    off_t startOfLine = startOffset;
+    
+    auto storeLineUpToDelimiter = [&](off_t endOfLine, off_t startOfNextLine)
+    {
+        storeLine(numberOfLines, startOfLine, endOfLine);
+        startOfLine = startOfNextLine;
+        return false;
+    };
+    auto continueScan = [](off_t)
+    {
+        return false;
+    };
+    
+    if (scanForDelimiters(reader, startOffset, endOffset, startOffset, scanSliceSize, delimiterPositions.data(), storeLineUpToDelimiter, continueScan) != 0)
+    {
+        numberOfLines = -1;
+        return -1;
+    }
+    
+    // The last line does not need to end with a delimiter.
+    if (startOfLine < endOffset)
+    {
+        storeLine(numberOfLines, startOfLine, endOffset);
     }
     
     return 0;
 }
+
+int LineIndexerCore::indexLinesInParallel(LargeFileReaderCore* reader, off_t fileSize, size_t chunkSize)
+{
+    WorkerPool& workerPool = WorkerPool::sharedPool();
+    
+    size_t numberOfChunks = (fileSize + chunkSize - 1) / chunkSize;
+    
+    // The delimiter positions take about 4 bytes per line, as much as a sparse index takes for many
+    // lines. Only keep them for a window of chunks, enough to keep every thread busy.
+    size_t numberOfThreads = workerPool.numberOfWorkers();
+    if ((numberOfIndexingThreads > 0) && (numberOfIndexingThreads < numberOfThreads))
+    {
+        numberOfThreads = numberOfIndexingThreads;
+    }
+    size_t windowSize = std::max(numberOfThreads, (size_t)1) * parallelIndexingChunksPerThread;
+    
+    std::vector<std::vector<uint32_t>> chunkDelimiterPositions(windowSize);
+    std::vector<off_t> chunkStartOfFirstLine(windowSize);
+    std::vector<int64_t> chunkFirstEntry(windowSize);
+    std::atomic<bool> hasFailed(false);
+    
+    off_t delimiterLength = indexedLineDelimiter.size();
+    off_t startOfLine = 0;
+    int64_t totalNumberOfEntries = 0;
+    
+    for (size_t firstChunkNumber = 0; firstChunkNumber < numberOfChunks; firstChunkNumber += windowSize)
+    {
+        size_t numberOfChunksInWindow = std::min(windowSize, numberOfChunks - firstChunkNumber);
+        auto chunkStartOffset = [&](size_t chunkNumberInWindow)
+        {
+            return (off_t)((firstChunkNumber + chunkNumberInWindow) * chunkSize);
+        };
+        
+        // Pass 1: find the delimiters in every chunk.
+        
+        workerPool.runTasks(numberOfChunksInWindow, numberOfIndexingThreads, [&](size_t chunkNumber)
+        {
+            off_t chunkEndOffset = std::min(chunkStartOffset(chunkNumber) + (off_t)chunkSize, fileSize);
+            chunkDelimiterPositions[chunkNumber].clear();
+            if (!findDelimitersInRange(reader, chunkStartOffset(chunkNumber), chunkEndOffset, chunkDelimiterPositions[chunkNumber]))
+            {
+                hasFailed = true;
+            }
+        });
+        
+        if (hasFailed)
+        {
+            numberOfLines = -1;
+            return -1;
+        }
+        
+        // Pass 2: find where the first line of every chunk starts.
+        
+        for (size_t chunkNumber = 0; chunkNumber < numberOfChunksInWindow; chunkNumber++)
+        {
+            chunkStartOfFirstLine[chunkNumber] = startOfLine;
+            if (!chunkDelimiterPositions[chunkNumber].empty())
+            {
+                startOfLine = chunkStartOffset(chunkNumber) + chunkDelimiterPositions[chunkNumber].back() + 1;
+            }
+        }
+        
+        // Pass 3: count the entries of every chunk, and give every chunk its place in the index.
+        
+        workerPool.runTasks(numberOfChunksInWindow, numberOfIndexingThreads, [&](size_t chunkNumber)
+        {
+            off_t startOfLine = chunkStartOfFirstLine[chunkNumber];
+            int64_t numberOfEntries = 0;
+            for (uint32_t delimiterPosition : chunkDelimiterPositions[chunkNumber])
+            {
+                off_t startOfNextLine = chunkStartOffset(chunkNumber) + delimiterPosition + 1;
+                numberOfEntries += numberOfEntriesForLine(startOfNextLine - delimiterLength - startOfLine);
+                startOfLine = startOfNextLine;
+            }
+            chunkFirstEntry[chunkNumber] = numberOfEntries;
+        });
+        
+        for (size_t chunkNumber = 0; chunkNumber < numberOfChunksInWindow; chunkNumber++)
+        {
+            int64_t numberOfEntries = chunkFirstEntry[chunkNumber];
+            chunkFirstEntry[chunkNumber] = totalNumberOfEntries;
+            totalNumberOfEntries += numberOfEntries;
+        }
+        
+        // The index only allocates when an entry beyond its end is used, which is not safe to do from
+        // multiple threads. Make it big enough up front.
+        if ((indexedLineCheckpointInterval == 1) && (totalNumberOfEntries > 0))
+        {
+            lineIndex[totalNumberOfEntries - 1];
+        }
+        
+        auto storeLinesOfChunk = [&](size_t chunkNumber)
+        {
+            off_t startOfLine = chunkStartOfFirstLine[chunkNumber];
+            int64_t entryNumber = chunkFirstEntry[chunkNumber];
+            for (uint32_t delimiterPosition : chunkDelimiterPositions[chunkNumber])
+            {
+                off_t startOfNextLine = chunkStartOffset(chunkNumber) + delimiterPosition + 1;
+                storeLine(entryNumber, startOfLine, startOfNextLine - delimiterLength);
+                startOfLine = startOfNextLine;
+            }
+        };
+        
+        if (indexedLineCheckpointInterval == 1)
+        {
+            workerPool.runTasks(numberOfChunksInWindow, numberOfIndexingThreads, storeLinesOfChunk);
+        }
+        else
+        {
+            // A checkpoint is stored relative to the first checkpoint of its group, which can be in an
+            // earlier chunk, so checkpoints are stored in order. This only walks the delimiter
+            // positions, and touches one line in lineCheckpointInterval.
+            for (size_t chunkNumber = 0; chunkNumber < numberOfChunksInWindow; chunkNumber++)
+            {
+                storeLinesOfChunk(chunkNumber);
+            }
+        }
+    }
+    
+    // The last line does not need to end with a delimiter.
+    if (startOfLine < fileSize)
+    {
+        storeLine(totalNumberOfEntries, startOfLine, fileSize);
+    }
+    
+    numberOfLines = totalNumberOfEntries;
+    
+    return 0;
+}
+
+bool LineIndexerCore::findDelimitersInRange(LargeFileReaderCore* reader, off_t startOffset, off_t endOffset, std::vector<uint32_t>& delimiterPositions)
+{
+    std::vector<uint32_t> sliceDelimiterPositions(scanSliceSize);
+    
+    auto addDelimiterPosition = [&](off_t, off_t startOfNextLine)
+    {
+        delimiterPositions.push_back((uint32_t)(startOfNextLine - 1 - startOffset));
+        return false;
+    };
+    auto continueScan = [](off_t)
+    {
+        return false;
+    };
+    
+    // A delimiter can start in the chunk before this one.
+    off_t earliestStartOfDelimiter = std::max(startOffset - (off_t)(indexedLineDelimiter.size() - 1), (off_t)0);
+    
+    return scanForDelimiters(reader, startOffset, endOffset, earliestStartOfDelimiter, scanSliceSize, sliceDelimiterPositions.data(), addDelimiterPosition, continueScan) == 0;
+}
+
+int64_t LineIndexerCore::numberOfEntriesForLine(size_t lineLength) const
+{
+    if (lineLength <= indexedMaximumLineLength)
+    {
+        return 1;
+    }
+    
+    return (lineLength + indexedMaximumLineLength - 1) / indexedMaximumLineLength;
+}
+
+void LineIndexerCore::storeLine(int64_t& entryNumber, off_t startOfLine, off_t endOfLine)
+{
+    while ((size_t)(endOfLine - startOfLine) > indexedMaximumLineLength)
+    {
+        storeEntry(entryNumber, startOfLine, indexedMaximumLineLength);
+        entryNumber++;
+        
+        startOfLine += indexedMaximumLineLength;
+    }
+    
+    storeEntry(entryNumber, startOfLine, endOfLine - startOfLine);
+    entryNumber++;
+}
+
+void LineIndexerCore::storeEntry(int64_t entryNumber, off_t offset, size_t length)
+{
+    if (indexedLineCheckpointInterval == 1)
+    {
+        LineIndexEntry& lineIndexEntry = lineIndex[entryNumber];
+        lineIndexEntry.offset = offset;
+        lineIndexEntry.length = length;
+        return;
+    }
+    
+    if ((entryNumber % indexedLineCheckpointInterval) != 0)
+    {
+        return;
+    }
+    
+    // An entry can be stored again (see indexNewLinesForFileReader), but only at the end of the index,
+    // so the first checkpoint of a group is always stored before the others are stored relative to it.
+    int64_t checkpointNumber = entryNumber / indexedLineCheckpointInterval;
+    int64_t groupNumber = checkpointNumber / checkpointsPerGroup;
+    if ((checkpointNumber % checkpointsPerGroup) == 0)
+    {
+        checkpointGroupOffsets[groupNumber] = offset;
+    }
+    checkpointRelativeOffsets[checkpointNumber] = (uint32_t)(offset - checkpointGroupOffsets[groupNumber]);
+}
+
+size_t LineIndexerCore::validMaximumLineLength() const
+{
+    if (maximumLineLength < 1)
+    {
+        return 1;
+    }
+    if (maximumLineLength > UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+    return maximumLineLength;
+}
+
+int64_t LineIndexerCore::validLineCheckpointInterval() const
+{
+    // A group of checkpoints must fit in 32 bits.
+    int64_t largestLineCheckpointInterval = UINT32_MAX / (checkpointsPerGroup * (validMaximumLineLength() + lineDelimiter.size()));
+    if (largestLineCheckpointInterval > maximumLineCheckpointInterval)
+    {
+        largestLineCheckpointInterval = maximumLineCheckpointInterval;
+    }
+    
+    if (lineCheckpointInterval < 1)
+    {
+        return 1;
+    }
+    if (lineCheckpointInterval > largestLineCheckpointInterval)
+    {
+        return std::max(largestLineCheckpointInterval, (int64_t)1);
+    }
+    return lineCheckpointInterval;
+}
+
+bool LineIndexerCore::hasValidLineDelimiter() const
+{
+    return !lineDelimiter.empty() && (lineDelimiter.size() <= maximumLineDelimiterLength);
+}
+
+off_t LineIndexerCore::offsetOfCheckpoint(int64_t checkpointNumber) const
+{
+    return checkpointGroupOffsets[checkpointNumber / checkpointsPerGroup] + checkpointRelativeOffsets[checkpointNumber];
+}
+
+void LineIndexerCore::resetIndex(int64_t checkpointInterval)
+{
+    lineIndex.clear();
+    checkpointGroupOffsets.clear();
+    checkpointRelativeOffsets.clear();
+    indexedLineCheckpointInterval = checkpointInterval;
+    indexedLineDelimiter = lineDelimiter;
+    indexedMaximumLineLength = validMaximumLineLength();
+}
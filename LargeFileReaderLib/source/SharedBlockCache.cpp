@@ -0,0 +1,339 @@
+//
+//  SharedBlockCache.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cassert>
+#include <stdexcept>
+#include <new>
+#include <algorithm>
+
+#include "SharedBlockCache.hpp"
+
+// Strategy (sharing):
+//
+// A shared cache is the cache that a single reader used to have, with the file number added to the key
+// of every block: one piece of memory, with its maps, eviction policies and mutexes, for all files. So a
+// block of any file can be evicted to make room for a block of any other file, and the eviction policies
+// see all accesses to all files, and keep the blocks that are used most (or most recently), wherever
+// they are from. A file that is not read anymore loses its blocks to the files that are, without anyone
+// having to tell the cache.
+//
+// When a file is detached, its blocks are given back right away, so they are used before any block of
+// another file is evicted.
+//
+// Strategy (shards):
+//
+// A mutex is only held for the bookkeeping of a read (a few map and list operations), not for the
+// reading or copying. Still, with many threads doing small reads from blocks that are all in the cache,
+// every read takes it twice (to pin and unpin a block), and with a single mutex the readers of all files
+// would take turns.
+//
+// So a large cache is split into shards, each with its own part of the blocks, its own map and eviction
+// policy, and its own mutex, and a block key always goes to the same shard. Readers of different blocks
+// then mostly take different mutexes. The key picks the shard with its low bits (plus the file number),
+// so the blocks of a sequential read, or of a batch, are spread over all shards, and so is a hot block
+// at the start of every file. The map of a shard hashes the key with its top bits, so that is not
+// skewed by the shard.
+//
+// Every shard evicts its own least used block, instead of the least used block of the whole cache. With
+// keys spread evenly and hundreds of blocks per shard, that is close enough. A small cache, where that
+// would not be true, and where a reader pinning a batch of blocks could pin a whole shard, has one
+// shard, and works as before.
+
+SharedBlockCache::SharedBlockCache(size_t cacheMaxSize, size_t cacheBlockSize, CacheEvictionPolicy::PolicyType evictionPolicyType,
+                                   size_t memoryAlignment, bool isMappingAddressSpace, const CacheMemoryAllocator& memoryAllocator) :
+    cacheBlockSize(cacheBlockSize),
+    cacheActualSize((cacheBlockSize > 0) ? (cacheMaxSize / cacheBlockSize) * cacheBlockSize : 0),
+    maxNumberOfCachedBlocks((cacheBlockSize > 0) ? (int64_t)(cacheMaxSize / cacheBlockSize) : 0),
+    numberOfCacheShards(numberOfCacheShardsForBlocks(maxNumberOfCachedBlocks)),
+    isMappingAddressSpace(isMappingAddressSpace)
+{
+    if ((cacheBlockSize == 0) || ((cacheMaxSize > 0) && (cacheBlockSize > cacheMaxSize)))
+    {
+        throw std::out_of_range("Cache block size must be less than cache max size");
+    }
+
+    if (isMappingAddressSpace)
+    {
+        cacheBlocks = reserveMappingAddressSpace(cacheActualSize);
+    }
+    else
+    {
+        memoryAllocator.allocate(cacheActualSize, memoryAlignment, cacheBlocksAllocation);
+        cacheBlocks = cacheBlocksAllocation.memory;
+    }
+    cacheBlockEntries = new CacheBlockEntry[maxNumberOfCachedBlocks];
+
+    cacheShards = new CacheShard[numberOfCacheShards];
+    cacheBlocksPerShard = std::max((int64_t)1, maxNumberOfCachedBlocks / numberOfCacheShards);
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        CacheShard& shard = cacheShards[shardNumber];
+        shard.firstCacheBlock = shardNumber * cacheBlocksPerShard;
+        shard.numberOfCacheBlocks = (shardNumber < (numberOfCacheShards - 1)) ? cacheBlocksPerShard : (maxNumberOfCachedBlocks - shard.firstCacheBlock);
+        shard.cacheBlockMap = new CacheBlockMap(shard.numberOfCacheBlocks, memoryAllocator);
+        shard.cacheEvictionPolicy = CacheEvictionPolicy::createPolicy(evictionPolicyType, shard.numberOfCacheBlocks);
+    }
+
+    currentNumberOfAttachedFiles = 0;
+}
+
+SharedBlockCache::~SharedBlockCache()
+{
+    assert(currentNumberOfAttachedFiles == 0);
+
+    if (isMappingAddressSpace)
+    {
+        // Unmaps all windows.
+        releaseMappingAddressSpace(cacheBlocks, cacheActualSize);
+    }
+    else
+    {
+        CacheMemoryAllocator::free(cacheBlocksAllocation);
+    }
+    delete [] cacheBlockEntries;
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        delete cacheShards[shardNumber].cacheBlockMap;
+        delete cacheShards[shardNumber].cacheEvictionPolicy;
+    }
+    delete [] cacheShards;
+}
+
+int64_t SharedBlockCache::numberOfCacheShardsForBlocks(int64_t numberOfCacheBlocks)
+{
+    int64_t numberOfShards = 1;
+    while (((numberOfShards * 2) <= maximumNumberOfCacheShards) && ((numberOfShards * 2 * minimumCacheBlocksPerShard) <= numberOfCacheBlocks))
+    {
+        numberOfShards *= 2;
+    }
+    return numberOfShards;
+}
+
+int64_t SharedBlockCache::numberOfAttachedFiles()
+{
+    std::lock_guard<std::mutex> lock(filesMutex);
+    return currentNumberOfAttachedFiles;
+}
+
+int64_t SharedBlockCache::numberOfCachedBlocks()
+{
+    int64_t numberOfBlocks = 0;
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        std::lock_guard<std::mutex> lock(cacheShards[shardNumber].shardMutex);
+        numberOfBlocks += cacheShards[shardNumber].currentNumberOfCachedBlocks;
+    }
+    return numberOfBlocks;
+}
+
+int64_t SharedBlockCache::numberOfCachedBlocksForFile(int64_t fileNumber)
+{
+    int64_t numberOfBlocks = 0;
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        CacheShard& shard = cacheShards[shardNumber];
+        std::lock_guard<std::mutex> lock(shard.shardMutex);
+        if ((fileNumber >= 0) && (fileNumber < (int64_t)shard.numberOfCachedBlocksForFiles.size()))
+        {
+            numberOfBlocks += shard.numberOfCachedBlocksForFiles[fileNumber];
+        }
+    }
+    return numberOfBlocks;
+}
+
+int64_t SharedBlockCache::attachFile()
+{
+    std::lock_guard<std::mutex> lock(filesMutex);
+
+    // Give out the lowest free number, so the numbers (and the vectors) stay as small as the number of
+    // files that are attached at the same time.
+    int64_t fileNumber = std::find(isFileNumberAttached.begin(), isFileNumberAttached.end(), false) - isFileNumberAttached.begin();
+    if (fileNumber >= maximumNumberOfFiles)
+    {
+        return -1;
+    }
+    if (fileNumber == (int64_t)isFileNumberAttached.size())
+    {
+        isFileNumberAttached.push_back(false);
+    }
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        CacheShard& shard = cacheShards[shardNumber];
+        std::lock_guard<std::mutex> shardLock(shard.shardMutex);
+        if (fileNumber == (int64_t)shard.numberOfCachedBlocksForFiles.size())
+        {
+            shard.numberOfCachedBlocksForFiles.push_back(0);
+        }
+        shard.numberOfCachedBlocksForFiles[fileNumber] = 0;
+    }
+
+    isFileNumberAttached[fileNumber] = true;
+    currentNumberOfAttachedFiles++;
+
+    return fileNumber;
+}
+
+void SharedBlockCache::detachFile(int64_t fileNumber)
+{
+    std::lock_guard<std::mutex> lock(filesMutex);
+
+    assert((fileNumber >= 0) && (fileNumber < (int64_t)isFileNumberAttached.size()) && isFileNumberAttached[fileNumber]);
+
+    for (int64_t shardNumber = 0; shardNumber < numberOfCacheShards; shardNumber++)
+    {
+        CacheShard& shard = cacheShards[shardNumber];
+        std::lock_guard<std::mutex> shardLock(shard.shardMutex);
+
+        // Blocks that were never used come after all others, we can stop when we have seen all used ones.
+        int64_t endOfUsedCacheBlocks = shard.firstCacheBlock + shard.currentNumberOfCachedBlocks + (int64_t)shard.freeCacheBlocks.size();
+        for (int64_t cacheBlock = shard.firstCacheBlock; (cacheBlock < endOfUsedCacheBlocks) && (shard.numberOfCachedBlocksForFiles[fileNumber] > 0); cacheBlock++)
+        {
+            CacheBlockEntry& entry = cacheBlockEntries[cacheBlock];
+            if ((entry.blockKey != -1) && (fileNumberForBlockKey(entry.blockKey) == fileNumber))
+            {
+                assert((entry.pinCount == 0) && !entry.isLoading);
+                freeCacheBlock(shard, cacheBlock);
+            }
+        }
+        // The next file that is attached gets this number, and so the same block keys.
+        shard.cacheEvictionPolicy->forgetRemovedBlocks([fileNumber](int64_t blockKey)
+        {
+            return fileNumberForBlockKey(blockKey) == fileNumber;
+        });
+
+        // Readers of other files might be waiting for a block.
+        shard.shardCondition.notify_all();
+    }
+
+    isFileNumberAttached[fileNumber] = false;
+    currentNumberOfAttachedFiles--;
+}
+
+int64_t SharedBlockCache::takeUnusedCacheBlock(CacheShard& shard, int64_t blockKey)
+{
+    // We initially start with all blocks of the shard empty and fill them linearly from the first to
+    // the last. Blocks that are given back are used first.
+
+    int64_t cacheBlock;
+
+    if (!shard.freeCacheBlocks.empty())
+    {
+        cacheBlock = shard.freeCacheBlocks.back();
+        shard.freeCacheBlocks.pop_back();
+    }
+    else if (shard.currentNumberOfCachedBlocks < shard.numberOfCacheBlocks)
+    {
+        cacheBlock = shard.firstCacheBlock + shard.currentNumberOfCachedBlocks;
+    }
+    else
+    {
+        return -1;
+    }
+    shard.currentNumberOfCachedBlocks++;
+    shard.numberOfCachedBlocksForFiles[fileNumberForBlockKey(blockKey)]++;
+
+    // It is pinned and loading, until the data is fetched.
+    CacheBlockEntry& entry = cacheBlockEntries[cacheBlock];
+    entry.blockKey = blockKey;
+    entry.isLoading = true;
+    entry.pinCount = 1;
+
+    shard.cacheBlockMap->insert(blockKey, cacheBlock);
+    shard.cacheEvictionPolicy->blockInserted(cacheBlock - shard.firstCacheBlock, blockKey);
+
+    return cacheBlock;
+}
+
+int64_t SharedBlockCache::selectVictimCacheBlock(CacheShard& shard)
+{
+    CacheBlockEntry* shardCacheBlockEntries = &cacheBlockEntries[shard.firstCacheBlock];
+    int64_t shardCacheBlock = shard.cacheEvictionPolicy->selectVictim([shardCacheBlockEntries](int64_t shardCacheBlock)
+    {
+        return shardCacheBlockEntries[shardCacheBlock].pinCount == 0;
+    });
+    return (shardCacheBlock != -1) ? (shard.firstCacheBlock + shardCacheBlock) : -1;
+}
+
+void SharedBlockCache::reuseCacheBlock(CacheShard& shard, int64_t cacheBlock, int64_t blockKey)
+{
+    // Fault the victim, it may be a block of another file.
+    CacheBlockEntry& entry = cacheBlockEntries[cacheBlock];
+    shard.cacheEvictionPolicy->blockRemoved(cacheBlock - shard.firstCacheBlock, entry.blockKey);
+    shard.cacheBlockMap->erase(entry.blockKey);
+    shard.numberOfCachedBlocksForFiles[fileNumberForBlockKey(entry.blockKey)]--;
+    shard.numberOfCachedBlocksForFiles[fileNumberForBlockKey(blockKey)]++;
+
+    // It is pinned and loading, until the data is fetched.
+    entry.blockKey = blockKey;
+    entry.isLoading = true;
+    entry.pinCount = 1;
+
+    shard.cacheBlockMap->insert(blockKey, cacheBlock);
+    shard.cacheEvictionPolicy->blockInserted(cacheBlock - shard.firstCacheBlock, blockKey);
+}
+
+void SharedBlockCache::freeCacheBlock(CacheShard& shard, int64_t cacheBlock)
+{
+    CacheBlockEntry& entry = cacheBlockEntries[cacheBlock];
+    shard.cacheBlockMap->erase(entry.blockKey);
+    // Not evicted, so the policy must not remember it as used.
+    shard.cacheEvictionPolicy->blockDiscarded(cacheBlock - shard.firstCacheBlock);
+    shard.numberOfCachedBlocksForFiles[fileNumberForBlockKey(entry.blockKey)]--;
+
+    entry.blockKey = -1;
+    entry.pinCount = 0;
+    entry.isLoading = false;
+    shard.freeCacheBlocks.push_back(cacheBlock);
+    shard.currentNumberOfCachedBlocks--;
+}
+
+unsigned char* SharedBlockCache::allocateCacheMemory(size_t size, size_t alignment)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    alignment = std::max(alignment, pageSize);
+
+    void* memory = NULL;
+    if (posix_memalign(&memory, alignment, size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return (unsigned char*)memory;
+}
+
+void SharedBlockCache::freeCacheMemory(unsigned char* memory)
+{
+    free(memory);
+}
+
+unsigned char* SharedBlockCache::reserveMappingAddressSpace(size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    // Reserve the address space with an inaccessible anonymous mapping. Windows are mapped over it
+    // with MAP_FIXED, so remapping a window is a single system call, and nobody else can end up
+    // in the address space between two windows.
+    void* memory = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    return (unsigned char*)memory;
+}
+
+void SharedBlockCache::releaseMappingAddressSpace(unsigned char* memory, size_t size)
+{
+    if (memory != NULL)
+    {
+        munmap(memory, size);
+    }
+}
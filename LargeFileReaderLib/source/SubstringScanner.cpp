@@ -0,0 +1,191 @@
+//
+//  SubstringScanner.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUBSTRINGSCANNER_HAS_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SUBSTRINGSCANNER_HAS_NEON 1
+#endif
+
+#include "SubstringScanner.hpp"
+
+typedef size_t (*FindMatchesFunction)(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions);
+
+// Whether the pattern is at data, given that its first and last byte are.
+static inline bool isMatchingCandidate(const unsigned char* data, const unsigned char* pattern, size_t patternLength)
+{
+    return (patternLength <= 2) || (memcmp(data + 1, pattern + 1, patternLength - 2) == 0);
+}
+
+// MARK: - Portable
+
+// Used for whatever is left after the last full vector, and on machines without vector support.
+static size_t findMatchesPortable(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions, size_t baseOffset)
+{
+    size_t numberOfMatches = 0;
+
+    if (length < patternLength)
+    {
+        return 0;
+    }
+
+    // The last position where the pattern fits.
+    const unsigned char* last = data + length - patternLength;
+    const unsigned char* search = data;
+    while (search <= last)
+    {
+        const unsigned char* found = (const unsigned char*)memchr(search, pattern[0], last - search + 1);
+        if (found == nullptr)
+        {
+            break;
+        }
+        if ((found[patternLength - 1] == pattern[patternLength - 1]) && isMatchingCandidate(found, pattern, patternLength))
+        {
+            positions[numberOfMatches++] = (uint32_t)(baseOffset + (found - data));
+        }
+        search = found + 1;
+    }
+
+    return numberOfMatches;
+}
+
+static size_t findMatchesPortable(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    return findMatchesPortable(data, length, pattern, patternLength, positions, 0);
+}
+
+// Check the candidates in mask, one bit per byte starting at offset, and hand out the positions of the
+// ones that match.
+static inline size_t storePositionsForCandidates(uint64_t mask, const unsigned char* data, size_t offset, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    size_t numberOfMatches = 0;
+    while (mask != 0)
+    {
+        size_t position = offset + __builtin_ctzll(mask);
+        if (isMatchingCandidate(&data[position], pattern, patternLength))
+        {
+            positions[numberOfMatches++] = (uint32_t)position;
+        }
+        mask &= mask - 1;
+    }
+    return numberOfMatches;
+}
+
+#if SUBSTRINGSCANNER_HAS_X86
+
+// MARK: - SSE2
+
+__attribute__((target("sse2")))
+static size_t findMatchesSSE2(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    size_t numberOfMatches = 0;
+    const __m128i firstByte = _mm_set1_epi8((char)pattern[0]);
+    const __m128i lastByte = _mm_set1_epi8((char)pattern[patternLength - 1]);
+
+    size_t offset = 0;
+    for (; (offset + 16 + patternLength - 1) <= length; offset += 16)
+    {
+        __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[offset]), firstByte);
+        __m128i last = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[offset + patternLength - 1]), lastByte);
+        uint64_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(first, last));
+        if (mask != 0)
+        {
+            numberOfMatches += storePositionsForCandidates(mask, data, offset, pattern, patternLength, &positions[numberOfMatches]);
+        }
+    }
+
+    return numberOfMatches + findMatchesPortable(&data[offset], length - offset, pattern, patternLength, &positions[numberOfMatches], offset);
+}
+
+// MARK: - AVX2
+
+__attribute__((target("avx2")))
+static size_t findMatchesAVX2(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    size_t numberOfMatches = 0;
+    const __m256i firstByte = _mm256_set1_epi8((char)pattern[0]);
+    const __m256i lastByte = _mm256_set1_epi8((char)pattern[patternLength - 1]);
+
+    size_t offset = 0;
+    for (; (offset + 32 + patternLength - 1) <= length; offset += 32)
+    {
+        __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)&data[offset]), firstByte);
+        __m256i last = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)&data[offset + patternLength - 1]), lastByte);
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(first, last));
+        if (mask != 0)
+        {
+            numberOfMatches += storePositionsForCandidates(mask, data, offset, pattern, patternLength, &positions[numberOfMatches]);
+        }
+    }
+
+    return numberOfMatches + findMatchesPortable(&data[offset], length - offset, pattern, patternLength, &positions[numberOfMatches], offset);
+}
+
+#endif /* SUBSTRINGSCANNER_HAS_X86 */
+
+#if SUBSTRINGSCANNER_HAS_NEON
+
+// MARK: - NEON
+
+static size_t findMatchesNEON(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    size_t numberOfMatches = 0;
+    const uint8x16_t firstByte = vdupq_n_u8(pattern[0]);
+    const uint8x16_t lastByte = vdupq_n_u8(pattern[patternLength - 1]);
+
+    // See LineDelimiterScanner for the mask with 4 bits per byte.
+    size_t offset = 0;
+    for (; (offset + 16 + patternLength - 1) <= length; offset += 16)
+    {
+        uint8x16_t candidates = vandq_u8(vceqq_u8(vld1q_u8(&data[offset]), firstByte), vceqq_u8(vld1q_u8(&data[offset + patternLength - 1]), lastByte));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(candidates), 4)), 0);
+        while (mask != 0)
+        {
+            size_t position = offset + (__builtin_ctzll(mask) >> 2);
+            if (isMatchingCandidate(&data[position], pattern, patternLength))
+            {
+                positions[numberOfMatches++] = (uint32_t)position;
+            }
+            mask &= ~((uint64_t)0xF << (__builtin_ctzll(mask) & ~3));
+        }
+    }
+
+    return numberOfMatches + findMatchesPortable(&data[offset], length - offset, pattern, patternLength, &positions[numberOfMatches], offset);
+}
+
+#endif /* SUBSTRINGSCANNER_HAS_NEON */
+
+// MARK: - Dispatch
+
+static FindMatchesFunction findMatchesFunctionForInstructionSet(LineDelimiterScanner::InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#if SUBSTRINGSCANNER_HAS_X86
+        case LineDelimiterScanner::InstructionSetAVX2:
+            return findMatchesAVX2;
+        case LineDelimiterScanner::InstructionSetSSE2:
+            return findMatchesSSE2;
+#endif
+#if SUBSTRINGSCANNER_HAS_NEON
+        case LineDelimiterScanner::InstructionSetNEON:
+            return findMatchesNEON;
+#endif
+        default:
+            return findMatchesPortable;
+    }
+}
+
+size_t SubstringScanner::findMatches(const unsigned char* data, size_t length, const unsigned char* pattern, size_t patternLength, uint32_t* positions)
+{
+    static const FindMatchesFunction findMatchesFunction = findMatchesFunctionForInstructionSet(LineDelimiterScanner::instructionSet());
+    return findMatchesFunction(data, length, pattern, patternLength, positions);
+}
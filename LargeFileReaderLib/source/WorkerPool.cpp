@@ -0,0 +1,156 @@
+//
+//  WorkerPool.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(size_t numberOfWorkers)
+{
+    if (numberOfWorkers == 0)
+    {
+        numberOfWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t workerNumber = 0; workerNumber < numberOfWorkers; workerNumber++)
+    {
+        workers.emplace_back(&WorkerPool::workerMain, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stop = true;
+        queue.clear();
+    }
+    queueCondition.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+WorkerPool& WorkerPool::sharedPool()
+{
+    static WorkerPool pool(0);
+    return pool;
+}
+
+WorkerPool& WorkerPool::sharedIOPool()
+{
+    static WorkerPool* pool = new WorkerPool(std::max(8u, std::thread::hardware_concurrency() * 2));
+    return *pool;
+}
+
+size_t WorkerPool::numberOfWorkers() const
+{
+    return workers.size();
+}
+
+void WorkerPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(task));
+    }
+    queueCondition.notify_one();
+}
+
+// Strategy (runTasks):
+//
+// Instead of queueing every task, we queue a few 'runners' that each keep taking the next task number
+// until there are none left. The calling thread is a runner too. So even if all workers are busy (or
+// are waiting in runTasks themselves), the caller gets through all tasks on its own, and we only wait
+// for runners that have actually started.
+
+void WorkerPool::runTasks(size_t numberOfTasks, size_t maximumConcurrency, const std::function<void(size_t taskNumber)>& task)
+{
+    if (numberOfTasks == 0)
+    {
+        return;
+    }
+
+    size_t numberOfRunners = std::min(numberOfTasks, workers.size() + 1);
+    if ((maximumConcurrency != 0) && (numberOfRunners > maximumConcurrency))
+    {
+        numberOfRunners = maximumConcurrency;
+    }
+
+    struct SharedState
+    {
+        std::atomic<size_t> nextTaskNumber{0};
+        std::mutex mutex;
+        std::condition_variable condition;
+        // Set when the caller is done. Runners that have not started by then don't start anymore.
+        bool isClosed = false;
+        // Runners that started and have not finished yet.
+        size_t numberOfRunnersBusy = 0;
+    };
+    std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+
+    auto runner = [state, numberOfTasks, &task]()
+    {
+        size_t taskNumber;
+        while ((taskNumber = state->nextTaskNumber.fetch_add(1)) < numberOfTasks)
+        {
+            task(taskNumber);
+        }
+    };
+
+    for (size_t runnerNumber = 1; runnerNumber < numberOfRunners; runnerNumber++)
+    {
+        enqueue([state, runner]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->isClosed)
+                {
+                    return;
+                }
+                state->numberOfRunnersBusy++;
+            }
+
+            runner();
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->numberOfRunnersBusy--;
+            state->condition.notify_all();
+        });
+    }
+
+    runner();
+
+    // All task numbers are handed out. Wait for the runners that are still busy with theirs.
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->isClosed = true;
+    state->condition.wait(lock, [&state] { return state->numberOfRunnersBusy == 0; });
+}
+
+void WorkerPool::workerMain()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stop || !queue.empty(); });
+            if (stop)
+            {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        task();
+    }
+}
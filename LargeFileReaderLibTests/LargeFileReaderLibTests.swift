@@ -313,8 +313,9 @@ import LargeFileReaderLib
         bytesRead = largeFileReader.read(buffer, bytes: 64)
         #expect(bytesRead == 64)
         #expect(largeFileReader.isEof == false)
-        buffer[64] = 0
-        #expect(String(cString: buffer) == "00:39:42+02 KacBoom system_installd[965]: PackageKit: Adding cli")
+        // Blocks are fetched at their own offset, so this must be the data at offset 128 of the file.
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        #expect(Data(bytes: buffer, count: 64) == fileData[128..<192])
         
         largeFileReader.close()
         #expect(largeFileReader.isOpen == false)
@@ -448,23 +449,913 @@ import LargeFileReaderLib
         bytesRead = largeFileReader.read(buffer, bytes: 64)
         #expect(bytesRead == 64)
         #expect(largeFileReader.isEof == false)
-        buffer[64] = 0
-        #expect(String(cString: buffer) == "689]: SUOSUServiceDaemon: availableMobileSoftwareUpdates = (\n\t  ")
+        // Blocks are fetched at their own offset, so this must be the data at offset 128 of the file.
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        #expect(Data(bytes: buffer, count: 64) == fileData[128..<192])
+        
+        largeFileReader.close()
+        #expect(largeFileReader.isOpen == false)
+    }
+    
+    
+    @Test func testConcurrentReadAtLargeFile() async throws {
+        
+        let cacheBlockSize = 4096
+        
+        let largeFileReader = LargeFileReader()
+        #expect(largeFileReader.isOpen == false)
+        
+        // Use a cache that is much smaller than the file, so that the readers constantly steal each
+        // other's cache blocks.
+        let openResult = largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 8 * cacheBlockSize, cacheBlockSize: cacheBlockSize)
+        try #require(openResult == true)
+        #expect(largeFileReader.isOpen == true)
+        
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        
+        // Every reader reads the file in its own order, with its own read size, and checks the data.
+        let results = await withTaskGroup(of: Bool.self) { group in
+            for readerNumber in 0..<8 {
+                group.addTask {
+                    let readSize = 1000 + readerNumber * 997
+                    let buffer: UnsafeMutablePointer<UInt8> = UnsafeMutablePointer<UInt8>.allocate(capacity: readSize)
+                    defer { buffer.deallocate() }
+                    
+                    var offset = (readerNumber * 123457) % fileData.count
+                    for _ in 0..<500 {
+                        let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: readSize)
+                        if bytesRead != min(readSize, fileData.count - offset) ||
+                            Data(bytes: buffer, count: bytesRead) != fileData[offset..<(offset + bytesRead)] {
+                            return false
+                        }
+                        offset = (offset + 7 * readSize) % fileData.count
+                    }
+                    return true
+                }
+            }
+            
+            var results: [Bool] = []
+            for await result in group {
+                results.append(result)
+            }
+            return results
+        }
+        #expect(results.count == 8)
+        #expect(results.allSatisfy { $0 })
+        
+        // readAt does not use or change the current file offset.
+        #expect(largeFileReader.isEof == false)
         
         largeFileReader.close()
         #expect(largeFileReader.isOpen == false)
     }
     
+    @Test @MainActor func testCacheEvictionPolicies() async throws {
+        
+        let cacheBlockSize = 4096
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        
+        let buffer: UnsafeMutablePointer<UInt8> = UnsafeMutablePointer<UInt8>.allocate(capacity: 65536)
+        defer { buffer.deallocate() }
+        
+        for cacheEvictionPolicy in [LargeFileReaderCacheEvictionPolicy.LRU, .CLOCK, .twoQueue] {
+            let largeFileReader = LargeFileReader()
+            largeFileReader.cacheEvictionPolicy = cacheEvictionPolicy
+            
+            let openResult = largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 8 * cacheBlockSize, cacheBlockSize: cacheBlockSize)
+            try #require(openResult == true)
+            #expect(largeFileReader.cacheEvictionPolicy == cacheEvictionPolicy)
+            
+            // Keep coming back to the header of the file while scanning through the rest of it, the data
+            // must be correct whatever block the policy decides to steal.
+            var offset = 0
+            while offset < fileData.count {
+                var bytesRead = largeFileReader.readAt(0, buffer: buffer, bytes: 64)
+                #expect(bytesRead == 64)
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[0..<64])
+                
+                bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 5000)
+                #expect(bytesRead == min(5000, fileData.count - offset))
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+                offset += 5000
+            }
+            
+            largeFileReader.close()
+            #expect(largeFileReader.isOpen == false)
+        }
+    }
+    
+    @Test @MainActor func testDirectIO() async throws {
+        
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        
+        let buffer: UnsafeMutablePointer<UInt8> = UnsafeMutablePointer<UInt8>.allocate(capacity: 65536)
+        defer { buffer.deallocate() }
+        
+        let largeFileReader = LargeFileReader()
+        largeFileReader.directIOEnabled = true
+        
+        // A block size that is not a multiple of any device block size, it must be rounded up.
+        let openResult = largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 1048576, cacheBlockSize: 5000)
+        try #require(openResult == true)
+        #expect(largeFileReader.cacheBlockSize >= 5000)
+        
+        // Read the whole file sequentially, including the (unaligned) tail.
+        var fileOffset = 0
+        while !largeFileReader.isEof {
+            let bytesRead = largeFileReader.read(buffer, bytes: 65536)
+            try #require(bytesRead >= 0)
+            #expect(Data(bytes: buffer, count: bytesRead) == fileData[fileOffset..<(fileOffset + bytesRead)])
+            fileOffset += bytesRead
+        }
+        #expect(fileOffset == fileData.count)
+        
+        // And some random reads at unaligned offsets.
+        for offset in stride(from: 13, to: fileData.count, by: 100003) {
+            let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 20000)
+            #expect(bytesRead == min(20000, fileData.count - offset))
+            #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+        }
+        
+        largeFileReader.close()
+        #expect(largeFileReader.isOpen == false)
+    }
+    
+    @Test @MainActor func testViews() async throws {
+        
+        let cacheBlockSize = 4096
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        
+        let largeFileReader = LargeFileReader()
+        let openResult = largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 8 * cacheBlockSize, cacheBlockSize: cacheBlockSize)
+        try #require(openResult == true)
+        
+        // Walk through the whole file with views, holding on to the previous one, so that there are
+        // always pinned blocks while the others are being stolen.
+        var offset = 0
+        var previousView: Data? = nil
+        while offset < fileData.count {
+            let view = try #require(largeFileReader.view(at: offset, maxBytes: 10000))
+            #expect(view.count > 0)
+            #expect(view.count <= cacheBlockSize - (offset % cacheBlockSize))
+            #expect(view == fileData[offset..<(offset + view.count)])
+            if let previousView {
+                #expect(previousView == fileData[(offset - previousView.count)..<offset])
+            }
+            previousView = view
+            offset += view.count
+        }
+        previousView = nil
+        
+        let endView = try #require(largeFileReader.view(at: fileData.count, maxBytes: 100))
+        #expect(endView.count == 0)
+        
+        largeFileReader.close()
+        #expect(largeFileReader.isOpen == false)
+    }
+    
+    @Test @MainActor func testMemoryMappingMatchesBlockCache() async throws {
+        
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        
+        let buffer: UnsafeMutablePointer<UInt8> = UnsafeMutablePointer<UInt8>.allocate(capacity: 65536)
+        defer { buffer.deallocate() }
+        
+        // The block cache and memory mapping, both with the same (small) memory budget, so that windows
+        // have to be remapped too, must return the same data. How fast they are is measured by the
+        // benchmark (LargeFileReaderBenchmark, with and without --memory-mapped).
+        for memoryMappingEnabled in [false, true] {
+            let largeFileReader = LargeFileReader()
+            largeFileReader.memoryMappingEnabled = memoryMappingEnabled
+            
+            let openResult = largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 1048576, cacheBlockSize: 65536)
+            try #require(openResult == true)
+            #expect(largeFileReader.isMemoryMapped == memoryMappingEnabled)
+            
+            var fileOffset = 0
+            while !largeFileReader.isEof {
+                let bytesRead = largeFileReader.read(buffer, bytes: 65536)
+                try #require(bytesRead >= 0)
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[fileOffset..<(fileOffset + bytesRead)])
+                fileOffset += bytesRead
+            }
+            #expect(fileOffset == fileData.count)
+            
+            // Jump around the file with a fixed stride, so reads cross windows and windows get remapped.
+            var offset = 0
+            for _ in 0..<10000 {
+                offset = (offset + 1_048_573) % fileData.count
+                let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 4096)
+                #expect(bytesRead == min(4096, fileData.count - offset))
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+            }
+            
+            largeFileReader.close()
+            #expect(largeFileReader.isOpen == false)
+        }
+    }
+    
+    @Test @MainActor func testFollowMode() async throws {
+        
+        let followPath = testPathForFile("test_follow.log")
+        defer { try? FileManager.default.removeItem(at: followPath) }
+        try Data().write(to: followPath)
+        let fileHandle = try FileHandle(forWritingTo: followPath)
+        defer { try? fileHandle.close() }
+        
+        let buffer: UnsafeMutablePointer<UInt8> = UnsafeMutablePointer<UInt8>.allocate(capacity: 65536)
+        defer { buffer.deallocate() }
+        
+        let largeFileReader = LargeFileReader()
+        largeFileReader.followEnabled = true
+        let openResult = largeFileReader.open(followPath.path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 4096)
+        try #require(openResult == true)
+        #expect(largeFileReader.isFollowing == true)
+        #expect(largeFileReader.fileSize() == 0)
+        
+        // Append in pieces that end halfway a block, and read everything after every piece, so that the
+        // block at the end of the file is cached before it grows.
+        var fileData = Data()
+        for appendNumber in 0..<50 {
+            let line = Data(String(repeating: "line \(appendNumber) ", count: appendNumber * 10).utf8) + Data("\n".utf8)
+            try fileHandle.write(contentsOf: line)
+            fileData.append(line)
+            
+            #expect(largeFileReader.refreshFileSize() == fileData.count)
+            
+            var offset = 0
+            while offset < fileData.count {
+                let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 65536)
+                try #require(bytesRead > 0)
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+                offset += bytesRead
+            }
+        }
+        
+        // A truncated file can not be followed.
+        try fileHandle.truncate(atOffset: 10)
+        #expect(largeFileReader.refreshFileSize() == -1)
+        
+        largeFileReader.close()
+        #expect(largeFileReader.isOpen == false)
+    }
+    
+    @Test @MainActor func testLineIndexer() async throws {
+        
+        let fileData = try Data(contentsOf: testPathForFile("test_small.log"))
+        var expectedLines = fileData.split(separator: 10, omittingEmptySubsequences: false).map { Data($0) }
+        if fileData.last == 10 {
+            expectedLines.removeLast()
+        }
+        
+        // Small blocks, so that lines cross block boundaries (the whole file fits in the cache, so the
+        // lines that we hold on to can not pin all blocks). Check both a full and a sparse index.
+        for lineCheckpointInterval in [1, 7] {
+            let largeFileReader = LargeFileReader()
+            let openResult = largeFileReader.open(testPathForFile("test_small.log").path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+            try #require(openResult == true)
+            
+            let lineIndexer = LineIndexer(reader: largeFileReader)
+            lineIndexer.lineCheckpointInterval = lineCheckpointInterval
+            #expect(lineIndexer.numberOfLines == -1)
+            try #require(lineIndexer.indexLines() == true)
+            #expect(lineIndexer.numberOfLines == expectedLines.count)
+            
+            for lineNumber in 0..<expectedLines.count {
+                #expect(lineIndexer.line(at: lineNumber) == expectedLines[lineNumber])
+            }
+            #expect(lineIndexer.line(at: expectedLines.count) == nil)
+            
+            let lines = try #require(lineIndexer.lines(from: 100, count: 50))
+            #expect(lines == Array(expectedLines[100..<150]))
+            let linesAtEnd = try #require(lineIndexer.lines(from: expectedLines.count - 3, count: 50))
+            #expect(linesAtEnd == Array(expectedLines[(expectedLines.count - 3)...]))
+            
+            var forwardLineNumbers: [Int] = []
+            lineIndexer.enumerateLines(from: 10, reverse: false) { lineNumber, line, stop in
+                #expect(line == expectedLines[lineNumber])
+                forwardLineNumbers.append(lineNumber)
+            }
+            #expect(forwardLineNumbers == Array(10..<expectedLines.count))
+            
+            var backwardLineNumbers: [Int] = []
+            lineIndexer.enumerateLines(from: 20, reverse: true) { lineNumber, line, stop in
+                #expect(line == expectedLines[lineNumber])
+                backwardLineNumbers.append(lineNumber)
+                if lineNumber == 5 {
+                    stop.pointee = true
+                }
+            }
+            #expect(backwardLineNumbers == Array((5...20).reversed()))
+            
+            largeFileReader.close()
+        }
+    }
+    
+    @Test @MainActor func testLineDelimiters() async throws {
+        
+        let delimitedPath = testPathForFile("test_delimited.log")
+        defer { try? FileManager.default.removeItem(at: delimitedPath) }
+        
+        // Records of all lengths, so that delimiters straddle the block boundaries. The last record has
+        // no delimiter.
+        let records = (0..<300).map { Data(String(repeating: "r\($0)", count: $0 % 40).utf8) }
+        for delimiter in [Data("\r\n".utf8), Data([0x1E]), Data([0x00]), Data("--8<--".utf8)] {
+            var fileData = Data()
+            for (recordNumber, record) in records.enumerated() {
+                if recordNumber > 0 {
+                    fileData.append(delimiter)
+                }
+                fileData.append(record)
+            }
+            try fileData.write(to: delimitedPath)
+            
+            for lineCheckpointInterval in [1, 5] {
+                let largeFileReader = LargeFileReader()
+                let openResult = largeFileReader.open(delimitedPath.path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+                try #require(openResult == true)
+                
+                let lineIndexer = LineIndexer(reader: largeFileReader)
+                lineIndexer.lineDelimiter = delimiter
+                lineIndexer.lineCheckpointInterval = lineCheckpointInterval
+                try #require(lineIndexer.indexLines() == true)
+                #expect(lineIndexer.numberOfLines == records.count)
+                for lineNumber in 0..<records.count {
+                    #expect(lineIndexer.line(at: lineNumber) == records[lineNumber])
+                }
+                
+                // Long records are cut into pieces.
+                lineIndexer.maximumLineLength = 16
+                try #require(lineIndexer.indexLines() == true)
+                let pieces = records.flatMap { record in
+                    stride(from: 0, to: max(record.count, 1), by: 16).map { record.subdata(in: $0..<min($0 + 16, record.count)) }
+                }
+                #expect(lineIndexer.numberOfLines == pieces.count)
+                #expect(lineIndexer.lines(from: 0, count: pieces.count) == pieces)
+                
+                largeFileReader.close()
+            }
+        }
+    }
+    
+    @Test @MainActor func testFollowLineIndexing() async throws {
+        
+        let followPath = testPathForFile("test_follow_lines.log")
+        defer { try? FileManager.default.removeItem(at: followPath) }
+        
+        // Appends that end halfway a line, and halfway a delimiter, so that the last line must be
+        // indexed again when the rest of it arrives.
+        var appends = ["first line\r\nsecond ", "line\r", "\n", "third line, longer than sixteen bytes\r", "\nfourth\r\n", "\r\n", "fif", "th\r", "\nsixth"]
+        for appendNumber in 0..<40 {
+            appends.append(String(repeating: "x", count: appendNumber * 7) + ["\r", "\r\nmid", "\r\n"][appendNumber % 3])
+        }
+        
+        for lineCheckpointInterval in [1, 5] {
+            for maximumLineLength in [2048, 16] {
+                try Data().write(to: followPath)
+                let fileHandle = try FileHandle(forWritingTo: followPath)
+                defer { try? fileHandle.close() }
+                
+                let largeFileReader = LargeFileReader()
+                largeFileReader.followEnabled = true
+                let openResult = largeFileReader.open(followPath.path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+                try #require(openResult == true)
+                
+                func makeLineIndexer() -> LineIndexer {
+                    let lineIndexer = LineIndexer(reader: largeFileReader)
+                    lineIndexer.lineDelimiter = Data("\r\n".utf8)
+                    lineIndexer.lineCheckpointInterval = lineCheckpointInterval
+                    lineIndexer.maximumLineLength = maximumLineLength
+                    return lineIndexer
+                }
+                
+                let followingLineIndexer = makeLineIndexer()
+                var fileSize = 0
+                for append in appends {
+                    try fileHandle.write(contentsOf: Data(append.utf8))
+                    fileSize += append.utf8.count
+                    #expect(largeFileReader.refreshFileSize() == fileSize)
+                    try #require(followingLineIndexer.indexNewLines() == true)
+                    
+                    let fullLineIndexer = makeLineIndexer()
+                    try #require(fullLineIndexer.indexLines() == true)
+                    #expect(followingLineIndexer.numberOfLines == fullLineIndexer.numberOfLines)
+                    #expect(followingLineIndexer.lines(from: 0, count: followingLineIndexer.numberOfLines) == fullLineIndexer.lines(from: 0, count: fullLineIndexer.numberOfLines))
+                }
+                
+                largeFileReader.close()
+            }
+        }
+    }
+    
+    @Test @MainActor func testLineIndexFile() async throws {
+        
+        let savedPath = testPathForFile("test_saved.log")
+        let lineIndexPath = testPathForFile("test_saved.log.lineindex")
+        defer {
+            try? FileManager.default.removeItem(at: savedPath)
+            try? FileManager.default.removeItem(at: lineIndexPath)
+        }
+        var fileData = try Data(contentsOf: testPathForFile("test_small.log"))
+        try fileData.write(to: savedPath)
+        
+        func openLineIndexer(_ configure: (LineIndexer) -> Void = { _ in }) throws -> (LargeFileReader, LineIndexer) {
+            let largeFileReader = LargeFileReader()
+            let openResult = largeFileReader.open(savedPath.path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+            try #require(openResult == true)
+            let lineIndexer = LineIndexer(reader: largeFileReader)
+            configure(lineIndexer)
+            return (largeFileReader, lineIndexer)
+        }
+        
+        let (largeFileReader, lineIndexer) = try openLineIndexer()
+        try #require(lineIndexer.indexLines() == true)
+        try #require(lineIndexer.saveLineIndex(lineIndexPath.path(percentEncoded: false)) == true)
+        let expectedLines = try #require(lineIndexer.lines(from: 0, count: lineIndexer.numberOfLines))
+        largeFileReader.close()
+        
+        // The same file, with the same settings, gets the same lines without indexing.
+        let (loadingFileReader, loadingLineIndexer) = try openLineIndexer()
+        #expect(loadingLineIndexer.loadLineIndex(lineIndexPath.path(percentEncoded: false)) == true)
+        #expect(loadingLineIndexer.numberOfLines == expectedLines.count)
+        for lineNumber in 0..<expectedLines.count {
+            #expect(loadingLineIndexer.line(at: lineNumber) == expectedLines[lineNumber])
+        }
+        #expect(loadingLineIndexer.line(at: expectedLines.count) == nil)
+        #expect(loadingLineIndexer.lines(from: 100, count: 50) == Array(expectedLines[100..<150]))
+        loadingFileReader.close()
+        
+        // Other settings make other lines.
+        let (delimiterFileReader, delimiterLineIndexer) = try openLineIndexer { $0.lineDelimiter = Data("\r\n".utf8) }
+        #expect(delimiterLineIndexer.loadLineIndex(lineIndexPath.path(percentEncoded: false)) == false)
+        #expect(delimiterLineIndexer.numberOfLines == -1)
+        delimiterFileReader.close()
+        let (lengthFileReader, lengthLineIndexer) = try openLineIndexer { $0.maximumLineLength = 16 }
+        #expect(lengthLineIndexer.loadLineIndex(lineIndexPath.path(percentEncoded: false)) == false)
+        lengthFileReader.close()
+        
+        // A changed file is not what was indexed, whether it has the same size or not.
+        fileData[0] ^= 0x20
+        try fileData.write(to: savedPath)
+        let (changedFileReader, changedLineIndexer) = try openLineIndexer()
+        #expect(changedLineIndexer.loadLineIndex(lineIndexPath.path(percentEncoded: false)) == false)
+        changedFileReader.close()
+        
+        fileData[0] ^= 0x20
+        fileData.append(Data("appended line\n".utf8))
+        try fileData.write(to: savedPath)
+        let (appendedFileReader, appendedLineIndexer) = try openLineIndexer()
+        #expect(appendedLineIndexer.loadLineIndex(lineIndexPath.path(percentEncoded: false)) == false)
+        appendedFileReader.close()
+    }
     
+    @Test @MainActor func testParallelLineIndexing() async throws {
+        
+        let parallelPath = testPathForFile("test_parallel.log")
+        defer { try? FileManager.default.removeItem(at: parallelPath) }
+        
+        // The smallest chunks there are, a record that spans several of them, and a delimiter split
+        // across every chunk boundary.
+        let chunkSize = 65536
+        for delimiter in [Data("\r\n".utf8), Data("<eor>".utf8)] {
+            var fileData = Data()
+            var records: [Data] = []
+            func appendRecord(_ record: Data) {
+                if !records.isEmpty {
+                    fileData.append(delimiter)
+                }
+                fileData.append(record)
+                records.append(record)
+            }
+            for chunkNumber in 1...6 {
+                if chunkNumber == 2 {
+                    appendRecord(Data(repeating: 0x6C, count: 3 * chunkSize))
+                }
+                let chunkBoundary = ((fileData.count + 200) / chunkSize + 1) * chunkSize
+                let startOfDelimiter = chunkBoundary - 1 - (chunkNumber % (delimiter.count - 1))
+                while fileData.count + 200 < startOfDelimiter {
+                    appendRecord(Data(String(repeating: "r\(records.count)", count: records.count % 30).utf8))
+                }
+                appendRecord(Data(repeating: 0x61, count: startOfDelimiter - fileData.count - delimiter.count))
+            }
+            appendRecord(Data("last".utf8))
+            try fileData.write(to: parallelPath)
+            
+            for maximumLineLength in [2048, 4 * chunkSize] {
+                for lineCheckpointInterval in [1, 5] {
+                    let largeFileReader = LargeFileReader()
+                    let openResult = largeFileReader.open(parallelPath.path(percentEncoded: false), cacheMaxSize: 1048576, cacheBlockSize: 4096)
+                    try #require(openResult == true)
+                    
+                    var indexedLines: [[Data]] = []
+                    for numberOfIndexingThreads in [1, 4] {
+                        let lineIndexer = LineIndexer(reader: largeFileReader)
+                        lineIndexer.lineDelimiter = delimiter
+                        lineIndexer.maximumLineLength = maximumLineLength
+                        lineIndexer.lineCheckpointInterval = lineCheckpointInterval
+                        lineIndexer.numberOfIndexingThreads = numberOfIndexingThreads
+                        lineIndexer.parallelIndexingChunkSize = chunkSize
+                        try #require(lineIndexer.indexLines() == true)
+                        indexedLines.append(try #require(lineIndexer.lines(from: 0, count: lineIndexer.numberOfLines)))
+                    }
+                    #expect(indexedLines[1] == indexedLines[0])
+                    if maximumLineLength > 3 * chunkSize {
+                        #expect(indexedLines[1] == records)
+                    }
+                    
+                    largeFileReader.close()
+                }
+            }
+        }
+    }
+    
+    @Test @MainActor func testFileSearcher() async throws {
+        
+        let fileData = try Data(contentsOf: testPathForFile("test_small.log"))
+        let lines = fileData.split(separator: 10, omittingEmptySubsequences: false).map { Data($0) }
+        
+        // Small blocks, so that matches cross block boundaries.
+        let largeFileReader = LargeFileReader()
+        let openResult = largeFileReader.open(testPathForFile("test_small.log").path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+        try #require(openResult == true)
+        let lineIndexer = LineIndexer(reader: largeFileReader)
+        try #require(lineIndexer.indexLines() == true)
+        
+        let fileSearcher = FileSearcher(reader: largeFileReader, lineIndexer: lineIndexer)
+        
+        // Search for a piece of a line in the middle of the file, and for everything that is in it.
+        let searchString = lines[lines.count / 2].prefix(12)
+        var expectedOffsets: [Int] = []
+        var searchRange = fileData.startIndex..<fileData.endIndex
+        while let range = fileData.range(of: searchString, in: searchRange) {
+            expectedOffsets.append(range.lowerBound)
+            searchRange = (range.lowerBound + 1)..<fileData.endIndex
+        }
+        
+        var offsets: [Int] = []
+        let numberOfMatches = fileSearcher.search(forString: Data(searchString)) { offset, length, lineNumber, stop in
+            #expect(length == searchString.count)
+            #expect(lines[lineNumber].range(of: searchString) != nil)
+            offsets.append(offset)
+        }
+        #expect(numberOfMatches == expectedOffsets.count)
+        #expect(offsets == expectedOffsets)
+        
+        // Stop at the first match.
+        var numberOfMatchesSeen = 0
+        _ = fileSearcher.search(forString: Data("\n".utf8)) { offset, length, lineNumber, stop in
+            numberOfMatchesSeen += 1
+            stop.pointee = true
+        }
+        #expect(numberOfMatchesSeen == 1)
+        
+        // Every line matches ^, the empty last one (after the last delimiter) is not a line.
+        var lineNumbers: [Int] = []
+        let numberOfLineMatches = fileSearcher.search(forRegularExpression: "^") { offset, length, lineNumber, stop in
+            lineNumbers.append(lineNumber)
+        }
+        #expect(numberOfLineMatches == lineIndexer.numberOfLines)
+        #expect(lineNumbers == Array(0..<lineIndexer.numberOfLines))
+        #expect(fileSearcher.search(forRegularExpression: "(") { _, _, _, _ in } == -1)
+        
+        largeFileReader.close()
+    }
+    
+    @Test @MainActor func testRegularExpressionLines() async throws {
+        
+        let searchPath = testPathForFile("test_search_lines.log")
+        defer { try? FileManager.default.removeItem(at: searchPath) }
+        
+        func search(_ fileSearcher: FileSearcher, _ pattern: String) -> [Int] {
+            var lineNumbers: [Int] = []
+            _ = fileSearcher.search(forRegularExpression: pattern) { offset, length, lineNumber, stop in
+                lineNumbers.append(lineNumber)
+            }
+            return lineNumbers
+        }
+        
+        // A line of 100000 bytes, which must not run a matcher out of stack. The lines end in "\r\n",
+        // which must not be part of the line for $.
+        try Data(("line one\r\n" + String(repeating: "a", count: 100_000) + "\r\nline three\r\nab\r\n").utf8).write(to: searchPath)
+        var largeFileReader = LargeFileReader()
+        var openResult = largeFileReader.open(searchPath.path(percentEncoded: false), cacheMaxSize: 1048576, cacheBlockSize: 4096)
+        try #require(openResult == true)
+        var lineIndexer = LineIndexer(reader: largeFileReader)
+        lineIndexer.lineDelimiter = Data("\r\n".utf8)
+        lineIndexer.maximumLineLength = 200_000
+        try #require(lineIndexer.indexLines() == true)
+        
+        var fileSearcher = FileSearcher(reader: largeFileReader, lineIndexer: lineIndexer)
+        #expect(search(fileSearcher, "e$") == [0, 2])
+        #expect(search(fileSearcher, "a.*b") == [3])
+        #expect(search(fileSearcher, "^a+$") == [1])
+        
+        // Without a line indexer, the searcher has its own delimiter, and matches long lines in pieces.
+        fileSearcher = FileSearcher(reader: largeFileReader)
+        fileSearcher.lineDelimiter = Data("\r\n".utf8)
+        #expect(search(fileSearcher, "e$") == [-1, -1])
+        fileSearcher.maximumLineLength = 40_000
+        #expect(search(fileSearcher, "^a+$").count == 3)
+        largeFileReader.close()
+        
+        // NUL separated records, with newlines in them. The line numbers are those of the records.
+        try Data("one\ntwo\u{0}three\u{0}four\nfive".utf8).write(to: searchPath)
+        largeFileReader = LargeFileReader()
+        openResult = largeFileReader.open(searchPath.path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 4096)
+        try #require(openResult == true)
+        lineIndexer = LineIndexer(reader: largeFileReader)
+        lineIndexer.lineDelimiter = Data([0x00])
+        try #require(lineIndexer.indexLines() == true)
+        
+        fileSearcher = FileSearcher(reader: largeFileReader, lineIndexer: lineIndexer)
+        #expect(search(fileSearcher, "^") == [0, 1, 2])
+        #expect(search(fileSearcher, "^t") == [1])
+        #expect(search(fileSearcher, "f") == [2, 2])
+        largeFileReader.close()
+    }
+    
+    @Test @MainActor func testCompressedFile() async throws {
+        
+        // test_small.log.gz is test_small.log, gzipped in two members.
+        let fileData = try Data(contentsOf: testPathForFile("test_small.log"))
+        
+        let largeFileReader = LargeFileReader()
+        let openResult = largeFileReader.open(testPathForFile("test_small.log.gz").path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 1024)
+        try #require(openResult == true)
+        #expect(largeFileReader.isCompressed == true)
+        #expect(largeFileReader.fileSize() == fileData.count)
+        
+        // Sequentially, across blocks and the member boundary.
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 700)
+        defer { buffer.deallocate() }
+        var readData = Data()
+        while true {
+            let bytesRead = largeFileReader.read(buffer, bytes: 700)
+            if bytesRead <= 0 {
+                break
+            }
+            readData.append(buffer, count: bytesRead)
+        }
+        #expect(readData == fileData)
+        
+        // Randomly.
+        for offset in stride(from: fileData.count - 1, to: 0, by: -997) {
+            let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 700)
+            #expect(bytesRead == min(700, fileData.count - offset))
+            #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+        }
+        
+        let lineIndexer = LineIndexer(reader: largeFileReader)
+        try #require(lineIndexer.indexLines() == true)
+        #expect(lineIndexer.numberOfLines == 266)
+        
+        largeFileReader.close()
+        
+        // Without decompression, it's just a file.
+        largeFileReader.decompressionEnabled = false
+        try #require(largeFileReader.open(testPathForFile("test_small.log.gz").path(percentEncoded: false)) == true)
+        #expect(largeFileReader.isCompressed == false)
+        #expect(largeFileReader.fileSize() < fileData.count)
+        largeFileReader.close()
+    }
+    
+    @Test @MainActor func testCacheStatistics() async throws {
+        
+        // 24 blocks of 1024 bytes, and room for 8 of them.
+        let largeFileReader = LargeFileReader()
+        largeFileReader.readAheadEnabled = false
+        let openResult = largeFileReader.open(testPathForFile("test_small.log").path(percentEncoded: false), cacheMaxSize: 8192, cacheBlockSize: 1024)
+        try #require(openResult == true)
+        let fileSize = largeFileReader.fileSize()
+        
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 1000)
+        defer { buffer.deallocate() }
+        while largeFileReader.read(buffer, bytes: 1000) > 0 {
+        }
+        
+        let statistics = largeFileReader.statistics()
+        #expect(statistics.numberOfMisses == 24)
+        #expect(statistics.numberOfEvictions == 16)
+        #expect(statistics.numberOfFetchedBlocks == 24)
+        #expect(statistics.numberOfFetchErrors == 0)
+        #expect(statistics.bytesReadFromFile == fileSize)
+        #expect(statistics.bytesServedFromCache == fileSize)
+        #expect(statistics.numberOfCachedBlocks == 8)
+        #expect(statistics.workingSetSize == 8192)
+        #expect(statistics.fetchLatencyHistogram.reduce(0) { $0 + $1.intValue } == statistics.numberOfFetches)
+        #expect(statistics.fetchLatencyPercentile(50) <= statistics.fetchLatencyPercentile(99))
+        
+        // The first block was evicted, so this is a miss and then a hit.
+        largeFileReader.resetStatistics()
+        #expect(largeFileReader.readAt(0, buffer: buffer, bytes: 10) == 10)
+        #expect(largeFileReader.readAt(0, buffer: buffer, bytes: 10) == 10)
+        let statisticsAfterReset = largeFileReader.statistics()
+        #expect(statisticsAfterReset.numberOfMisses == 1)
+        #expect(statisticsAfterReset.numberOfHits == 1)
+        #expect(statisticsAfterReset.hitRate == 0.5)
+        #expect(statisticsAfterReset.bytesServedFromCache == 20)
+        
+        largeFileReader.close()
+    }
+    
+    @Test @MainActor func testSharedCache() async throws {
+        
+        // Room for 8 blocks of 1024 bytes, for both readers together.
+        let sharedCache = try #require(LargeFileReaderSharedCache(cacheMaxSize: 8192, cacheBlockSize: 1024))
+        #expect(sharedCache.cacheActualSize == 8192)
+        
+        let firstReader = LargeFileReader()
+        let secondReader = LargeFileReader()
+        firstReader.readAheadEnabled = false
+        secondReader.readAheadEnabled = false
+        firstReader.sharedCache = sharedCache
+        secondReader.sharedCache = sharedCache
+        try #require(firstReader.open(testPathForFile("test_small.log").path(percentEncoded: false)) == true)
+        try #require(secondReader.open(testPathForFile("test_large.log").path(percentEncoded: false)) == true)
+        #expect(firstReader.isSharingCache)
+        #expect(firstReader.cacheBlockSize == 1024)
+        #expect(sharedCache.numberOfAttachedFiles == 2)
+        
+        let firstFileData = try Data(contentsOf: testPathForFile("test_small.log"))
+        let secondFileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 4096)
+        defer { buffer.deallocate() }
+        
+        // The first file takes 4 blocks, and then the second file takes the rest, and the blocks of
+        // the first file when it needs more.
+        #expect(firstReader.readAt(0, buffer: buffer, bytes: 4096) == 4096)
+        #expect(Data(bytes: buffer, count: 4096) == firstFileData.prefix(4096))
+        #expect(firstReader.statistics().numberOfCachedBlocks == 4)
+        #expect(secondReader.readAt(0, buffer: buffer, bytes: 4096) == 4096)
+        #expect(Data(bytes: buffer, count: 4096) == secondFileData.prefix(4096))
+        #expect(sharedCache.numberOfCachedBlocks == 8)
+        #expect(secondReader.readAt(4096, buffer: buffer, bytes: 4096) == 4096)
+        #expect(Data(bytes: buffer, count: 4096) == secondFileData.subdata(in: 4096..<8192))
+        #expect(sharedCache.numberOfCachedBlocks == 8)
+        #expect(firstReader.statistics().numberOfCachedBlocks == 0)
+        #expect(secondReader.statistics().numberOfCachedBlocks == 8)
+        #expect(secondReader.statistics().numberOfEvictions == 4)
+        
+        // The blocks of the first file were evicted, not mixed up with the blocks of the second file.
+        #expect(firstReader.readAt(0, buffer: buffer, bytes: 1024) == 1024)
+        #expect(Data(bytes: buffer, count: 1024) == firstFileData.prefix(1024))
+        #expect(firstReader.statistics().numberOfMisses == 5)
+        
+        // Closing a file gives its blocks back.
+        secondReader.close()
+        #expect(sharedCache.numberOfAttachedFiles == 1)
+        #expect(sharedCache.numberOfCachedBlocks == 1)
+        
+        firstReader.close()
+        #expect(sharedCache.numberOfAttachedFiles == 0)
+    }
+
+    @Test @MainActor func testReadRanges() async throws {
+
+        let largeFileReader = LargeFileReader()
+        largeFileReader.readAheadEnabled = false
+        try #require(largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 16384, cacheBlockSize: 1024) == true)
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+
+        // Out of order, overlapping, neighbours, crossing blocks, and past the end of the file.
+        let offsetsAndLengths = [(5000, 100), (0, 10), (5050, 3000), (2048, 1024), (1024, 1024), (fileData.count - 10, 100), (fileData.count + 10, 10)]
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 8192)
+        defer { buffer.deallocate() }
+        var ranges: [LargeFileReaderReadRange] = []
+        var bufferOffset = 0
+        for (offset, length) in offsetsAndLengths {
+            ranges.append(LargeFileReaderReadRange(fileOffset: offset, buffer: buffer + bufferOffset, length: length, bytesRead: 0))
+            bufferOffset += length
+        }
+
+        let totalBytesRead = largeFileReader.readRanges(&ranges, count: ranges.count)
+        #expect(totalBytesRead == 100 + 10 + 3000 + 1024 + 1024 + 10)
+        for range in ranges {
+            let expectedLength = max(0, min(range.length, fileData.count - range.fileOffset))
+            #expect(range.bytesRead == expectedLength)
+            if range.bytesRead > 0 {
+                #expect(Data(bytes: range.buffer, count: range.bytesRead) == fileData.subdata(in: range.fileOffset..<(range.fileOffset + range.bytesRead)))
+            }
+        }
+
+        // Every block is fetched once, however many ranges need it: blocks 0, 1, 2, 4 to 7, and the last one.
+        #expect(largeFileReader.statistics().numberOfMisses == 8)
+
+        largeFileReader.close()
+    }
+
+    @Test @MainActor func testLargeReadBypass() async throws {
+
+        // 16 blocks of 1024 bytes in the cache, and reads of 8192 bytes or more go around it.
+        let largeFileReader = LargeFileReader()
+        largeFileReader.readAheadEnabled = false
+        try #require(largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 16384, cacheBlockSize: 1024) == true)
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 1048576)
+        defer { buffer.deallocate() }
+
+        // Fill the cache with the first 16 blocks.
+        #expect(largeFileReader.readAt(0, buffer: buffer, bytes: 16384) == 16384)
+        largeFileReader.largeReadBypassThreshold = 8192
+
+        // Only the partial blocks at the start and the end of a large read go through the cache.
+        largeFileReader.resetStatistics()
+        #expect(largeFileReader.readAt(100000 + 500, buffer: buffer, bytes: 1048576) == 1048576)
+        #expect(Data(bytes: buffer, count: 1048576) == fileData.subdata(in: 100500..<(100500 + 1048576)))
+        var statistics = largeFileReader.statistics()
+        #expect(statistics.numberOfMisses == 2)
+        #expect(statistics.numberOfEvictions == 2)
+        #expect(statistics.bytesBypassingCache == 1048576 - 1024)
+        #expect(statistics.bytesServedFromCache == 1024)
+
+        // Small reads still go through the cache, which still has blocks 2 to 15.
+        largeFileReader.resetStatistics()
+        #expect(largeFileReader.readAt(8192 + 1000, buffer: buffer, bytes: 4000) == 4000)
+        statistics = largeFileReader.statistics()
+        #expect(statistics.numberOfHits == 5)
+        #expect(statistics.bytesBypassingCache == 0)
+
+        // Switched off, a large read goes through the cache.
+        largeFileReader.largeReadBypassThreshold = 0
+        largeFileReader.resetStatistics()
+        #expect(largeFileReader.readAt(200000, buffer: buffer, bytes: 65536) == 65536)
+        #expect(Data(bytes: buffer, count: 65536) == fileData.subdata(in: 200000..<265536))
+        #expect(largeFileReader.statistics().bytesBypassingCache == 0)
+
+        largeFileReader.close()
+    }
+
+    @Test @MainActor func testAsyncReads() async throws {
+
+        let largeFileReader = LargeFileReader()
+        largeFileReader.readAheadEnabled = false
+        try #require(largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 4096) == true)
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 20000)
+        defer { buffer.deallocate() }
+
+        // Misses are read on the I/O worker pool, the main actor is free while we wait.
+        for offset in stride(from: fileData.count - 1, to: 0, by: -250007) {
+            let bytesRead = await largeFileReader.readAsyncAt(offset, buffer: buffer, bytes: 20000)
+            #expect(bytesRead == min(20000, fileData.count - offset))
+            #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+        }
+
+        // A read of blocks that are cached comes straight from the cache.
+        largeFileReader.resetStatistics()
+        #expect(await largeFileReader.readAsyncAt(1000, buffer: buffer, bytes: 5000) == 5000)
+        #expect(await largeFileReader.readAsyncAt(1000, buffer: buffer, bytes: 5000) == 5000)
+        #expect(Data(bytes: buffer, count: 5000) == fileData.subdata(in: 1000..<6000))
+        let statistics = largeFileReader.statistics()
+        #expect(statistics.numberOfMisses == 2)
+        #expect(statistics.numberOfHits == 2)
+
+        // Nothing past the end of the file, and an error when it is closed.
+        #expect(await largeFileReader.readAsyncAt(fileData.count, buffer: buffer, bytes: 100) == 0)
+        largeFileReader.close()
+        #expect(await largeFileReader.readAsyncAt(0, buffer: buffer, bytes: 100) == -1)
+    }
+
+    @Test @MainActor func testCachePageTypes() async throws {
+
+        let fileData = try Data(contentsOf: testPathForFile("test_large.log"))
+        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: 700)
+        defer { buffer.deallocate() }
+
+        // Whatever the machine has reserved, every page type falls back to one that it has, and the
+        // data is the same.
+        for pageType in [LargeFileReaderCachePageType.default, .transparentHuge, .huge2MB, .huge1GB] {
+            let largeFileReader = LargeFileReader()
+            largeFileReader.cachePageType = pageType
+            largeFileReader.cacheNumaPolicy = .interleave
+            try #require(largeFileReader.open(testPathForFile("test_large.log").path(percentEncoded: false), cacheMaxSize: 65536, cacheBlockSize: 4096) == true)
+            #expect(largeFileReader.cacheActualPageType.rawValue <= pageType.rawValue)
+
+            for offset in stride(from: fileData.count - 1, to: 0, by: -997) {
+                let bytesRead = largeFileReader.readAt(offset, buffer: buffer, bytes: 700)
+                #expect(bytesRead == min(700, fileData.count - offset))
+                #expect(Data(bytes: buffer, count: bytesRead) == fileData[offset..<(offset + bytesRead)])
+            }
+            largeFileReader.close()
+            #expect(largeFileReader.cacheActualPageType == .default)
+        }
+
+        let sharedCache = try #require(LargeFileReaderSharedCache(cacheMaxSize: 65536, cacheBlockSize: 4096, cacheEvictionPolicy: .LRU,
+                                                                  cachePageType: .transparentHuge, numaPolicy: .bind, numaNodeMask: 1))
+        #expect(sharedCache.cacheActualPageType.rawValue <= LargeFileReaderCachePageType.transparentHuge.rawValue)
+    }
+
     func copyTestFiles() {
         copyTestFile(filename: "test_empty.log")
         copyTestFile(filename: "test_small.log")
+        copyTestFile(filename: "test_small.log.gz")
         copyTestFile(filename: "test_large.log")
     }
     
     func deleteTestFiles() {
         deleteTestFile(filename: "test_empty.log")
         deleteTestFile(filename: "test_small.log")
+        deleteTestFile(filename: "test_small.log.gz")
         deleteTestFile(filename: "test_large.log")
     }
     
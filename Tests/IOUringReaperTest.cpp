@@ -0,0 +1,175 @@
+//
+//  IOUringReaperTest.cpp
+//  LargeFileReaderLib
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IOUringFileIOBackend.hpp"
+
+// Two threads read from one IOUringFileIOBackend at the same time:
+//
+// - Thread A reads a block that is not in the page cache. The read does not complete when it is
+//   submitted, so A becomes the reaper, and waits in the kernel for its completion.
+// - Thread B reads a block that is in the page cache, while A is between unlocking the ring and
+//   entering the kernel. That read completes when it is submitted.
+//
+// The gap between unlocking and entering the kernel is normally far too short to hit, so we make it
+// longer by sleeping in front of every io_uring_enter that waits for completions. If B takes A's
+// completion from the ring in that gap, A waits for a completion that never comes.
+//
+// Where the file can not be dropped from the page cache (e.g. on tmpfs), A's read completes when it is
+// submitted too, A never becomes the reaper, and the test passes without testing much.
+
+#if LARGEFILEREADER_HAS_IO_URING
+
+#include <linux/io_uring.h>
+
+static const long reaperDelayMicroseconds = 200000;
+
+// Wraps the syscall() of the C library, which IOUringFileIOBackend uses to talk to io_uring.
+extern "C" long syscall(long number, ...)
+{
+    va_list arguments;
+    va_start(arguments, number);
+    long argument[6];
+    for (int argumentIndex = 0; argumentIndex < 6; argumentIndex++)
+    {
+        argument[argumentIndex] = va_arg(arguments, long);
+    }
+    va_end(arguments);
+
+    static long (*realSyscall)(long, ...) = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+    if ((number == __NR_io_uring_enter) && ((argument[3] & IORING_ENTER_GETEVENTS) != 0))
+    {
+        usleep(reaperDelayMicroseconds);
+    }
+    return realSyscall(number, argument[0], argument[1], argument[2], argument[3], argument[4], argument[5]);
+}
+
+int main(int argc, char** argv)
+{
+    std::string directory = (argc > 1) ? argv[1] : ".";
+    std::string filePath = directory + "/IOUringReaperTest.data";
+
+    const size_t blockSize = 4096;
+    const off_t coldOffset = 0;
+    const off_t warmOffset = 1048576;
+
+    // Write the file, and make sure it is on disk, so the kernel can drop it from the page cache.
+    int fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0)
+    {
+        fprintf(stderr, "Can not create %s: %s\n", filePath.c_str(), strerror(errno));
+        return 1;
+    }
+    std::vector<unsigned char> fileData(warmOffset + blockSize);
+    for (size_t byteIndex = 0; byteIndex < fileData.size(); byteIndex++)
+    {
+        fileData[byteIndex] = (unsigned char)(byteIndex * 7);
+    }
+    bool isWritten = (pwrite(fileDescriptor, fileData.data(), fileData.size(), 0) == (ssize_t)fileData.size()) && (fsync(fileDescriptor) == 0);
+    unlink(filePath.c_str());
+    if (!isWritten)
+    {
+        fprintf(stderr, "Can not write %s: %s\n", filePath.c_str(), strerror(errno));
+        close(fileDescriptor);
+        return 1;
+    }
+    // Drop all of it (the kernel may keep pages around that are only partly in a smaller range), and
+    // read the warm block back in.
+    posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+    std::vector<unsigned char> coldBuffer(blockSize);
+    std::vector<unsigned char> warmBuffer(blockSize);
+    if (pread(fileDescriptor, warmBuffer.data(), blockSize, warmOffset) != (ssize_t)blockSize)
+    {
+        fprintf(stderr, "Can not read %s: %s\n", filePath.c_str(), strerror(errno));
+        close(fileDescriptor);
+        return 1;
+    }
+
+    IOUringFileIOBackend backend(IOUringFileIOBackend::defaultQueueDepth);
+    if (!backend.attach(fileDescriptor, 0))
+    {
+        printf("io_uring is not available, nothing to test\n");
+        close(fileDescriptor);
+        return 0;
+    }
+
+    FileIOBackend::BlockRequest coldRequest = { coldOffset, coldBuffer.data(), blockSize, 0 };
+    FileIOBackend::BlockRequest warmRequest = { warmOffset, warmBuffer.data(), blockSize, 0 };
+    std::atomic<int> numberOfThreadsDone(0);
+
+    std::thread coldThread([&]()
+    {
+        backend.readBlocks(&coldRequest, 1);
+        numberOfThreadsDone++;
+    });
+    // Start B while A sleeps in front of the kernel.
+    usleep(reaperDelayMicroseconds / 4);
+    std::thread warmThread([&]()
+    {
+        backend.readBlocks(&warmRequest, 1);
+        numberOfThreadsDone++;
+    });
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    while ((numberOfThreadsDone < 2) && ((std::chrono::steady_clock::now() - startTime) < std::chrono::seconds(10)))
+    {
+        usleep(10000);
+    }
+    if (numberOfThreadsDone < 2)
+    {
+        // A thread is stuck in readBlocks, so we can not join it.
+        fprintf(stderr, "FAILED: readBlocks did not return\n");
+        fflush(stderr);
+        _exit(1);
+    }
+    coldThread.join();
+    warmThread.join();
+
+    bool isSuccess = true;
+    if ((coldRequest.bytesRead != (ssize_t)blockSize) || (memcmp(coldBuffer.data(), &fileData[coldOffset], blockSize) != 0))
+    {
+        fprintf(stderr, "FAILED: wrong data at %lld\n", (long long)coldOffset);
+        isSuccess = false;
+    }
+    if ((warmRequest.bytesRead != (ssize_t)blockSize) || (memcmp(warmBuffer.data(), &fileData[warmOffset], blockSize) != 0))
+    {
+        fprintf(stderr, "FAILED: wrong data at %lld\n", (long long)warmOffset);
+        isSuccess = false;
+    }
+
+    backend.detach();
+    close(fileDescriptor);
+
+    if (isSuccess)
+    {
+        printf("OK\n");
+    }
+    return isSuccess ? 0 : 1;
+}
+
+#else
+
+int main()
+{
+    printf("io_uring is not available, nothing to test\n");
+    return 0;
+}
+
+#endif